@@ -43,8 +43,9 @@ namespace md{
    * T is the type of the values
    * S is the type of the satellites
    * B is the number of the pivots
+   * Alloc is the allocation policy of the nodes (see slab_allocator.hpp)
    */
-  template< typename K, typename S, size_t B = 7, size_t T = 3>
+  template< typename K, typename S, size_t B = 7, size_t T = 3, typename Alloc = dyn::slab_allocator<b_tree_tag>>
   class B_tree{
   public:
     typedef typename std::conditional<in_range_unsigned<uint8_t>(B),uint8_t,
@@ -55,8 +56,8 @@ namespace md{
                               >::type
                             >::type B_t;
 
-    typedef typename B_tree_node<K,S,B,T>::key_t key_t;
-    typedef typename B_tree_node<K,S,B,T>::shifted_key_ptr_t shifted_key_ptr_t;
+    typedef typename B_tree_node<K,S,B,T,Alloc>::key_t key_t;
+    typedef typename B_tree_node<K,S,B,T,Alloc>::shifted_key_ptr_t shifted_key_ptr_t;
 
     typedef struct tt_key{
       K value;
@@ -73,7 +74,7 @@ namespace md{
       }
 
       tt_key(key_t other):
-        value(other.value),satellites(*other.satellites)
+        value(other.value),satellites(other.satellites->begin(),other.satellites->end())
       {
 
       }
@@ -117,18 +118,46 @@ namespace md{
     shifted_key_ptr_t predecessor(const K &value_);
     shifted_key_ptr_t successor(const K &value_);
 
+    /*!
+     * The number of distinct keys in the set.
+     * Complexity: O(1)
+     */
+    size_t size();
+    /*!
+     * The number of keys smaller than value_.
+     * Complexity: O(log n)
+     * @param  value_ the value of the element y
+     * @return        the rank of y among the keys of the set.
+     */
+    size_t rank(const K &value_);
+    /*!
+     * The number of keys y with lo_ <= y <= hi_.
+     * Complexity: O(log n)
+     * @param  lo_ the lower bound of the range
+     * @param  hi_ the upper bound of the range (inclusive)
+     * @return     the number of keys in the range.
+     */
+    size_t count_range(const K &lo_, const K &hi_);
+    /*!
+     * Finds the element with k_ smaller keys in the set.
+     * Complexity: O(log n)
+     * @param  k_ the rank of the element (starting from 0)
+     * @return    the element if k_ < size(), nullptr otherwise.
+     */
+    shifted_key_ptr_t select(size_t k_);
+
 
-    B_tree<K,S,B,T>* shift(K &shift_);
-    B_tree<K,S,B,T>* join(B_tree<K,S,B,T>* rhs);
-    B_tree<K,S,B,T>* split(const K &value_);
-    B_tree<K,S,B,T>* merge(B_tree<K,S,B,T>* rhs);
+    B_tree<K,S,B,T,Alloc>* shift(K &shift_);
+    B_tree<K,S,B,T,Alloc>* join(B_tree<K,S,B,T,Alloc>* rhs);
+    B_tree<K,S,B,T,Alloc>* split(const K &value_);
+    B_tree<K,S,B,T,Alloc>* merge(B_tree<K,S,B,T,Alloc>* rhs);
 
     // Iterator: return one bitstring at a time
    class iterator{
    public:
      typedef iterator self_type;
      typedef std::pair<K,std::vector<S> > value_type;
-     typedef B_tree_node<K,S,B,T>* pointer;
+     typedef B_tree_node<K,S,B,T,Alloc>* pointer;
      /*!
       * Create an iterator that start from the first or from the last element.
       * @param current_   the head of the B-tree
@@ -161,12 +190,12 @@ namespace md{
      const value_type operator->() {
        shifted_key_ptr_t key_ptr = _current->get_key(_current_index);
        K value =  key_ptr.key->value + key_ptr.shift + _shift;
-       return std::make_pair((value),*(key_ptr.key->satellites));
+       return std::make_pair((value),std::vector<S>(key_ptr.key->satellites->begin(),key_ptr.key->satellites->end()));
      }
      const value_type operator*() {
        shifted_key_ptr_t key_ptr = _current->get_key(_current_index);
        K value =  key_ptr.key->value + key_ptr.shift + _shift;
-       return std::make_pair((value),*(key_ptr.key->satellites));
+       return std::make_pair((value),std::vector<S>(key_ptr.key->satellites->begin(),key_ptr.key->satellites->end()));
      }
      bool operator==(const self_type& rhs) { return _current == rhs._current; }
      bool operator!=(const self_type& rhs) { return _current != rhs._current; }
@@ -250,23 +279,23 @@ namespace md{
    }
 
   private:
-    B_tree_node<K,S,B,T>* _head;
+    B_tree_node<K,S,B,T,Alloc>* _head;
   }; // B_tree
 
   // Ctor
-  template< typename K, typename S, size_t B, size_t T>
-  B_tree<K,S,B,T>::B_tree():
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  B_tree<K,S,B,T,Alloc>::B_tree():
     _head(nullptr)
   {
     assert(T<= B && T > 1);
   }
 
   // Dtor
-  template< typename K, typename S, size_t B, size_t T>
-  B_tree<K,S,B,T>::~B_tree()
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  B_tree<K,S,B,T,Alloc>::~B_tree()
   {
     if(_head != nullptr)
-      delete _head;
+      Alloc::destroy(_head);
   }
 
   /*!
@@ -274,10 +303,10 @@ namespace md{
    * @param value_     the value of the element in the set.
    * @param satellite_ the satellite attached to the element in the set.
    */
-  template< typename K, typename S, size_t B, size_t T>
-  typename B_tree<K,S,B,T>::shifted_key_ptr_t B_tree<K,S,B,T>::make_set(K &value_, S &satellite_)
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  typename B_tree<K,S,B,T,Alloc>::shifted_key_ptr_t B_tree<K,S,B,T,Alloc>::make_set(K &value_, S &satellite_)
   {
-    _head = new B_tree_node<K,S,B,T>();
+    _head = Alloc::template create<B_tree_node<K,S,B,T,Alloc>>();
     return _head->insert(value_,satellite_);
   }
   /*!
@@ -285,13 +314,13 @@ namespace md{
    * @param value_     the value of the element to be inserted.
    * @param satellite_ the satellite attached to the element to be inserted.
    */
-  template< typename K, typename S, size_t B, size_t T>
-  typename B_tree<K,S,B,T>::shifted_key_ptr_t B_tree<K,S,B,T>::insert(K &value_, S &satellite_)
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  typename B_tree<K,S,B,T,Alloc>::shifted_key_ptr_t B_tree<K,S,B,T,Alloc>::insert(K &value_, S &satellite_)
   {
     if(_head == nullptr) return make_set(value_,satellite_);
 
     if(_head->is_full()){
-      B_tree_node<K,S,B,T>* tmp = new B_tree_node<K,S,B,T>(false);
+      B_tree_node<K,S,B,T,Alloc>* tmp = Alloc::template create<B_tree_node<K,S,B,T,Alloc>>(false);
       tmp->set_child(0,_head);
       tmp->split_child(0);
       _head = tmp;
@@ -303,19 +332,19 @@ namespace md{
    * Remove the element of value value_ from the set.
    * @param value_ the value of the element to be removed.
    */
-  template< typename K, typename S, size_t B, size_t T>
-  typename B_tree<K,S,B,T>::key_tt B_tree<K,S,B,T>::remove(K &value_)
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  typename B_tree<K,S,B,T,Alloc>::key_tt B_tree<K,S,B,T,Alloc>::remove(K &value_)
   {
     key_t res = _head->remove(value_);
     if(_head->get_n_keys() == 0){
-      delete _head;
+      Alloc::destroy(_head);
       _head = nullptr;
     }
 
     if(res.satellites != nullptr){
       key_tt res_(res);
 
-      delete res.satellites;
+      Alloc::destroy(res.satellites);
 
       return res_;
     }else{
@@ -331,8 +360,8 @@ namespace md{
    * @param  shift_ the shift to be applied
    * @return        the element y if it exists, nullptr otherwise.
    */
-   template< typename K, typename S, size_t B, size_t T>
-   typename B_tree<K,S,B,T>::shifted_key_ptr_t B_tree<K,S,B,T>::shift_greater(const K &value_,K &shift_)
+   template< typename K, typename S, size_t B, size_t T, typename Alloc>
+   typename B_tree<K,S,B,T,Alloc>::shifted_key_ptr_t B_tree<K,S,B,T,Alloc>::shift_greater(const K &value_,K &shift_)
    {
      if(_head != nullptr)
        return _head->shift_greater(value_,shift_);
@@ -344,8 +373,8 @@ namespace md{
    * @param  value_ the value of the element y
    * @return        the element y if it exists, NULL otherwise.
    */
-   template< typename K, typename S, size_t B, size_t T>
-   typename B_tree<K,S,B,T>::shifted_key_ptr_t B_tree<K,S,B,T>::search(const K &value_)
+   template< typename K, typename S, size_t B, size_t T, typename Alloc>
+   typename B_tree<K,S,B,T,Alloc>::shifted_key_ptr_t B_tree<K,S,B,T,Alloc>::search(const K &value_)
    {
      if(_head != nullptr)
        return _head->search(value_);
@@ -353,8 +382,8 @@ namespace md{
        return shifted_key_ptr_t();
    }
 
-   template< typename K, typename S, size_t B, size_t T>
-   typename B_tree<K,S,B,T>::shifted_key_ptr_t B_tree<K,S,B,T>::predecessor(const K &value_)
+   template< typename K, typename S, size_t B, size_t T, typename Alloc>
+   typename B_tree<K,S,B,T,Alloc>::shifted_key_ptr_t B_tree<K,S,B,T,Alloc>::predecessor(const K &value_)
    {
      if(_head != nullptr)
        return _head->predecessor(value_);
@@ -362,8 +391,8 @@ namespace md{
        return shifted_key_ptr_t();
    }
 
-   template< typename K, typename S, size_t B, size_t T>
-   typename B_tree<K,S,B,T>::shifted_key_ptr_t B_tree<K,S,B,T>::successor(const K &value_)
+   template< typename K, typename S, size_t B, size_t T, typename Alloc>
+   typename B_tree<K,S,B,T,Alloc>::shifted_key_ptr_t B_tree<K,S,B,T,Alloc>::successor(const K &value_)
    {
      if(_head != nullptr)
        return _head->successor(value_);
@@ -371,8 +400,43 @@ namespace md{
        return shifted_key_ptr_t();
    }
 
-   template< typename K, typename S, size_t B, size_t T>
-   B_tree<K,S,B,T>* B_tree<K,S,B,T>::shift(K &shift_)
+   template< typename K, typename S, size_t B, size_t T, typename Alloc>
+   size_t B_tree<K,S,B,T,Alloc>::size()
+   {
+     if(_head != nullptr)
+       return _head->get_count();
+     else
+       return 0;
+   }
+
+   template< typename K, typename S, size_t B, size_t T, typename Alloc>
+   size_t B_tree<K,S,B,T,Alloc>::rank(const K &value_)
+   {
+     if(_head != nullptr)
+       return _head->rank(value_);
+     else
+       return 0;
+   }
+
+   template< typename K, typename S, size_t B, size_t T, typename Alloc>
+   size_t B_tree<K,S,B,T,Alloc>::count_range(const K &lo_, const K &hi_)
+   {
+     if(_head == nullptr || key_less(hi_, lo_))
+       return 0;
+     return _head->rank(hi_, true) - _head->rank(lo_);
+   }
+
+   template< typename K, typename S, size_t B, size_t T, typename Alloc>
+   typename B_tree<K,S,B,T,Alloc>::shifted_key_ptr_t B_tree<K,S,B,T,Alloc>::select(size_t k_)
+   {
+     if(_head != nullptr)
+       return _head->select(k_);
+     else
+       return shifted_key_ptr_t();
+   }
+
+   template< typename K, typename S, size_t B, size_t T, typename Alloc>
+   B_tree<K,S,B,T,Alloc>* B_tree<K,S,B,T,Alloc>::shift(K &shift_)
    {
      if(_head != nullptr)
        _head->shift(shift_);
@@ -380,8 +444,8 @@ namespace md{
    }
 
 
-  template< typename K, typename S, size_t B, size_t T>
-  B_tree<K,S,B,T>* B_tree<K,S,B,T>::join(B_tree<K,S,B,T>* rhs)
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  B_tree<K,S,B,T,Alloc>* B_tree<K,S,B,T,Alloc>::join(B_tree<K,S,B,T,Alloc>* rhs)
   {
     if(_head == nullptr){
       _head = rhs->_head;
@@ -397,19 +461,19 @@ namespace md{
 
   }
 
-  template< typename K, typename S, size_t B, size_t T>
-  B_tree<K,S,B,T>* B_tree<K,S,B,T>::split(const K &value_)
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  B_tree<K,S,B,T,Alloc>* B_tree<K,S,B,T,Alloc>::split(const K &value_)
   {
-    B_tree<K,S,B,T>* rhs = new B_tree<K,S,B,T>();
+    B_tree<K,S,B,T,Alloc>* rhs = new B_tree<K,S,B,T,Alloc>();
 
     if(_head != nullptr){
       rhs->_head = _head->split(value_);
       if(rhs->_head->get_n_keys() == 0){
-        delete rhs->_head;
+        Alloc::destroy(rhs->_head);
         rhs->_head = nullptr;
       }
       if(_head->get_n_keys() == 0){
-        delete _head;
+        Alloc::destroy(_head);
         _head = nullptr;
       }
     }
@@ -418,8 +482,8 @@ namespace md{
 
   }
 
-  template< typename K, typename S, size_t B, size_t T>
-  B_tree<K,S,B,T>* B_tree<K,S,B,T>::merge(B_tree<K,S,B,T>* rhs)
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  B_tree<K,S,B,T,Alloc>* B_tree<K,S,B,T,Alloc>::merge(B_tree<K,S,B,T,Alloc>* rhs)
   {
     // ******************************************
     // COMMON PART
@@ -450,24 +514,24 @@ namespace md{
     // ******************************************
     // Farrach & Thorup merge algorithm
     // ******************************************
-    B_tree<K,S,B,T>* A = new B_tree<K,S,B,T>();
-    B_tree<K,S,B,T>* D = new B_tree<K,S,B,T>();
-    B_tree<K,S,B,T>* C = new B_tree<K,S,B,T>();
+    B_tree<K,S,B,T,Alloc>* A = new B_tree<K,S,B,T,Alloc>();
+    B_tree<K,S,B,T,Alloc>* D = new B_tree<K,S,B,T,Alloc>();
+    B_tree<K,S,B,T,Alloc>* C = new B_tree<K,S,B,T,Alloc>();
 
     A->_head = _head;
     D->_head = rhs->_head;
     do{
       K min_A = A->_head->get_min();
       K min_D = D->_head->get_min();
-      if(min_D < min_A){
+      if(key_less(min_D, min_A)){
         std::swap(A,D);
         std::swap(min_A,min_D);
       }
-      B_tree<K,S,B,T>* A_I = A;//new B_tree<K,S,B,T>();
+      B_tree<K,S,B,T,Alloc>* A_I = A;//new B_tree<K,S,B,T,Alloc>();
       A_I->_head = A->_head;
       A = A_I->split(min_D);
       // perform the pruning
-      B_tree<K,S,B,T>* eq_elem = A_I->split(min_D-1);
+      B_tree<K,S,B,T,Alloc>* eq_elem = A_I->split(min_D-1);
       if(eq_elem->_head != nullptr){
         shifted_key_ptr_t min_elem = D->_head->predecessor(min_D);
         for(auto sat: *(eq_elem->_head->get_key(0).key->satellites)){
@@ -35,27 +35,54 @@
 #include <typeinfo>
 #include <type_traits>
 #include <limits>
+#include "include/internal/slab_allocator.hpp"
 
 namespace md{
 
+  /*!
+   * Tag of the default allocation policy of the B-tree nodes and their satellite vectors
+   */
+  struct b_tree_tag{};
+
   template< typename T>
   constexpr bool in_range_unsigned(const long long int x)
   {
     return  ((x-std::numeric_limits<T>::min()) <= (std::numeric_limits<T>::max()-std::numeric_limits<T>::min()));
   }
 
+  /*!
+   * Order of two keys stored relative to the shifts of their nodes. A lazy shift may wrap the relative keys of
+   * unsigned types around, so unsigned keys are compared by their signed difference and the keys of one tree
+   * have to be less than 2^(bits-1) apart.
+   */
+  template< typename K>
+  inline typename std::enable_if<std::is_signed<K>::value,bool>::type key_less(const K& a, const K& b)
+  {
+    return a < b;
+  }
+
+  template< typename K>
+  inline typename std::enable_if<!std::is_signed<K>::value,bool>::type key_less(const K& a, const K& b)
+  {
+    return static_cast<typename std::make_signed<K>::type>(static_cast<K>(a - b)) < 0;
+  }
+
   /*!
    * K is the type of the key values
    * S is the type of the satellites
    * B is the number of the pivots
    * T is the minimum degree of the B-tree
+   * Alloc is the allocation policy of the nodes, the children arrays and the satellite vectors
    */
-  template< typename K, typename S, size_t B = 63, size_t T = 3>
+  template< typename K, typename S, size_t B = 63, size_t T = 3, typename Alloc = dyn::slab_allocator<b_tree_tag>>
   class B_tree_node{
   public:
+    // the satellites of a key, their element buffer is allocated with Alloc as well
+    typedef std::vector<S,dyn::policy_allocator<S,Alloc>> satellite_vector_t;
+
     typedef struct t_key{
       K value;
-      std::vector<S>* satellites;
+      satellite_vector_t* satellites;
 
       ~t_key(){
         // if(satellites != nullptr)
@@ -178,7 +205,7 @@ namespace md{
      * @param i the index of the child to be returned
      * @return  the i-th child of the node if it exists.
      */
-    B_tree_node<K,S,B,T>* get_child(B_t i);
+    B_tree_node<K,S,B,T,Alloc>* get_child(B_t i);
 
     /*!
      * Access the i-th key of the node.
@@ -197,7 +224,7 @@ namespace md{
      * Set the child as the i-th child of the node.
      * @param i the index of the child to be inserted into
      */
-    void set_child(B_t i, B_tree_node<K,S,B,T>* child);
+    void set_child(B_t i, B_tree_node<K,S,B,T,Alloc>* child);
 
     /*!
      * Finds the predecessor of the element of key value in the subtree rooted in this node.
@@ -213,7 +240,31 @@ namespace md{
      */
     shifted_key_ptr_t successor(K value);
 
-    friend void swap(B_tree_node<K,S,B,T>& first, B_tree_node<K,S,B,T>& second)
+    /*!
+     * The number of keys smaller than value (or smaller than or equal to value if inclusive) in the subtree
+     * rooted in this node.
+     * Complexity: O(B log_B(n))
+     * @param  value     the key of the element we look for.
+     * @param  inclusive true if a key equal to value is counted.
+     * @return           the number of keys.
+     */
+    size_t rank(K value, bool inclusive = false);
+
+    /*!
+     * Finds the element with k smaller keys in the subtree rooted in this node.
+     * Complexity: O(B log_B(n))
+     * @param  k the rank of the element (starting from 0).
+     * @return   a pointer to the element in the tree (nullptr if the subtree holds at most k keys).
+     */
+    shifted_key_ptr_t select(size_t k);
+
+    /*!
+     * The number of keys in the subtree rooted in this node.
+     * @return the number of keys in the subtree.
+     */
+    size_t get_count();
+
+    friend void swap(B_tree_node<K,S,B,T,Alloc>& first, B_tree_node<K,S,B,T,Alloc>& second)
     {
         using std::swap;
 
@@ -222,6 +273,7 @@ namespace md{
         }
         swap(first.n, second.n);
         swap(first.children, second.children);
+        swap(first._count, second._count);
     }
 
     /*!
@@ -229,9 +281,9 @@ namespace md{
      * than the greatest element of this.
      * @param other The other B-tree.
      */
-    void join(B_tree_node<K,S,B,T>* other);
+    void join(B_tree_node<K,S,B,T,Alloc>* other);
 
-    B_tree_node<K,S,B,T>* split(const K &value_, size_t *h_this = nullptr, size_t *h_rhs = nullptr);
+    B_tree_node<K,S,B,T,Alloc>* split(const K &value_, size_t *h_this = nullptr, size_t *h_rhs = nullptr);
 
     /*!
      * The height h of the tree rooted in this node.
@@ -290,11 +342,24 @@ namespace md{
           assert(children[i]->check_integrity());
         }
       }
+      size_t count = n;
+      if(!is_leaf()){
+        for(B_t i = 0; i < n+1; ++i){
+          count += children[i]->_count;
+        }
+      }
+      assert(_count == count);
       return true;
     }
 
   protected:
 
+    /*!
+     * Recomputes the number of keys in the subtree rooted in this node from the counts of its children.
+     * Has to be called bottom-up on every node whose keys or children changed.
+     */
+    void recount();
+
     void merge_children(B_t i, size_t* h_this = nullptr);
 
     void fuse_children(B_t i, size_t* h_this = nullptr);
@@ -320,7 +385,7 @@ namespace md{
      * @param h_this    the height of the tree
      * @param h_lhs     the height of the subtree to be joint
      */
-    void join_left(B_tree_node<K,S,B,T>* lhs, key_t max_value , size_t *h_this = nullptr, size_t *h_lhs = nullptr);
+    void join_left(B_tree_node<K,S,B,T,Alloc>* lhs, key_t max_value , size_t *h_this = nullptr, size_t *h_lhs = nullptr);
 
     /*!
      * Join the lhs subtree on the right spine of this tree, using the min_value
@@ -330,26 +395,28 @@ namespace md{
      * @param h_this    the height of the tree
      * @param h_rhs     the height of the subtree to be joint
      */
-    void join_right(B_tree_node<K,S,B,T>* rhs, key_t min_value , size_t *h_this = nullptr, size_t *h_rhs = nullptr);
+    void join_right(B_tree_node<K,S,B,T,Alloc>* rhs, key_t min_value , size_t *h_this = nullptr, size_t *h_rhs = nullptr);
 
 
   private:
     key_t keys[B];            // The keys of the node.
-    B_tree_node<K,S,B,T>** children; // The pointers to the children of the node. (if nullptr the node is a leaf)
+    B_tree_node<K,S,B,T,Alloc>** children; // The pointers to the children of the node. (if nullptr the node is a leaf)
     B_t n;                    // The number of keys in the node.
     K _shift;                    // The shift value of the node.
+    size_t _count;            // The number of keys in the subtree rooted in the node.
 
   }; // B_tree_node
 
   // Ctor
-  template< typename K, typename S, size_t B, size_t T>
-  B_tree_node<K,S,B,T>::B_tree_node(bool _is_leaf):
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  B_tree_node<K,S,B,T,Alloc>::B_tree_node(bool _is_leaf):
     children(nullptr),
     n(0),
-    _shift(0)
+    _shift(0),
+    _count(0)
   {
     if(!_is_leaf){
-      children = new B_tree_node<K,S,B,T>*[B+1];
+      children = static_cast<B_tree_node<K,S,B,T,Alloc>**>(Alloc::allocate((B+1)*sizeof(B_tree_node<K,S,B,T,Alloc>*)));
       for(B_t i = 0; i < B+1; ++i)
         children[i] = nullptr;
 
@@ -358,21 +425,21 @@ namespace md{
   }
 
   // Dtor
-  template< typename K, typename S, size_t B, size_t T>
-  B_tree_node<K,S,B,T>::~B_tree_node()
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  B_tree_node<K,S,B,T,Alloc>::~B_tree_node()
   {
     if(children != nullptr){
       for(B_t i = 0; i < n+1; ++i)
         if(children[i] != nullptr)
-          delete children[i];
+          Alloc::destroy(children[i]);
 
-      delete[] children;
+      Alloc::deallocate(children,(B+1)*sizeof(B_tree_node<K,S,B,T,Alloc>*));
     }
 
     for(B_t i = 0; i < B; ++i){
       if(keys[i].satellites != nullptr){
         assert(i<n);
-        delete keys[i].satellites;
+        Alloc::destroy(keys[i].satellites);
       }
     }
   }
@@ -383,8 +450,8 @@ namespace md{
    * @param i the index of the child to be returned
    * @return  the i-th child of the node if it exists.
    */
-  template< typename K, typename S, size_t B, size_t T>
-  B_tree_node<K,S,B,T>* B_tree_node<K,S,B,T>::get_child(B_t i)
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  B_tree_node<K,S,B,T,Alloc>* B_tree_node<K,S,B,T,Alloc>::get_child(B_t i)
   {
       if(i < n+1 && !is_leaf()){
           return children[i];
@@ -398,8 +465,8 @@ namespace md{
    * @return  the i-th key of the node if it exists.
    */
 
-  template< typename K, typename S, size_t B, size_t T>
-  typename B_tree_node<K,S,B,T>::shifted_key_ptr_t B_tree_node<K,S,B,T>::get_key(B_t i)
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  typename B_tree_node<K,S,B,T,Alloc>::shifted_key_ptr_t B_tree_node<K,S,B,T,Alloc>::get_key(B_t i)
   {
     if(i < n){
       return shifted_key_ptr_t(&keys[i],_shift);
@@ -411,8 +478,8 @@ namespace md{
    * The number of keys in the node.
    * @return the number of keys in the node.
    */
-  template< typename K, typename S, size_t B, size_t T>
-  typename B_tree_node<K,S,B,T>::B_t B_tree_node<K,S,B,T>::get_n_keys(){
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  typename B_tree_node<K,S,B,T,Alloc>::B_t B_tree_node<K,S,B,T,Alloc>::get_n_keys(){
     return n;
   }
 
@@ -420,33 +487,33 @@ namespace md{
    * Set the child as the i-th child of the node.
    * @param i the index of the child to be inserted into
    */
-  template< typename K, typename S, size_t B, size_t T>
-  void B_tree_node<K,S,B,T>::set_child(B_t i, B_tree_node<K,S,B,T>* child)
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  void B_tree_node<K,S,B,T,Alloc>::set_child(B_t i, B_tree_node<K,S,B,T,Alloc>* child)
   {
     if(children == nullptr)
-      children = new B_tree_node<K,S,B,T>*[B+1];
+      children = static_cast<B_tree_node<K,S,B,T,Alloc>**>(Alloc::allocate((B+1)*sizeof(B_tree_node<K,S,B,T,Alloc>*)));
 
     children[i] = child;
   }
 
-  template< typename K, typename S, size_t B, size_t T>
-  bool B_tree_node<K,S,B,T>::is_leaf()
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  bool B_tree_node<K,S,B,T,Alloc>::is_leaf()
   {
 
     return (children == nullptr);
 
   }
 
-  template< typename K, typename S, size_t B, size_t T>
-  bool B_tree_node<K,S,B,T>::is_full()
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  bool B_tree_node<K,S,B,T,Alloc>::is_full()
   {
 
     return (n == B);
 
   }
 
-  template< typename K, typename S, size_t B, size_t T>
-  K B_tree_node<K,S,B,T>::height()
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  K B_tree_node<K,S,B,T,Alloc>::height()
   {
     // if(n == 0 && children == nullptr) return 0;
     // else
@@ -454,32 +521,92 @@ namespace md{
     else return (children[0]->height() + 1);
   }
 
-  template< typename K, typename S, size_t B, size_t T>
-  K B_tree_node<K,S,B,T>::get_max()
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  K B_tree_node<K,S,B,T,Alloc>::get_max()
   {
     if(children == nullptr) return (keys[n-1].value + _shift);
     else return (children[n]->get_max() + _shift);
   }
 
-  template< typename K, typename S, size_t B, size_t T>
-  K B_tree_node<K,S,B,T>::get_min()
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  K B_tree_node<K,S,B,T,Alloc>::get_min()
   {
     if(children == nullptr) return (keys[0].value  + _shift);
     else return (children[0]->get_min() + _shift);
   }
 
-  template< typename K, typename S, size_t B, size_t T>
-  void B_tree_node<K,S,B,T>::shift(K shift_)
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  void B_tree_node<K,S,B,T,Alloc>::shift(K shift_)
   {
     _shift += shift_;
   }
 
-  template< typename K, typename S, size_t B, size_t T>
-  K B_tree_node<K,S,B,T>::get_shift()
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  K B_tree_node<K,S,B,T,Alloc>::get_shift()
   {
     return _shift;
   }
 
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  size_t B_tree_node<K,S,B,T,Alloc>::get_count()
+  {
+    return _count;
+  }
+
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  void B_tree_node<K,S,B,T,Alloc>::recount()
+  {
+    _count = n;
+    if(!is_leaf()){
+      for(B_t i = 0; i < n+1; ++i){
+        if(children[i] != nullptr)
+          _count += children[i]->_count;
+      }
+    }
+  }
+
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  size_t B_tree_node<K,S,B,T,Alloc>::rank(K value, bool inclusive)
+  {
+    // shift the value
+    value -= _shift;
+
+    // count the keys and the subtrees left of value
+    size_t below = 0;
+    B_t i = 0;
+    while(i < n && (key_less(keys[i].value, value) || (inclusive && keys[i].value == value))){
+      if(!is_leaf() && children[i] != nullptr)
+        below += children[i]->_count;
+      below++;
+      i++;
+    }
+
+    if(!is_leaf() && children[i] != nullptr)
+      below += children[i]->rank(value, inclusive);
+
+    return below;
+  }
+
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  typename B_tree_node<K,S,B,T,Alloc>::shifted_key_ptr_t B_tree_node<K,S,B,T,Alloc>::select(size_t k)
+  {
+    for(B_t i = 0; i < n+1; ++i){
+      if(!is_leaf() && children[i] != nullptr){
+        if(k < children[i]->_count){
+          shifted_key_ptr_t tmp_ptr = children[i]->select(k);
+          tmp_ptr.do_shift(_shift);
+          return tmp_ptr;
+        }
+        k -= children[i]->_count;
+      }
+      if(i < n){
+        if(k == 0) return shifted_key_ptr_t(&keys[i], _shift);
+        k--;
+      }
+    }
+    return shifted_key_ptr_t( nullptr, _shift);
+  }
+
     /*!
      * Finds the element of key value in the subtree rooted in this node and shifts all values having an
      * equal or greater key than key value.
@@ -488,8 +615,8 @@ namespace md{
      * @param  shift: the shift which is applied to the greater elements
      * @return       a pointer to the element in the tree.
      */
-    template< typename K, typename S, size_t B, size_t T>
-    typename B_tree_node<K,S,B,T>::shifted_key_ptr_t B_tree_node<K,S,B,T>::shift_greater(K value,K shift)
+    template< typename K, typename S, size_t B, size_t T, typename Alloc>
+    typename B_tree_node<K,S,B,T,Alloc>::shifted_key_ptr_t B_tree_node<K,S,B,T,Alloc>::shift_greater(K value,K shift)
     {
       cout<<"internal shift: "<<_shift<<"\n";
       value -= _shift;
@@ -500,7 +627,7 @@ namespace md{
       // Find the predecessor and successor in the node by performing a binary search
       while(r > l + 1){
         size_t mid = (l+r)/2;
-        if(keys[mid].value <= value){
+        if(!key_less(value, keys[mid].value)){
           l = mid;
         }else{
           r = mid;
@@ -510,8 +637,10 @@ namespace md{
       //if we have found the key in this node, shift all children and keys which are on the right of the key
       if(keys[l].value == value && keys[l].satellites != nullptr){
         for(B_t s=l;s<=n;s++){
-          keys[s].value=keys[s].value+shift;
-          auto keyt =get_key(s);
+          //keys[n] lies behind the last key (and behind the array if the node is full)
+          if(s<n){
+            keys[s].value=keys[s].value+shift;
+          }
           cout<<"Before error\n";
           if(s>l){
             if(!is_leaf() && children[s] != nullptr){
@@ -527,11 +656,13 @@ namespace md{
       }
 
       // If it is greater than the largest element among the pivots the child is the rightmost one
-      if(keys[l].value < value){
+      if(key_less(keys[l].value, value)){
         l++;
       }
       for(B_t s=l;s<=n;s++){
-        keys[s].value=keys[s].value+shift;
+        if(s<n){
+          keys[s].value=keys[s].value+shift;
+        }
         if(s>l){
           if(!(children == nullptr)){
             auto child=children[s];
@@ -555,8 +686,8 @@ namespace md{
    * @param  value the key of the element we look for.
    * @return       a pointer to the element in the tree.
    */
-  template< typename K, typename S, size_t B, size_t T>
-  typename B_tree_node<K,S,B,T>::shifted_key_ptr_t B_tree_node<K,S,B,T>::search(K value)
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  typename B_tree_node<K,S,B,T,Alloc>::shifted_key_ptr_t B_tree_node<K,S,B,T,Alloc>::search(K value)
   {
     // shift the value
     value -= _shift;
@@ -567,7 +698,7 @@ namespace md{
     // Find the predecessor and successor of value
     while(r > l + 1){
       size_t mid = (l+r)/2;
-      if(keys[mid].value <= value){
+      if(!key_less(value, keys[mid].value)){
         l = mid;
       }else{
         r = mid;
@@ -577,7 +708,7 @@ namespace md{
     if(keys[l].value == value && keys[l].satellites != nullptr) return shifted_key_ptr_t(&keys[l], _shift);
 
     // If it is greater than the largest element among the pivots the children is the rightmost one
-    if(keys[l].value < value) l++;
+    if(key_less(keys[l].value, value)) l++;
 
     if(!is_leaf() && children[l] != nullptr){
 
@@ -595,8 +726,8 @@ namespace md{
    * @param  value the key of the element we look for.
    * @return       a pointer to the element in the tree.
    */
-  template< typename K, typename S, size_t B, size_t T>
-  typename B_tree_node<K,S,B,T>::shifted_key_ptr_t B_tree_node<K,S,B,T>::predecessor(K value)
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  typename B_tree_node<K,S,B,T,Alloc>::shifted_key_ptr_t B_tree_node<K,S,B,T,Alloc>::predecessor(K value)
   {
     // shift the value
     value -= _shift;
@@ -607,17 +738,20 @@ namespace md{
     // Find the predecessor and successor of value
     while(r > l + 1){
       size_t mid = (l+r)/2;
-      if(keys[mid].value <= value){
+      if(!key_less(value, keys[mid].value)){
         l = mid;
       }else{
         r = mid;
       }
     }
 
-    if(is_leaf() && keys[l].value <= value && keys[l].satellites != nullptr) return shifted_key_ptr_t(&keys[l],_shift);
+    if(is_leaf() && !key_less(value, keys[l].value) && keys[l].satellites != nullptr) return shifted_key_ptr_t(&keys[l],_shift);
+
+    // a pivot equal to value is its own predecessor, the left child only holds smaller keys
+    if(!is_leaf() && n > 0 && keys[l].value == value) return shifted_key_ptr_t(&keys[l],_shift);
 
     // If it is greater than the largest element among the pivots the children is the rightmost one
-    if(keys[l].value < value) l++;
+    if(key_less(keys[l].value, value)) l++;
 
     shifted_key_ptr_t ans( nullptr, _shift);
 
@@ -626,8 +760,9 @@ namespace md{
       ans.do_shift(_shift);
     }
 
-    if(ans.key == nullptr && l > 0 && keys[l-1].value <= value){
-      ans.key = &keys[l-1];
+    // the shift of the child must not be applied to the own key
+    if(ans.key == nullptr && l > 0 && !key_less(value, keys[l-1].value)){
+      ans = shifted_key_ptr_t(&keys[l-1], _shift);
     }
 
     return ans;
@@ -638,8 +773,8 @@ namespace md{
    * @param  value the key of the element we look for.
    * @return       a pointer to the element in the tree.
    */
-  template< typename K, typename S, size_t B, size_t T>
-  typename B_tree_node<K,S,B,T>::shifted_key_ptr_t B_tree_node<K,S,B,T>::successor(K value)
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  typename B_tree_node<K,S,B,T,Alloc>::shifted_key_ptr_t B_tree_node<K,S,B,T,Alloc>::successor(K value)
   {
 
     // shift the value
@@ -651,7 +786,7 @@ namespace md{
     // Find the successor and successor of value
     while(r > l + 1){
       size_t mid = (l+r)/2;
-      if(keys[mid].value <= value){
+      if(!key_less(value, keys[mid].value)){
         l = mid;
       }else{
         r = mid;
@@ -659,9 +794,9 @@ namespace md{
     }
 
     // If it is greater than the largest element among the pivots the children is the rightmost one
-    if(keys[l].value > value) r--;
+    if(key_less(value, keys[l].value)) r--;
 
-    if(is_leaf() && r < n && keys[r].value > value && keys[r].satellites != nullptr) return shifted_key_ptr_t(&keys[r], _shift);
+    if(is_leaf() && r < n && key_less(value, keys[r].value) && keys[r].satellites != nullptr) return shifted_key_ptr_t(&keys[r], _shift);
 
     shifted_key_ptr_t ans( nullptr, _shift);
 
@@ -670,8 +805,9 @@ namespace md{
       ans.do_shift(_shift);
     }
 
-    if(ans.key == nullptr && r < n && keys[r].value > value){
-      ans.key = &keys[r];
+    // the shift of the child must not be applied to the own key
+    if(ans.key == nullptr && r < n && key_less(value, keys[r].value)){
+      ans = shifted_key_ptr_t(&keys[r], _shift);
     }
 
     return ans;
@@ -682,8 +818,8 @@ namespace md{
    * @param value     the key of the element that has to be inserted.
    * @param satellite the satellite information attached to the element.
    */
-  template< typename K, typename S, size_t B, size_t T>
-  typename B_tree_node<K,S,B,T>::shifted_key_ptr_t B_tree_node<K,S,B,T>::insert(K value, S satellite)
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  typename B_tree_node<K,S,B,T,Alloc>::shifted_key_ptr_t B_tree_node<K,S,B,T,Alloc>::insert(K value, S satellite)
   {
     // shift the value
     value -= _shift;
@@ -700,18 +836,19 @@ namespace md{
 
       // Create the new element
       keys[n].value = value;
-      keys[n].satellites = new std::vector<S>();
+      keys[n].satellites = Alloc::template create<satellite_vector_t>();
       keys[n].satellites->push_back(satellite);
 
       // Bubble the new element in the correct position
       B_t i = 0;
 
-      while(i < n && keys[n-i-1].value > value){
+      while(i < n && key_less(value, keys[n-i-1].value)){
         std::swap(keys[n-i-1],keys[n-i]);
         i++;
       }
 
       n++;
+      _count++;
       return shifted_key_ptr_t( &keys[n-i-1], _shift );
     }
 
@@ -721,7 +858,7 @@ namespace md{
     // Find the predecessor and successor of value
     while(r > l + 1){
       size_t mid = (l+r)/2;
-      if(keys[mid].value <= value){
+      if(!key_less(value, keys[mid].value)){
         l = mid;
       }else{
         r = mid;
@@ -734,7 +871,7 @@ namespace md{
       return shifted_key_ptr_t( &keys[l], _shift);
     }
 
-    if(keys[l].value < value) l++;
+    if(key_less(keys[l].value, value)) l++;
 
     if(children[l] != nullptr){
         // if the child is full, split it
@@ -746,14 +883,15 @@ namespace md{
             return shifted_key_ptr_t( &keys[l], _shift);
           }
 
-          if(keys[l].value < value) l++;
+          if(key_less(keys[l].value, value)) l++;
         }
     }else{
-      children[l] = new B_tree_node<K,S,B,T>();
+      children[l] = Alloc::template create<B_tree_node<K,S,B,T,Alloc>>();
     }
 
     // Insert the element in the child
     shifted_key_ptr_t ans = children[l]->insert(value,satellite);
+    recount();
 
     ans.do_shift( _shift );
     return ans;
@@ -764,8 +902,8 @@ namespace md{
    * @param  value the key value of the element to be removed
    * @return       the removed element with its satellite informations.
    */
-  template< typename K, typename S, size_t B, size_t T>
-  typename B_tree_node<K,S,B,T>::key_t B_tree_node<K,S,B,T>::remove(K value)
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  typename B_tree_node<K,S,B,T,Alloc>::key_t B_tree_node<K,S,B,T,Alloc>::remove(K value)
   {
 
     // shift the value
@@ -778,7 +916,7 @@ namespace md{
     // Find the predecessor and successor of value
     while(r > l + 1){
       size_t mid = (l+r)/2;
-      if(keys[mid].value <= value){
+      if(!key_less(value, keys[mid].value)){
         l = mid;
       }else{
         r = mid;
@@ -806,8 +944,8 @@ namespace md{
       }
     }else if(keys[l].value == value){
       // Case 2. If the value is in the node and the node is an internal node.
-      B_tree_node<K,S,B,T>* y = children[l];
-      B_tree_node<K,S,B,T>* z = children[l+1];
+      B_tree_node<K,S,B,T,Alloc>* y = children[l];
+      B_tree_node<K,S,B,T,Alloc>* z = children[l+1];
       if(y->n >= T){
         // Case 2.a) If the child y that precedes value in the node has at least T keys, then
         // find the predecessor of value in the subtree rooted in y.
@@ -834,16 +972,19 @@ namespace md{
       }else{
         // Case 2.c) Otherwise, if both y and z have less than T - 1 keys.
         // merge y and z.
+        // The recursive call shifts the value again (and the merge may change the shift of the node)
+        value += _shift;
         merge_children(l);
         res = remove(value);
+        res.value -= _shift;
       }
 
     }else{
       // Case 3. If value is not in the node. Determine the root of the subtree that must contain value.
-      if(keys[l].value < value) l++;
-      B_tree_node<K,S,B,T>* c = children[l];
-      B_tree_node<K,S,B,T>* lhs = nullptr;
-      B_tree_node<K,S,B,T>* rhs = nullptr;
+      if(key_less(keys[l].value, value)) l++;
+      B_tree_node<K,S,B,T,Alloc>* c = children[l];
+      B_tree_node<K,S,B,T,Alloc>* lhs = nullptr;
+      B_tree_node<K,S,B,T,Alloc>* rhs = nullptr;
       if(l > 0) lhs = children[l-1];
       if(l < n) rhs = children[l+1];
       // If c has only T - 1 keys
@@ -875,6 +1016,7 @@ namespace md{
 
           if(!lhs->is_leaf()) lhs->children[lhs->n] = nullptr;
           lhs->n--;
+          lhs->recount();
 
 
           res = c->remove(value);
@@ -900,10 +1042,13 @@ namespace md{
           // Bubble the element of rhs to the left
 
           rhs->shift_left(0);
+          rhs->recount();
 
           res = c->remove(value);
         }else{
           // Case 3.b) If c and both its immediate siblings have T-1 keys.
+          // Unshift the value before merging, the merge may change the shift of the node
+          value += _shift;
           if(l > 0){
             merge_children(l-1);
             // res = children[l-1]->remove(value);
@@ -911,7 +1056,6 @@ namespace md{
             merge_children(l);
             // res = children[l]->remove(value);
           }
-          value += _shift;
           res = remove(value);
           res.value -= _shift;
         }
@@ -921,6 +1065,7 @@ namespace md{
 
 
     }
+    recount();
     // shift the result
     res.value += _shift;
 
@@ -931,12 +1076,12 @@ namespace md{
    * Split the child at index i into two.
    * @param index the index of the child to be splitted
    */
-  template< typename K, typename S, size_t B, size_t T>
-  void B_tree_node<K,S,B,T>::split_child(B_t index)
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  void B_tree_node<K,S,B,T,Alloc>::split_child(B_t index)
   {
 
-    B_tree_node<K,S,B,T>* lhs = children[index];
-    B_tree_node<K,S,B,T>* rhs = new B_tree_node<K,S,B,T>(lhs->is_leaf());
+    B_tree_node<K,S,B,T,Alloc>* lhs = children[index];
+    B_tree_node<K,S,B,T,Alloc>* rhs = Alloc::template create<B_tree_node<K,S,B,T,Alloc>>(lhs->is_leaf());
 
     // Shift rhs
     rhs->_shift = lhs->_shift;
@@ -968,7 +1113,7 @@ namespace md{
    children[n+1] = rhs;
    // Bubble the median in the correct place
    B_t i = n;
-   while(i > 0 && keys[i-1].value > keys[i].value){
+   while(i > 0 && key_less(keys[i].value, keys[i-1].value)){
 
      std::swap(children[i], children[i+1]);
      std::swap(keys[i-1], keys[i]);
@@ -979,6 +1124,10 @@ namespace md{
    rhs->n = lhs->n - (median_pos + 1);
    lhs->n = median_pos;
 
+   lhs->recount();
+   rhs->recount();
+   recount();
+
   }
 
   /*!
@@ -986,8 +1135,8 @@ namespace md{
    * i.e., pos <- pos + 1
    * @param pos the position that has to be overwritten.
    */
-   template< typename K, typename S, size_t B, size_t T>
-   void B_tree_node<K,S,B,T>::shift_left(B_t pos)
+   template< typename K, typename S, size_t B, size_t T, typename Alloc>
+   void B_tree_node<K,S,B,T,Alloc>::shift_left(B_t pos)
   {
     // Shift left the elements in the node
     if(is_leaf()){
@@ -1016,8 +1165,8 @@ namespace md{
    * i.e., pos + offset <- pos
    * @param pos the position that has to be overwritten.
    */
-   template< typename K, typename S, size_t B, size_t T>
-   void B_tree_node<K,S,B,T>::shift_right(B_t pos, B_t offset)
+   template< typename K, typename S, size_t B, size_t T, typename Alloc>
+   void B_tree_node<K,S,B,T,Alloc>::shift_right(B_t pos, B_t offset)
   {
     // Shift left the elements in the node
     if(is_leaf()){
@@ -1053,14 +1202,14 @@ namespace md{
    * Merge the children i and i+1 together
    * @param i the position of the key such that the preceding and following children have to be merged
    */
-  template< typename K, typename S, size_t B, size_t T>
-  void B_tree_node<K,S,B,T>::merge_children(B_t i, size_t* h_this)
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  void B_tree_node<K,S,B,T,Alloc>::merge_children(B_t i, size_t* h_this)
   {
     assert(i < n);
     assert( (B_t)(children[i]->n + children[i+1]->n + 1) <= B);
 
-    B_tree_node<K,S,B,T>* lhs = children[i];
-    B_tree_node<K,S,B,T>* rhs = children[i+1];
+    B_tree_node<K,S,B,T,Alloc>* lhs = children[i];
+    B_tree_node<K,S,B,T,Alloc>* rhs = children[i+1];
 
     B_t median_pos = lhs->n;
     // Move the i-th key as median of the new node.
@@ -1099,12 +1248,13 @@ namespace md{
 
    }
    lhs->n = median_pos + rhs->n + 1;
+   lhs->recount();
 
    // Shift left the elements in the node
    std::swap(children[i],children[i+1]);
 
    shift_left(i);
-   delete rhs;
+   Alloc::destroy(rhs);
 
    // Shrinking the height
    if(n == 0){
@@ -1117,11 +1267,12 @@ namespace md{
      _shift+= lhs->_shift;
 
      lhs->children[0] = nullptr;
-     delete lhs;
+     Alloc::destroy(lhs);
 
      // Update the height of the subtree
      if(h_this != nullptr) (*h_this)--;
    }
+   recount();
 
   }
 
@@ -1129,13 +1280,13 @@ namespace md{
    * Fuse the children i and i+1 together
    * @param i the position of the key that has to be fused with following children have to be merged
    */
-  template< typename K, typename S, size_t B, size_t T>
-  void B_tree_node<K,S,B,T>::fuse_children(B_t i, size_t* h_this)
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  void B_tree_node<K,S,B,T,Alloc>::fuse_children(B_t i, size_t* h_this)
   {
     assert(i < n);
 
-    B_tree_node<K,S,B,T>* lhs = children[i];
-    B_tree_node<K,S,B,T>* rhs = children[i+1];
+    B_tree_node<K,S,B,T,Alloc>* lhs = children[i];
+    B_tree_node<K,S,B,T,Alloc>* rhs = children[i+1];
 
     // If the total number of keys is smaller than or equals to B then merge.
     if( (B_t)(lhs->n + rhs->n + 1) <= B){
@@ -1148,8 +1299,12 @@ namespace md{
       size_t median_pos = (lhs->n + rhs->n + 1) >> 1;
 
       // The children are balanced
-      if(median_pos == lhs->n || median_pos == rhs->n)
+      if(median_pos == lhs->n || median_pos == rhs->n){
+        lhs->recount();
+        rhs->recount();
+        recount();
         return;
+      }
 
       if(median_pos < lhs->n){
         // The median key is in the left child
@@ -1314,6 +1469,9 @@ namespace md{
 
 
       }
+      lhs->recount();
+      rhs->recount();
+      recount();
     }
 
 
@@ -1327,11 +1485,11 @@ namespace md{
    * @param h_this    the height of the tree
    * @param h_lhs     the height of the subtree to be joint
    */
- template< typename K, typename S, size_t B, size_t T>
- void B_tree_node<K,S,B,T>::join_left(B_tree_node<K,S,B,T>* lhs, key_t max_key , size_t *h_this, size_t *h_lhs)
+ template< typename K, typename S, size_t B, size_t T, typename Alloc>
+ void B_tree_node<K,S,B,T,Alloc>::join_left(B_tree_node<K,S,B,T,Alloc>* lhs, key_t max_key , size_t *h_this, size_t *h_lhs)
   {
-    B_tree_node<K,S,B,T>* t1 = this;
-    B_tree_node<K,S,B,T>* t2 = lhs;
+    B_tree_node<K,S,B,T,Alloc>* t1 = this;
+    B_tree_node<K,S,B,T,Alloc>* t2 = lhs;
 
     // Check if the heads are not null
     if(t2 == nullptr){
@@ -1354,13 +1512,14 @@ namespace md{
 
     // Test if the root is full and if so, split it.
     if(t1->is_full()){
-      B_tree_node<K,S,B,T>* tmp = new B_tree_node<K,S,B,T>(false);
+      B_tree_node<K,S,B,T,Alloc>* tmp = Alloc::template create<B_tree_node<K,S,B,T,Alloc>>(false);
       // std::swap(*this,tmp);
       for(B_t i = 0; i < B; ++i){
         std::swap(keys[i], tmp->keys[i]);
       }
       std::swap(children, tmp->children);
       std::swap(n, tmp->n);
+      std::swap(_count, tmp->_count);
       // shift+= tmp->shift;
 
       children[0] = tmp;
@@ -1371,10 +1530,14 @@ namespace md{
 
     // From this point on we have that h2 < h1.
 
+    // The nodes on the left spine gaining the keys of t2
+    std::vector<B_tree_node<K,S,B,T,Alloc>*> spine;
+
     // Find the node on the left spine of t1 at height (h1 - h2)
     while( h1 > h2 + 1 ){
 
-      B_tree_node<K,S,B,T>* t1_child = t1->children[0];
+      spine.push_back(t1);
+      B_tree_node<K,S,B,T,Alloc>* t1_child = t1->children[0];
       // if the child is full, split it
       if(t1_child->is_full()){
         t1->split_child(0);
@@ -1404,6 +1567,12 @@ namespace md{
     // Fuse t1_child and t2
     t1->fuse_children(0);
 
+    // Update the counts of the spine bottom-up
+    while(!spine.empty()){
+      spine.back()->recount();
+      spine.pop_back();
+    }
+
 
 
   }
@@ -1417,11 +1586,11 @@ namespace md{
    * @param h_this    the height of the tree
    * @param h_rhs     the height of the subtree to be joint
    */
- template< typename K, typename S, size_t B, size_t T>
- void B_tree_node<K,S,B,T>::join_right(B_tree_node<K,S,B,T>* rhs, key_t min_key , size_t *h_this, size_t *h_rhs)
+ template< typename K, typename S, size_t B, size_t T, typename Alloc>
+ void B_tree_node<K,S,B,T,Alloc>::join_right(B_tree_node<K,S,B,T,Alloc>* rhs, key_t min_key , size_t *h_this, size_t *h_rhs)
   {
-    B_tree_node<K,S,B,T>* t1 = this;
-    B_tree_node<K,S,B,T>* t2 = rhs;
+    B_tree_node<K,S,B,T,Alloc>* t1 = this;
+    B_tree_node<K,S,B,T,Alloc>* t2 = rhs;
 
     // Check if the heads are not null
     if(t2 == nullptr){
@@ -1446,13 +1615,14 @@ namespace md{
 
     // Test if the root is full and if so, split it.
     if(t1->is_full()){
-      B_tree_node<K,S,B,T>* tmp = new B_tree_node<K,S,B,T>(false);
+      B_tree_node<K,S,B,T,Alloc>* tmp = Alloc::template create<B_tree_node<K,S,B,T,Alloc>>(false);
       // std::swap(*this,tmp);
       for(B_t i = 0; i < B; ++i){
         std::swap(keys[i], tmp->keys[i]);
       }
       std::swap(children, tmp->children);
       std::swap(n, tmp->n);
+      std::swap(_count, tmp->_count);
 
       children[0] = tmp;
       this->split_child(0);
@@ -1463,7 +1633,7 @@ namespace md{
     // If t1 and t2 have the same heights
     if (h1 == h2){
       // Create a new node
-      B_tree_node<K,S,B,T>* tmp = new B_tree_node<K,S,B,T>(false);
+      B_tree_node<K,S,B,T,Alloc>* tmp = Alloc::template create<B_tree_node<K,S,B,T,Alloc>>(false);
       // std::swap(*this,tmp);
       for(B_t i = 0; i < B; ++i){
         std::swap(keys[i], tmp->keys[i]);
@@ -1471,6 +1641,7 @@ namespace md{
       std::swap(children, tmp->children);
       std::swap(n, tmp->n);
       std::swap(_shift, tmp->_shift);
+      std::swap(_count, tmp->_count);
       // Place the max element of T as the median key in the new node
       t1->keys[0] = min_key;
       // Shift the key
@@ -1483,10 +1654,14 @@ namespace md{
       // Fuse t1 and t2
       t1->fuse_children(0, h_this);
     }else{
+      // The nodes on the right spine gaining the keys of t2
+      std::vector<B_tree_node<K,S,B,T,Alloc>*> spine;
+
       // Find the node on the right spine of t1 at height (h1 - h2)
       while( h1 > h2 + 1 ){
 
-        B_tree_node<K,S,B,T>* t1_child = t1->children[t1->n];
+        spine.push_back(t1);
+        B_tree_node<K,S,B,T,Alloc>* t1_child = t1->children[t1->n];
         // if the child is full, split it
         if(t1_child->is_full()){
           t1->split_child(t1->n);
@@ -1516,6 +1691,11 @@ namespace md{
       // Fuse t1_child and t2
       t1->fuse_children(t1->n - 1, h_this);
 
+      // Update the counts of the spine bottom-up
+      while(!spine.empty()){
+        spine.back()->recount();
+        spine.pop_back();
+      }
     }
 
 
@@ -1524,11 +1704,11 @@ namespace md{
   }
 
 
-  template< typename K, typename S, size_t B, size_t T>
-  void B_tree_node<K,S,B,T>::join(B_tree_node<K,S,B,T>* other)
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  void B_tree_node<K,S,B,T,Alloc>::join(B_tree_node<K,S,B,T,Alloc>* other)
   {
-    B_tree_node<K,S,B,T>* t1 = this;
-    B_tree_node<K,S,B,T>* t2 = other;
+    B_tree_node<K,S,B,T,Alloc>* t1 = this;
+    B_tree_node<K,S,B,T,Alloc>* t2 = other;
 
     // Check if the heads are not null
     if(t2 == nullptr){
@@ -1540,7 +1720,7 @@ namespace md{
     // K t2_max = t2->get_max();
     // K t2_min = t2->get_min();
 
-    assert(t1_max < t2->get_min());
+    assert(key_less(t1_max, t2->get_min()));
 
     // Remove the max element of t1 from t1
     key_t t1_max_key = t1->remove(t1_max);
@@ -1565,6 +1745,7 @@ namespace md{
       std::swap(t1->children, t2->children);
       std::swap(t1->n, t2->n);
       std::swap(t1->_shift, t2->_shift);
+      std::swap(t1->_count, t2->_count);
 
       std::swap(h1, h2);
 
@@ -1573,8 +1754,8 @@ namespace md{
 
   }
 
-  template< typename K, typename S, size_t B, size_t T>
-  B_tree_node<K,S,B,T>* B_tree_node<K,S,B,T>::split(const K &value_, size_t *h_this, size_t *h_rhs)
+  template< typename K, typename S, size_t B, size_t T, typename Alloc>
+  B_tree_node<K,S,B,T,Alloc>* B_tree_node<K,S,B,T,Alloc>::split(const K &value_, size_t *h_this, size_t *h_rhs)
   {
     // Shift the value
     K value = value_ - _shift;
@@ -1597,18 +1778,18 @@ namespace md{
     // Find the predecessor and successor of value
     while(r > l + 1){
       size_t mid = (l+r)/2;
-      if(keys[mid].value <= value){
+      if(!key_less(value, keys[mid].value)){
         l = mid;
       }else{
         r = mid;
       }
     }
 
-    if(keys[l].value <= value) l++;
+    if(!key_less(value, keys[l].value)) l++;
     // l contains the index of the child that has to be split.
 
     // split the current node around the element l
-    B_tree_node<K,S,B,T>* rhs = new B_tree_node<K,S,B,T>(is_leaf());
+    B_tree_node<K,S,B,T,Alloc>* rhs = Alloc::template create<B_tree_node<K,S,B,T,Alloc>>(is_leaf());
     // Shift rhs
     rhs->_shift = _shift;
 
@@ -1623,17 +1804,19 @@ namespace md{
       }
       rhs->n = n-l;
       n = l;
+      rhs->recount();
+      recount();
 
     }else{
       // Disconnect the l-th child from this node
-      B_tree_node<K,S,B,T>* lhs_child = children[l];
+      B_tree_node<K,S,B,T,Alloc>* lhs_child = children[l];
       children[l] = nullptr;
 
       // Split the l-th child
       // Get the height of the children subtree
       size_t h_sub_tree = (*h_this) -1;
       size_t h_rhs_sub_tree = (*h_this) -1;
-      B_tree_node<K,S,B,T>* rhs_child = lhs_child->split(value, &h_sub_tree, &h_rhs_sub_tree);
+      B_tree_node<K,S,B,T,Alloc>* rhs_child = lhs_child->split(value, &h_sub_tree, &h_rhs_sub_tree);
       // Shift the rhs_child and the lhs_child
       rhs_child->_shift += _shift;
       lhs_child->_shift += _shift;
@@ -1643,7 +1826,7 @@ namespace md{
       // Popolate the rhs node
       if( l == n ){
 
-        delete rhs;
+        Alloc::destroy(rhs);
         rhs = rhs_child;
         // Update the height of rhs
         (*h_rhs) = (h_rhs_sub_tree);
@@ -1681,7 +1864,7 @@ namespace md{
 
         if(l == (B_t)(n-1)){
           // rhs is empty
-          delete rhs;
+          Alloc::destroy(rhs);
           rhs = children[l+1];
           children[l+1] = nullptr;
           // Shift rhs
@@ -1734,9 +1917,10 @@ namespace md{
         std::swap(n, lhs_child->n);
         std::swap(children, lhs_child->children);
         std::swap(_shift, lhs_child->_shift);
+        std::swap(_count, lhs_child->_count);
         // _shift += lhs_child->_shift;
         lhs_child->children[0] = nullptr;
-        delete lhs_child;
+        Alloc::destroy(lhs_child);
         // Update the height of this subtree
         (*h_this) = (h_sub_tree);
       }else{
@@ -1754,15 +1938,16 @@ namespace md{
         if(l == 1){
           // Swap this with its child
           // std::swap(*this,children[0]);
-          B_tree_node<K,S,B,T>* other = children[0];
+          B_tree_node<K,S,B,T,Alloc>* other = children[0];
           for(B_t i = 0; i < B; ++i){
             std::swap(keys[i], other->keys[i]);
           }
           std::swap(n, other->n);
           std::swap(children, other->children);
+          std::swap(_count, other->_count);
           _shift += other->_shift;
           other->children[0] = nullptr;
-          delete other;
+          Alloc::destroy(other);
           // Update the height of this subtree
           (*h_this)--;
 
@@ -1772,6 +1957,8 @@ namespace md{
 
 
       }
+      rhs->recount();
+      recount();
 
 
 
@@ -13,20 +13,34 @@
 
 #include "B-tree.hh"
 #include "B_tree_node.hh"
+#include "undo_journal.h"
+#include "kmer_frequency.h"
+#include "change_feed.h"
+#include "packed_kmers.h"
 
 using namespace std;
 using namespace md;
 
+/*
+* Switch for the debug output of the tree updates: while it is set, the update functions print the whole minimizer
+* tree after every update. Benchmarks clear it, so that they time the update and not the output.
+*/
+inline bool& print_updated_minimizer_trees(){
+  static bool enabled=true;
+  return enabled;
+}
+
 /*!
  * Print all elements stored in the B-tree to the command line
  * @param minimizerTree:    the B-tree to be printed
  */
-void print_minimizerTree(B_tree<int,std::string,7,3>* minimizerTree){
+template<class Pos>
+void print_minimizerTree(B_tree<Pos,std::string,7,3>* minimizerTree){
   //int i = 0;
   for(auto elem: *minimizerTree){
-    int minikey=elem.first;
+    Pos minikey=elem.first;
     auto elem3 = minimizerTree->search(minikey);
-    std::vector<std::string> es2=*elem3.key->satellites;
+    auto& es2=*elem3.key->satellites;
     std::string sequence=es2[0];
     cout<<"Minimizer at "<<elem.first<<":" <<sequence<<"\n";
     //i+= 1;
@@ -37,9 +51,10 @@ void print_minimizerTree(B_tree<int,std::string,7,3>* minimizerTree){
  * @param minimizerTree:    the B-tree to be filled
  * @param minis:    the set of minimizers to be stored in the B-tree
  */
-void fill_minimizer_tree(B_tree<int,std::string,7,3>* minimizerTree,vector<Minimizer> minis){
-  for(int i=0;i<minis.size();i++){
-    int position=minis[i].getPosition();
+template<class Pos>
+void fill_minimizer_tree(B_tree<Pos,std::string,7,3>* minimizerTree,vector<BasicMinimizer<Pos>> minis){
+  for(int i=0;i<(int)minis.size();i++){
+    Pos position=minis[i].getPosition();
     std::string satelliteval =minis[i].getSequence();
     minimizerTree->insert(position,satelliteval);
   }
@@ -50,43 +65,117 @@ void fill_minimizer_tree(B_tree<int,std::string,7,3>* minimizerTree,vector<Minim
  * @param minimizerTree:    the B-tree to be altered
  * @param left:  the lower bound of the range
  * @param right:  the upper bound of the range
+ * @param journal:  (optional) undo journal recording the deleted minimizers
+ * @param frequencies:  (optional) k-mer counts from which the deleted minimizers are removed
+ * @param feed:  (optional) change feed receiving the deleted minimizers
  */
-void delete_minimizers_inefficient(B_tree<int,std::string,7,3>* minimizerTree,int& left,int& right){
-  for(int i = left; i <=right; i+=1){
+template<class Pos>
+void delete_minimizers_inefficient(B_tree<Pos,std::string,7,3>* minimizerTree,Pos& left,Pos& right,BasicUndoJournal<Pos>* journal=nullptr,KmerFrequencyTable* frequencies=nullptr,BasicChangeFeed<Pos>* feed=nullptr){
+  for(Pos i = left; i <=right; i+=1){
     cout<<"Removing "<<i<<" \n";
-    minimizerTree->remove(i);
+    auto removed=minimizerTree->remove(i);
+    if(journal!=nullptr && !removed.satellites.empty()){
+      journal->recordRemovedMinimizer(i,removed.satellites);
+    }
+    if(frequencies!=nullptr){
+      for(int s=0;s<(int)removed.satellites.size();s++){
+        frequencies->remove(removed.satellites[s]);
+      }
+    }
+    if(feed!=nullptr){
+      for(int s=0;s<(int)removed.satellites.size();s++){
+        feed->recordDeleted(i,removed.satellites[s]);
+      }
+    }
     if(!minimizerTree->is_empty()){
-    minimizerTree->remove(i);
+    removed=minimizerTree->remove(i);
+    if(journal!=nullptr && !removed.satellites.empty()){
+      journal->recordRemovedMinimizer(i,removed.satellites);
+    }
+    if(frequencies!=nullptr){
+      for(int s=0;s<(int)removed.satellites.size();s++){
+        frequencies->remove(removed.satellites[s]);
+      }
+    }
+    if(feed!=nullptr){
+      for(int s=0;s<(int)removed.satellites.size();s++){
+        feed->recordDeleted(i,removed.satellites[s]);
+      }
+    }
     }
   }
 }
 
 /*!
- * Updating the B-tree by deleting old minimizers and filling the tree with the updated minimizers.
+ * Detach the elements having a key with left<=key<=right by splitting the B-tree twice and joining the outer
+ * parts again. Costs O(log n) besides the size of the returned tree.
+ * @param minimizerTree:    the B-tree to be altered
+ * @param left:  the lower bound of the range
+ * @param right:  the upper bound of the range
+ *
+ * @return the B-tree holding the detached elements (owned by the caller)
+ */
+template<class Pos>
+B_tree<Pos,std::string,7,3>* extract_minimizers(B_tree<Pos,std::string,7,3>* minimizerTree,Pos left,Pos right){
+  B_tree<Pos,std::string,7,3>* middle=minimizerTree->split(left-1);
+  B_tree<Pos,std::string,7,3>* rhs=middle->split(right);
+  minimizerTree->join(rhs);
+  return middle;
+}
+
+/*!
+ * Partition the minimizers into parts ranges holding the same number of minimizers (up to one), e.g. to distribute
+ * the tree over several threads. Uses the subtree counts of the B-tree, so it costs O(parts log n).
+ * @param minimizerTree:    the B-tree to be partitioned
+ * @param parts:  the number of ranges
+ *
+ * @return the position of the first minimizer of every non-empty range, in ascending order. Range i holds the
+ *         minimizers from boundaries[i] up to (excluding) boundaries[i+1].
+ */
+template<class Pos>
+std::vector<Pos> partition_minimizers(B_tree<Pos,std::string,7,3>* minimizerTree,int parts){
+  assert(parts>0);
+  std::vector<Pos> boundaries;
+  uint64_t total=minimizerTree->size();
+  for(int i=0;i<parts;i++){
+    uint64_t first=total*i/parts;
+    if(first<total && (boundaries.empty() || first>total*(i-1)/parts)){
+      auto elem=minimizerTree->select(first);
+      boundaries.push_back(elem.key->value+elem.shift);
+    }
+  }
+  return boundaries;
+}
+
+/*!
+ * Updating the B-tree by deleting old minimizers and filling the tree with the already generated updated minimizers.
  * @param minimizerTree:    the B-tree to be updated
- * @param fullsubseq:  the substring which the new minimzers are generated for
+ * @param newminis:  the minimizers of the updated substring (positions in the whole DNA sequence)
  * @param thisstartpos:  the index of the substrings starting position in the whole DNA sequences
- * @param k_size: length of the k-mers
- * @param w_size: size of the window
  * @param var_impact_shift: the length by which subsequent minimizers key have to be shifted
+ * @param journal: (optional) undo journal recording the deleted, shifted and inserted minimizers
+ * @param frequencies: (optional) k-mer counts following the deleted and inserted minimizers
+ * @param feed: (optional) change feed receiving the deleted, shifted and inserted minimizers in this order
  */
-void update_minimizerTree(B_tree<int,std::string,7,3>* minimizerTree,std::string& fullsubseq,int& thisstartpos,int& k_size,int& w_size, int& var_impact_shift){
-  //generate the minimizers for the updated subsequence
-  std::vector<Minimizer> newminis=get_kmer_minimizers_algo(fullsubseq, k_size, w_size,thisstartpos);
+template<class Pos>
+void update_minimizerTree_with_minimizers(B_tree<Pos,std::string,7,3>* minimizerTree,std::vector<BasicMinimizer<Pos>>& newminis,Pos& thisstartpos,typename position_traits<Pos>::delta_type& var_impact_shift,BasicUndoJournal<Pos>* journal=nullptr,KmerFrequencyTable* frequencies=nullptr,BasicChangeFeed<Pos>* feed=nullptr){
+  if(journal!=nullptr){
+    journal->beginTreeEdit(minimizerTree);
+  }
   //find the positions of the first and last minimizer in the new set
-  int start=newminis.front().getPosition();
+  Pos start=newminis.front().getPosition();
   cout<<start<<" is the first new minimizer\n";
-  int end=newminis.back().getPosition();//end after shift
+  Pos end=newminis.back().getPosition();//end after shift
   //update last minimizers' position to find the right end position for the deletion
-  int newend = end-var_impact_shift;
+  Pos newend = end-var_impact_shift;
   //find the last minimizer position in the minimizer tree
-  int lastminipos=minimizerTree->get_max();
+  Pos lastminipos=minimizerTree->get_max();
 
   //cout<<"Shifting the elements by "<<var_impact_shift<<"\n";
   cout<<"Newend "<<newend<<", Lastminipos: "<<lastminipos<<"\n";
 
 //as the B-tree does not deliver stop if after last element set position of last deleted minimizer to maximum in tree
-  int suc=0;
+  Pos suc=0;
   /*if(end>lastminipos){
     end=lastminipos;
     suc=-1;
@@ -114,7 +203,7 @@ void update_minimizerTree(B_tree<int,std::string,7,3>* minimizerTree,std::string
   //delete all minimizers between left and right
   //delete all minimizers which are affected by the variation
   if(!(start>minimizerTree->get_max())){
-  delete_minimizers_inefficient(minimizerTree,start,newend);
+  delete_minimizers_inefficient(minimizerTree,start,newend,journal,frequencies,feed);
   //delete_minimizers_iterator(minimizerTree,start,newend);
   }
   if(!minimizerTree->is_empty()){
@@ -122,41 +211,97 @@ void update_minimizerTree(B_tree<int,std::string,7,3>* minimizerTree,std::string
     //shift all minimizers located at a position greater/equal than suc
     if(suc){
       cout<<"Shifting all minimizers greater than "<<suc<<" by "<<var_impact_shift<<"\n";
-      minimizerTree->shift_greater(suc,var_impact_shift);
+      Pos shift=var_impact_shift;
+      minimizerTree->shift_greater(suc,shift);
+      if(journal!=nullptr){
+        journal->recordShift(suc,var_impact_shift);
+      }
+      if(feed!=nullptr){
+        feed->recordShift(suc,var_impact_shift);
+      }
+    }
+    if(print_updated_minimizer_trees()){
+      cout<<"minimizer tree after applying shift: \n";
+      print_minimizerTree(minimizerTree);
+      cout<<"after applying shift done: \n";
     }
-    cout<<"minimizer tree after applying shift: \n";
-    print_minimizerTree(minimizerTree);
-    cout<<"after applying shift done: \n";
 
   }
   else{
     cout<<"B-tree is empty\n";
     //minimizerTree->~B_tree();
-    //B_tree<int,std::string,7,3>* minimizerTree = new B_tree<int,std::string,7,3>();
+    //B_tree<Pos,std::string,7,3>* minimizerTree = new B_tree<Pos,std::string,7,3>();
   }
   cout<<"New Minimizers to be added:\n";
-  for(int i=0;i<newminis.size();i++){
+  for(int i=0;i<(int)newminis.size();i++){
     newminis[i].printMinimizer();
   }
   cout<<"printing new minimizers done\n";
   fill_minimizer_tree(minimizerTree,newminis);
-  cout<<"New Minimizer Tree:\n";
-  print_minimizerTree(minimizerTree);
+  if(journal!=nullptr){
+    for(int i=0;i<(int)newminis.size();i++){
+      journal->recordInsertedMinimizer(newminis[i].getPosition());
+    }
+  }
+  if(frequencies!=nullptr){
+    for(int i=0;i<(int)newminis.size();i++){
+      std::string sequence=newminis[i].getSequence();
+      frequencies->add(sequence);
+    }
+  }
+  if(feed!=nullptr){
+    for(int i=0;i<(int)newminis.size();i++){
+      feed->recordInserted(newminis[i].getPosition(),newminis[i].getSequence());
+    }
+  }
+  if(print_updated_minimizer_trees()){
+    cout<<"New Minimizer Tree:\n";
+    print_minimizerTree(minimizerTree);
+  }
   cout<<"Updating done\n";
 }
 
+/*!
+ * Updating the B-tree by deleting old minimizers and filling the tree with the updated minimizers.
+ * @param minimizerTree:    the B-tree to be updated
+ * @param fullsubseq:  the substring which the new minimzers are generated for
+ * @param thisstartpos:  the index of the substrings starting position in the whole DNA sequences
+ * @param k_size: length of the k-mers
+ * @param w_size: size of the window
+ * @param var_impact_shift: the length by which subsequent minimizers key have to be shifted
+ * @param journal: (optional) undo journal recording the deleted, shifted and inserted minimizers
+ * @param frequencies: (optional) k-mer counts following the deleted and inserted minimizers
+ * @param feed: (optional) change feed receiving the deleted, shifted and inserted minimizers
+ */
+template<class Pos>
+void update_minimizerTree(B_tree<Pos,std::string,7,3>* minimizerTree,std::string& fullsubseq,Pos& thisstartpos,int& k_size,int& w_size,typename position_traits<Pos>::delta_type& var_impact_shift,BasicUndoJournal<Pos>* journal=nullptr,KmerFrequencyTable* frequencies=nullptr,BasicChangeFeed<Pos>* feed=nullptr){
+  //generate the minimizers for the updated subsequence, by a fixed kernel if (k_size,w_size) has one (for
+  //subsequences of at least one window both deliver the same minimizers)
+  std::vector<BasicMinimizer<Pos>> newminis;
+  bool fixed=false;
+  if((int)fullsubseq.size()>=w_size && w_size>k_size){
+    std::vector<uint8_t> codes=pack_sequence(fullsubseq);
+    fixed=get_fixed_kmer_minimizers_dispatch(codes.data(),codes.size(),k_size,w_size,LEXICOGRAPHIC,thisstartpos,newminis);
+  }
+  if(!fixed){
+    newminis=get_kmer_minimizers_algo(fullsubseq, k_size, w_size,thisstartpos);
+  }
+  update_minimizerTree_with_minimizers(minimizerTree,newminis,thisstartpos,var_impact_shift,journal,frequencies,feed);
+}
+
 /*!
  * Copy the elements stored in the B-tree into a vector
  * @param minimizerTree:    the B-tree to be copied
  */
-std::vector<Minimizer> minimizer_to_vector(B_tree<int,std::string,7,3>* minimizerTree){
-  std::vector<Minimizer> minimizers;
+template<class Pos>
+std::vector<BasicMinimizer<Pos>> minimizer_to_vector(B_tree<Pos,std::string,7,3>* minimizerTree){
+  std::vector<BasicMinimizer<Pos>> minimizers;
   for(auto elem: *minimizerTree){
-    int minikey=elem.first;
+    Pos minikey=elem.first;
     auto elem3 = minimizerTree->search(minikey);
-    std::vector<std::string> es2=*elem3.key->satellites;
+    auto& es2=*elem3.key->satellites;
     std::string sequence=es2.back();
-    Minimizer mini=Minimizer(minikey,sequence);
+    BasicMinimizer<Pos> mini=BasicMinimizer<Pos>(minikey,sequence);
     minimizers.push_back(mini);
   }
   return minimizers;
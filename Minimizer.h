@@ -11,28 +11,30 @@
 #define MINIMIZER_H
 
 #include "main.h"
+#include "positions.h"
 
 /*
 * Class to internally represent minimizers
 *
-* @param position    the position of the minimizer
+* @param position    the position of the minimizer (of the integer type Pos, see positions.h)
 * @param sequence    the sequence of the minimizer
 *
 */
 
-class Minimizer{
+template<class Pos>
+class BasicMinimizer{
 private:
-  int position;
+  Pos position;
   string sequence;
 public:
   //Custom constructor
-  Minimizer(int& pos, string& seq){
+  BasicMinimizer(Pos& pos, string& seq){
     position=pos;
     sequence=seq;
   }
   //Default constructor
-  Minimizer() = default;
-  void alterposition(int& pos){
+  BasicMinimizer() = default;
+  void alterposition(Pos& pos){
     position=pos;
   }
 
@@ -50,14 +52,14 @@ public:
    *@param pos: the new position
    *@param seq: the new sequence
    */
-  void updateMinimizer(int& pos, string& seq){
+  void updateMinimizer(Pos& pos, string& seq){
     position=pos;
     sequence=seq;
   }
   /*
    *returns the position of the minimizer
    */
-  int getPosition(){
+  Pos getPosition(){
     return position;
   }
   /*
@@ -68,4 +70,6 @@ public:
   }
 };
 
+typedef BasicMinimizer<int> Minimizer;
+
 #endif
@@ -11,25 +11,29 @@
 #define VARIANT_H
 
 #include "main.h"
+#include "positions.h"
 /*
 * Class to define a variant
 * author: Alexander Petri
 *
-* @param position    the position of the variant
+* @param position    the position of the variant (of the integer type Pos, see positions.h)
 * @param sequence    the sequence of the variants
 * @param originalseqlen  the length of the subsequence before the variant was applied
 * @param length      the length of the subsequence after the variant was applied
 *
 */
-class Variant{
+template<class Pos>
+class BasicVariant{
 private:
-  int position;
+  Pos position;
   string sequence;
   int originalseqlen;
   int length;
 public:
+  typedef typename position_traits<Pos>::delta_type delta_t;
+
   // Constructor
-  Variant(int& pos, int& origin, int& len, string& seq){
+  BasicVariant(Pos& pos, int& origin, int& len, string& seq){
     position=pos;
     sequence=seq;
     originalseqlen=origin;
@@ -43,13 +47,13 @@ public:
   * @param shift   the amount of bases the variant is shifted by
   *
   */
-  void updateVariantPosition(int& shift){
+  void updateVariantPosition(delta_t& shift){
     position+=shift;
   }
   /*
   *returns the position of the variant
   */
-  int getVariantPosition(){
+  Pos getVariantPosition(){
     return position;
   }
   /*
@@ -80,4 +84,6 @@ public:
   }
 };
 
+typedef BasicVariant<int> Variant;
+
 #endif
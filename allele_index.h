@@ -0,0 +1,284 @@
+////////////////////////////////////////////////////////////////////////////////
+// allele_index.h
+//   allele-aware index header file.
+//
+// Minimizer index over the reference and the ALT alleles of a variant set. Only
+// the minimizers of windows spanning an ALT allele are added to the reference
+// minimizers, each tagged with the ALT alleles it requires, so no haplotype has
+// to be materialized.
+//
+////////////////////////////////////////////////////////////////////////////////
+//  author: Alexander Petri
+
+#ifndef ALLELE_INDEX_H
+#define ALLELE_INDEX_H
+
+#include "main.h"
+#include "Variant.h"
+#include "Minimizer.h"
+#include "packed_kmers.h"
+#include "get_kmer_minimizers.h"
+#include "dynseq_functions.h"
+#include "dynamic_minimizer.h"
+#include "include/dynamic.hpp"
+
+#include <set>
+
+/*
+* Minimizer index of a reference together with the ALT alleles of a set of variants.
+*
+* The variants are grouped into clusters with compute_left_bound and compute_right_bound, exactly like the merged
+* variation-impact-ranges of compute_dynamic_minimizers. For every cluster the combinations of its ALT alleles are
+* applied to the reference segment around the cluster only, and the minimizers of the resulting local haplotypes are
+* generated. A minimizer is added if one of the windows choosing it (the span [pos+k-w, pos+w-1]) overlaps an ALT
+* allele. Its tag is the set of ALT alleles overlapping this span: the minimizer is present on every haplotype
+* carrying these ALT alleles and the REF allele of all other variants overlapping the span. Its position is given on
+* the haplotype carrying exactly the ALT alleles of the tag. Minimizers whose k-mer lies outside of the ALT alleles
+* and which are reference minimizers as well are not added a second time.
+* The index therefore grows with the number of variants and not with the number of haplotypes.
+*
+* Combinations are formed of an allele and up to max_cluster_alleles-1 following alleles of the same cluster, so
+* a cluster of m variants costs O(m * 2^(max_cluster_alleles-1)) local minimizer computations. Variants whose
+* reference ranges overlap (e.g. several ALT alleles at one site) are never combined.
+*
+* All entries are sorted by (packed k-mer, position), reference minimizers have an empty tag.
+*
+* @param kmers          the packed k-mers of all entries
+* @param positions      the positions of all entries
+* @param tag_offsets    the tag of entry i is alleles[tag_offsets[i]] ... alleles[tag_offsets[i+1]-1]
+* @param alleles        the indices (into the variant set) of the ALT alleles of all tags
+* @param k_size         the length of the k-mers
+* @param w_size         the window size
+* @param n_reference    the number of reference minimizers
+*/
+class AlleleAwareIndex{
+private:
+  std::vector<uint64_t> kmers;
+  std::vector<int> positions;
+  std::vector<int> tag_offsets;
+  std::vector<int> alleles;
+  int k_size;
+  int w_size;
+  int n_reference=0;
+
+  /*
+  * returns true if [start, end] overlaps the allele occupying [allele_start, allele_start+allele_length-1].
+  * A deleted allele (allele_length 0) is overlapped by ranges covering both of its neighbouring bases.
+  */
+  static bool overlaps(int start,int end,int allele_start,int allele_length){
+    if(allele_length==0){
+      return start<allele_start && end>=allele_start;
+    }
+    return start<=allele_start+allele_length-1 && end>=allele_start;
+  }
+
+  /*
+  * generates the minimizers of every allele combination of one cluster and adds the tagged ones to entries
+  */
+  void indexCluster(dyn::wt_str& reference,std::vector<Variant>& variants,std::vector<int>& cluster,int left,int right,std::vector<Minimizer>& reference_minis,int max_cluster_alleles,std::set<std::tuple<std::vector<int>,int,std::string>>& entries){
+    int n=reference.size();
+    //extend the cluster, so that the windows of all affected minimizers are located in the segment
+    int segment_left=std::max(0,left-w_size-k_size);
+    int segment_right=std::min(n-1,right+w_size+k_size);
+    std::string segment=dynseq_get_substr(reference,segment_left,segment_right);
+    for(int first=0;first<(int)cluster.size();first++){
+      int followers=std::min((int)cluster.size()-first-1,max_cluster_alleles-1);
+      for(int mask=0;mask<(1<<followers);mask++){
+        std::vector<int> combination;
+        combination.push_back(cluster[first]);
+        for(int j=0;j<followers;j++){
+          if(mask&(1<<j)){
+            combination.push_back(cluster[first+1+j]);
+          }
+        }
+        //apply the ALT alleles to the segment and remember where they are located
+        std::string haplotype="";
+        std::vector<int> allele_starts;
+        int cursor=segment_left;
+        bool compatible=true;
+        for(int j=0;j<(int)combination.size() && compatible;j++){
+          Variant& var=variants[combination[j]];
+          int pos=var.getVariantPosition();
+          //overlapping reference ranges or two alleles at the same site cannot be combined
+          if(pos<cursor || (j>0 && pos==variants[combination[j-1]].getVariantPosition())){
+            compatible=false;
+            break;
+          }
+          haplotype+=segment.substr(cursor-segment_left,pos-cursor);
+          allele_starts.push_back(segment_left+haplotype.size());
+          haplotype+=var.getVariantSequence();
+          cursor=std::min(pos+var.getVariantOriginalSeqLen(),segment_right+1);
+        }
+        if(!compatible){
+          continue;
+        }
+        haplotype+=segment.substr(cursor-segment_left);
+        if((int)haplotype.size()<w_size){
+          continue;
+        }
+        int haplotype_right=segment_left+haplotype.size()-1;
+        std::vector<Minimizer> minis=get_kmer_minimizers_algo(haplotype,k_size,w_size,segment_left);
+        for(int i=0;i<(int)minis.size();i++){
+          int pos=minis[i].getPosition();
+          int span_left=pos+k_size-w_size;
+          int span_right=pos+w_size-1;
+          //skip minimizers whose windows are not completely located in the segment
+          if((span_left<segment_left && segment_left>0) || (span_right>haplotype_right && segment_right<n-1)){
+            continue;
+          }
+          std::vector<int> tag;
+          bool kmer_in_allele=false;
+          int shift_before=0;
+          int untagged_shift_before=0;
+          for(int j=0;j<(int)combination.size();j++){
+            Variant& var=variants[combination[j]];
+            int length=var.getVariantLength();
+            int delta=length-var.getVariantOriginalSeqLen();
+            bool in_span=overlaps(span_left,span_right,allele_starts[j],length);
+            if(in_span){
+              tag.push_back(combination[j]);
+              kmer_in_allele=kmer_in_allele || overlaps(pos,pos+k_size-1,allele_starts[j],length);
+            }
+            if(allele_starts[j]+length<=pos){
+              shift_before+=delta;
+              if(!in_span){
+                untagged_shift_before+=delta;
+              }
+            }
+          }
+          if(tag.empty()){
+            continue;
+          }
+          std::string kmer=minis[i].getSequence();
+          if(!kmer_in_allele){
+            //the k-mer is a reference k-mer, it does not have to be added if it is a reference minimizer
+            int reference_pos=pos-shift_before;
+            auto it=std::lower_bound(reference_minis.begin(),reference_minis.end(),reference_pos,[](Minimizer& a,int b){return a.getPosition()<b;});
+            if(it!=reference_minis.end() && it->getPosition()==reference_pos && it->getSequence()==kmer){
+              continue;
+            }
+          }
+          entries.insert(std::make_tuple(tag,pos-untagged_shift_before,kmer));
+        }
+      }
+    }
+  }
+
+public:
+  /*!
+   * Builds the index of the reference and the ALT alleles of the variants
+   * @param reference:   the reference sequence
+   * @param variants:    the variants, sorted by position and given in reference coordinates (they are not altered)
+   * @param k:           length of the k-mers
+   * @param w:           window size
+   * @param max_cluster_alleles: the maximum number of ALT alleles combined in one local haplotype
+   */
+  AlleleAwareIndex(dyn::wt_str& reference,std::vector<Variant>& variants,int& k,int& w,int max_cluster_alleles=8){
+    k_size=k;
+    w_size=w;
+    std::string reference_sequence=dynseq_tostring(reference);
+    std::vector<Minimizer> reference_minis=get_kmer_minimizers(reference_sequence,k_size,w_size);
+    n_reference=reference_minis.size();
+    std::set<std::tuple<std::vector<int>,int,std::string>> entries;
+    //group the variants into the merged variation-impact-ranges, the reference is not altered, so no shift applies
+    int previous_right=0;
+    int prevlength=0;
+    int prevseqstart=0;
+    bool prevseq=false;
+    std::vector<int> cluster;
+    for(int i=0;i<(int)variants.size();i++){
+      std::tuple<int,int,int> left_infos=compute_left_bound(previous_right,variants[i],prevlength,prevseqstart,k_size,w_size,prevseq);
+      int thisstartpos=std::get<2>(left_infos);
+      std::tuple<int,bool> right_infos=compute_right_bound(variants,i,w_size,k_size,reference);
+      int right=std::get<0>(right_infos);
+      bool subseq=std::get<1>(right_infos);
+      cluster.push_back(i);
+      if(!subseq){
+        indexCluster(reference,variants,cluster,thisstartpos,right,reference_minis,max_cluster_alleles,entries);
+        cluster.clear();
+      }
+      else{
+        prevseqstart=thisstartpos;
+      }
+      previous_right=right;
+      prevseq=subseq;
+    }
+    //sort the reference minimizers and the tagged minimizers by k-mer
+    std::vector<std::tuple<uint64_t,int,int>> order;
+    std::vector<std::vector<int>> tags;
+    for(int i=0;i<(int)reference_minis.size();i++){
+      std::string kmer=reference_minis[i].getSequence();
+      order.push_back(std::make_tuple(pack_kmer(kmer,0,k_size),reference_minis[i].getPosition(),-1));
+    }
+    for(auto& entry: entries){
+      std::string kmer=std::get<2>(entry);
+      order.push_back(std::make_tuple(pack_kmer(kmer,0,k_size),std::get<1>(entry),(int)tags.size()));
+      tags.push_back(std::get<0>(entry));
+    }
+    std::sort(order.begin(),order.end());
+    kmers.reserve(order.size());
+    positions.reserve(order.size());
+    tag_offsets.reserve(order.size()+1);
+    for(int i=0;i<(int)order.size();i++){
+      kmers.push_back(std::get<0>(order[i]));
+      positions.push_back(std::get<1>(order[i]));
+      tag_offsets.push_back(alleles.size());
+      int tag=std::get<2>(order[i]);
+      if(tag>=0){
+        alleles.insert(alleles.end(),tags[tag].begin(),tags[tag].end());
+      }
+    }
+    tag_offsets.push_back(alleles.size());
+  }
+
+  /*
+  * returns the range [first, last) of the entries holding kmer
+  */
+  std::pair<int,int> lookup(std::string& kmer){
+    uint64_t packed=pack_kmer(kmer,0,k_size);
+    int first=std::lower_bound(kmers.begin(),kmers.end(),packed)-kmers.begin();
+    int last=std::upper_bound(kmers.begin(),kmers.end(),packed)-kmers.begin();
+    return std::make_pair(first,last);
+  }
+  /*
+  * returns the number of entries (reference and ALT minimizers)
+  */
+  int size(){
+    return kmers.size();
+  }
+  int getNumberOfReferenceMinimizers(){
+    return n_reference;
+  }
+  int getNumberOfAltMinimizers(){
+    return kmers.size()-n_reference;
+  }
+  /*
+  * returns the position of entry i, for ALT minimizers on the haplotype carrying exactly the ALT alleles of its tag
+  */
+  int getPosition(int i){
+    return positions[i];
+  }
+  std::string getSequence(int i){
+    return unpack_kmer(kmers[i],k_size);
+  }
+  /*
+  * returns the number of ALT alleles required by entry i, 0 for reference minimizers
+  */
+  int getNumberOfAlleles(int i){
+    return tag_offsets[i+1]-tag_offsets[i];
+  }
+  /*
+  * returns a pointer to the indices of the ALT alleles required by entry i
+  */
+  int* getAlleles(int i){
+    return alleles.data()+tag_offsets[i];
+  }
+  /*
+  * prints the sizes of the index to the console
+  */
+  void printStatistics(){
+    cout<<n_reference<<" reference minimizers, "<<getNumberOfAltMinimizers()<<" ALT minimizers, "<<alleles.size()<<" allele tags\n";
+  }
+};
+
+#endif
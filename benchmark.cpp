@@ -21,6 +21,8 @@
 
 #include "include/internal/wt_string.hpp"
 
+#include "perf_counters.h"
+
 using namespace std;
 using namespace dyn;
 
@@ -49,15 +51,23 @@ void benchmark_bv(uint64_t size, double p = 0.5){
 	using std::chrono::duration_cast;
 	using std::chrono::duration;
 
+	//hardware counters of every phase, reported per operation next to the times (n/a where unavailable)
+	PerfCounterGroup counters;
+	PerfMeasurement phases[7];
+
+	if(!counters.isAvailable()) cout << "hardware counters unavailable (" << counters.getError() << "), measuring time only" << endl;
+
 	auto t1 = high_resolution_clock::now();
 
 	cout << "insert ... " << flush;
+	counters.start();
 	for(uint64_t i=0;i<size;++i){
 
 		ulint c = double(rand())/RAND_MAX < p ? 1 : 0;
 		bv.insert(rand()%(bv.size()+1),c);
 
 	}
+	phases[0] = counters.stop();
 	cout << "done." << endl;
 
 	auto t2 = high_resolution_clock::now();
@@ -65,32 +75,38 @@ void benchmark_bv(uint64_t size, double p = 0.5){
 	auto max_size = bv.bit_size();
 	
 	cout << "access ... " << flush;
+	counters.start();
 	for(uint64_t i=0;i<size;++i){
 
 	   //bv[rand()%bv.size()];
 	   bv.at(rand()%bv.size());
 
 	}
+	phases[1] = counters.stop();
 	cout << "done." << endl;
 
 	auto t3 = high_resolution_clock::now();
 
 	cout << "rank 0 ... " << flush;
+	counters.start();
 	for(uint64_t i=0;i<size;++i){
 
 		bv.rank(rand()%(bv.size()+1),0);
 
 	}
+	phases[2] = counters.stop();
 	cout << "done." << endl;
 
 	auto t4 = high_resolution_clock::now();
 
 	cout << "rank 1 ... " << flush;
+	counters.start();
 	for(uint64_t i=0;i<size;++i){
 
 		bv.rank(rand()%(bv.size()+1),1);
 
 	}
+	phases[3] = counters.stop();
 	cout << "done." << endl;
 
 	auto t5 = high_resolution_clock::now();
@@ -99,25 +115,30 @@ void benchmark_bv(uint64_t size, double p = 0.5){
 	uint64_t nr_1 = bv.rank(bv.size(),1);
 
 	cout << "select 0 ... " << flush;
+	counters.start();
 	for(uint64_t i=0;i<size;++i){
 
 		bv.select(rand()%nr_0,0);
 
 	}
+	phases[4] = counters.stop();
 	cout << "done." << endl;
 
 	auto t6 = high_resolution_clock::now();
 
 	cout << "select 1 ... " << flush;
+	counters.start();
 	for(uint64_t i=0;i<size;++i){
 
 		bv.select(rand()%nr_1,1);
 
 	}
+	phases[5] = counters.stop();
 	cout << "done." << endl;
 	auto t7 = high_resolution_clock::now();
 
 	cout << "remove ... " << flush;
+	counters.start();
 	
 	for(uint64_t i=0;i<size;++i){
 	   //bv[rand()%bv.size()];
@@ -126,6 +147,7 @@ void benchmark_bv(uint64_t size, double p = 0.5){
 
 	}
 
+	phases[6] = counters.stop();
 	cout << "done." << endl;
 	auto t8 = high_resolution_clock::now();
 
@@ -146,6 +168,9 @@ void benchmark_bv(uint64_t size, double p = 0.5){
 
 	cout << (double)sec_rem/size << " microseconds/remove" << endl;
 
+	const char* phase_names[7] = {"insert","access","rank0","rank1","select0","select1","remove"};
+	for(int i=0;i<7;++i) phases[i].printPerOperation(phase_names[i],size);
+
 	cout << "Max bit size of the structure (allocated memory, bits): " << max_size << endl;
 	cout << "Final bit size of the structure (allocated memory, bits): " << bv.bit_size() << endl;
 
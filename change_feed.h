@@ -0,0 +1,229 @@
+////////////////////////////////////////////////////////////////////////////////
+// change_feed.h
+//   change feed header file.
+//
+//  ordered log of the deletions, insertions and shifts the update engine
+//  applies to a minimizer tree, so that downstream hash tables and caches can
+//  follow the tree incrementally instead of dumping it after every update.
+//
+////////////////////////////////////////////////////////////////////////////////
+//  author: Alexander Petri
+
+#ifndef CHANGE_FEED_H
+#define CHANGE_FEED_H
+
+#include "main.h"
+#include "positions.h"
+
+#include <atomic>
+#include <cassert>
+
+/*
+* The kinds of changes of a minimizer tree
+* MINIMIZER_DELETED    the minimizer kmer at position was removed
+* MINIMIZER_INSERTED   the minimizer kmer was inserted at position
+* MINIMIZERS_SHIFTED   every minimizer at a position >= position moved by delta
+*/
+enum ChangeType{
+  MINIMIZER_DELETED,
+  MINIMIZER_INSERTED,
+  MINIMIZERS_SHIFTED
+};
+
+/*
+* One entry of the change feed. Positions refer to the tree as it is right before the change, so replaying the
+* entries in the order of their numbers reproduces the tree.
+*
+* @param number     the number of the entry in the feed, starting at 0
+* @param type       the kind of change
+* @param position   the position of the minimizer, or the first shifted position
+* @param delta      the shift (0 unless type is MINIMIZERS_SHIFTED)
+* @param kmer       the k-mer of the minimizer (empty if type is MINIMIZERS_SHIFTED)
+*/
+template<class Pos>
+struct BasicMinimizerChange{
+  typedef typename position_traits<Pos>::delta_type delta_t;
+  uint64_t number;
+  ChangeType type;
+  Pos position;
+  delta_t delta;
+  std::string kmer;
+};
+
+/*
+* Bounded lock-free ring buffer for one producer and one consumer thread.
+*
+* @param slots      the entries, the capacity is a power of two
+* @param head       the number of entries popped so far (written by the consumer)
+* @param tail       the number of entries pushed so far (written by the producer)
+*/
+template<class Pos>
+class BasicChangeRing{
+private:
+  std::vector<BasicMinimizerChange<Pos>> slots;
+  uint64_t mask;
+  std::atomic<uint64_t> head;
+  std::atomic<uint64_t> tail;
+
+public:
+  BasicChangeRing(uint64_t capacity){
+    assert(capacity>0 && (capacity&(capacity-1))==0);
+    slots.resize(capacity);
+    mask=capacity-1;
+    head.store(0);
+    tail.store(0);
+  }
+  /*
+  * returns false if the buffer is full
+  */
+  bool tryPush(BasicMinimizerChange<Pos>& change){
+    uint64_t t=tail.load(std::memory_order_relaxed);
+    if(t-head.load(std::memory_order_acquire)>mask){
+      return false;
+    }
+    slots[t&mask]=std::move(change);
+    tail.store(t+1,std::memory_order_release);
+    return true;
+  }
+  /*
+  * returns false if the buffer is empty
+  */
+  bool tryPop(BasicMinimizerChange<Pos>& change){
+    uint64_t h=head.load(std::memory_order_relaxed);
+    if(h==tail.load(std::memory_order_acquire)){
+      return false;
+    }
+    change=std::move(slots[h&mask]);
+    head.store(h+1,std::memory_order_release);
+    return true;
+  }
+  uint64_t size() const{
+    return tail.load(std::memory_order_acquire)-head.load(std::memory_order_acquire);
+  }
+  uint64_t capacity() const{
+    return mask+1;
+  }
+};
+
+/*
+* Sink of the changes of a minimizer tree. The changes are either handed to a callback in the updating thread or
+* pushed into a lock-free ring buffer drained by a consumer thread with poll(). If the ring buffer is full, the
+* updating thread waits until the consumer has made room, so a ring buffer needs a consumer running concurrently
+* (or a capacity larger than the number of changes between two drains).
+* A shift is a single entry for the whole range of moved minimizers, not one entry per minimizer.
+*
+* @param callback   receives every change (if set)
+* @param ring       buffers the changes otherwise
+*/
+template<class Pos>
+class BasicChangeFeed{
+private:
+  typedef typename position_traits<Pos>::delta_type delta_t;
+  std::function<void(const BasicMinimizerChange<Pos>&)> callback;
+  BasicChangeRing<Pos>* ring=nullptr;
+  uint64_t next_number=0;
+  uint64_t deleted=0;
+  uint64_t inserted=0;
+  uint64_t shifted=0;
+  uint64_t stalls=0;
+
+  void emit(ChangeType type,Pos position,delta_t delta,const std::string& kmer){
+    BasicMinimizerChange<Pos> change;
+    change.number=next_number++;
+    change.type=type;
+    change.position=position;
+    change.delta=delta;
+    change.kmer=kmer;
+    if(callback){
+      callback(change);
+      return;
+    }
+    if(!ring->tryPush(change)){
+      stalls++;
+      while(!ring->tryPush(change)){
+        std::this_thread::yield();
+      }
+    }
+  }
+
+public:
+  /*!
+   * @param consumer:   called with every change in the updating thread
+   */
+  BasicChangeFeed(std::function<void(const BasicMinimizerChange<Pos>&)> consumer){
+    callback=consumer;
+  }
+  /*!
+   * @param ring_capacity:   capacity of the ring buffer (a power of two)
+   */
+  BasicChangeFeed(uint64_t ring_capacity){
+    ring=new BasicChangeRing<Pos>(ring_capacity);
+  }
+  ~BasicChangeFeed(){
+    delete ring;
+  }
+  BasicChangeFeed(const BasicChangeFeed&)=delete;
+  BasicChangeFeed& operator=(const BasicChangeFeed&)=delete;
+
+  void recordDeleted(Pos position,const std::string& kmer){
+    deleted++;
+    emit(MINIMIZER_DELETED,position,0,kmer);
+  }
+  void recordInserted(Pos position,const std::string& kmer){
+    inserted++;
+    emit(MINIMIZER_INSERTED,position,0,kmer);
+  }
+  /*
+  * records that every minimizer at a position >= from moved by delta (nothing is recorded for delta 0)
+  */
+  void recordShift(Pos from,delta_t delta){
+    if(delta==0){
+      return;
+    }
+    shifted++;
+    emit(MINIMIZERS_SHIFTED,from,delta,std::string());
+  }
+
+  /*
+  * takes the next change from the ring buffer, returns false if there is none (consumer thread only)
+  */
+  bool poll(BasicMinimizerChange<Pos>& change){
+    assert(ring!=nullptr);
+    return ring->tryPop(change);
+  }
+  /*
+  * returns the number of changes waiting in the ring buffer (any thread)
+  */
+  uint64_t getNumberOfBufferedChanges() const{
+    return ring==nullptr ? 0 : ring->size();
+  }
+  /*
+  * returns the number of changes that found the ring buffer full and had to wait for the consumer
+  */
+  uint64_t getNumberOfStalls() const{
+    return stalls;
+  }
+  uint64_t getNumberOfChanges() const{
+    return next_number;
+  }
+  uint64_t getNumberOfDeletions() const{
+    return deleted;
+  }
+  uint64_t getNumberOfInsertions() const{
+    return inserted;
+  }
+  uint64_t getNumberOfShifts() const{
+    return shifted;
+  }
+  /*
+  * prints the counters of the feed to the console
+  */
+  void printStatistics() const{
+    cout<<next_number<<" changes: "<<deleted<<" deletions, "<<inserted<<" insertions, "<<shifted<<" shifts\n";
+  }
+};
+
+typedef BasicMinimizerChange<int> MinimizerChange;
+typedef BasicChangeFeed<int> ChangeFeed;
+
+#endif
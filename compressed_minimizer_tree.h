@@ -0,0 +1,538 @@
+////////////////////////////////////////////////////////////////////////////////
+// compressed_minimizer_tree.h
+//   compressed minimizer tree header file.
+//
+// Minimizer tree with compressed leaves. Every leaf holds up to leaf_capacity
+// minimizers, their positions delta-encoded and their k-mers 2-bit packed in
+// the width-adaptive packed vectors of DYNAMIC. The B-tree only stores the first
+// position of every leaf, so its lazy shifts still move all following
+// minimizers in O(log n).
+//
+////////////////////////////////////////////////////////////////////////////////
+//  author: Alexander Petri
+
+#ifndef COMPRESSED_MINIMIZER_TREE_H
+#define COMPRESSED_MINIMIZER_TREE_H
+
+#include "main.h"
+#include "positions.h"
+#include "Variant.h"
+#include "Minimizer.h"
+#include "packed_kmers.h"
+#include "get_kmer_minimizers.h"
+#include "dynamic_minimizer.h"
+#include "B-tree.hh"
+#include "B_tree_node.hh"
+#include "include/internal/slab_allocator.hpp"
+#include "include/dynamic.hpp"
+
+#include <cassert>
+
+struct compressed_tree_tag{};
+
+/*
+* Leaf of the compressed minimizer tree. The position of minimizer i is the key of the leaf in the B-tree plus the
+* inclusive prefix sum deltas[0]+...+deltas[i], deltas[0] is always 0. Consecutive minimizers are at most w apart,
+* so a delta takes about log2(w) bits, a k-mer takes 2k bits.
+*
+* @param deltas     the differences between the positions of consecutive minimizers
+* @param kmers      the 2-bit packed k-mers
+*/
+struct CompressedLeaf{
+  dyn::packed_vector deltas;
+  dyn::packed_vector kmers;
+};
+
+/*
+* Minimizer tree storing the minimizers in compressed leaves of up to leaf_capacity minimizers.
+* The B-tree maps the first position of every leaf to the leaf, shifting all minimizers from a position onward
+* changes one delta of the leaf containing this position and shifts the keys of all following leaves lazily with
+* shift_greater of the B-tree. Positions are unique, inserting a minimizer at an occupied position replaces its k-mer.
+* Leaves are split when they exceed leaf_capacity, after a deletion two neighbouring leaves are merged if one of
+* them holds less than a quarter of it. The B-tree nodes and the leaves are allocated with slab_allocator<compressed_tree_tag>.
+*
+* @param leaves         B-tree mapping the first position of every leaf to the leaf
+* @param k_size         the length of the k-mers
+* @param leaf_capacity  the maximum number of minimizers of a leaf
+* @param n              the number of minimizers
+* @param n_leaves       the number of leaves
+*/
+template<class Pos>
+class CompressedMinimizerTree{
+private:
+  typedef B_tree<Pos,CompressedLeaf*,7,3,dyn::slab_allocator<compressed_tree_tag>> leaf_tree_t;
+  typedef dyn::slab_allocator<compressed_tree_tag> leaf_alloc;
+  typedef typename position_traits<Pos>::delta_type delta_t;
+
+  leaf_tree_t* leaves;
+  int k_size;
+  int leaf_capacity;
+  uint64_t n=0;
+  uint64_t n_leaves=0;
+
+  /*
+  * returns the number of bits of x, at least 1
+  */
+  static uint64_t bitWidth(uint64_t x){
+    uint64_t width=1;
+    while(width<64 && (x>>width)!=0){
+      width++;
+    }
+    return width;
+  }
+  /*
+  * returns a packed vector of the values with the smallest width holding all of them
+  */
+  static dyn::packed_vector encode(std::vector<uint64_t>& values){
+    uint64_t width=1;
+    for(int i=0;i<(int)values.size();i++){
+      width=std::max(width,bitWidth(values[i]));
+    }
+    dyn::packed_vector packed(values.size(),width);
+    for(int i=0;i<(int)values.size();i++){
+      packed.set(i,values[i]);
+    }
+    return packed;
+  }
+
+  /*
+  * creates a leaf starting at start, holding the minimizers at start+offsets[i] (offsets[0]==0)
+  */
+  CompressedLeaf* createLeaf(std::vector<uint64_t>& offsets,std::vector<uint64_t>& kmers,Pos start){
+    std::vector<uint64_t> deltas(offsets.size());
+    for(int i=0;i<(int)offsets.size();i++){
+      deltas[i]=(i==0) ? 0 : offsets[i]-offsets[i-1];
+    }
+    CompressedLeaf* leaf=leaf_alloc::template create<CompressedLeaf>();
+    leaf->deltas=encode(deltas);
+    leaf->kmers=encode(kmers);
+    leaves->insert(start,leaf);
+    n_leaves++;
+    return leaf;
+  }
+  /*
+  * rewrites a leaf with the minimizers at start+offsets[i] (offsets[0]==0)
+  */
+  void rewriteLeaf(CompressedLeaf* leaf,std::vector<uint64_t>& offsets,std::vector<uint64_t>& kmers){
+    std::vector<uint64_t> deltas(offsets.size());
+    for(int i=0;i<(int)offsets.size();i++){
+      deltas[i]=(i==0) ? 0 : offsets[i]-offsets[i-1];
+    }
+    leaf->deltas=encode(deltas);
+    leaf->kmers=encode(kmers);
+  }
+  /*
+  * removes the leaf starting at start from the B-tree and frees it
+  */
+  void dropLeaf(Pos start,CompressedLeaf* leaf){
+    leaves->remove(start);
+    leaf_alloc::destroy(leaf);
+    n_leaves--;
+  }
+  /*
+  * moves the key of a leaf from start to new_start, no other leaf may start in between
+  */
+  void rekeyLeaf(Pos start,Pos new_start,CompressedLeaf* leaf){
+    if(start==new_start){
+      return;
+    }
+    leaves->remove(start);
+    leaves->insert(new_start,leaf);
+  }
+  /*
+  * decodes the offsets (relative to the start of the leaf) and the k-mers of a leaf
+  */
+  static void decodeLeaf(CompressedLeaf* leaf,std::vector<uint64_t>& offsets,std::vector<uint64_t>& kmers){
+    uint64_t size=leaf->deltas.size();
+    offsets.resize(size);
+    kmers.resize(size);
+    uint64_t offset=0;
+    for(uint64_t i=0;i<size;i++){
+      offset+=leaf->deltas.at(i);
+      offsets[i]=offset;
+      kmers[i]=leaf->kmers.at(i);
+    }
+  }
+  /*
+  * finds the leaf starting at or before pos, returns false if pos is located before the first leaf
+  */
+  bool leafAtOrBefore(Pos pos,Pos& start,CompressedLeaf*& leaf){
+    if(leaves->is_empty()){
+      return false;
+    }
+    auto elem=leaves->predecessor(pos);
+    if(elem.key==nullptr){
+      return false;
+    }
+    leaf=(*elem.key->satellites)[0];
+    start=elem.shift_key().value;
+    return true;
+  }
+  /*
+  * finds the first leaf starting after pos, returns false if there is none
+  */
+  bool leafAfter(Pos pos,Pos& start,CompressedLeaf*& leaf){
+    if(leaves->is_empty()){
+      return false;
+    }
+    auto elem=leaves->successor(pos);
+    if(elem.key==nullptr){
+      return false;
+    }
+    leaf=(*elem.key->satellites)[0];
+    start=elem.shift_key().value;
+    return true;
+  }
+  /*
+  * splits the leaf starting at start into two halves
+  */
+  void splitLeaf(Pos start,CompressedLeaf* leaf){
+    std::vector<uint64_t> offsets;
+    std::vector<uint64_t> kmers;
+    decodeLeaf(leaf,offsets,kmers);
+    uint64_t half=offsets.size()/2;
+    uint64_t base=offsets[half];
+    std::vector<uint64_t> right_offsets;
+    std::vector<uint64_t> right_kmers;
+    for(uint64_t i=half;i<offsets.size();i++){
+      right_offsets.push_back(offsets[i]-base);
+      right_kmers.push_back(kmers[i]);
+    }
+    offsets.resize(half);
+    kmers.resize(half);
+    rewriteLeaf(leaf,offsets,kmers);
+    createLeaf(right_offsets,right_kmers,(Pos)(start+base));
+  }
+  /*
+  * merges the leaf starting at start with the following leaf if one of them is underfull and both fit into one leaf
+  */
+  void mergeWithSuccessor(Pos start,CompressedLeaf* leaf){
+    Pos next_start;
+    CompressedLeaf* next;
+    if(!leafAfter(start,next_start,next)){
+      return;
+    }
+    uint64_t underfull=leaf_capacity/4;
+    if(leaf->deltas.size()>=underfull && next->deltas.size()>=underfull){
+      return;
+    }
+    if((int)(leaf->deltas.size()+next->deltas.size())>leaf_capacity){
+      return;
+    }
+    std::vector<uint64_t> offsets;
+    std::vector<uint64_t> kmers;
+    std::vector<uint64_t> next_offsets;
+    std::vector<uint64_t> next_kmers;
+    decodeLeaf(leaf,offsets,kmers);
+    decodeLeaf(next,next_offsets,next_kmers);
+    uint64_t base=(uint64_t)(Pos)(next_start-start);
+    for(int i=0;i<(int)next_offsets.size();i++){
+      offsets.push_back(base+next_offsets[i]);
+      kmers.push_back(next_kmers[i]);
+    }
+    rewriteLeaf(leaf,offsets,kmers);
+    dropLeaf(next_start,next);
+  }
+
+public:
+  /*!
+   * Builds the compressed tree of sorted minimizers
+   * @param minimizers:     the minimizers, sorted by position
+   * @param k:              length of the k-mers
+   * @param capacity:       the maximum number of minimizers of a leaf
+   */
+  CompressedMinimizerTree(std::vector<BasicMinimizer<Pos>>& minimizers,int k,int capacity=256){
+    leaves=new leaf_tree_t();
+    k_size=k;
+    leaf_capacity=capacity;
+    assert(leaf_capacity>=4 && 2*k_size<=64);
+    for(int first=0;first<(int)minimizers.size();first+=leaf_capacity){
+      int last=std::min((int)minimizers.size(),first+leaf_capacity);
+      Pos start=minimizers[first].getPosition();
+      std::vector<uint64_t> offsets;
+      std::vector<uint64_t> kmers;
+      for(int i=first;i<last;i++){
+        std::string kmer=minimizers[i].getSequence();
+        offsets.push_back((uint64_t)(Pos)(minimizers[i].getPosition()-start));
+        kmers.push_back(pack_kmer(kmer,0,k_size));
+      }
+      createLeaf(offsets,kmers,start);
+    }
+    n=minimizers.size();
+  }
+  ~CompressedMinimizerTree(){
+    if(!leaves->is_empty()){
+      for(auto elem: *leaves){
+        leaf_alloc::destroy(elem.second[0]);
+      }
+    }
+    delete leaves;
+  }
+  CompressedMinimizerTree(const CompressedMinimizerTree&)=delete;
+  CompressedMinimizerTree& operator=(const CompressedMinimizerTree&)=delete;
+
+  /*!
+   * Inserts a minimizer, the k-mer is replaced if there already is a minimizer at pos
+   * @param pos:    the position of the minimizer
+   * @param kmer:   the k-mer of the minimizer
+   */
+  void insert(Pos pos,std::string& kmer){
+    uint64_t packed=pack_kmer(kmer,0,k_size);
+    Pos start;
+    CompressedLeaf* leaf;
+    if(!leafAtOrBefore(pos,start,leaf)){
+      std::vector<uint64_t> offsets(1,0);
+      std::vector<uint64_t> kmers(1,packed);
+      if(!leafAfter(pos,start,leaf)){
+        //the tree is empty
+        createLeaf(offsets,kmers,pos);
+        n++;
+        return;
+      }
+      //pos becomes the first position of the first leaf
+      leaf->deltas.insert(0,0);
+      leaf->deltas.increment(1,(uint64_t)(Pos)(start-pos));
+      leaf->kmers.insert(0,packed);
+      rekeyLeaf(start,pos,leaf);
+      start=pos;
+    }
+    else{
+      uint64_t target=(uint64_t)(Pos)(pos-start);
+      uint64_t offset=0;
+      uint64_t i=0;
+      uint64_t size=leaf->deltas.size();
+      while(i<size && offset+leaf->deltas.at(i)<target){
+        offset+=leaf->deltas.at(i);
+        i++;
+      }
+      if(i<size && offset+leaf->deltas.at(i)==target){
+        //the position is already taken
+        leaf->kmers.set(i,0);
+        leaf->kmers.increment(i,packed);
+        return;
+      }
+      uint64_t delta=target-offset;
+      leaf->deltas.insert(i,delta);
+      if(i<size){
+        leaf->deltas.increment(i+1,delta,true);
+      }
+      leaf->kmers.insert(i,packed);
+    }
+    n++;
+    if((int)leaf->deltas.size()>leaf_capacity){
+      splitLeaf(start,leaf);
+    }
+  }
+
+  /*!
+   * Deletes the minimizers at positions left<=pos<=right
+   * @param left:   the lower bound of the range
+   * @param right:  the upper bound of the range
+   */
+  void removeRange(Pos left,Pos right){
+    if(leaves->is_empty() || right<left){
+      return;
+    }
+    //collect the leaves overlapping the range
+    std::vector<std::pair<Pos,CompressedLeaf*>> touched;
+    Pos start;
+    CompressedLeaf* leaf;
+    if(!leafAtOrBefore(left,start,leaf) && !leafAfter(left,start,leaf)){
+      return;
+    }
+    while(start<=right){
+      touched.push_back(std::make_pair(start,leaf));
+      if(!leafAfter(start,start,leaf)){
+        break;
+      }
+    }
+    bool has_survivor=false;
+    Pos survivor_start=0;
+    CompressedLeaf* survivor=nullptr;
+    for(int t=0;t<(int)touched.size();t++){
+      Pos leaf_start=touched[t].first;
+      CompressedLeaf* current=touched[t].second;
+      std::vector<uint64_t> offsets;
+      std::vector<uint64_t> kmers;
+      decodeLeaf(current,offsets,kmers);
+      std::vector<uint64_t> kept_offsets;
+      std::vector<uint64_t> kept_kmers;
+      Pos new_start=leaf_start;
+      for(int i=0;i<(int)offsets.size();i++){
+        Pos pos=leaf_start+(Pos)offsets[i];
+        if(pos>=left && pos<=right){
+          continue;
+        }
+        if(kept_offsets.empty()){
+          new_start=pos;
+        }
+        kept_offsets.push_back((uint64_t)(Pos)(pos-new_start));
+        kept_kmers.push_back(kmers[i]);
+      }
+      n-=offsets.size()-kept_offsets.size();
+      if(kept_offsets.empty()){
+        dropLeaf(leaf_start,current);
+        continue;
+      }
+      if(kept_offsets.size()!=offsets.size()){
+        rewriteLeaf(current,kept_offsets,kept_kmers);
+        rekeyLeaf(leaf_start,new_start,current);
+      }
+      if(!has_survivor || new_start<survivor_start){
+        has_survivor=true;
+        survivor_start=new_start;
+        survivor=current;
+      }
+    }
+    //merge the leaf in front of the range with the leaf behind it
+    if(!has_survivor && !leafAtOrBefore(left,survivor_start,survivor)){
+      return;
+    }
+    mergeWithSuccessor(survivor_start,survivor);
+  }
+
+  /*!
+   * Shifts the minimizers at positions >=pos by shift
+   * @param pos:    the first position to be shifted
+   * @param shift:  the shift, negative shifts must not move a minimizer to or before its predecessor
+   */
+  void shiftGreater(Pos pos,delta_t shift){
+    if(leaves->is_empty() || shift==0){
+      return;
+    }
+    Pos start;
+    CompressedLeaf* leaf;
+    Pos key_shift=(Pos)shift;
+    if(!leafAtOrBefore(pos,start,leaf)){
+      //all minimizers are shifted
+      Pos first=leaves->get_min();
+      leaves->shift_greater(first,key_shift);
+      return;
+    }
+    if(start!=pos){
+      //shift the part of the leaf behind pos by changing one delta
+      uint64_t target=(uint64_t)(Pos)(pos-start);
+      uint64_t offset=0;
+      uint64_t size=leaf->deltas.size();
+      for(uint64_t i=0;i<size;i++){
+        offset+=leaf->deltas.at(i);
+        if(offset>=target){
+          if(shift>0){
+            leaf->deltas.increment(i,(uint64_t)shift);
+          }
+          else{
+            assert(leaf->deltas.at(i)>(uint64_t)(-shift));
+            leaf->deltas.increment(i,(uint64_t)(-shift),true);
+          }
+          break;
+        }
+      }
+      if(!leafAfter(start,start,leaf)){
+        return;
+      }
+    }
+    leaves->shift_greater(start,key_shift);
+  }
+
+  /*!
+   * Replaces the minimizers in [left, right] by newminis and shifts the minimizers after right, the update of one
+   * variation-impact-range
+   * @param left:       first position of the replaced range
+   * @param right:      last position of the replaced range (before the shift)
+   * @param newminis:   the new minimizers of the range (after the shift)
+   * @param shift:      the length difference introduced by the variants of the range
+   */
+  void replaceRange(Pos left,Pos right,std::vector<BasicMinimizer<Pos>>& newminis,delta_t shift){
+    removeRange(left,right);
+    if(right<std::numeric_limits<Pos>::max()){
+      shiftGreater(right+1,shift);
+    }
+    for(int i=0;i<(int)newminis.size();i++){
+      std::string kmer=newminis[i].getSequence();
+      insert(newminis[i].getPosition(),kmer);
+    }
+  }
+
+  /*
+  * returns true and sets kmer if there is a minimizer at pos
+  */
+  bool search(Pos pos,std::string& kmer){
+    Pos start;
+    CompressedLeaf* leaf;
+    if(!leafAtOrBefore(pos,start,leaf)){
+      return false;
+    }
+    uint64_t target=(uint64_t)(Pos)(pos-start);
+    uint64_t offset=0;
+    for(uint64_t i=0;i<leaf->deltas.size() && offset<=target;i++){
+      offset+=leaf->deltas.at(i);
+      if(offset==target){
+        kmer=unpack_kmer(leaf->kmers.at(i),k_size);
+        return true;
+      }
+    }
+    return false;
+  }
+  /*
+  * returns all minimizers sorted by position
+  */
+  std::vector<BasicMinimizer<Pos>> toVector(){
+    std::vector<BasicMinimizer<Pos>> minimizers;
+    if(leaves->is_empty()){
+      return minimizers;
+    }
+    std::vector<uint64_t> offsets;
+    std::vector<uint64_t> kmers;
+    for(auto elem: *leaves){
+      decodeLeaf(elem.second[0],offsets,kmers);
+      for(int i=0;i<(int)offsets.size();i++){
+        Pos pos=elem.first+(Pos)offsets[i];
+        std::string kmer=unpack_kmer(kmers[i],k_size);
+        minimizers.push_back(BasicMinimizer<Pos>(pos,kmer));
+      }
+    }
+    return minimizers;
+  }
+  uint64_t size(){
+    return n;
+  }
+  uint64_t getNumberOfLeaves(){
+    return n_leaves;
+  }
+  /*
+  * returns the bytes used by the B-tree nodes, the leaves and the packed vectors. The statistics of the node
+  * allocator are shared by all compressed trees, so the value is exact if there is only one of them.
+  */
+  uint64_t getBytes(){
+    uint64_t bytes=leaf_alloc::stats().live_bytes+n_leaves*sizeof(CompressedLeaf*);
+    if(!leaves->is_empty()){
+      for(auto elem: *leaves){
+        CompressedLeaf* leaf=elem.second[0];
+        bytes+=leaf->deltas.bit_size()/8-sizeof(dyn::packed_vector);
+        bytes+=leaf->kmers.bit_size()/8-sizeof(dyn::packed_vector);
+      }
+    }
+    return bytes;
+  }
+};
+
+/*!
+ * Applies the variants to the sequence and updates the compressed minimizer tree
+ * @param tree:     the compressed minimizer tree
+ * @param dynamic_sequence:  the sequence to be altered
+ * @param variants: the variants to be applied
+ * @param k_size:   k-mer length
+ * @param w_size:   window size
+ */
+template<class Pos>
+void compute_dynamic_minimizers_compressed(CompressedMinimizerTree<Pos>& tree,dyn::wt_str& dynamic_sequence,std::vector<BasicVariant<Pos>>& variants,int& k_size,int& w_size){
+  apply_variants_to_dynamic_sequence(dynamic_sequence,variants,k_size,w_size,
+    [&](std::string& fullsubseq,Pos& thisstartpos,typename position_traits<Pos>::delta_type& var_impact_shift){
+      std::vector<BasicMinimizer<Pos>> newminis=get_kmer_minimizers_algo(fullsubseq,k_size,w_size,thisstartpos);
+      Pos left=(thisstartpos==0) ? std::numeric_limits<Pos>::min() : newminis.front().getPosition();
+      Pos right=newminis.back().getPosition()-var_impact_shift;
+      tree.replaceRange(left,right,newminis,var_impact_shift);
+    });
+}
+
+#endif
@@ -0,0 +1,197 @@
+////////////////////////////////////////////////////////////////////////////////
+// contig_index.h
+//   contig-aware minimizer index header file.
+//
+// One minimizer tree and one dynamic sequence per contig. The positions of a
+// contig are stored with the integer type Pos, positions across contigs are
+// addressed with (contig, offset) keys packed into 64 bits. The contigs are
+// independent, so their variants can be applied in parallel. Every contig
+// allocates its nodes from its own slab arena, so the workers take no lock.
+//
+////////////////////////////////////////////////////////////////////////////////
+//  author: Alexander Petri
+
+#ifndef CONTIG_INDEX_H
+#define CONTIG_INDEX_H
+
+#include "main.h"
+#include "positions.h"
+#include "Variant.h"
+#include "Minimizer.h"
+#include "get_kmer_minimizers.h"
+#include "B_tree_operations.h"
+#include "dynseq_functions.h"
+#include "dynamic_minimizer.h"
+#include "include/dynamic.hpp"
+
+#include <atomic>
+
+/*
+* Minimizer index of a genome consisting of several contigs.
+* Pos has to be able to address the longest contig (position_traits<Pos>::fits): uint32_t for contigs of human size
+* halves the memory of the keys compared to int64_t, int64_t allows contigs longer than 2^31 bases.
+*
+* @param contigs      the names and current lengths of the contigs
+* @param trees        the minimizer tree of every contig
+* @param sequences    the dynamic sequence of every contig
+* @param arenas       the slab arena of every contig, holding the nodes and satellites of its tree and the nodes and
+*                     leaves of its sequence
+* @param k_size       the length of the k-mers
+* @param w_size       the window size
+*/
+template<class Pos>
+class ContigMinimizerIndex{
+private:
+  typedef dyn::slab_allocator<md::b_tree_tag> tree_alloc;
+
+  ContigTable contigs;
+  std::vector<B_tree<Pos,std::string,7,3>*> trees;
+  std::vector<dyn::wt_str*> sequences;
+  std::vector<dyn::slab_arena*> arenas;
+  int k_size;
+  int w_size;
+
+public:
+  ContigMinimizerIndex(int k,int w){
+    k_size=k;
+    w_size=w;
+  }
+  /*
+  * The sequences are destroyed node by node. The trees are discarded with their arena in O(chunks), unless the k-mers
+  * are too long for the short string buffer and their characters live outside of the arena.
+  */
+  ~ContigMinimizerIndex(){
+    bool short_satellites=k_size<=(int)std::string().capacity();
+    for(int i=0;i<(int)trees.size();i++){
+      delete sequences[i];
+      if(short_satellites){
+        arenas[i]->release();
+      }
+      else{
+        tree_alloc::destroy(trees[i]);
+      }
+      delete arenas[i];
+    }
+  }
+  ContigMinimizerIndex(const ContigMinimizerIndex&)=delete;
+  ContigMinimizerIndex& operator=(const ContigMinimizerIndex&)=delete;
+
+  /*!
+   * Adds a contig, computes its minimizers and returns the id of the contig
+   * @param name:       the name of the contig
+   * @param sequence:   the sequence of the contig
+   */
+  int addContig(std::string name,std::string& sequence){
+    if(!position_traits<Pos>::fits(sequence.size())){
+      cout<<"Contig "<<name<<" is too long for the position type of the index\n";
+      assert(false);
+    }
+    int id=contigs.addContig(name,sequence.size());
+    std::vector<BasicMinimizer<Pos>> minis=get_kmer_minimizers<Pos>(sequence,k_size,w_size);
+    dyn::slab_arena* arena=new dyn::slab_arena();
+    dyn::slab_arena_scope scope(arena);
+    B_tree<Pos,std::string,7,3>* tree=tree_alloc::template create<B_tree<Pos,std::string,7,3>>();
+    fill_minimizer_tree(tree,minis);
+    dyn::wt_str* dynamic_sequence=new dyn::wt_str((uint64_t)4);
+    dynseq_push_many(*dynamic_sequence,sequence);
+    trees.push_back(tree);
+    sequences.push_back(dynamic_sequence);
+    arenas.push_back(arena);
+    return id;
+  }
+
+  /*!
+   * Applies the variants of every contig and updates its minimizers. Every contig is processed by exactly one
+   * thread inside the scope of its own arena, the contigs do not share any mutable state.
+   * @param variants:   variants[c] are the variants of contig c, sorted by position
+   * @param threads:    the number of worker threads
+   * @param ranges:     (optional) ranges[c] are the planned variation-impact-ranges of the variants of contig c
+   */
+  void applyVariants(std::vector<std::vector<BasicVariant<Pos>>>& variants,int threads=1,const std::vector<std::vector<BasicImpactRange<Pos>>>* ranges=nullptr){
+    assert(variants.size()==trees.size());
+    assert(ranges==nullptr || ranges->size()==trees.size());
+    std::atomic<int> next_contig(0);
+    auto worker=[&](){
+      int c;
+      while((c=next_contig.fetch_add(1))<(int)trees.size()){
+        if(!variants[c].empty()){
+          dyn::slab_arena_scope scope(arenas[c]);
+          compute_dynamic_minimizers(trees[c],*sequences[c],variants[c],k_size,w_size,BasicUpdateObservers<Pos>(),ranges==nullptr ? nullptr : &(*ranges)[c]);
+        }
+      }
+    };
+    threads=std::max(1,std::min(threads,(int)trees.size()));
+    std::vector<std::thread> workers;
+    for(int t=1;t<threads;t++){
+      workers.push_back(std::thread(worker));
+    }
+    worker();
+    for(int t=0;t<(int)workers.size();t++){
+      workers[t].join();
+    }
+    for(int c=0;c<(int)trees.size();c++){
+      contigs.setLength(c,sequences[c]->size());
+      if(!position_traits<Pos>::fits(sequences[c]->size())){
+        cout<<"Contig "<<contigs.getName(c)<<" outgrew the position type of the index\n";
+        assert(false);
+      }
+    }
+  }
+
+  /*
+  * returns the packed key of a minimizer at position pos of contig
+  */
+  contig_key_t getKey(int contig,Pos pos){
+    return make_contig_key(contig,pos);
+  }
+  /*
+  * returns the sequence of the minimizer stored under key or an empty string if there is no such minimizer
+  */
+  std::string lookup(contig_key_t key){
+    int contig=key_contig(key);
+    if(contig>=trees.size()){
+      return "";
+    }
+    Pos pos=key_offset(key);
+    auto elem=trees[contig]->search(pos);
+    if(elem.key==nullptr){
+      return "";
+    }
+    return (*elem.key->satellites)[0];
+  }
+  /*
+  * returns the packed keys of all minimizers, sorted by contig and position
+  */
+  std::vector<contig_key_t> getKeys(){
+    std::vector<contig_key_t> keys;
+    for(int c=0;c<trees.size();c++){
+      for(auto elem: *trees[c]){
+        keys.push_back(make_contig_key(c,elem.first));
+      }
+    }
+    return keys;
+  }
+  int getK(){
+    return k_size;
+  }
+  int getW(){
+    return w_size;
+  }
+  B_tree<Pos,std::string,7,3>* getTree(int contig){
+    return trees[contig];
+  }
+  dyn::wt_str& getSequence(int contig){
+    return *sequences[contig];
+  }
+  ContigTable& getContigTable(){
+    return contigs;
+  }
+  /*
+  * returns the allocation statistics of the arena of contig
+  */
+  dyn::alloc_stats getAllocationStatistics(int contig){
+    return arenas[contig]->stats();
+  }
+};
+
+#endif
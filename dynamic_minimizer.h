@@ -13,10 +13,13 @@
 
 #include "main.h"
 #include "Variant.h"
+#include "positions.h"
 #include "B-tree.hh"
 #include "B_tree_node.hh"
 #include "B_tree_operations.h"
 #include "dynseq_functions.h"
+#include "liftover.h"
+#include "undo_journal.h"
 #include "DYNAMIC-master/include/dynamic.hpp"
 
 /*!
@@ -34,17 +37,18 @@
 * @return offset:           the position in the variation-impact-range at which the variation starts
 * @return thisstartpos:     the position at which the current variation-impact-range starts. If prevseq is true, the position of the previous variation-impact-range
 */
-std::tuple<int,int,int> compute_left_bound(int& previous_right,Variant& thisvar,int& prevlength,int& prevseqstart,int& k_size,int& w_size, bool& prevseq){
-  int left = 0;
+template<class Pos>
+std::tuple<Pos,int,Pos> compute_left_bound(Pos& previous_right,BasicVariant<Pos>& thisvar,typename position_traits<Pos>::delta_type& prevlength,Pos& prevseqstart,int& k_size,int& w_size, bool& prevseq){
+  Pos left = 0;
   int offset = 0;
-  int thisstartpos = 0;
-  int variation_position = thisvar.getVariantPosition();
+  Pos thisstartpos = 0;
+  Pos variation_position = thisvar.getVariantPosition();
   if(prevseq){//this variation range intersects with the variation range of the previous variant
     left = previous_right + prevlength-1;
     thisstartpos = prevseqstart;
     }
   else{//no intersection with previous variation range
-    if(variation_position <= w_size + (k_size - 1)){//if this variant is at a position which is close to the start of the sequence
+    if((int64_t)variation_position <= w_size + (k_size - 1)){//if this variant is at a position which is close to the start of the sequence
       left = 0;
     }
     else{ //if this variant is far enough away from the sequences' start
@@ -69,18 +73,17 @@ std::tuple<int,int,int> compute_left_bound(int& previous_right,Variant& thisvar,
 *                           variation-impact-range and false if not
 
 */
-std::tuple<int,bool> compute_right_bound(std::vector<Variant>& variants,int& variant_index,int& w_size,int& k_size,dyn::wt_str& sequence){
+template<class Pos>
+std::tuple<Pos,bool> compute_right_bound(std::vector<BasicVariant<Pos>>& variants,int& variant_index,int& w_size,int& k_size,dyn::wt_str& sequence){
   cout<<"Dynseqsize crb: "<<sequence.size()<<"\n";
-  Variant this_variant=variants.at(variant_index);
+  BasicVariant<Pos> this_variant=variants.at(variant_index);
   bool subseq=false;
-  int length=this_variant.getVariantLength();
   int originalseqlen=this_variant.getVariantOriginalSeqLen();
-  int this_variant_pos=this_variant.getVariantPosition();
-  int this_variant_delta=length - originalseqlen;
+  Pos this_variant_pos=this_variant.getVariantPosition();
   string this_variant_seq=this_variant.getVariantSequence();
-  int next_variant_pos=0;
-  int right=0;
-  if(variant_index+1<variants.size()){ //if this variant is not the last element of variants
+  Pos next_variant_pos=0;
+  Pos right=0;
+  if(variant_index+1<(int)variants.size()){ //if this variant is not the last element of variants
     next_variant_pos=variants.at(variant_index+1).getVariantPosition(); //get the position of the next variation
     if(this_variant_pos+originalseqlen+(2*w_size)+2*(k_size-1)>=next_variant_pos){ //the next variation is in the variation-range of this variation
       right=this_variant_pos+originalseqlen;//set right to the position after the affected sequence part(last aff position)
@@ -91,8 +94,9 @@ std::tuple<int,bool> compute_right_bound(std::vector<Variant>& variants,int& var
     }
   }
   else{//this variant is the last element of variants
-    if(this_variant_pos+w_size+originalseqlen+k_size+1>=sequence.size()-1){
-      right=sequence.size()-1;
+    //signed comparison, so that an empty sequence does not wrap around
+    if((int64_t)(this_variant_pos+w_size+originalseqlen+k_size+1)>=(int64_t)sequence.size()-1){
+      right=(Pos)(sequence.size()-1);
       cout<<"right! "<<right<<"\n";
     }
     else{
@@ -110,48 +114,124 @@ std::tuple<int,bool> compute_right_bound(std::vector<Variant>& variants,int& var
 }
 
 /*!
-* Implementation of the dynamic minimizer algorithm.
-* @param minimizerTree:     B-tree holding the final minimizers
-* @param sequence:  the sequence to be altered
+* Callback invoked once per (merged) variation-impact-range after the sequence has been updated.
+* @param fullsubseq:        the updated subsequence covering the variation-impact-range
+* @param thisstartpos:      the position at which the variation-impact-range starts
+* @param var_impact_shift:  the length by which subsequent minimizers have to be shifted
+*/
+template<class Pos>
+struct impact_range_callback_t{
+  typedef std::function<void(std::string&,Pos&,typename position_traits<Pos>::delta_type&)> type;
+};
+typedef impact_range_callback_t<int>::type impact_range_callback;
+
+/*
+* A variation-impact-range planned before the variants are applied: the n_variants variants starting at first_variant
+* are recomputed together. left is the lower bound of the range and right the upper bound of its last variant as
+* compute_left_bound and compute_right_bound return them, both in reference coordinates, i.e. without the shift of the
+* variants in front of them (left is negative if the range starts at 0 behind a deletion).
+*/
+template<class Pos>
+struct BasicImpactRange{
+  uint64_t first_variant;
+  int64_t left;
+  int64_t right;
+  uint32_t n_variants;
+};
+typedef BasicImpactRange<int> ImpactRange;
+
+/*!
+* Applies the variants to the dynamic sequence and hands every variation-impact-range to update_minimizers.
+* The variation-impact-ranges are computed for k_size and w_size, which therefore have to be the largest
+* values used by update_minimizers.
+* @param dynamic_sequence:  the sequence to be altered
 * @param variants:          Vector of variants which are applied to the sequence
 * @param k_size:            length of the k-mers
 * @param w_size:            window size for the minimizer generations
+* @param update_minimizers: callback updating the minimizers for every variation-impact-range
+* @param liftover:          (optional) liftover recording every applied variant, so that positions can be
+*                           translated between the reference and the altered sequence afterwards
+* @param journal:           (optional) undo journal recording the changes of the sequence and the variant positions
+* @param ranges:            (optional) the variation-impact-ranges of the variants, planned for k_size and w_size
+*                           before they are applied (e.g. by build_variant_plan). The bounds are read from the ranges
+*                           instead of being computed for every variant.
 */
-void compute_dynamic_minimizers(B_tree<int,std::string,7,3>* minimizerTree,dyn::wt_str& dynamic_sequence,std::vector<Variant>& variants,int& k_size,int& w_size){
-int previous_shift=0;
-int previous_right = 0;
-int prevlength = 0;
-int prevseqstart = 0;
+template<class Pos>
+void apply_variants_to_dynamic_sequence(dyn::wt_str& dynamic_sequence,std::vector<BasicVariant<Pos>>& variants,int& k_size,int& w_size,typename impact_range_callback_t<Pos>::type update_minimizers,BasicLiftover<Pos>* liftover=nullptr,BasicUndoJournal<Pos>* journal=nullptr,const std::vector<BasicImpactRange<Pos>>* ranges=nullptr){
+typedef typename position_traits<Pos>::delta_type delta_t;
+delta_t previous_shift=0;
+Pos previous_right = 0;
+delta_t prevlength = 0;
+Pos prevseqstart = 0;
 bool prevseq = false;
 bool subseq=false;
-int shift=0;
+delta_t shift=0;
 std::vector<int> variants_in_subseq;
 std::vector<int> variant_changes;
 std::string previous_sequence="";
-int var_impact_shift=0;
-int appliedshift=0;
+delta_t var_impact_shift=0;
+delta_t appliedshift=0;
+//the planned range of the current variant and the index of the variant in it
+uint64_t range_index=0;
+uint32_t range_variant=0;
+if(ranges!=nullptr){
+  uint64_t planned=0;
+  for(uint64_t r=0;r<ranges->size();r++){
+    assert((*ranges)[r].first_variant==planned && (*ranges)[r].n_variants>0);
+    planned+=(*ranges)[r].n_variants;
+  }
+  assert(planned==variants.size());
+}
 //iterate over all variations
-  for(int i=0;i<variants.size();i++){
+  for(int i=0;i<(int)variants.size();i++){
     int offset=0;
-    std::tuple<int,int,int> left_infos;
-    std::tuple<int,bool> right_infos;
+    std::tuple<Pos,int,Pos> left_infos;
+    std::tuple<Pos,bool> right_infos;
     //apply the shift to the position of the current variation
     variants.at(i).updateVariantPosition(previous_shift);
-    Variant this_var = variants.at(i);
+    if(journal!=nullptr){
+      journal->recordVariantShift(i,previous_shift);
+    }
+    BasicVariant<Pos> this_var = variants.at(i);
     string this_variant_seq=this_var.getVariantSequence();
     int originalseqlen=this_var.getVariantOriginalSeqLen();
-    int this_variant_delta= this_var.getVariantLength() - originalseqlen;
+    delta_t this_variant_delta= this_var.getVariantLength() - originalseqlen;
     shift=previous_shift+this_variant_delta;
     int variant_index = i;
-    //compute the variation-impact-range
-    left_infos = compute_left_bound(previous_right,this_var,prevlength,prevseqstart,k_size,w_size,prevseq);
-    int left = std::get<0>(left_infos);
+    //record the edit in the liftover (the position of this_var is already given in altered coordinates)
+    if(liftover!=nullptr){
+      liftover->applyVariant(this_var);
+    }
+    //compute the variation-impact-range or read it from the planned range, whose bounds only have to be shifted
+    if(ranges==nullptr){
+      left_infos = compute_left_bound(previous_right,this_var,prevlength,prevseqstart,k_size,w_size,prevseq);
+    }
+    else if(range_variant==0){
+      Pos planned_left=(Pos)((*ranges)[range_index].left+previous_shift);
+      left_infos = make_tuple(planned_left,(int)(this_var.getVariantPosition()-planned_left),planned_left);
+    }
+    else{
+      Pos merged_left=previous_right+prevlength-1;
+      left_infos = make_tuple(merged_left,(int)(this_var.getVariantPosition()-merged_left),prevseqstart);
+    }
+    Pos left = std::get<0>(left_infos);
     offset=std::get<1>(left_infos);
-    int thisstartpos=std::get<2>(left_infos);
+    Pos thisstartpos=std::get<2>(left_infos);
     var_impact_shift+=this_variant_delta;
     //std::string whole_sequence=dynseq_tostring(dynamic_sequence);
-    right_infos = compute_right_bound(variants,variant_index,w_size,k_size,dynamic_sequence);
-    int right = std::get<0>(right_infos);
+    if(ranges==nullptr){
+      right_infos = compute_right_bound(variants,variant_index,w_size,k_size,dynamic_sequence);
+    }
+    else if(range_variant+1==(*ranges)[range_index].n_variants){
+      right_infos = make_tuple((Pos)((*ranges)[range_index].right+previous_shift),false);
+      range_index++;
+      range_variant=0;
+    }
+    else{
+      right_infos = make_tuple((Pos)(this_var.getVariantPosition()+originalseqlen),true);
+      range_variant++;
+    }
+    Pos right = std::get<0>(right_infos);
     subseq = std::get<1>(right_infos);
     if(subseq==true){
       cout<<"This variation-impactrange intersects with the following\n";
@@ -174,10 +254,11 @@ int appliedshift=0;
     cout<<"otherend: "<<offset+originalseqlen+1<<"\n";
 
     //apply the variation to the subsequence
+    std::string original_subsequence=subsequence;
     std::string newsubsequence="";
     if (offset > 0){
       int subseqend=offset+originalseqlen;
-      if(subseqend>subsequence.size()){
+      if(subseqend>(int)subsequence.size()){
       subseqend=subsequence.size()-1;
     }
       newsubsequence =subsequence.substr(0,offset)+this_variant_seq+subsequence.substr(subseqend);
@@ -198,6 +279,9 @@ int appliedshift=0;
       dynseq_update_substr(dynamic_sequence,left,right,subsequence);
     }*/
     //update the sequence
+    if(journal!=nullptr){
+      journal->recordSequenceEdit(left,original_subsequence,subsequence.size());
+    }
     dynseq_update_substr(dynamic_sequence,left,right+1,subsequence);
 
     //whole_sequence=dynseq_tostring(dynamic_sequence);
@@ -210,7 +294,7 @@ int appliedshift=0;
     if(prevseq){
       cout<<"prevseq\n";
       cout<<"prevseqstart: "<<prevseqstart<<", sprevseqsize"<<previous_sequence.size()<<", left: "<<left<<"\n";
-      int overlap=prevseqstart+previous_sequence.size()-left;
+      int64_t overlap=(int64_t)prevseqstart+(int64_t)previous_sequence.size()-(int64_t)left;
       cout<<"overlap: "<<overlap <<"\n";
       if (overlap<0){
         fullsubseq=previous_sequence+subsequence;
@@ -235,8 +319,8 @@ int appliedshift=0;
       //cout<<"Printing the minimizer Tree done\n";
       //cout<<"Varimpact "<<var_impact_shift<<"\n";
 
-      //update the minimizer tree holding the minimizers
-      update_minimizerTree(minimizerTree,fullsubseq,thisstartpos,k_size,w_size,var_impact_shift);
+      //update the minimizers of the variation-impact-range
+      update_minimizers(fullsubseq,thisstartpos,var_impact_shift);
 
       //cout<<"done with applying shifts\n";
       //get_kmer_minimizers_algo(minimizerTree,fullsubseq,k_size,w_size,thisstartpos);
@@ -261,5 +345,61 @@ int appliedshift=0;
   cout<<"Algorithm finished!!!\n";
 }
 
+/*
+* The optional observers of an update. Every observer left at nullptr is skipped, the others are set by name:
+* compute_dynamic_minimizers(tree,sequence,variants,k,w,UpdateObservers().withJournal(&journal).withFeed(&feed));
+*
+* @param liftover       liftover recording every applied variant, so that positions can be translated between the
+*                       reference and the altered sequence afterwards
+* @param journal        undo journal recording all changes, so that they can be reverted
+* @param frequencies    k-mer counts following every deleted and inserted minimizer, so that the mask of the most
+*                       frequent minimizers stays correct
+* @param feed           change feed receiving every deleted, shifted and inserted minimizer in order
+*/
+template<class Pos>
+struct BasicUpdateObservers{
+  BasicLiftover<Pos>* liftover=nullptr;
+  BasicUndoJournal<Pos>* journal=nullptr;
+  KmerFrequencyTable* frequencies=nullptr;
+  BasicChangeFeed<Pos>* feed=nullptr;
+
+  BasicUpdateObservers& withLiftover(BasicLiftover<Pos>* observer){
+    liftover=observer;
+    return *this;
+  }
+  BasicUpdateObservers& withJournal(BasicUndoJournal<Pos>* observer){
+    journal=observer;
+    return *this;
+  }
+  BasicUpdateObservers& withFrequencies(KmerFrequencyTable* observer){
+    frequencies=observer;
+    return *this;
+  }
+  BasicUpdateObservers& withFeed(BasicChangeFeed<Pos>* observer){
+    feed=observer;
+    return *this;
+  }
+};
+typedef BasicUpdateObservers<int> UpdateObservers;
+
+/*!
+* Implementation of the dynamic minimizer algorithm.
+* @param minimizerTree:     B-tree holding the final minimizers
+* @param sequence:  the sequence to be altered
+* @param variants:          Vector of variants which are applied to the sequence
+* @param k_size:            length of the k-mers
+* @param w_size:            window size for the minimizer generations
+* @param observers:         (optional) liftover, undo journal, k-mer counts and change feed following the update
+* @param ranges:            (optional) the planned variation-impact-ranges of the variants
+*/
+template<class Pos>
+void compute_dynamic_minimizers(B_tree<Pos,std::string,7,3>* minimizerTree,dyn::wt_str& dynamic_sequence,std::vector<BasicVariant<Pos>>& variants,int& k_size,int& w_size,BasicUpdateObservers<Pos> observers=BasicUpdateObservers<Pos>(),const std::vector<BasicImpactRange<Pos>>* ranges=nullptr){
+  apply_variants_to_dynamic_sequence(dynamic_sequence,variants,k_size,w_size,
+    [&](std::string& fullsubseq,Pos& thisstartpos,typename position_traits<Pos>::delta_type& var_impact_shift){
+      //update the minimizer tree holding the minimizers
+      update_minimizerTree(minimizerTree,fullsubseq,thisstartpos,k_size,w_size,var_impact_shift,observers.journal,observers.frequencies,observers.feed);
+    },observers.liftover,observers.journal,ranges);
+}
+
 
 #endif
@@ -24,11 +24,12 @@
 *
 * @return subsequence       the subsequence
 */
-std::string dynseq_get_substr(dyn::wt_str dynamic_sequence, int left, int right){
-  std::string subsequence="";
-  for(int i=left;i<=right;i++){
-    subsequence+=dynamic_sequence.at(i);
+std::string dynseq_get_substr(dyn::wt_str& dynamic_sequence, int64_t left, int64_t right){
+  if(right<left){
+    return "";
   }
+  std::string subsequence(right-left+1,'A');
+  dynamic_sequence.extract(left,right+1,subsequence.begin());
   return subsequence;
 }
 /*
@@ -38,29 +39,36 @@ std::string dynseq_get_substr(dyn::wt_str dynamic_sequence, int left, int right)
 * @return output            the std::string
 */
 std::string dynseq_tostring(dyn::wt_str& dynamic_sequence){
-  int size=dynamic_sequence.size();
-  std::string output="";
-  for(int i=0;i<size;i++){
-    output+=dynamic_sequence.at(i);
-  }
+  std::string output(dynamic_sequence.size(),'A');
+  dynamic_sequence.extract(0,output.size(),output.begin());
   return output;
 }
 /*
+* appends a sequence to the end of the dynamic sequence
+* @param dynamic_sequence   the dynamic sequence
+* @param bases              the bases to be appended
+*/
+void dynseq_push_many(dyn::wt_str& dynamic_sequence, std::string& bases){
+  for(int i=0;i<(int)bases.length();i++){
+    dynamic_sequence.push_back(bases.at(i));
+  }
+}
+/*
 * updates the dynamic sequence by replacing a substring
 * @param dynamic_sequence   the dynamic sequence
 * @param left               the lower bound for the elements to be deleted
 * @param right              the upper bound for the elements to be deleted
 * @param subsequence        the subsequence which is inserted into the dynamic sequence
 */
-void dynseq_update_substr(dyn::wt_str& dynamic_sequence, int left, int right,std::string subsequence){
+void dynseq_update_substr(dyn::wt_str& dynamic_sequence, int64_t left, int64_t right,std::string subsequence){
   //cout<<"Size of dynseq:"<<dynamic_sequence.size()<<"\n";
-  for(int i=left;i<right;i++){
+  for(int64_t i=left;i<right;i++){
     //if(i<dynamic_sequence.size()){
       dynamic_sequence.remove(left);
     //  cout<<"Dynseq after: "<<dynseq_tostring(dynamic_sequence)<<"\n";
   //  }
   }
-  for(int i=0;i<subsequence.length();i++){
+  for(int i=0;i<(int)subsequence.length();i++){
     //cout<<"Adding Element at "<<left+i<<"\n";
     dynamic_sequence.insert(left+i,subsequence.at(i));
     //cout<<"Subsequence at i:"<<subsequence.at(i)<<"\n";
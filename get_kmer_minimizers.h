@@ -47,14 +47,16 @@ void print_forward_list(std::forward_list<std::string>& forward){
  *
  * (@param w)         not a param of this function as w can be calculated by w=w_size-k_size+1
  */
-std::vector<Minimizer> get_kmer_minimizers(string& sequence, int& k_size, int& w_size){
+template<class Pos=int>
+std::vector<BasicMinimizer<Pos>> get_kmer_minimizers(string& sequence, int& k_size, int& w_size){
   int w = w_size - k_size+1;
+  //signed, so that sequences shorter than k_size do not wrap around
+  int64_t n_kmers=(int64_t)sequence.length()-k_size+1;
   string max(k_size, 'Z');
   string curr_min;
-  int min_pos=std::numeric_limits<int>::max();
-  int min_diff=0;
+  Pos min_pos=std::numeric_limits<Pos>::max();
   curr_min=max;
-  std::vector<Minimizer> minimizers;
+  std::vector<BasicMinimizer<Pos>> minimizers;
   std::forward_list<std::string> forward;
   auto beginIt=forward.begin();
   auto otherIt=beginIt;
@@ -94,12 +96,13 @@ std::vector<Minimizer> get_kmer_minimizers(string& sequence, int& k_size, int& w
   }
   curr_min=minimum;
   //generate Minimizer object and add it to the solution
-  Minimizer startmini=Minimizer(startpos,minimum);
+  Pos first_pos=startpos;
+  BasicMinimizer<Pos> startmini=BasicMinimizer<Pos>(first_pos,minimum);
   minimizers.push_back(startmini);
-  Minimizer mini;
+  BasicMinimizer<Pos> mini;
   min_pos=startpos;
   //find the rest of the Minimizers
-  for (int i=w;i<sequence.length()-k_size+1;i++){
+  for (Pos i=w;(int64_t)i<n_kmers;i++){
     string new_kmer=sequence.substr(i,k_size);
     //if the new k_mer is smaller than curr_min: We have found a minimizer! Empty forward list
     if(new_kmer<curr_min){
@@ -110,7 +113,7 @@ std::vector<Minimizer> get_kmer_minimizers(string& sequence, int& k_size, int& w
       forward.clear();
     }
    //if we have not found a new minimizer in w consecutive kmers. Find minimum of the set of kmers->new minimizer
-    else if(i-min_pos==w){
+    else if((int64_t)(i-min_pos)==w){
       otherIt = forward.insert_after(otherIt, new_kmer);
       int itnum=0;
       int pos=0;
@@ -161,18 +164,20 @@ std::vector<Minimizer> get_kmer_minimizers(string& sequence, int& k_size, int& w
  *
  * (@param w)         not a param of this function as w can be calculated by w=w_size-k_size+1
  */
-std::vector<Minimizer> get_kmer_minimizers_algo(string& sequence, int& k_size, int& w_size,int& posshift){
+template<class Pos>
+std::vector<BasicMinimizer<Pos>> get_kmer_minimizers_algo(string& sequence, int& k_size, int& w_size,Pos& posshift){
   int w = w_size - k_size+1;
+  //signed, so that sequences shorter than k_size do not wrap around
+  int64_t n_kmers=(int64_t)sequence.length()-k_size+1;
   string max(k_size, 'Z');
   string curr_min;
-  int min_pos=std::numeric_limits<int>::max();
-  int min_diff=0;
+  Pos min_pos=std::numeric_limits<Pos>::max();
   curr_min=max;
-  std::vector<Minimizer> minimizers;
+  std::vector<BasicMinimizer<Pos>> minimizers;
   std::forward_list<std::string> forward;
   auto beginIt=forward.begin();
   auto otherIt=beginIt;
-  int realpos=0;
+  Pos realpos=0;
   // generate the first minimizer of the sequence by finding the minimum kmer out of the first w k_mers
   for(int i=0;i<w;i++){
     //fill the forward list with the kmers
@@ -210,12 +215,12 @@ std::vector<Minimizer> get_kmer_minimizers_algo(string& sequence, int& k_size, i
   //generate Minimizer object and add it to the solution
   realpos=startpos+posshift;
   //Minimizer startmini=Minimizer(realpos,minimum);
-  minimizers.push_back(Minimizer(realpos,minimum));
+  minimizers.push_back(BasicMinimizer<Pos>(realpos,minimum));
   //minimizerTree->insert(realpos,minimum);
   //Minimizer mini;
   min_pos=startpos;
   //find the rest of the Minimizers
-  for (int i=w;i<sequence.length()-k_size+1;i++){
+  for (Pos i=w;(int64_t)i<n_kmers;i++){
     string new_kmer=sequence.substr(i,k_size);
     //if the new k_mer is smaller than curr_min: We have found a minimizer! Empty forward list
     if(new_kmer<curr_min){
@@ -223,12 +228,12 @@ std::vector<Minimizer> get_kmer_minimizers_algo(string& sequence, int& k_size, i
       min_pos=i;
       realpos=min_pos+posshift;
       //mini.updateMinimizer(realpos,curr_min);
-      minimizers.push_back(Minimizer(realpos, curr_min));
+      minimizers.push_back(BasicMinimizer<Pos>(realpos, curr_min));
       //minimizerTree->insert(realpos,curr_min);
       forward.clear();
     }
    //if we have not found a new minimizer in w consecutive kmers. Find minimum of the set of kmers->new minimizer
-    else if(i-min_pos==w){
+    else if((int64_t)(i-min_pos)==w){
       otherIt = forward.insert_after(otherIt, new_kmer);
       int itnum=0;
       int pos=0;
@@ -255,7 +260,7 @@ std::vector<Minimizer> get_kmer_minimizers_algo(string& sequence, int& k_size, i
       realpos=min_pos+posshift;
       //mini.updateMinimizer(realpos,curr_min);
 
-      minimizers.push_back(Minimizer(realpos,curr_min));
+      minimizers.push_back(BasicMinimizer<Pos>(realpos,curr_min));
       //minimizerTree->insert(realpos,curr_min);
     }
     //only add the new kmer to the forward list
@@ -269,7 +274,7 @@ std::vector<Minimizer> get_kmer_minimizers_algo(string& sequence, int& k_size, i
     }
   }
   //cout<<"Printing getkmerminimizers\n";
-  for(int i=0;i<minimizers.size();i++){
+  for(int i=0;i<(int)minimizers.size();i++){
     minimizers[i].printMinimizer();
   }
   //cout<<"Printing getkmerminimizers done\n";
@@ -0,0 +1,321 @@
+////////////////////////////////////////////////////////////////////////////////
+// haplotype_export.h
+//   haplotype export header file.
+//
+//  writes the (altered) sequence held in a dynamic sequence as FASTA or 2 bit
+//  packed bases. The sequence is cut into chunks which are decoded in parallel
+//  with one sequential pass over the wavelet tree each, so the whole sequence
+//  is never held as one string.
+//
+////////////////////////////////////////////////////////////////////////////////
+//  author: Alexander Petri
+
+#ifndef HAPLOTYPE_EXPORT_H
+#define HAPLOTYPE_EXPORT_H
+
+#include "main.h"
+#include "packed_kmers.h"
+#include "include/dynamic.hpp"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/*
+* HAPLOTYPE_FASTA:     a header line >name followed by the bases in lines of line_width bases
+* HAPLOTYPE_TWO_BIT:   the bases packed into little-endian uint64_t words, 32 bases per word, base i in bits
+*                      2*(i%32) of word i/32 (A=0, C=1, G=2, T=3, other bases as A), the layout of the sequence of a
+*                      snapshot. The last word is padded with A.
+*/
+enum HaplotypeFormat{
+  HAPLOTYPE_FASTA,
+  HAPLOTYPE_TWO_BIT
+};
+
+struct HaplotypeExportStatistics{
+  uint64_t bases=0;
+  uint64_t chunks=0;
+  uint64_t bytes=0;
+  int threads=0;
+  double seconds=0;
+
+  /*
+  * prints the statistics to the console
+  */
+  void printStatistics() const{
+    cout<<bases<<" bases in "<<chunks<<" chunks exported to "<<bytes<<" bytes by "<<threads<<" threads in "<<seconds<<" s ("<<(seconds>0 ? bases/seconds : 0.0)<<" bases/s)\n";
+  }
+};
+
+/*
+* Cuts a sequence into chunks which can be written independently: a chunk of a FASTA file is a whole number of lines,
+* a chunk of a 2 bit file a whole number of words.
+*
+* @param length       the number of bases
+* @param header       the bytes in front of the first base
+* @param chunk_size   the (maximal) number of bases of a chunk
+*/
+class HaplotypeLayout{
+private:
+  HaplotypeFormat format;
+  uint64_t length;
+  uint64_t header;
+  uint64_t line_width;
+  uint64_t chunk_size;
+
+public:
+  HaplotypeLayout(HaplotypeFormat layout_format,uint64_t bases,std::string& name,uint64_t chunk_bases,int width){
+    assert(width>0);
+    format=layout_format;
+    length=bases;
+    line_width=width;
+    header=format==HAPLOTYPE_FASTA ? name.size()+2 : 0;
+    uint64_t unit=format==HAPLOTYPE_FASTA ? line_width : 32;
+    chunk_size=std::max(unit,chunk_bases/unit*unit);
+  }
+  uint64_t getNumberOfChunks() const{
+    return (length+chunk_size-1)/chunk_size;
+  }
+  uint64_t getChunkSize() const{
+    return chunk_size;
+  }
+  uint64_t getChunkStart(uint64_t chunk) const{
+    return std::min(length,chunk*chunk_size);
+  }
+  uint64_t getChunkEnd(uint64_t chunk) const{
+    return std::min(length,(chunk+1)*chunk_size);
+  }
+  /*
+  * returns the offset of the output of the chunk starting with base position (or ending at the end of the sequence)
+  */
+  uint64_t getOffset(uint64_t position) const{
+    if(format==HAPLOTYPE_TWO_BIT){
+      return (position+31)/32*sizeof(uint64_t);
+    }
+    return header+position+(position+line_width-1)/line_width;
+  }
+  uint64_t getSize() const{
+    return getOffset(length);
+  }
+  uint64_t getHeaderSize() const{
+    return header;
+  }
+};
+
+/*
+* writes the header line of a FASTA file
+*/
+inline void write_haplotype_header(HaplotypeFormat format,std::string& name,char* out){
+  if(format==HAPLOTYPE_FASTA){
+    out[0]='>';
+    memcpy(out+1,name.data(),name.size());
+    out[name.size()+1]='\n';
+  }
+}
+
+/*
+* decodes the bases start ... end-1 of the sequence and writes them in the output format
+* @param bases    scratch space for end-start bases
+* @param out      receives layout.getOffset(end)-layout.getOffset(start) bytes
+*/
+inline void export_haplotype_chunk(dyn::wt_str& dynamic_sequence,HaplotypeFormat format,int line_width,uint64_t start,uint64_t end,char* bases,char* out){
+  dynamic_sequence.extract(start,end,bases);
+  uint64_t n=end-start;
+  if(format==HAPLOTYPE_FASTA){
+    for(uint64_t i=0;i<n;i+=line_width){
+      uint64_t line=std::min<uint64_t>(line_width,n-i);
+      memcpy(out,bases+i,line);
+      out[line]='\n';
+      out+=line+1;
+    }
+    return;
+  }
+  for(uint64_t i=0;i<n;i+=32){
+    uint64_t word=0;
+    uint64_t last=std::min<uint64_t>(32,n-i);
+    for(uint64_t j=0;j<last;j++){
+      word|=uint64_t(encode_base(bases[i+j]))<<(2*j);
+    }
+    memcpy(out+i/32*sizeof(uint64_t),&word,sizeof(uint64_t));
+  }
+}
+
+/*!
+ * returns the number of bytes export_haplotype writes for a sequence
+ */
+uint64_t haplotype_export_size(uint64_t length,std::string& name,HaplotypeFormat format=HAPLOTYPE_FASTA,int line_width=60){
+  HaplotypeLayout layout(format,length,name,1,line_width);
+  return layout.getSize();
+}
+
+/*!
+ * Writes the sequence into a buffer, e.g. a mapped file. Every thread decodes whole chunks and writes them straight to
+ * their place in the buffer, apart from the buffer only one chunk of bases per thread is held in memory.
+ * @param dynamic_sequence:   the sequence
+ * @param buffer:             receives haplotype_export_size(...) bytes
+ * @param name:               the name of the FASTA record
+ * @param format:             FASTA or 2 bit packed bases
+ * @param threads:            the number of threads decoding chunks
+ * @param chunk_size:         the number of bases per chunk, rounded down to whole lines (words)
+ * @param line_width:         the number of bases per FASTA line
+ * @param statistics:         (optional) receives the number of bases, chunks and bytes and the time
+ */
+void export_haplotype(dyn::wt_str& dynamic_sequence,char* buffer,std::string& name,HaplotypeFormat format=HAPLOTYPE_FASTA,int threads=1,uint64_t chunk_size=1<<20,int line_width=60,HaplotypeExportStatistics* statistics=nullptr){
+  auto start_time=std::chrono::high_resolution_clock::now();
+  HaplotypeLayout layout(format,dynamic_sequence.size(),name,chunk_size,line_width);
+  write_haplotype_header(format,name,buffer);
+  std::atomic<uint64_t> next_chunk(0);
+  auto worker=[&](){
+    std::vector<char> bases(layout.getChunkSize());
+    uint64_t chunk;
+    while((chunk=next_chunk.fetch_add(1))<layout.getNumberOfChunks()){
+      uint64_t start=layout.getChunkStart(chunk);
+      export_haplotype_chunk(dynamic_sequence,format,line_width,start,layout.getChunkEnd(chunk),bases.data(),buffer+layout.getOffset(start));
+    }
+  };
+  threads=std::max<int>(1,std::min<uint64_t>(threads,layout.getNumberOfChunks()));
+  std::vector<std::thread> workers;
+  for(int t=1;t<threads;t++){
+    workers.push_back(std::thread(worker));
+  }
+  worker();
+  for(int t=0;t<(int)workers.size();t++){
+    workers[t].join();
+  }
+  if(statistics!=nullptr){
+    statistics->bases=dynamic_sequence.size();
+    statistics->chunks=layout.getNumberOfChunks();
+    statistics->bytes=layout.getSize();
+    statistics->threads=threads;
+    statistics->seconds=std::chrono::duration<double>(std::chrono::high_resolution_clock::now()-start_time).count();
+  }
+}
+
+/*
+* writes all bytes to a file descriptor, retrying partial and interrupted writes
+*/
+inline bool write_haplotype_bytes(int fd,const char* data,uint64_t size){
+  while(size>0){
+    ssize_t written=write(fd,data,size);
+    if(written<0 && errno==EINTR){
+      continue;
+    }
+    if(written<=0){
+      return false;
+    }
+    data+=written;
+    size-=written;
+  }
+  return true;
+}
+
+/*!
+ * Writes the sequence to a file descriptor (file, pipe or socket). The chunks are decoded in parallel and written in
+ * order as soon as all chunks in front of them are written, so at most one chunk per thread is held in memory.
+ * @param dynamic_sequence:   the sequence
+ * @param fd:                 the file descriptor, written from its current position
+ * @param name:               the name of the FASTA record
+ * @param format:             FASTA or 2 bit packed bases
+ * @param threads:            the number of threads decoding chunks
+ * @param chunk_size:         the number of bases per chunk, rounded down to whole lines (words)
+ * @param line_width:         the number of bases per FASTA line
+ * @param statistics:         (optional) receives the number of bases, chunks and bytes and the time
+ *
+ * @return true if everything was written
+ */
+bool export_haplotype(dyn::wt_str& dynamic_sequence,int fd,std::string& name,HaplotypeFormat format=HAPLOTYPE_FASTA,int threads=1,uint64_t chunk_size=1<<20,int line_width=60,HaplotypeExportStatistics* statistics=nullptr){
+  auto start_time=std::chrono::high_resolution_clock::now();
+  HaplotypeLayout layout(format,dynamic_sequence.size(),name,chunk_size,line_width);
+  std::vector<char> header(layout.getHeaderSize());
+  write_haplotype_header(format,name,header.data());
+  bool failed=!write_haplotype_bytes(fd,header.data(),header.size());
+  std::atomic<uint64_t> next_chunk(0);
+  uint64_t next_write=0;
+  std::mutex write_mutex;
+  std::condition_variable written;
+  auto worker=[&](){
+    std::vector<char> bases(layout.getChunkSize());
+    std::vector<char> out(layout.getOffset(layout.getChunkSize())-layout.getOffset(0));
+    uint64_t chunk;
+    while((chunk=next_chunk.fetch_add(1))<layout.getNumberOfChunks()){
+      uint64_t start=layout.getChunkStart(chunk);
+      uint64_t end=layout.getChunkEnd(chunk);
+      export_haplotype_chunk(dynamic_sequence,format,line_width,start,end,bases.data(),out.data());
+      //chunks are taken in order, so the thread holding the first unwritten chunk never waits
+      std::unique_lock<std::mutex> lock(write_mutex);
+      written.wait(lock,[&](){return next_write==chunk;});
+      if(!failed){
+        failed=!write_haplotype_bytes(fd,out.data(),layout.getOffset(end)-layout.getOffset(start));
+      }
+      next_write++;
+      written.notify_all();
+    }
+  };
+  threads=std::max<int>(1,std::min<uint64_t>(threads,layout.getNumberOfChunks()));
+  std::vector<std::thread> workers;
+  for(int t=1;t<threads;t++){
+    workers.push_back(std::thread(worker));
+  }
+  worker();
+  for(int t=0;t<(int)workers.size();t++){
+    workers[t].join();
+  }
+  if(statistics!=nullptr){
+    statistics->bases=dynamic_sequence.size();
+    statistics->chunks=layout.getNumberOfChunks();
+    statistics->bytes=layout.getSize();
+    statistics->threads=threads;
+    statistics->seconds=std::chrono::duration<double>(std::chrono::high_resolution_clock::now()-start_time).count();
+  }
+  return !failed;
+}
+
+/*!
+ * Writes the sequence into a file which is sized up front and mapped into memory, so all threads write their chunks
+ * in place without waiting for each other.
+ * @param dynamic_sequence:   the sequence
+ * @param path:               the path of the file, an existing file is replaced
+ * @param name:               the name of the FASTA record
+ * @param format:             FASTA or 2 bit packed bases
+ * @param threads:            the number of threads decoding chunks
+ * @param chunk_size:         the number of bases per chunk, rounded down to whole lines (words)
+ * @param line_width:         the number of bases per FASTA line
+ * @param statistics:         (optional) receives the number of bases, chunks and bytes and the time
+ *
+ * @return true if the file was written
+ */
+bool export_haplotype_file(dyn::wt_str& dynamic_sequence,std::string& path,std::string& name,HaplotypeFormat format=HAPLOTYPE_FASTA,int threads=1,uint64_t chunk_size=1<<20,int line_width=60,HaplotypeExportStatistics* statistics=nullptr){
+  uint64_t size=haplotype_export_size(dynamic_sequence.size(),name,format,line_width);
+  int fd=open(path.c_str(),O_RDWR|O_CREAT|O_TRUNC,0644);
+  if(fd<0){
+    cout<<"Could not write haplotype "<<path<<"\n";
+    return false;
+  }
+  if(ftruncate(fd,size)!=0){
+    cout<<"Could not resize haplotype "<<path<<"\n";
+    close(fd);
+    return false;
+  }
+  if(size==0){
+    close(fd);
+    return true;
+  }
+  void* mapped=mmap(nullptr,size,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+  close(fd);
+  if(mapped==MAP_FAILED){
+    cout<<"Could not map haplotype "<<path<<"\n";
+    return false;
+  }
+  export_haplotype(dynamic_sequence,(char*)mapped,name,format,threads,chunk_size,line_width,statistics);
+  bool synced=msync(mapped,size,MS_SYNC)==0;
+  munmap(mapped,size);
+  return synced;
+}
+
+#endif
@@ -13,6 +13,7 @@
 #define INTERNAL_HACKED_BLOCK_HPP_
 
 #include "includes.hpp"
+#include "slab_allocator.hpp"
 
 namespace dyn{
 
@@ -321,6 +322,7 @@ public:
      * Left part remains in this block, right part in the
      * new returned block
      */
+    template <class alloc = heap_allocator<default_tag>>
     hacked_vector* split(){
 
         uint64_t tot_words = (size_/int_per_word_) + (size_%int_per_word_!=0);
@@ -342,7 +344,7 @@ public:
 
         size_ = nr_left_ints;
 
-        auto right = new hacked_vector(right_words,nr_right_ints,width_);
+        auto right = alloc::template create<hacked_vector>(right_words,nr_right_ints,width_);
 
         return right;
 
@@ -13,9 +13,17 @@
 #define INTERNAL_PACKED_BLOCK_HPP_
 
 #include "includes.hpp"
+#include "slab_allocator.hpp"
 
 namespace dyn{
 
+   /*
+    * the words of the packed vectors are allocated with slab_allocator<leaf_words_tag>, so the
+    * leaves of a structure built inside a slab_arena_scope keep their words in its arena
+    */
+   struct leaf_words_tag {};
+   typedef vector<uint64_t, policy_allocator<uint64_t, slab_allocator<leaf_words_tag>>> word_vector;
+
    template <class Container> class pv_reference{
 
    public:
@@ -127,7 +135,7 @@ namespace dyn{
 	 int_per_word_ = 64/width_;
 	 MASK = (uint64_t(1) << width_)-1;
 
-	 words = vector<uint64_t>( size_/int_per_word_ +  ( size_%int_per_word_ != 0 ) );
+	 words = word_vector( size_/int_per_word_ +  ( size_%int_per_word_ != 0 ) );
 
         assert(size_ / int_per_word_ <= words.size());
         assert((size_ / int_per_word_ == words.size()
@@ -135,7 +143,7 @@ namespace dyn{
                 && "uninitialized non-zero values in the end of the vector");
       }
 
-      packed_vector(vector<uint64_t>&& _words, uint64_t size, uint8_t width) {
+      packed_vector(word_vector&& _words, uint64_t size, uint8_t width) {
 
         assert(width);
 
@@ -597,6 +605,7 @@ namespace dyn{
        * Left part remains in this block, right part in the
        * new returned block
        */
+      template <class alloc = heap_allocator<default_tag>>
       packed_vector* split(){
 
 	 uint64_t tot_words = (size_/int_per_word_) + (size_%int_per_word_!=0);
@@ -615,7 +624,7 @@ namespace dyn{
 
         assert(words.begin() + nr_left_words + extra_ < words.end());
         assert(words.begin() + tot_words <= words.end());
-        vector<uint64_t> right_words(tot_words - nr_left_words + extra_, 0);
+        word_vector right_words(tot_words - nr_left_words + extra_, 0);
         std::copy(words.begin() + nr_left_words, words.begin() + tot_words, right_words.begin());
         words.resize(nr_left_words + extra_);
         std::fill(words.begin() + nr_left_words, words.end(), 0);
@@ -627,7 +636,7 @@ namespace dyn{
         assert(int_per_word_ == 64 / width_);
         assert(right_words.size() * int_per_word_ >= nr_right_ints);
 
-	 auto right = new packed_vector(std::move(right_words), nr_right_ints, width_);
+	 auto right = alloc::template create<packed_vector>(std::move(right_words), nr_right_ints, width_);
 
         assert(size_ / int_per_word_ <= words.size());
         assert((size_ / int_per_word_ == words.size()
@@ -716,7 +725,7 @@ namespace dyn{
 
 	 if(w_size>0){
 
-	    words = vector<uint64_t>(w_size);
+	    words = word_vector(w_size);
 	    in.read((char*)words.data(),sizeof(uint64_t)*w_size);
 
 	 }
@@ -759,7 +768,7 @@ namespace dyn{
 
       }
 
-      void set_without_psum_update(uint64_t i, uint64_t x, vector< uint64_t >& new_words, uint8_t& new_int_per_word_, uint8_t& new_width_, uint64_t& new_MASK ){
+      void set_without_psum_update(uint64_t i, uint64_t x, word_vector& new_words, uint8_t& new_int_per_word_, uint8_t& new_width_, uint64_t& new_MASK ){
 
 	 assert(bitsize(x)<=new_width_);
 
@@ -907,7 +916,7 @@ namespace dyn{
 	 uint8_t new_int_per_word_ = 64/new_width_;
 	 uint64_t new_size_= size_; 
 
-	 vector< uint64_t > new_words( new_size_/new_int_per_word_ + (new_size_%new_int_per_word_ != 0) + extra_, 0 );
+	 word_vector new_words( new_size_/new_int_per_word_ + (new_size_%new_int_per_word_ != 0) + extra_, 0 );
 	 //vector< uint64_t > new_words( new_size_/new_int_per_word_ + (new_size_%new_int_per_word_ != 0) );
 
 	 uint64_t new_MASK = (uint64_t(1) << new_width_)-1;
@@ -968,7 +977,7 @@ namespace dyn{
 	 uint8_t new_int_per_word_ = 64/new_width_;
 	 uint64_t new_size_= size_ - 1; 
 
-	 vector< uint64_t > new_words( new_size_/new_int_per_word_ + (new_size_%new_int_per_word_ != 0) + extra_, 0 );
+	 word_vector new_words( new_size_/new_int_per_word_ + (new_size_%new_int_per_word_ != 0) + extra_, 0 );
 
 	 uint64_t new_MASK = (uint64_t(1) << new_width_)-1;
 
@@ -1009,7 +1018,7 @@ namespace dyn{
 	 uint8_t new_int_per_word_ = 64/new_width_;
 	 uint64_t new_size_= size_ + 1;
 
-	 vector< uint64_t > new_words( new_size_/new_int_per_word_ + (new_size_%new_int_per_word_ != 0) + extra_, 0 );
+	 word_vector new_words( new_size_/new_int_per_word_ + (new_size_%new_int_per_word_ != 0) + extra_, 0 );
 
 	 uint64_t new_MASK = (uint64_t(1) << new_width_)-1;
 
@@ -1071,7 +1080,7 @@ namespace dyn{
 
 	 size_=vec.size();
 
-	 words = vector<uint64_t>( size_/int_per_word_ + (size_%int_per_word_ != 0) + extra_ );
+	 words = word_vector( size_/int_per_word_ + (size_%int_per_word_ != 0) + extra_ );
 
 	 for(ulint j=0;j<vec.size();++j){
 
@@ -1129,7 +1138,7 @@ namespace dyn{
 
       }
 
-      vector<uint64_t> words;
+      word_vector words;
       uint64_t psum_=0;
       uint64_t MASK=0;
       uint64_t size_=0;
@@ -1146,7 +1155,7 @@ class packed_bit_vector : public packed_vector {
 public:
     explicit packed_bit_vector(ulint size = 0) : packed_vector(size, 1) {}
 
-    packed_bit_vector(vector<uint64_t>&& words, uint64_t size)
+    packed_bit_vector(word_vector&& words, uint64_t size)
         : packed_vector(std::move(words), size, 1) {}
 
     virtual void push_back(uint64_t x) override final {
@@ -1185,6 +1194,7 @@ public:
     }
 
 
+    template <class alloc = heap_allocator<default_tag>>
     packed_bit_vector* split() {
         uint64_t tot_words = (size_/int_per_word_) + (size_%int_per_word_!=0);
 
@@ -1202,7 +1212,7 @@ public:
 
         assert(words.begin() + nr_left_words + extra_ < words.end());
         assert(words.begin() + tot_words <= words.end());
-        vector<uint64_t> right_words(tot_words - nr_left_words + extra_, 0);
+        word_vector right_words(tot_words - nr_left_words + extra_, 0);
         std::copy(words.begin() + nr_left_words, words.begin() + tot_words, right_words.begin());
         words.resize(nr_left_words + extra_);
         std::fill(words.begin() + nr_left_words, words.end(), 0);
@@ -1211,7 +1221,7 @@ public:
         size_ = nr_left_ints;
         psum_ = psum(size_-1);
 
-        auto right = new packed_bit_vector(std::move(right_words), nr_right_ints);
+        auto right = alloc::template create<packed_bit_vector>(std::move(right_words), nr_right_ints);
 
         assert(size_ / int_per_word_ <= words.size());
         assert((size_ / int_per_word_ == words.size()
@@ -0,0 +1,466 @@
+/*
+ * slab_allocator.hpp
+ *
+ *      Author: Alexander Petri
+ *
+ *  Allocation policies for the nodes and leaves of the dynamic structures.
+ *
+ *  A policy is a class with static members only, so it can be passed as template argument
+ *  without changing the size of the nodes:
+ *
+ *    static void* allocate(uint64_t bytes)
+ *    static void deallocate(void* p, uint64_t bytes)
+ *    static U* create<U>(args...)          construct a U in memory of the policy
+ *    static void destroy(U* p)             destruct and free a U created by create
+ *    static alloc_stats stats()
+ *
+ *  A slab_arena keeps one pool per size class (multiples of 16 bytes up to 1024 bytes). Every
+ *  pool carves fixed-size slots out of 64 KiB chunks and reuses freed slots through an intrusive
+ *  free list, larger requests are served from the heap and linked into the arena. Every chunk and
+ *  every large block records its arena, so memory is always freed into the arena it came from,
+ *  and release() returns all memory of an arena to the system in O(chunks + large blocks).
+ *
+ *  slab_allocator<Tag> allocates from the arena installed for the calling thread with a
+ *  slab_arena_scope, and without one from the shared arena of the Tag (md::b_tree_tag, spsi_tag,
+ *  ...). The arena of a scope belongs to one structure or index (e.g. one per contig of a
+ *  ContigMinimizerIndex): its statistics cover exactly that index, release() only frees its memory,
+ *  and it takes no lock, so it must only be used by one thread at a time. The shared arenas serve
+ *  all structures without an arena of their own and serialize their allocations with a mutex.
+ *
+ *  heap_allocator<Tag> uses new and delete for every object (the behaviour without pools) and
+ *  keeps the same statistics. It is the default of the leaf split functions, so leaves created
+ *  outside of a tree can still be freed with delete.
+ *
+ */
+
+#ifndef INTERNAL_SLAB_ALLOCATOR_HPP_
+#define INTERNAL_SLAB_ALLOCATOR_HPP_
+
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include <vector>
+#include <utility>
+#include <iostream>
+#include <algorithm>
+#include <mutex>
+#include <cassert>
+#include <cstdlib>
+
+namespace dyn {
+
+/*
+ * allocation statistics of one policy
+ */
+struct alloc_stats {
+  uint64_t allocations = 0;    // number of allocations
+  uint64_t deallocations = 0;  // number of deallocations
+  uint64_t live = 0;           // objects currently allocated
+  uint64_t peak_live = 0;      // maximum of live
+  uint64_t live_bytes = 0;     // bytes currently allocated
+  uint64_t peak_bytes = 0;     // maximum of live_bytes
+  uint64_t chunks = 0;         // chunks currently held by the pools
+  uint64_t chunk_bytes = 0;    // bytes of these chunks
+
+  void on_allocate(uint64_t bytes) {
+    allocations++;
+    live++;
+    live_bytes += bytes;
+    peak_live = std::max(peak_live, live);
+    peak_bytes = std::max(peak_bytes, live_bytes);
+  }
+
+  void on_deallocate(uint64_t bytes) {
+    deallocations++;
+    live--;
+    live_bytes -= bytes;
+  }
+
+  void print(std::ostream& out, const char* name) const {
+    out << name << ": " << allocations << " allocations, " << deallocations
+        << " deallocations, " << live << " live (peak " << peak_live << "), "
+        << live_bytes << " live bytes (peak " << peak_bytes << "), " << chunks
+        << " chunks (" << chunk_bytes << " bytes)\n";
+  }
+};
+
+/*
+ * pool of fixed-size slots of one arena. Slots are carved out of chunks and freed slots are kept
+ * in an intrusive singly linked free list. Every chunk is aligned to its size and starts with the
+ * arena it belongs to.
+ */
+class slab_pool {
+ public:
+  static const uint64_t chunk_size = 64 * 1024;
+  static const uint64_t chunk_header = 16;
+
+  slab_pool() {}
+
+  slab_pool(const slab_pool&) = delete;
+  slab_pool& operator=(const slab_pool&) = delete;
+
+  void init(uint64_t slot) { slot_size = slot; }
+
+  void* allocate(void* owner, alloc_stats& stats) {
+    if (free_list != nullptr) {
+      void* p = free_list;
+      free_list = *reinterpret_cast<void**>(p);
+      return p;
+    }
+
+    if (next == end) grow(owner, stats);
+
+    void* p = next;
+    next += slot_size;
+    return p;
+  }
+
+  void deallocate(void* p) {
+    *reinterpret_cast<void**>(p) = free_list;
+    free_list = p;
+  }
+
+  /*
+   * return all chunks to the system without visiting the slots
+   */
+  void release(alloc_stats& stats) {
+    for (auto c : chunks) free(c);
+
+    stats.chunks -= chunks.size();
+    stats.chunk_bytes -= chunks.size() * chunk_size;
+
+    chunks.clear();
+    free_list = nullptr;
+    next = end = nullptr;
+  }
+
+  /*
+   * the arena owning the chunk of slot p
+   */
+  static void* owner(void* p) {
+    uintptr_t chunk = reinterpret_cast<uintptr_t>(p) & ~(uintptr_t)(chunk_size - 1);
+    return *reinterpret_cast<void**>(chunk);
+  }
+
+ private:
+  void grow(void* owner, alloc_stats& stats) {
+    void* c = nullptr;
+    if (posix_memalign(&c, chunk_size, chunk_size) != 0) throw std::bad_alloc();
+    *reinterpret_cast<void**>(c) = owner;
+    chunks.push_back(static_cast<char*>(c));
+
+    stats.chunks++;
+    stats.chunk_bytes += chunk_size;
+
+    next = static_cast<char*>(c) + chunk_header;
+    end = next + ((chunk_size - chunk_header) / slot_size) * slot_size;
+  }
+
+  uint64_t slot_size = 0;
+  void* free_list = nullptr;
+  char* next = nullptr;
+  char* end = nullptr;
+  std::vector<char*> chunks;
+};
+
+/*
+ * the pools, the large blocks and the statistics of one index (or of the structures sharing a
+ * Tag). Only a shared arena locks.
+ */
+class slab_arena {
+ public:
+  static const uint64_t granularity = 16;
+  static const uint64_t max_slot = 1024;
+
+  explicit slab_arena(bool shared_ = false) : shared(shared_) {
+    for (uint64_t i = 0; i < n_classes; ++i) pools[i].init((i + 1) * granularity);
+  }
+
+  /*
+   * returns all memory of the arena, the structures allocated from it must be gone
+   */
+  ~slab_arena() { release(); }
+
+  slab_arena(const slab_arena&) = delete;
+  slab_arena& operator=(const slab_arena&) = delete;
+
+  void* allocate(uint64_t bytes) {
+    guard g(*this);
+    a_stats.on_allocate(bytes);
+
+    if (bytes > max_slot) {
+      large_block* b = static_cast<large_block*>(::operator new(sizeof(large_block) + bytes));
+      b->owner = this;
+      b->prev = nullptr;
+      b->next = large;
+      if (large != nullptr) large->prev = b;
+      large = b;
+      return b + 1;
+    }
+
+    return pools[size_class(bytes)].allocate(this, a_stats);
+  }
+
+  /*
+   * p has to be allocated from this arena with the same number of bytes (see owner)
+   */
+  void deallocate(void* p, uint64_t bytes) {
+    guard g(*this);
+    a_stats.on_deallocate(bytes);
+
+    if (bytes > max_slot) {
+      large_block* b = static_cast<large_block*>(p) - 1;
+      if (b->prev != nullptr) b->prev->next = b->next;
+      else large = b->next;
+      if (b->next != nullptr) b->next->prev = b->prev;
+      ::operator delete(b);
+      return;
+    }
+
+    pools[size_class(bytes)].deallocate(p);
+  }
+
+  /*
+   * the arena p of the given size was allocated from
+   */
+  static slab_arena* owner(void* p, uint64_t bytes) {
+    if (bytes > max_slot) return (static_cast<large_block*>(p) - 1)->owner;
+    return static_cast<slab_arena*>(slab_pool::owner(p));
+  }
+
+  alloc_stats stats() {
+    guard g(*this);
+    return a_stats;
+  }
+
+  /*
+   * bulk teardown: return all chunks and large blocks to the system in O(chunks + large
+   * blocks). Destructors are not run, every structure allocated from this arena must be
+   * discarded without destroying it. Memory the stored objects got elsewhere (e.g. std::string
+   * buffers longer than the short string buffer) is not reclaimed. A shared arena is never
+   * released.
+   */
+  void release() {
+    assert(!shared);
+
+    for (uint64_t i = 0; i < n_classes; ++i) pools[i].release(a_stats);
+    while (large != nullptr) {
+      large_block* b = large;
+      large = b->next;
+      ::operator delete(b);
+    }
+
+    a_stats.live = 0;
+    a_stats.live_bytes = 0;
+  }
+
+  /*
+   * the arena slab_allocator allocates from on the calling thread, nullptr for the shared arenas
+   */
+  static slab_arena*& current() {
+    static thread_local slab_arena* a = nullptr;
+    return a;
+  }
+
+ private:
+  static const uint64_t n_classes = max_slot / granularity;
+
+  // header of an allocation larger than max_slot, keeps the block 16 byte aligned
+  struct large_block {
+    slab_arena* owner;
+    large_block* prev;
+    large_block* next;
+    uint64_t padding;
+  };
+
+  struct guard {
+    explicit guard(slab_arena& a) : lock(a.shared ? &a.lock : nullptr) {
+      if (lock != nullptr) lock->lock();
+    }
+    ~guard() {
+      if (lock != nullptr) lock->unlock();
+    }
+    std::mutex* lock;
+  };
+
+  static uint64_t size_class(uint64_t bytes) {
+    return bytes == 0 ? 0 : (bytes - 1) / granularity;
+  }
+
+  bool shared;
+  slab_pool pools[n_classes];
+  large_block* large = nullptr;
+  alloc_stats a_stats;
+  std::mutex lock;
+};
+
+/*
+ * installs an arena for the allocations of the calling thread until the scope ends, the arena
+ * that was installed before is restored afterwards
+ */
+class slab_arena_scope {
+ public:
+  explicit slab_arena_scope(slab_arena* a) : previous(slab_arena::current()) {
+    slab_arena::current() = a;
+  }
+  ~slab_arena_scope() { slab_arena::current() = previous; }
+
+  slab_arena_scope(const slab_arena_scope&) = delete;
+  slab_arena_scope& operator=(const slab_arena_scope&) = delete;
+
+ private:
+  slab_arena* previous;
+};
+
+template <class Tag>
+class slab_allocator {
+ public:
+  static void* allocate(uint64_t bytes) {
+    slab_arena* a = slab_arena::current();
+    return (a != nullptr ? *a : shared()).allocate(bytes);
+  }
+
+  static void deallocate(void* p, uint64_t bytes) {
+    if (p == nullptr) return;
+
+    slab_arena::owner(p, bytes)->deallocate(p, bytes);
+  }
+
+  template <class U, class... Args>
+  static U* create(Args&&... args) {
+    void* p = allocate(sizeof(U));
+    return new (p) U(std::forward<Args>(args)...);
+  }
+
+  template <class U>
+  static void destroy(U* p) {
+    if (p == nullptr) return;
+
+    p->~U();
+    deallocate(p, sizeof(U));
+  }
+
+  /*
+   * statistics of the shared arena of the Tag, the arenas of the scopes keep their own
+   */
+  static alloc_stats stats() { return shared().stats(); }
+
+  static void print_stats(std::ostream& out, const char* name) {
+    stats().print(out, name);
+  }
+
+ private:
+  /*
+   * the shared arena is never destroyed, so structures with static storage duration can still
+   * free their nodes when the program exits
+   */
+  static slab_arena& shared() {
+    static slab_arena* a = new slab_arena(true);
+    return *a;
+  }
+};
+
+template <class Tag>
+class heap_allocator {
+ public:
+  static void* allocate(uint64_t bytes) {
+    record_allocate(bytes);
+    return ::operator new(bytes);
+  }
+
+  static void deallocate(void* p, uint64_t bytes) {
+    if (p == nullptr) return;
+
+    record_deallocate(bytes);
+    ::operator delete(p);
+  }
+
+  template <class U, class... Args>
+  static U* create(Args&&... args) {
+    record_allocate(sizeof(U));
+    return new U(std::forward<Args>(args)...);
+  }
+
+  template <class U>
+  static void destroy(U* p) {
+    if (p == nullptr) return;
+
+    record_deallocate(sizeof(U));
+    delete p;
+  }
+
+  static alloc_stats stats() {
+    state& s = get();
+    std::lock_guard<std::mutex> g(s.lock);
+    return s.stats;
+  }
+
+  static void print_stats(std::ostream& out, const char* name) {
+    stats().print(out, name);
+  }
+
+ private:
+  struct state {
+    alloc_stats stats;
+    std::mutex lock;
+  };
+
+  static void record_allocate(uint64_t bytes) {
+    state& s = get();
+    std::lock_guard<std::mutex> g(s.lock);
+    s.stats.on_allocate(bytes);
+  }
+
+  static void record_deallocate(uint64_t bytes) {
+    state& s = get();
+    std::lock_guard<std::mutex> g(s.lock);
+    s.stats.on_deallocate(bytes);
+  }
+
+  static state& get() {
+    static state* s = new state();
+    return *s;
+  }
+};
+
+struct default_tag {};
+
+/*
+ * std::allocator interface on top of a policy, used for the vectors inside the nodes
+ */
+template <class T, class alloc>
+struct policy_allocator {
+  typedef T value_type;
+
+  template <class U>
+  struct rebind {
+    typedef policy_allocator<U, alloc> other;
+  };
+
+  policy_allocator() {}
+
+  template <class U>
+  policy_allocator(const policy_allocator<U, alloc>&) {}
+
+  T* allocate(std::size_t n) {
+    return static_cast<T*>(alloc::allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T* p, std::size_t n) { alloc::deallocate(p, n * sizeof(T)); }
+};
+
+template <class T, class U, class alloc>
+bool operator==(const policy_allocator<T, alloc>&,
+                const policy_allocator<U, alloc>&) {
+  return true;
+}
+
+template <class T, class U, class alloc>
+bool operator!=(const policy_allocator<T, alloc>&,
+                const policy_allocator<U, alloc>&) {
+  return false;
+}
+
+}  // namespace dyn
+
+#endif /* INTERNAL_SLAB_ALLOCATOR_HPP_ */
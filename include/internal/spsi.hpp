@@ -25,9 +25,13 @@
 #include <array>
 
 #include "includes.hpp"
+#include "slab_allocator.hpp"
 
 namespace dyn {
 
+// tag of the default allocation policy of spsi
+struct spsi_tag {};
+
 template <class Container>
 class spsi_reference {
  public:
@@ -99,17 +103,19 @@ class spsi_reference {
 template <class leaf_type,  // underlying representation of the integers
           uint32_t B_LEAF,  // number of integers m allowed for a
           // leaf is B_LEAF <= m <= 2*B_LEAF (except at the beginning)
-          uint32_t B  // Order of the tree: number of elements n in each
-                      // internal node
+          uint32_t B,  // Order of the tree: number of elements n in each
+                       // internal node
           // is always B <= n <= 2B+1  (except at the beginning)
           // Alan: Actually, B + 1 <= n <= 2B+2  (except at the beginning)
+          class alloc = slab_allocator<spsi_tag>  // allocation policy of the
+                                                  // nodes and leaves
           >
 class spsi {
  public:
   /*
    * copy constructor
    */
-  explicit spsi(const spsi& sp) { root = new node(*sp.root); }
+  explicit spsi(const spsi& sp) { root = alloc::template create<node>(*sp.root); }
 
   /*
    * move constructor
@@ -121,9 +127,9 @@ class spsi {
    */
   void operator=(const spsi& sp) {
     root->free_mem();
-    delete root;
+    alloc::destroy(root);
 
-    root = new node(*sp.root);
+    root = alloc::template create<node>(*sp.root);
   }
 
   /*
@@ -131,7 +137,7 @@ class spsi {
    */
   void operator=(spsi&& sp) {
     root->free_mem();
-    delete root;
+    alloc::destroy(root);
 
     root = sp.root;
     sp.root = NULL;
@@ -142,7 +148,7 @@ class spsi {
   /*
    * create empty spsi.
    */
-  spsi() : root(new node()) {}
+  spsi() : root(alloc::template create<node>()) {}
 
   /*
    * create empty spsi. Input parameters are not used (legacy option). This
@@ -154,7 +160,7 @@ class spsi {
   ~spsi() {
     if (root) {
       root->free_mem();
-      delete root;
+      alloc::destroy(root);
     }
   }
 
@@ -276,7 +282,7 @@ class spsi {
   void remove(uint64_t i) {
     node* new_root = root->remove(i);
     if (new_root != NULL) {
-      delete root;
+      alloc::destroy(root);
       root = new_root;
     }
   }
@@ -300,7 +306,7 @@ class spsi {
   uint64_t bit_size() const {
     assert(root != NULL);
 
-    uint64_t bs = 8 * sizeof(spsi<leaf_type, B_LEAF, B>);
+    uint64_t bs = 8 * sizeof(spsi<leaf_type, B_LEAF, B, alloc>);
 
     if (root != NULL) bs += root->bit_size();
     return bs;
@@ -317,6 +323,18 @@ class spsi {
     return root->at(i);
   }
 
+  /*
+   * call f(x) for the integers in positions [begin, end), in order. The tree
+   * is descended once and the leaves are then read sequentially.
+   */
+  template <class F>
+  void for_each(uint64_t begin, uint64_t end, F&& f) const {
+    assert(begin <= end);
+    assert(end <= size());
+
+    if (begin < end) root->for_each(begin, end, f);
+  }
+
   /*
    * decrement/increment i-th integer by delta units
    */
@@ -346,12 +364,16 @@ class spsi {
   }
 
   void load(istream& in) {
-    root = new node();
+    root = alloc::template create<node>();
     root->load(in);
   }
 
  private:
   class node;
+
+  typedef vector<node*, policy_allocator<node*, alloc>> node_vector;
+  typedef vector<leaf_type*, policy_allocator<leaf_type*, alloc>> leaf_vector;
+
   node* root = NULL;  // tree root
 };
 
@@ -359,12 +381,13 @@ class spsi {
 template <class leaf_type,  // underlying representation of the integers
           uint32_t B_LEAF,  // number of integers m allowed for a
           // leaf is B_LEAF <= m <= 2*B_LEAF (except at the beginning)
-          uint32_t B  // Order of the tree: number of elements n in each
-                      // internal node
+          uint32_t B,  // Order of the tree: number of elements n in each
+                       // internal node
           // is always B <= n <= 2B+1  (except at the beginning)
           // Alan: Actually, B + 1 <= n <= 2B+2  (except at the beginning)
+          class alloc  // allocation policy of the nodes and leaves
           >
-class spsi<leaf_type, B_LEAF, B>::node {
+class spsi<leaf_type, B_LEAF, B, alloc>::node {
  public:
   /*
    * copy constructor
@@ -374,17 +397,17 @@ class spsi<leaf_type, B_LEAF, B>::node {
     subtree_psums = n.subtree_psums;
 
     if (n.has_leaves_) {
-      leaves = vector<leaf_type*>(n.nr_children, NULL);
+      leaves = leaf_vector(n.nr_children, NULL);
 
       for (uint64_t i = 0; i < n.nr_children; ++i) {
-        leaves[i] = new leaf_type(*n.leaves[i]);
+        leaves[i] = alloc::template create<leaf_type>(*n.leaves[i]);
       }
 
     } else {
-      children = vector<node*>(n.nr_children, NULL);
+      children = node_vector(n.nr_children, NULL);
 
       for (uint64_t i = 0; i < n.nr_children; ++i) {
-        children[i] = new node(*n.children[i]);
+        children[i] = alloc::template create<node>(*n.children[i]);
         children[i]->overwrite_parent(this);
       }
     }
@@ -405,15 +428,15 @@ class spsi<leaf_type, B_LEAF, B>::node {
     nr_children = 1;
     has_leaves_ = true;
 
-    leaves = vector<leaf_type*>(1);
-    leaves[0] = new leaf_type();
+    leaves = leaf_vector(1);
+    leaves[0] = alloc::template create<leaf_type>();
   }
 
   /*
    * create new node given some children (other internal nodes),the parent,
    * and the rank of this node among its siblings
    */
-  node(vector<node*>&& c, node* P = NULL, uint32_t rank = 0) {
+  node(node_vector&& c, node* P = NULL, uint32_t rank = 0) {
     this->rank_ = rank;
     this->parent = P;
 
@@ -446,7 +469,7 @@ class spsi<leaf_type, B_LEAF, B>::node {
    * create new node given some children (leaves),the parent, and the rank of
    * this node among its siblings
    */
-  node(vector<leaf_type*>&& c, node* P = NULL, uint32_t rank = 0) {
+  node(leaf_vector&& c, node* P = NULL, uint32_t rank = 0) {
     this->rank_ = rank;
     this->parent = P;
 
@@ -503,11 +526,11 @@ class spsi<leaf_type, B_LEAF, B>::node {
 
   void free_mem() {
     if (has_leaves()) {
-      for (uint32_t i = 0; i < nr_children; ++i) delete leaves[i];
+      for (uint32_t i = 0; i < nr_children; ++i) alloc::destroy(leaves[i]);
 
     } else {
       for (uint32_t i = 0; i < nr_children; ++i) children[i]->free_mem();
-      for (uint32_t i = 0; i < nr_children; ++i) delete children[i];
+      for (uint32_t i = 0; i < nr_children; ++i) alloc::destroy(children[i]);
     }
   }
 
@@ -540,6 +563,39 @@ class spsi<leaf_type, B_LEAF, B>::node {
     return children[j]->at(i - previous_size);
   }
 
+  /*
+   * call f(x) for the integers in positions [begin, end) of the subtree
+   * rooted in this node, in order
+   */
+  template <class F>
+  void for_each(uint64_t begin, uint64_t end, F& f) const {
+    assert(begin < end);
+    assert(end <= size());
+
+    uint32_t j = find_child(begin);
+
+    // size stored in previous counter
+    uint64_t previous_size = (j == 0 ? 0 : subtree_sizes[j - 1]);
+
+    while (begin < end) {
+      assert(j < nr_children);
+
+      uint64_t child_end = std::min(end, subtree_sizes[j]);
+
+      if (has_leaves()) {
+        for (uint64_t i = begin - previous_size; i < child_end - previous_size; ++i) {
+          f(leaves[j]->at(i));
+        }
+      } else {
+        children[j]->for_each(begin - previous_size, child_end - previous_size, f);
+      }
+
+      begin = child_end;
+      previous_size = subtree_sizes[j];
+      j++;
+    }
+  }
+
   /*
    * returns sum up to i-th integer included
    */
@@ -799,7 +855,7 @@ class spsi<leaf_type, B_LEAF, B>::node {
 
       // if this is the root, create new root
       if (is_root()) {
-        new_root = new node(vector<node*>{this, right});
+        new_root = alloc::template create<node>(node_vector{this, right});
         assert(not new_root->is_full());
 
         this->overwrite_parent(new_root);
@@ -1027,15 +1083,15 @@ class spsi<leaf_type, B_LEAF, B>::node {
         }
         node* xy;
         if (not x->has_leaves()) {
-          vector<node*> cc(prev->children.begin(), prev->children.end());
+          node_vector cc(prev->children.begin(), prev->children.end());
           cc.insert(cc.end(), next->children.begin(), next->children.end());
 
           assert(cc.size() == 2 * B + 2);
-          xy = new node(std::move(cc), prev->parent, prev->rank());
+          xy = alloc::template create<node>(std::move(cc), prev->parent, prev->rank());
         } else {
           assert(prev->nr_children == prev->leaves.size());
           assert(next->nr_children == next->leaves.size());
-          vector<leaf_type*> cc(prev->leaves.begin(), prev->leaves.end());
+          leaf_vector cc(prev->leaves.begin(), prev->leaves.end());
           cc.insert(cc.end(), next->leaves.begin(), next->leaves.end());
 
           if (cc.size() > 2 * B + 2) {
@@ -1046,7 +1102,7 @@ class spsi<leaf_type, B_LEAF, B>::node {
           }
 
           assert(cc.size() == 2 * B + 2);
-          xy = new node(std::move(cc), prev->parent, prev->rank());
+          xy = alloc::template create<node>(std::move(cc), prev->parent, prev->rank());
         }
 
         // update xy->parent
@@ -1085,9 +1141,9 @@ class spsi<leaf_type, B_LEAF, B>::node {
           }
         }
 
-        delete xy;
+        alloc::destroy(xy);
         // y has been merged into x, so needs to be de-allocated.
-        delete y;
+        alloc::destroy(y);
       }
     }  // end if not x->can_lose()
 
@@ -1103,7 +1159,6 @@ class spsi<leaf_type, B_LEAF, B>::node {
     uint64_t previous_size = (j == 0 ? 0 : subtree_sizes[j - 1]);
 
     i = i - previous_size;
-    assert(i >= 0);
     if (this->has_leaves()) {
       assert(this->leaves.size() == nr_children);
       assert(this->can_lose());
@@ -1203,11 +1258,9 @@ class spsi<leaf_type, B_LEAF, B>::node {
           }
 
           if (y_is_prev) {
-            assert(0 <= j);
             assert(j < this->leaves.size());
             this->leaves.erase(this->leaves.begin() + j);
           } else {
-            assert(0 <= j + 1);
             assert(j + 1 < this->leaves.size());
             this->leaves.erase(this->leaves.begin() + j + 1);
           }
@@ -1357,16 +1410,16 @@ class spsi<leaf_type, B_LEAF, B>::node {
 
     if (has_leaves_) {
       assert(leaves_len > 0);
-      leaves = vector<leaf_type*>(leaves_len);
+      leaves = leaf_vector(leaves_len);
 
-      for (auto& l : leaves) l = new leaf_type();
+      for (auto& l : leaves) l = alloc::template create<leaf_type>();
       for (auto& l : leaves) l->load(in);
 
     } else {
       assert(children_len > 0);
-      children = vector<node*>(children_len);
+      children = node_vector(children_len);
 
-      for (auto& c : children) c = new node();
+      for (auto& c : children) c = alloc::template create<node>();
       for (auto& c : children) c->overwrite_parent(this);
       for (auto& c : children) c->load(in);
     }
@@ -1405,10 +1458,10 @@ class spsi<leaf_type, B_LEAF, B>::node {
     nr_children++;
 
     // temporary copy children
-    vector<node*> temp(children);
+    node_vector temp(children);
 
     // reset children
-    children = vector<node*>(nr_children);
+    children = node_vector(nr_children);
     uint32_t k = 0;  // index in children
 
     for (uint32_t j = 0; j < nr_children - 1; ++j) {
@@ -1451,7 +1504,7 @@ class spsi<leaf_type, B_LEAF, B>::node {
       subtree_psums[0] = left->psum();
       subtree_psums[1] = left->psum() + right->psum();
 
-      leaves = vector<leaf_type*>{left, right};
+      leaves = leaf_vector{left, right};
 
       nr_children++;
 
@@ -1477,10 +1530,10 @@ class spsi<leaf_type, B_LEAF, B>::node {
     nr_children++;
 
     // temporary copy leaves
-    vector<leaf_type*> temp(leaves);
+    leaf_vector temp(leaves);
 
     // reset leaves
-    leaves = vector<leaf_type*>(nr_children);
+    leaves = leaf_vector(nr_children);
     uint32_t k = 0;  // index in leaves
 
     for (uint32_t j = 0; j < nr_children - 1; ++j) {
@@ -1509,7 +1562,7 @@ class spsi<leaf_type, B_LEAF, B>::node {
     }
 
     // the leaf does not have enough vacant slots
-    leaf_type *next = leaf->split();
+    leaf_type *next = leaf->template split<alloc>();
 
     assert(free_capacity(*leaf));
 
@@ -1537,7 +1590,7 @@ class spsi<leaf_type, B_LEAF, B>::node {
     }
 
     // the leaf does not have enough vacant slots
-    leaf_type *next = leaf->split();
+    leaf_type *next = leaf->template split<alloc>();
 
     assert(free_capacity(*leaf) >= n);
 
@@ -1626,7 +1679,7 @@ class spsi<leaf_type, B_LEAF, B>::node {
     node* right = NULL;
 
     if (has_leaves()) {
-      vector<leaf_type*> right_children_l(nr_children - nr_children / 2);
+      leaf_vector right_children_l(nr_children - nr_children / 2);
 
       ulint k = 0;
 
@@ -1635,11 +1688,11 @@ class spsi<leaf_type, B_LEAF, B>::node {
 
       assert(k == right_children_l.size());
 
-      right = new node(std::move(right_children_l), parent, rank() + 1);
+      right = alloc::template create<node>(std::move(right_children_l), parent, rank() + 1);
       leaves.erase(leaves.begin() + nr_children / 2, leaves.end());
 
     } else {
-      vector<node*> right_children_n(nr_children - nr_children / 2);
+      node_vector right_children_n(nr_children - nr_children / 2);
 
       ulint k = 0;
 
@@ -1648,7 +1701,7 @@ class spsi<leaf_type, B_LEAF, B>::node {
 
       assert(k == right_children_n.size());
 
-      right = new node(std::move(right_children_n), parent, rank() + 1);
+      right = alloc::template create<node>(std::move(right_children_n), parent, rank() + 1);
 
       children.erase(children.begin() + nr_children / 2, children.end());
     }
@@ -1710,8 +1763,8 @@ class spsi<leaf_type, B_LEAF, B>::node {
   array<uint64_t, 2 * B + 2> subtree_sizes;
   array<uint64_t, 2 * B + 2> subtree_psums;
 
-  vector<node*> children;
-  vector<leaf_type*> leaves;
+  node_vector children;
+  leaf_vector leaves;
 
   node* parent = NULL;  // NULL for root
   uint32_t rank_ = 0;   // rank of this node among its siblings
@@ -94,6 +94,18 @@ namespace dyn{
 
       }
 
+      /*
+       * call f(b) for the bits in positions [begin, end), in order. Cheaper
+       * than one access per bit, as the leaves are read sequentially.
+       */
+      template<class F>
+      void for_each(uint64_t begin, uint64_t end, F&& f) const {
+
+	 assert(begin<=end and end<=size());
+	 spsi_.for_each(begin,end,f);
+
+      }
+
       uint64_t select(uint64_t i, bool b = true) const {
 
 	 return b ? select1(i) : select0(i);
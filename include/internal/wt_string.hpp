@@ -87,6 +87,20 @@ class wt_string {
     return root.at(i);
   }
 
+  /*
+   * write the characters in positions [begin, end) to out and return the
+   * iterator behind the last written character. Every node is visited once
+   * and its bitvector read sequentially, instead of one root-to-leaf descent
+   * per character. Needs a bitvector with for_each.
+   */
+  template <class OutputIterator>
+  OutputIterator extract(uint64_t begin, uint64_t end, OutputIterator out) const {
+    assert(begin <= end);
+    assert(end <= size());
+
+    return root.extract(begin, end, out);
+  }
+
   /*
    * position of i-th character equal to c. 0 =< i < rank(size(),c)
    */
@@ -350,6 +364,43 @@ class wt_string<dynamic_bitvector_t>::node {
     return child0_->at(bv.rank0(i));
   }
 
+  /*
+   * write the characters in positions [begin, end) of this subtree to out.
+   * The characters of both children are extracted first and then
+   * interleaved in the order of the bits of this node.
+   */
+  template <class OutputIterator>
+  OutputIterator extract(ulint begin, ulint end, OutputIterator out) const {
+    if (is_leaf()) return std::fill_n(out, end - begin, label());
+
+    if (begin == end) return out;
+
+    vector<char_type> zeros;
+    vector<char_type> ones;
+
+    if (has_child0()) {
+      ulint begin0 = bv.rank0(begin);
+      zeros.resize(bv.rank0(end) - begin0);
+      child0_->extract(begin0, begin0 + zeros.size(), zeros.begin());
+    }
+
+    if (has_child1()) {
+      ulint begin1 = bv.rank1(begin);
+      ones.resize(bv.rank1(end) - begin1);
+      child1_->extract(begin1, begin1 + ones.size(), ones.begin());
+    }
+
+    auto zero = zeros.begin();
+    auto one = ones.begin();
+
+    bv.for_each(begin, end, [&](bool b) {
+      *out = b ? *one++ : *zero++;
+      ++out;
+    });
+
+    return out;
+  }
+
   /*
    * true iif code B has already been inserted
    */
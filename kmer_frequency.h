@@ -0,0 +1,287 @@
+////////////////////////////////////////////////////////////////////////////////
+// kmer_frequency.h
+//   k-mer frequency header file.
+//
+//  counts how often every packed k-mer occurs among the minimizers and masks
+//  the most frequent ones. The counts are updated whenever the minimizer
+//  algorithm inserts or deletes a minimizer, so the mask never has to be rebuilt.
+//
+////////////////////////////////////////////////////////////////////////////////
+//  author: Alexander Petri
+
+#ifndef KMER_FREQUENCY_H
+#define KMER_FREQUENCY_H
+
+#include "main.h"
+#include "packed_kmers.h"
+#include "B-tree.hh"
+#include "B_tree_node.hh"
+
+#include <unordered_map>
+
+using namespace md;
+
+/*
+* Count-min sketch over packed k-mers supporting increments and decrements. As long as no k-mer is decremented
+* below its true count, estimate() never underestimates.
+*
+* @param counters     depth rows of 2^width_bits counters
+* @param width_bits   the number of bits of a column index
+* @param depth        the number of rows
+*/
+class CountMinSketch{
+private:
+  std::vector<uint32_t> counters;
+  int width_bits;
+  int depth;
+
+  /*
+  * multiply-shift hash of the k-mer for row
+  */
+  uint64_t column(uint64_t kmer,int row) const{
+    static const uint64_t multipliers[8]={0x9E3779B97F4A7C15ULL,0xC2B2AE3D27D4EB4FULL,0x165667B19E3779F9ULL,0xD6E8FEB86659FD93ULL,
+                                          0xFF51AFD7ED558CCDULL,0xC4CEB9FE1A85EC53ULL,0x94D049BB133111EBULL,0xBF58476D1CE4E5B9ULL};
+    return ((kmer+1)*multipliers[row])>>(64-width_bits);
+  }
+
+public:
+  CountMinSketch(int bits,int rows){
+    assert(bits>0 && bits<32 && rows>0 && rows<=8);
+    width_bits=bits;
+    depth=rows;
+    counters.assign((uint64_t)depth<<width_bits,0);
+  }
+
+  void add(uint64_t kmer,int64_t count){
+    for(int r=0;r<depth;r++){
+      counters[((uint64_t)r<<width_bits)+column(kmer,r)]+=count;
+    }
+  }
+  uint32_t estimate(uint64_t kmer) const{
+    uint32_t minimum=std::numeric_limits<uint32_t>::max();
+    for(int r=0;r<depth;r++){
+      minimum=std::min(minimum,counters[((uint64_t)r<<width_bits)+column(kmer,r)]);
+    }
+    return minimum;
+  }
+  uint64_t getBytes() const{
+    return counters.size()*sizeof(uint32_t);
+  }
+};
+
+/*
+* Occurrence counts of the packed k-mers of the minimizers and a mask of the most frequent ones.
+* The first max_exact distinct k-mers are counted exactly in a hash map, further k-mers are counted in a count-min
+* sketch that is allocated on first use. A k-mer only enters the map if the sketch does not count it yet, so every
+* k-mer is counted either exactly or in the sketch.
+*
+* The mask holds the k-mers with a count above the threshold, the smallest count (at least 1) such that at most
+* mask_fraction of the exactly counted k-mers lie above it. The histogram of the exact counts is kept up to date,
+* so every increment or decrement moves the threshold in amortized O(1) and isMasked is answered in O(1) by one map
+* lookup (plus depth sketch probes for k-mers of the sketch).
+*
+* @param counts           the exact counts
+* @param sketch           the counts of the k-mers that did not fit into the map (nullptr until needed)
+* @param histogram        histogram[c] is the number of exactly counted k-mers with count c
+* @param threshold        k-mers with a count above threshold are masked
+* @param above            the number of exactly counted k-mers with a count above threshold
+* @param mask_fraction    the fraction of the distinct k-mers that may be masked
+* @param max_exact        the maximal number of exactly counted k-mers
+* @param sketched         the number of occurrences counted in the sketch
+*/
+class KmerFrequencyTable{
+private:
+  std::unordered_map<uint64_t,uint32_t> counts;
+  CountMinSketch* sketch=nullptr;
+  std::vector<uint64_t> histogram;
+  uint32_t threshold=1;
+  uint64_t above=0;
+  double mask_fraction;
+  uint64_t max_exact;
+  int sketch_width_bits;
+  int sketch_depth;
+  uint64_t sketched=0;
+  int k_size;
+
+  uint64_t getHistogram(uint32_t count) const{
+    return count<histogram.size() ? histogram[count] : 0;
+  }
+  /*
+  * moves the count of an exactly counted k-mer from before to after in the histogram
+  */
+  void moveCount(uint32_t before,uint32_t after){
+    if(before>0){
+      histogram[before]--;
+    }
+    if(after>0){
+      if(after>=histogram.size()){
+        histogram.resize(after+1,0);
+      }
+      histogram[after]++;
+    }
+    if(before<=threshold && after>threshold){
+      above++;
+    }
+    else if(after<=threshold && before>threshold){
+      above--;
+    }
+    rebalance();
+  }
+  /*
+  * moves the threshold until at most mask_fraction of the distinct k-mers lie above it
+  */
+  void rebalance(){
+    uint64_t allowed=(uint64_t)(mask_fraction*counts.size());
+    while(above>allowed){
+      threshold++;
+      above-=getHistogram(threshold);
+    }
+    while(threshold>1 && above+getHistogram(threshold)<=allowed){
+      above+=getHistogram(threshold);
+      threshold--;
+    }
+  }
+
+public:
+  /*!
+   * @param k:                  length of the k-mers
+   * @param fraction:           the fraction of the most frequent distinct k-mers to be masked
+   * @param max_exact_kmers:    the maximal number of exactly counted distinct k-mers
+   * @param width_bits:         the sketch has 2^width_bits counters per row
+   * @param depth:              the number of rows of the sketch
+   */
+  KmerFrequencyTable(int k,double fraction=0.0002,uint64_t max_exact_kmers=(uint64_t)1<<22,int width_bits=20,int depth=4){
+    assert(k>0 && k<=32 && fraction>=0 && fraction<=1);
+    k_size=k;
+    mask_fraction=fraction;
+    max_exact=max_exact_kmers;
+    sketch_width_bits=width_bits;
+    sketch_depth=depth;
+  }
+  ~KmerFrequencyTable(){
+    delete sketch;
+  }
+  KmerFrequencyTable(const KmerFrequencyTable&)=delete;
+  KmerFrequencyTable& operator=(const KmerFrequencyTable&)=delete;
+
+  /*
+  * counts one more occurrence of kmer
+  */
+  void add(uint64_t kmer){
+    auto it=counts.find(kmer);
+    if(it!=counts.end()){
+      it->second++;
+      moveCount(it->second-1,it->second);
+      return;
+    }
+    if(counts.size()<max_exact && (sketch==nullptr || sketch->estimate(kmer)==0)){
+      counts[kmer]=1;
+      moveCount(0,1);
+      return;
+    }
+    if(sketch==nullptr){
+      sketch=new CountMinSketch(sketch_width_bits,sketch_depth);
+    }
+    sketch->add(kmer,1);
+    sketched++;
+  }
+  /*
+  * removes one occurrence of kmer
+  */
+  void remove(uint64_t kmer){
+    auto it=counts.find(kmer);
+    if(it!=counts.end()){
+      uint32_t before=it->second;
+      if(before==1){
+        counts.erase(it);
+      }
+      else{
+        it->second--;
+      }
+      moveCount(before,before-1);
+      return;
+    }
+    if(sketch==nullptr || sketch->estimate(kmer)==0){
+      cout<<"Removing the k-mer "<<unpack_kmer(kmer,k_size)<<", which was never counted\n";
+      return;
+    }
+    sketch->add(kmer,-1);
+    sketched--;
+  }
+  void add(std::string& sequence){
+    add(pack_kmer(sequence,0,k_size));
+  }
+  void remove(std::string& sequence){
+    remove(pack_kmer(sequence,0,k_size));
+  }
+
+  /*!
+   * Counts the minimizers stored in a B-tree, e.g. the minimizers of the reference before any variant is applied
+   * @param minimizerTree:    the B-tree holding the minimizers
+   */
+  template<class Pos>
+  void addTree(B_tree<Pos,std::string,7,3>* minimizerTree){
+    if(minimizerTree->is_empty()){
+      return;
+    }
+    for(auto elem: *minimizerTree){
+      for(int i=0;i<(int)elem.second.size();i++){
+        add(elem.second[i]);
+      }
+    }
+  }
+
+  /*
+  * returns the number of occurrences of kmer (an upper bound for k-mers of the sketch)
+  */
+  uint32_t getCount(uint64_t kmer) const{
+    auto it=counts.find(kmer);
+    if(it!=counts.end()){
+      return it->second;
+    }
+    return sketch==nullptr ? 0 : sketch->estimate(kmer);
+  }
+  /*
+  * returns true if kmer is one of the most frequent k-mers and should be skipped by lookups
+  */
+  bool isMasked(uint64_t kmer) const{
+    return getCount(kmer)>threshold;
+  }
+  bool isMasked(std::string& sequence) const{
+    return isMasked(pack_kmer(sequence,0,k_size));
+  }
+  /*
+  * changes the fraction of masked k-mers, the threshold is moved accordingly
+  */
+  void setMaskFraction(double fraction){
+    assert(fraction>=0 && fraction<=1);
+    mask_fraction=fraction;
+    rebalance();
+  }
+  double getMaskFraction() const{
+    return mask_fraction;
+  }
+  uint32_t getThreshold() const{
+    return threshold;
+  }
+  /*
+  * returns the number of exactly counted k-mers with a count above the threshold
+  */
+  uint64_t getNumberOfMaskedKmers() const{
+    return above;
+  }
+  uint64_t getNumberOfExactKmers() const{
+    return counts.size();
+  }
+  uint64_t getNumberOfSketchedOccurrences() const{
+    return sketched;
+  }
+  /*
+  * prints the size of the table and the mask to the console
+  */
+  void printStatistics() const{
+    cout<<counts.size()<<" exactly counted k-mers, "<<sketched<<" occurrences in the sketch, threshold "<<threshold<<", "<<above<<" masked k-mers\n";
+  }
+};
+
+#endif
@@ -0,0 +1,312 @@
+////////////////////////////////////////////////////////////////////////////////
+// liftover.h
+//   liftover class header file.
+//
+//  class to translate positions between the reference and the altered sequence
+//
+////////////////////////////////////////////////////////////////////////////////
+//  author: Alexander Petri
+
+#ifndef LIFTOVER_H
+#define LIFTOVER_H
+
+#include "main.h"
+#include "Variant.h"
+#include "include/dynamic.hpp"
+
+/*
+* Class to map positions between the reference and the altered (alternate) sequence.
+*
+* Both coordinate systems are cut into the same list of segments, which alternate between
+* unchanged segments (even index) and edited segments (odd index):
+*
+*   match_0, edit_0, match_1, edit_1, ..., match_m
+*
+* The length of every segment is stored twice, once in reference coordinates and once in
+* alternate coordinates, each time in a DYNAMIC packed_spsi. Partial sums then give the start
+* of a segment in both sequences and search finds the segment covering a position, so every
+* query and every recorded edit costs O(log v) for v recorded variants.
+*
+* Positions located inside an edited segment are mapped onto the first position of the
+* corresponding segment in the other sequence.
+*
+* @param ref_segments    the lengths of the segments in the reference sequence
+* @param alt_segments    the lengths of the segments in the altered sequence
+*/
+template<class Pos>
+class BasicLiftover{
+private:
+  dyn::packed_spsi ref_segments;
+  dyn::packed_spsi alt_segments;
+
+  /*
+  * returns the start of segment j in the given coordinate system
+  */
+  uint64_t segmentStart(dyn::packed_spsi& segments, uint64_t j){
+    return j==0 ? 0 : segments.psum(j-1);
+  }
+
+  /*
+  * returns the index of the segment covering pos (pos must be smaller than the total length)
+  */
+  uint64_t findSegment(dyn::packed_spsi& segments, uint64_t pos){
+    return segments.search(pos+1);
+  }
+
+  /*
+  * maps pos from the coordinate system stored in from into the one stored in to
+  */
+  Pos lift(dyn::packed_spsi& from, dyn::packed_spsi& to, Pos& pos){
+    uint64_t from_total=from.psum();
+    uint64_t to_total=to.psum();
+    if(pos<0){
+      return pos;
+    }
+    //positions behind the end of the sequence are shifted by the total length difference
+    if((uint64_t)pos>=from_total){
+      return pos-(Pos)from_total+(Pos)to_total;
+    }
+    uint64_t j=findSegment(from,pos);
+    uint64_t offset=pos-segmentStart(from,j);
+    uint64_t start=segmentStart(to,j);
+    if(j%2==0){
+      return (Pos)(start+offset);
+    }
+    return (Pos)start;
+  }
+
+  /*
+  * maps the sorted positions from the coordinate system stored in from into the one stored in to
+  * by walking the segments from left to right instead of searching every position separately
+  */
+  std::vector<Pos> liftSorted(dyn::packed_spsi& from, dyn::packed_spsi& to, std::vector<Pos>& positions){
+    std::vector<Pos> lifted;
+    lifted.reserve(positions.size());
+    uint64_t from_total=from.psum();
+    uint64_t n_segments=from.size();
+    uint64_t j=0;
+    uint64_t from_start=0;
+    uint64_t to_start=0;
+    bool located=false;
+    for(int i=0;i<(int)positions.size();i++){
+      Pos pos=positions[i];
+      if(pos<0 || (uint64_t)pos>=from_total){
+        lifted.push_back(lift(from,to,pos));
+        continue;
+      }
+      if(!located){
+        j=findSegment(from,pos);
+        from_start=segmentStart(from,j);
+        to_start=segmentStart(to,j);
+        located=true;
+      }
+      //advance to the segment covering pos
+      uint64_t from_len=from.at(j);
+      while((uint64_t)pos>=from_start+from_len && j+1<n_segments){
+        from_start+=from_len;
+        to_start+=to.at(j);
+        j++;
+        from_len=from.at(j);
+      }
+      if(j%2==0){
+        lifted.push_back((Pos)(to_start+pos-from_start));
+      }
+      else{
+        lifted.push_back((Pos)to_start);
+      }
+    }
+    return lifted;
+  }
+
+  /*
+  * maps unsorted positions by sorting them first and restoring the input order afterwards
+  */
+  std::vector<Pos> liftBatch(dyn::packed_spsi& from, dyn::packed_spsi& to, std::vector<Pos>& positions){
+    std::vector<int> order(positions.size());
+    for(int i=0;i<(int)order.size();i++){
+      order[i]=i;
+    }
+    std::sort(order.begin(),order.end(),[&positions](int a,int b){return positions[a]<positions[b];});
+    std::vector<Pos> sorted_positions;
+    sorted_positions.reserve(positions.size());
+    for(int i=0;i<(int)order.size();i++){
+      sorted_positions.push_back(positions[order[i]]);
+    }
+    std::vector<Pos> sorted_lifted=liftSorted(from,to,sorted_positions);
+    std::vector<Pos> lifted(positions.size());
+    for(int i=0;i<(int)order.size();i++){
+      lifted[order[i]]=sorted_lifted[i];
+    }
+    return lifted;
+  }
+
+public:
+  // Constructor
+  BasicLiftover(Pos reference_length){
+    ref_segments.push_back(reference_length);
+    alt_segments.push_back(reference_length);
+  }
+
+  /*
+  * records an edit, which replaces original_length bases at position pos of the current altered
+  * sequence with length new bases. Edits overlapping or touching already recorded edited segments
+  * are merged with them.
+  *
+  * @param pos               the position of the edit in the altered sequence
+  * @param original_length   the number of bases removed from the altered sequence
+  * @param length            the number of bases inserted into the altered sequence
+  */
+  void applyEdit(Pos pos, int original_length, int length){
+    uint64_t alt_total=alt_segments.psum();
+    uint64_t n_segments=alt_segments.size();
+    assert(pos>=0 && (uint64_t)(pos+original_length)<=alt_total);
+    //find the unchanged segment in which the merged edit starts and the number of bases kept in it
+    uint64_t first_match=n_segments-1;
+    uint64_t left=0;
+    uint64_t alt_start=pos;
+    if((uint64_t)pos<alt_total){
+      uint64_t j=findSegment(alt_segments,pos);
+      if(j%2==0){
+        first_match=j;
+        left=pos-segmentStart(alt_segments,j);
+      }
+      else{
+        first_match=j-1;
+        left=alt_segments.at(j-1);
+        alt_start=segmentStart(alt_segments,j);
+      }
+    }
+    else{
+      left=alt_segments.at(first_match);
+    }
+    //find the unchanged segment in which the merged edit ends and the number of bases kept in it
+    uint64_t last_match=first_match;
+    uint64_t right=alt_segments.at(first_match)-left;
+    uint64_t alt_end=pos+original_length;
+    if(first_match!=n_segments-1 || left<alt_segments.at(first_match)){
+      uint64_t end_pos=(original_length>0) ? pos+original_length-1 : pos;
+      uint64_t j=(end_pos<alt_total) ? findSegment(alt_segments,end_pos) : n_segments-1;
+      if(original_length==0 && j%2==1 && (uint64_t)pos==segmentStart(alt_segments,j)){
+        //a pure insertion in front of an edited segment does not have to be merged with it
+        j=first_match;
+      }
+      if(j%2==0){
+        last_match=j;
+        uint64_t consumed=(original_length>0) ? end_pos+1 : end_pos;
+        right=alt_segments.at(j)-(consumed-segmentStart(alt_segments,j));
+      }
+      else{
+        last_match=j+1;
+        right=alt_segments.at(j+1);
+        alt_end=segmentStart(alt_segments,j+1);
+      }
+    }
+    //compute the reference range covered by the merged edit
+    uint64_t ref_start=segmentStart(ref_segments,first_match)+left;
+    uint64_t ref_end=segmentStart(ref_segments,last_match)+ref_segments.at(last_match)-right;
+    uint64_t ref_length=ref_end-ref_start;
+    uint64_t alt_length=(alt_end-alt_start)-original_length+length;
+    //replace the segments between first_match and last_match by match(left), edit, match(right)
+    for(uint64_t j=first_match+1;j<=last_match;j++){
+      ref_segments.remove(first_match+1);
+      alt_segments.remove(first_match+1);
+    }
+    ref_segments.set(first_match,left);
+    alt_segments.set(first_match,left);
+    ref_segments.insert(first_match+1,ref_length);
+    alt_segments.insert(first_match+1,alt_length);
+    ref_segments.insert(first_match+2,right);
+    alt_segments.insert(first_match+2,right);
+  }
+
+  /*
+  * records the edit described by a variant, whose position is given in altered coordinates
+  */
+  void applyVariant(BasicVariant<Pos>& variant){
+    applyEdit(variant.getVariantPosition(),variant.getVariantOriginalSeqLen(),variant.getVariantLength());
+  }
+
+  /*
+  * returns the position in the altered sequence corresponding to the reference position pos
+  */
+  Pos refToAlt(Pos pos){
+    return lift(ref_segments,alt_segments,pos);
+  }
+
+  /*
+  * returns the position in the reference sequence corresponding to the altered position pos
+  */
+  Pos altToRef(Pos pos){
+    return lift(alt_segments,ref_segments,pos);
+  }
+
+  /*
+  * maps a batch of sorted reference positions into the altered sequence
+  */
+  std::vector<Pos> refToAltSorted(std::vector<Pos>& positions){
+    return liftSorted(ref_segments,alt_segments,positions);
+  }
+
+  /*
+  * maps a batch of sorted altered positions into the reference sequence
+  */
+  std::vector<Pos> altToRefSorted(std::vector<Pos>& positions){
+    return liftSorted(alt_segments,ref_segments,positions);
+  }
+
+  /*
+  * maps a batch of reference positions in arbitrary order into the altered sequence
+  */
+  std::vector<Pos> refToAltBatch(std::vector<Pos>& positions){
+    return liftBatch(ref_segments,alt_segments,positions);
+  }
+
+  /*
+  * maps a batch of altered positions in arbitrary order into the reference sequence
+  */
+  std::vector<Pos> altToRefBatch(std::vector<Pos>& positions){
+    return liftBatch(alt_segments,ref_segments,positions);
+  }
+
+  /*
+  * returns the number of edited segments recorded so far
+  */
+  int getNumberOfEdits(){
+    return (int)(ref_segments.size()/2);
+  }
+
+  /*
+  * returns the length of the reference sequence
+  */
+  Pos getReferenceLength(){
+    return (Pos)ref_segments.psum();
+  }
+
+  /*
+  * returns the length of the altered sequence
+  */
+  Pos getAlternateLength(){
+    return (Pos)alt_segments.psum();
+  }
+
+  /*
+  * prints the segments to the console
+  *
+  * Output: ref start-ref end -> alt start-alt end (match|edit)
+  */
+  void printLiftover(){
+    uint64_t ref_start=0;
+    uint64_t alt_start=0;
+    for(uint64_t j=0;j<ref_segments.size();j++){
+      uint64_t ref_len=ref_segments.at(j);
+      uint64_t alt_len=alt_segments.at(j);
+      cout<<ref_start<<"-"<<ref_start+ref_len<<" -> "<<alt_start<<"-"<<alt_start+alt_len<<(j%2==0 ? " match" : " edit")<<"\n";
+      ref_start+=ref_len;
+      alt_start+=alt_len;
+    }
+  }
+};
+
+typedef BasicLiftover<int> Liftover;
+
+#endif
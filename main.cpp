@@ -20,6 +20,26 @@
 #include "dynamic_minimizer_no.h"
 #include "brute_force.h"
 #include "dynseq_functions.h"
+#include "liftover.h"
+#include "multi_minimizer.h"
+#include "seed_lookup.h"
+#include "undo_journal.h"
+#include "structural_variants.h"
+#include "streaming_minimizer.h"
+#include "snapshot.h"
+#include "versioned_index.h"
+#include "allele_index.h"
+#include "contig_index.h"
+#include "compressed_minimizer_tree.h"
+#include "minimizer_stream.h"
+#include "seed_schemes.h"
+#include "window_cache.h"
+#include "sample_transitions.h"
+#include "minimizer_pipeline.h"
+#include "variant_plan.h"
+#include "perf_counters.h"
+#include "haplotype_export.h"
+#include "minimizer_filter.h"
 #include "include/dynamic.hpp"
 
 using namespace std;
@@ -54,10 +74,10 @@ int main(){
   //dynamic_sequence.insert(0,'a');
   //dynamic_sequence.
   std::vector<char> myVector(sequence.begin(), sequence.end());
-  for (int i=0;i<myVector.size();i++){
+  for (int i=0;i<(int)myVector.size();i++){
     dynamic_sequence.push_back(myVector[i]);
   }
-  for (int i=0;i<myVector.size();i++){
+  for (int i=0;i<(int)myVector.size();i++){
     dynamic_sequence2.push_back(myVector[i]);
   }
   cout<<"Size: "<<dynamic_sequence.size()<<"\n";
@@ -138,7 +158,7 @@ int main(){
   cout<<"Time needed: "<< ms<<"miliseconds\n";
 
   cout<<"Random variants:\n";
-  for(int i=0;i<variants.size();i++){
+  for(int i=0;i<(int)variants.size();i++){
     variants.at(i).printVariant();
   }
   //for (int i=0;i< variants.size();i++){
@@ -180,7 +200,13 @@ int main(){
   cout<<"Starting normal compute dynamic minimizers\n";
   auto begin3 = chrono::high_resolution_clock::now();
 
-  compute_dynamic_minimizers(minimizerTree,dynamic_sequence2,variants,k,w);
+  Liftover liftover(seqlen);
+  UndoJournal journal;
+  std::vector<Minimizer> reference_minis=minimizer_to_vector(minimizerTree);
+  //count the minimizers of the reference, the counts follow every update of the tree
+  KmerFrequencyTable frequencies(k,0.01);
+  frequencies.addTree(minimizerTree);
+  compute_dynamic_minimizers(minimizerTree,dynamic_sequence2,variants,k,w,UpdateObservers().withLiftover(&liftover).withJournal(&journal).withFrequencies(&frequencies));
   auto sndtime3=std::chrono::system_clock::now();
   auto dur3=sndtime3-begin3;
   auto msalgo = std::chrono::duration_cast<std::chrono::milliseconds>(dur3).count();
@@ -222,9 +248,9 @@ int main(){
   cout<<"Bf-Minimizer      vs        AlgoMinimizer\n";
   bool rightMinis=true;
   bool rightMinisno=true;
-  for(int i=0;i<newminisbf.size();i++){
+  for(int i=0;i<(int)newminisbf.size();i++){
     Minimizer bfmini=newminisbf[i];
-    if(i<=algominis.size()){
+    if(i<=(int)algominis.size()){
       Minimizer algomini=algominis[i];
       cout<<"Minimizer "<<bfmini.getSequence()<<": "<<bfmini.getPosition()<<"  vs     "<< algomini.getSequence()<<": "<<algomini.getPosition()<<"   "<<(bfmini.getSequence()==algomini.getSequence() && bfmini.getPosition()==algomini.getPosition())<<"\n";
       if(!(bfmini.getSequence()==algomini.getSequence() && bfmini.getPosition()==algomini.getPosition())){
@@ -263,7 +289,1200 @@ int main(){
   else{
     cout<<"ERROR\n";
   }
+  //the variants in variants3 still hold their reference positions, the ones in variants the altered positions
+  bool rightLiftover=true;
+  for(int i=0;i<(int)variants3.size();i++){
+    if(liftover.refToAlt(variants3[i].getVariantPosition()-1)+1!=variants[i].getVariantPosition()){
+      rightLiftover=false;
+    }
+  }
+  //map every position both ways and compare with the alignment of the reference and the altered sequence built
+  //from variants3: kept bases map onto each other, the bases of an edited segment onto the start of the segment
+  //in the other sequence
+  std::vector<int> expected_alt(sequence2.size());
+  std::vector<int> expected_ref(algo_result.size());
+  std::vector<bool> kept(sequence2.size(),true);
+  int ref_cursor=0;
+  int alt_cursor=0;
+  for(int i=0;i<=(int)variants3.size();i++){
+    int edit_start=i<(int)variants3.size() ? variants3[i].getVariantPosition() : (int)sequence2.size();
+    for(;ref_cursor<edit_start;ref_cursor++,alt_cursor++){
+      expected_alt[ref_cursor]=alt_cursor;
+      rightLiftover=rightLiftover && alt_cursor<(int)algo_result.size() && algo_result[alt_cursor]==sequence2[ref_cursor];
+      if(alt_cursor<(int)algo_result.size()){
+        expected_ref[alt_cursor]=ref_cursor;
+      }
+    }
+    if(i<(int)variants3.size()){
+      for(int j=0;j<variants3[i].getVariantOriginalSeqLen();j++,ref_cursor++){
+        expected_alt[ref_cursor]=alt_cursor;
+        kept[ref_cursor]=false;
+      }
+      for(int j=0;j<variants3[i].getVariantLength();j++,alt_cursor++){
+        if(alt_cursor<(int)algo_result.size()){
+          expected_ref[alt_cursor]=edit_start;
+        }
+      }
+    }
+  }
+  rightLiftover=rightLiftover && alt_cursor==(int)algo_result.size() && liftover.getAlternateLength()==(int)algo_result.size();
+  std::vector<int> ref_positions;
+  std::vector<int> alt_positions;
+  for(int i=0;rightLiftover && i<(int)sequence2.size();i++){
+    rightLiftover=liftover.refToAlt(i)==expected_alt[i] && (!kept[i] || liftover.altToRef(expected_alt[i])==i);
+    ref_positions.push_back(i);
+  }
+  for(int i=0;rightLiftover && i<(int)algo_result.size();i++){
+    rightLiftover=liftover.altToRef(i)==expected_ref[i];
+    alt_positions.push_back(i);
+  }
+  //the batched lookups give the same positions, sorted and in arbitrary order
+  rightLiftover=rightLiftover && liftover.refToAltSorted(ref_positions)==expected_alt && liftover.altToRefSorted(alt_positions)==expected_ref;
+  std::vector<int> shuffled_positions=ref_positions;
+  std::shuffle(shuffled_positions.begin(),shuffled_positions.end(),std::mt19937(seqlen));
+  std::vector<int> shuffled_alt=liftover.refToAltBatch(shuffled_positions);
+  for(int i=0;rightLiftover && i<(int)shuffled_positions.size();i++){
+    rightLiftover=shuffled_alt[i]==expected_alt[shuffled_positions[i]];
+  }
+  shuffled_positions=alt_positions;
+  std::shuffle(shuffled_positions.begin(),shuffled_positions.end(),std::mt19937(seqlen));
+  std::vector<int> shuffled_ref=liftover.altToRefBatch(shuffled_positions);
+  for(int i=0;rightLiftover && i<(int)shuffled_positions.size();i++){
+    rightLiftover=shuffled_ref[i]==expected_ref[shuffled_positions[i]];
+  }
+  if(rightLiftover){
+    cout<<"The liftover mapped all variants to their altered positions!\n";
+  }
+  //look up all k-mers of the altered sequence in the minimizer tree
+  SeedIndex seedIndex(minimizerTree,k);
+  SeedQueryResult seedResult;
+  std::vector<uint64_t> queries;
+  for(int i=0;i+k<=(int)algo_result.size();i++){
+    queries.push_back(pack_kmer(algo_result,i,k));
+  }
+  seedIndex.query_batch(queries,seedResult);
+  seedResult.printStatistics();
+  bool rightSeeds=true;
+  for(int i=0;i<(int)queries.size();i++){
+    for(int j=0;j<seedResult.getNumberOfHits(i);j++){
+      if(algo_result.substr(seedResult.getHits(i)[j],k)!=algo_result.substr(i,k)){
+        rightSeeds=false;
+      }
+    }
+  }
+  if(rightSeeds){
+    cout<<"The seed lookup returned the right positions!\n";
+  }
+  //miss-dominated lookups (random k-mers) with and without a filter in front of the seed index
+  MinimizerFilter seedFilter(k,seedIndex.size());
+  seedFilter.addTree(minimizerTree);
+  seedFilter.printStatistics();
+  std::vector<uint64_t> miss_queries;
+  std::mt19937_64 query_generator(k);
+  for(int i=0;i<200000;i++){
+    miss_queries.push_back(i%10==0 ? queries[i%queries.size()] : query_generator()&(((uint64_t)1<<(2*k))-1));
+  }
+  SeedQueryResult unfilteredResult;
+  SeedQueryResult filteredResult;
+  seedIndex.query_batch(miss_queries,unfilteredResult);
+  seedIndex.query_batch(miss_queries,filteredResult,nullptr,&seedFilter);
+  unfilteredResult.printStatistics();
+  filteredResult.printStatistics();
+  bool rightFilter=unfilteredResult.offsets==filteredResult.offsets && unfilteredResult.positions==filteredResult.positions;
+  //the maintained counts equal a recount of the altered tree and masked k-mers get no hits
+  auto frequencies_match=[&](){
+    std::map<uint64_t,uint32_t> recount;
+    for(auto elem: *minimizerTree){
+      for(int i=0;i<(int)elem.second.size();i++){
+        recount[pack_kmer(elem.second[i],0,k)]++;
+      }
+    }
+    bool match=recount.size()==frequencies.getNumberOfExactKmers();
+    for(auto count: recount){
+      match=match && frequencies.getCount(count.first)==count.second;
+    }
+    return match;
+  };
+  bool rightFrequencies=frequencies_match();
+  seedIndex.query_batch(queries,seedResult,&frequencies);
+  for(int i=0;i<(int)queries.size();i++){
+    if(frequencies.isMasked(queries[i]) && seedResult.getNumberOfHits(i)>0){
+      rightFrequencies=false;
+    }
+  }
+  frequencies.printStatistics();
+  //restore the reference sequence and its minimizers
+  journal.printJournal();
+  journal.revert(dynamic_sequence2,&variants,&frequencies);
+  rightFrequencies=rightFrequencies && frequencies_match();
+  if(rightFrequencies){
+    cout<<"The k-mer counts followed the minimizer updates!\n";
+  }
+  std::vector<Minimizer> reverted_minis=minimizer_to_vector(minimizerTree);
+  bool rightRevert=dynseq_tostring(dynamic_sequence2)==sequence2 && reverted_minis.size()==reference_minis.size();
+  for(int i=0;rightRevert && i<(int)reverted_minis.size();i++){
+    if(reverted_minis[i].getPosition()!=reference_minis[i].getPosition() || reverted_minis[i].getSequence()!=reference_minis[i].getSequence()){
+      rightRevert=false;
+    }
+  }
+  for(int i=0;i<(int)variants3.size();i++){
+    if(variants[i].getVariantPosition()!=variants3[i].getVariantPosition()){
+      rightRevert=false;
+    }
+  }
+  if(rightRevert){
+    cout<<"The revert restored the reference sequence and minimizers!\n";
+  }
+  //apply a large deletion, a translocation and an inversion to the restored reference
+  std::string sv_sequence=sequence2;
+  StructuralVariant deletion(DELETION,10,20);
+  StructuralVariant translocation(TRANSLOCATION,5,15,60);
+  StructuralVariant inversion(INVERSION,30,12);
+  apply_structural_variant(minimizerTree,dynamic_sequence2,deletion,k,w);
+  sv_sequence.erase(10,20);
+  apply_structural_variant(minimizerTree,dynamic_sequence2,translocation,k,w);
+  sv_sequence=sv_sequence.substr(0,5)+sv_sequence.substr(20,40)+sv_sequence.substr(5,15)+sv_sequence.substr(60);
+  apply_structural_variant(minimizerTree,dynamic_sequence2,inversion,k,w);
+  std::string inverted_block=sv_sequence.substr(30,12);
+  sv_sequence.replace(30,12,reverse_complement(inverted_block));
+  std::vector<Minimizer> sv_minis=get_kmer_minimizers(sv_sequence,k,w);
+  std::vector<Minimizer> sv_algominis=minimizer_to_vector(minimizerTree);
+  bool rightSV=dynseq_tostring(dynamic_sequence2)==sv_sequence && sv_minis.size()==sv_algominis.size();
+  for(int i=0;rightSV && i<(int)sv_minis.size();i++){
+    if(sv_minis[i].getPosition()!=sv_algominis[i].getPosition() || sv_minis[i].getSequence()!=sv_algominis[i].getSequence()){
+      rightSV=false;
+    }
+  }
+  if(rightSV){
+    cout<<"The structural variants delivered the right minimizers!\n";
+  }
+  //extend the sequence by appending bases
+  MinimizerAppender appender(minimizerTree,&dynamic_sequence2,k,w);
+  std::string appended_bases=generate_random_sequence(50);
+  appender.append(appended_bases);
+  sv_sequence+=appended_bases;
+  std::vector<Minimizer> append_minis=get_kmer_minimizers(sv_sequence,k,w);
+  std::vector<Minimizer> append_algominis=minimizer_to_vector(minimizerTree);
+  bool rightAppend=dynseq_tostring(dynamic_sequence2)==sv_sequence && append_minis.size()==append_algominis.size();
+  for(int i=0;rightAppend && i<(int)append_minis.size();i++){
+    if(append_minis[i].getPosition()!=append_algominis[i].getPosition() || append_minis[i].getSequence()!=append_algominis[i].getSequence()){
+      rightAppend=false;
+    }
+  }
+  if(rightAppend){
+    cout<<"The appended bases delivered the right minimizers!\n";
+  }
+  //write a snapshot spanning many blocks, map it and apply variants inside a narrow range, which thaws only the
+  //blocks around it
+  int snapshot_length=20000;
+  std::string snapshot_text=generate_random_sequence(snapshot_length);
+  std::vector<Minimizer> snapshot_reference=get_kmer_minimizers(snapshot_text,k,w);
+  B_tree<int,std::string,7,3>* snapshotTree=new B_tree<int,std::string,7,3>();
+  fill_minimizer_tree(snapshotTree,snapshot_reference);
+  wt_str snapshot_dynseq(sigma);
+  dynseq_push_many(snapshot_dynseq,snapshot_text);
+  std::string snapshot_path="minimizers.snapshot";
+  write_minimizer_snapshot(snapshot_path,snapshotTree,snapshot_dynseq,k,w);
+  MinimizerSnapshot snapshot;
+  bool rightSnapshot=snapshot.open(snapshot_path) && snapshot.getNumberOfBlocks()>8;
+  if(rightSnapshot){
+    dyn::wt_str snapshot_sequence((uint64_t)4);
+    snapshot.thaw_sequence(snapshot_sequence);
+    LazyMinimizerTree lazyTree(&snapshot);
+    //the variants of a 200 base window moved to the middle of the sequence
+    std::string snapshot_window=snapshot_text.substr(0,200);
+    int snapshot_variant_count=3;
+    vector<Variant> snapshot_variants=generate_random_variations(snapshot_window,snapshot_variant_count);
+    int snapshot_offset=snapshot_length/2;
+    for(int i=0;i<(int)snapshot_variants.size();i++){
+      snapshot_variants[i].updateVariantPosition(snapshot_offset);
+    }
+    vector<Variant> snapshot_variants2=snapshot_variants;
+    compute_dynamic_minimizers_lazy(lazyTree,snapshot_sequence,snapshot_variants,k,w);
+    int thawed_blocks=lazyTree.getNumberOfThawedBlocks();
+    cout<<"Thawed "<<thawed_blocks<<" of "<<snapshot.getNumberOfBlocks()<<" blocks\n";
+    //the lazily thawed tree has to match the tree updated in memory
+    compute_dynamic_minimizers(snapshotTree,snapshot_dynseq,snapshot_variants2,k,w);
+    std::vector<Minimizer> snapshot_minis=minimizer_to_vector(snapshotTree);
+    std::vector<Minimizer> snapshot_algominis=minimizer_to_vector(lazyTree.thaw_all());
+    rightSnapshot=thawed_blocks<snapshot.getNumberOfBlocks()/2 && dynseq_tostring(snapshot_sequence)==dynseq_tostring(snapshot_dynseq) && snapshot_minis.size()==snapshot_algominis.size();
+    for(int i=0;rightSnapshot && i<(int)snapshot_minis.size();i++){
+      if(snapshot_minis[i].getPosition()!=snapshot_algominis[i].getPosition() || snapshot_minis[i].getSequence()!=snapshot_algominis[i].getSequence()){
+        rightSnapshot=false;
+      }
+    }
+  }
+  delete snapshotTree;
+  if(rightSnapshot){
+    cout<<"The snapshot delivered the right minimizers!\n";
+  }
+  //damaged snapshots are rejected instead of being read outside the mapping
+  std::ifstream snapshot_file(snapshot_path,std::ios::binary);
+  std::string snapshot_bytes((std::istreambuf_iterator<char>(snapshot_file)),std::istreambuf_iterator<char>());
+  snapshot_file.close();
+  std::string damaged_path="damaged.snapshot";
+  auto opens_damaged=[&](std::string bytes,bool verify){
+    std::ofstream damaged_file(damaged_path,std::ios::binary|std::ios::trunc);
+    damaged_file.write(bytes.data(),bytes.size());
+    damaged_file.close();
+    MinimizerSnapshot damaged;
+    return damaged.open(damaged_path,verify);
+  };
+  snapshot_header_t snapshot_header;
+  memcpy(&snapshot_header,snapshot_bytes.data(),sizeof(snapshot_header));
+  //a header only file with a section far behind its end
+  snapshot_header_t far_header=snapshot_header;
+  far_header.keys_offset=(uint64_t)1<<40;
+  far_header.file_size=sizeof(far_header);
+  bool rightDamage=opens_damaged(snapshot_bytes,true) && !opens_damaged(std::string((const char*)&far_header,sizeof(far_header)),false);
+  //a changed header field is caught by the checksum
+  std::string flipped_bytes=snapshot_bytes;
+  snapshot_header_t flipped_header=snapshot_header;
+  flipped_header.k_size^=1;
+  memcpy(&flipped_bytes[0],&flipped_header,sizeof(flipped_header));
+  rightDamage=rightDamage && !opens_damaged(flipped_bytes,true);
+  std::remove(damaged_path.c_str());
+  if(rightDamage){
+    cout<<"The snapshot rejected the damaged files!\n";
+  }
+  std::remove(snapshot_path.c_str());
+  //apply a long stream of variants to the versioned index while reader threads keep scanning it. The readers only see
+  //the minimizers, the sequence itself is not versioned and is only read by the updating thread. The minimizers a
+  //reader visits per second of its own CPU time have to stay about the same during the updates, although the
+  //updating thread shares the cores with the readers
+  std::string versioned_sequence=dynseq_tostring(dynamic_sequence2);
+  std::vector<Minimizer> versioned_reference=minimizer_to_vector(minimizerTree);
+  VersionedMinimizerIndex versionedIndex(versioned_reference);
+  dyn::wt_str versioned_dynseq(sigma);
+  dynseq_push_many(versioned_dynseq,versioned_sequence);
+  std::vector<vector<Variant>> versioned_rounds;
+  int versioned_round_count=80;
+  std::atomic<int> reader_phase(0);
+  std::atomic<long> visited_idle(0);
+  std::atomic<long> visited_updating(0);
+  std::atomic<long> reader_ns_idle(0);
+  std::atomic<long> reader_ns_updating(0);
+  auto thread_nanoseconds=[](){
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID,&now);
+    return (long)now.tv_sec*1000000000L+now.tv_nsec;
+  };
+  std::vector<std::thread> readers;
+  for(int r=0;r<2;r++){
+    readers.emplace_back([&](){
+      MinimizerIndexReader reader(versionedIndex);
+      Minimizer found;
+      long visited[2]={0,0};
+      long nanoseconds[2]={0,0};
+      int phase;
+      while((phase=reader_phase.load())<2){
+        long scan_start=thread_nanoseconds();
+        reader.pin();
+        int pos=-1;
+        while(reader.successor(pos,found)){
+          pos=found.getPosition();
+          visited[phase]++;
+        }
+        reader.unpin();
+        nanoseconds[phase]+=thread_nanoseconds()-scan_start;
+      }
+      visited_idle+=visited[0];
+      visited_updating+=visited[1];
+      reader_ns_idle+=nanoseconds[0];
+      reader_ns_updating+=nanoseconds[1];
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  reader_phase=1;
+  auto update_start=std::chrono::high_resolution_clock::now();
+  for(int round=0;round<versioned_round_count;round++){
+    std::string round_sequence=dynseq_tostring(versioned_dynseq);
+    versioned_rounds.push_back(generate_random_variations(round_sequence,numbervars));
+    vector<Variant> round_variants=versioned_rounds.back();
+    compute_dynamic_minimizers_versioned(versionedIndex,versioned_dynseq,round_variants,k,w);
+  }
+  auto update_end=std::chrono::high_resolution_clock::now();
+  reader_phase=2;
+  for(int r=0;r<(int)readers.size();r++){
+    readers[r].join();
+  }
+  double update_seconds=std::chrono::duration<double>(update_end-update_start).count();
+  double idle_rate=reader_ns_idle>0 ? visited_idle*1e9/reader_ns_idle : 0;
+  double updating_rate=reader_ns_updating>0 ? visited_updating*1e9/reader_ns_updating : 0;
+  cout<<"Reader minimizers per CPU second without updates: "<<idle_rate<<", during "<<update_seconds<<" s of updates: "<<updating_rate<<" ("<<versionedIndex.getVersion()<<" versions)\n";
+  for(int round=0;round<(int)versioned_rounds.size();round++){
+    compute_dynamic_minimizers(minimizerTree,dynamic_sequence2,versioned_rounds[round],k,w);
+  }
+  std::vector<Minimizer> versioned_minis=minimizer_to_vector(minimizerTree);
+  std::vector<Minimizer> versioned_algominis;
+  MinimizerIndexReader versionedReader(versionedIndex);
+  versionedReader.pin();
+  versionedReader.collect(std::numeric_limits<int>::min(),std::numeric_limits<int>::max(),versioned_algominis);
+  versionedReader.unpin();
+  bool rightVersioned=dynseq_tostring(versioned_dynseq)==dynseq_tostring(dynamic_sequence2) && versioned_minis.size()==versioned_algominis.size()
+    && idle_rate>0 && updating_rate>=0.5*idle_rate;
+  for(int i=0;rightVersioned && i<(int)versioned_minis.size();i++){
+    if(versioned_minis[i].getPosition()!=versioned_algominis[i].getPosition() || versioned_minis[i].getSequence()!=versioned_algominis[i].getSequence()){
+      rightVersioned=false;
+    }
+  }
+  if(rightVersioned){
+    cout<<"The versioned index delivered the right minimizers!\n";
+  }
+  //index the reference together with the ALT alleles and seed the fully altered haplotype against it
+  wt_str allele_reference(sigma);
+  dynseq_push_many(allele_reference,sequence2);
+  vector<Variant> allele_variants=variants3;
+  AlleleAwareIndex alleleIndex(allele_reference,allele_variants,k,w);
+  alleleIndex.printStatistics();
+  std::string alt_haplotype="";
+  int allele_cursor=0;
+  for(int i=0;i<(int)allele_variants.size();i++){
+    alt_haplotype+=sequence2.substr(allele_cursor,allele_variants[i].getVariantPosition()-allele_cursor)+allele_variants[i].getVariantSequence();
+    allele_cursor=allele_variants[i].getVariantPosition()+allele_variants[i].getVariantOriginalSeqLen();
+  }
+  alt_haplotype+=sequence2.substr(allele_cursor);
+  std::vector<Minimizer> alt_minis=get_kmer_minimizers(alt_haplotype,k,w);
+  bool rightAlleles=true;
+  for(int i=0;i<(int)alt_minis.size();i++){
+    std::string kmer=alt_minis[i].getSequence();
+    std::pair<int,int> hits=alleleIndex.lookup(kmer);
+    if(hits.first==hits.second){
+      rightAlleles=false;
+    }
+  }
+  if(rightAlleles){
+    cout<<"The allele-aware index contains all minimizers of the ALT haplotype!\n";
+  }
+  //index two contigs with 32-bit positions, apply their variants in parallel and compare with the int pipeline
+  ContigMinimizerIndex<uint32_t> contigIndex(k,w);
+  std::vector<std::string> contig_sequences={sequence2,versioned_sequence};
+  std::vector<std::vector<BasicVariant<uint32_t>>> contig_variants(contig_sequences.size());
+  std::vector<std::vector<Variant>> contig_int_variants;
+  for(int c=0;c<(int)contig_sequences.size();c++){
+    contigIndex.addContig("contig"+std::to_string(c),contig_sequences[c]);
+    contig_int_variants.push_back(generate_random_variations(contig_sequences[c],numbervars));
+    for(int i=0;i<(int)contig_int_variants[c].size();i++){
+      uint32_t pos=contig_int_variants[c][i].getVariantPosition();
+      int origin=contig_int_variants[c][i].getVariantOriginalSeqLen();
+      int length=contig_int_variants[c][i].getVariantLength();
+      std::string seq=contig_int_variants[c][i].getVariantSequence();
+      contig_variants[c].push_back(BasicVariant<uint32_t>(pos,origin,length,seq));
+    }
+  }
+  //the workers allocate from the arenas of their contigs only, the shared (locked) arenas are not touched
+  uint64_t shared_allocations=dyn::slab_allocator<md::b_tree_tag>::stats().allocations+dyn::slab_allocator<dyn::spsi_tag>::stats().allocations+dyn::slab_allocator<dyn::leaf_words_tag>::stats().allocations;
+  contigIndex.applyVariants(contig_variants,2);
+  bool rightContigs=shared_allocations==dyn::slab_allocator<md::b_tree_tag>::stats().allocations+dyn::slab_allocator<dyn::spsi_tag>::stats().allocations+dyn::slab_allocator<dyn::leaf_words_tag>::stats().allocations;
+  for(int c=0;c<(int)contig_sequences.size();c++){
+    dyn::alloc_stats contig_stats=contigIndex.getAllocationStatistics(c);
+    contig_stats.print(cout,("Arena of contig"+std::to_string(c)).c_str());
+    rightContigs=rightContigs && contig_stats.live>0 && contig_stats.chunks>0;
+  }
+  for(int c=0;c<(int)contig_sequences.size();c++){
+    B_tree<int,std::string,7,3>* contigTree=new B_tree<int,std::string,7,3>();
+    fill_minimizer_tree(contigTree,get_kmer_minimizers(contig_sequences[c],k,w));
+    wt_str contig_dynseq(sigma);
+    dynseq_push_many(contig_dynseq,contig_sequences[c]);
+    compute_dynamic_minimizers(contigTree,contig_dynseq,contig_int_variants[c],k,w);
+    std::vector<Minimizer> contig_minis=minimizer_to_vector(contigTree);
+    std::vector<BasicMinimizer<uint32_t>> contig_algominis=minimizer_to_vector(contigIndex.getTree(c));
+    if(dynseq_tostring(contigIndex.getSequence(c))!=dynseq_tostring(contig_dynseq) || contig_minis.size()!=contig_algominis.size()){
+      rightContigs=false;
+    }
+    for(int i=0;rightContigs && i<(int)contig_minis.size();i++){
+      if(contig_minis[i].getPosition()!=(int)contig_algominis[i].getPosition() || contig_minis[i].getSequence()!=contig_algominis[i].getSequence()){
+        rightContigs=false;
+      }
+    }
+    delete contigTree;
+  }
+  if(rightContigs){
+    cout<<"The contig index delivered the right minimizers!\n";
+  }
+  //apply the variants to a tree with compressed leaves and compare the memory with the B-tree of strings
+  std::vector<Minimizer> compressed_reference=get_kmer_minimizers(sequence2,k,w);
+  CompressedMinimizerTree<int> compressedTree(compressed_reference,k,16);
+  wt_str compressed_dynseq(sigma);
+  dynseq_push_many(compressed_dynseq,sequence2);
+  vector<Variant> compressed_variants=variants3;
+  vector<Variant> compressed_variants2=variants3;
+  compute_dynamic_minimizers_compressed(compressedTree,compressed_dynseq,compressed_variants,k,w);
+  B_tree<int,std::string,7,3>* compressedCheckTree=new B_tree<int,std::string,7,3>();
+  fill_minimizer_tree(compressedCheckTree,compressed_reference);
+  wt_str compressed_check_dynseq(sigma);
+  dynseq_push_many(compressed_check_dynseq,sequence2);
+  compute_dynamic_minimizers(compressedCheckTree,compressed_check_dynseq,compressed_variants2,k,w);
+  std::vector<Minimizer> compressed_minis=minimizer_to_vector(compressedCheckTree);
+  delete compressedCheckTree;
+  std::vector<Minimizer> compressed_algominis=compressedTree.toVector();
+  bool rightCompressed=compressed_minis.size()==compressed_algominis.size();
+  for(int i=0;rightCompressed && i<(int)compressed_minis.size();i++){
+    if(compressed_minis[i].getPosition()!=compressed_algominis[i].getPosition() || compressed_minis[i].getSequence()!=compressed_algominis[i].getSequence()){
+      rightCompressed=false;
+    }
+  }
+  if(rightCompressed){
+    cout<<"The compressed tree delivered the right minimizers!\n";
+  }
+  //update the trees of several schemes in one pass and compare every tree with a separate update of its scheme
+  std::vector<MinimizerScheme> multi_schemes={MinimizerScheme(k,w),MinimizerScheme(3,5),MinimizerScheme(5,9)};
+  std::vector<B_tree<int,std::string,7,3>*> multiTrees;
+  std::vector<std::map<int,std::vector<std::string>>> multi_mirrors(multi_schemes.size());
+  std::vector<ChangeFeed*> multi_feeds;
+  std::vector<UpdateObservers> multi_observers;
+  std::vector<std::vector<Minimizer>> multi_reference;
+  for(int i=0;i<(int)multi_schemes.size();i++){
+    multiTrees.push_back(new B_tree<int,std::string,7,3>());
+  }
+  fill_multi_minimizer_trees(multiTrees,multi_schemes,sequence2);
+  for(int i=0;i<(int)multi_schemes.size();i++){
+    multi_reference.push_back(minimizer_to_vector(multiTrees[i]));
+    for(int j=0;j<(int)multi_reference[i].size();j++){
+      multi_mirrors[i][multi_reference[i][j].getPosition()].push_back(multi_reference[i][j].getSequence());
+    }
+    std::map<int,std::vector<std::string>>& mirror=multi_mirrors[i];
+    multi_feeds.push_back(new ChangeFeed([&mirror](const MinimizerChange& change){
+      if(change.type==MINIMIZER_INSERTED){
+        mirror[change.position].push_back(change.kmer);
+      }
+      else if(change.type==MINIMIZER_DELETED){
+        std::vector<std::string>& kmers=mirror[change.position];
+        kmers.erase(std::find(kmers.begin(),kmers.end(),change.kmer));
+        if(kmers.empty()){
+          mirror.erase(change.position);
+        }
+      }
+      else{
+        std::map<int,std::vector<std::string>> shifted;
+        for(auto it=mirror.begin();it!=mirror.end();++it){
+          shifted[it->first>=change.position ? it->first+change.delta : it->first]=it->second;
+        }
+        mirror.swap(shifted);
+      }
+    }));
+    multi_observers.push_back(UpdateObservers().withFeed(multi_feeds[i]));
+  }
+  wt_str multi_dynseq(sigma);
+  dynseq_push_many(multi_dynseq,sequence2);
+  vector<Variant> multi_variants=variants3;
+  UndoJournal multi_journal;
+  compute_dynamic_minimizers_multi(multiTrees,multi_schemes,multi_dynseq,multi_variants,UpdateObservers().withJournal(&multi_journal),multi_observers);
+  bool rightMulti=dynseq_tostring(multi_dynseq)==algo_result;
+  for(int i=0;rightMulti && i<(int)multi_schemes.size();i++){
+    int scheme_k=multi_schemes[i].getK();
+    int scheme_w=multi_schemes[i].getW();
+    B_tree<int,std::string,7,3>* schemeTree=new B_tree<int,std::string,7,3>();
+    fill_minimizer_tree(schemeTree,multi_reference[i]);
+    wt_str scheme_dynseq(sigma);
+    dynseq_push_many(scheme_dynseq,sequence2);
+    vector<Variant> scheme_variants=variants3;
+    compute_dynamic_minimizers(schemeTree,scheme_dynseq,scheme_variants,scheme_k,scheme_w);
+    std::vector<Minimizer> scheme_minis=minimizer_to_vector(schemeTree);
+    std::vector<Minimizer> multi_minis=minimizer_to_vector(multiTrees[i]);
+    delete schemeTree;
+    rightMulti=scheme_minis.size()==multi_minis.size() && multi_mirrors[i].size()==multi_minis.size();
+    auto mirrored=multi_mirrors[i].begin();
+    for(int j=0;rightMulti && j<(int)scheme_minis.size();j++,++mirrored){
+      rightMulti=scheme_minis[j].getPosition()==multi_minis[j].getPosition() && scheme_minis[j].getSequence()==multi_minis[j].getSequence()
+        && mirrored->first==multi_minis[j].getPosition() && mirrored->second.size()==1 && mirrored->second[0]==multi_minis[j].getSequence();
+    }
+  }
+  //the journal moves the sequence and all trees back to the reference
+  multi_journal.revert(multi_dynseq,&multi_variants);
+  rightMulti=rightMulti && dynseq_tostring(multi_dynseq)==sequence2;
+  for(int i=0;i<(int)multi_schemes.size();i++){
+    std::vector<Minimizer> reverted_minis=minimizer_to_vector(multiTrees[i]);
+    rightMulti=rightMulti && reverted_minis.size()==multi_reference[i].size();
+    for(int j=0;rightMulti && j<(int)reverted_minis.size();j++){
+      rightMulti=reverted_minis[j].getPosition()==multi_reference[i][j].getPosition() && reverted_minis[j].getSequence()==multi_reference[i][j].getSequence();
+    }
+    delete multiTrees[i];
+    delete multi_feeds[i];
+  }
+  if(rightMulti){
+    cout<<"The multi-scheme update delivered the right minimizers!\n";
+  }
+  std::string memory_sequence="";
+  for(int i=0;i<100000;i++){
+    memory_sequence+="ACGT"[rand()%4];
+  }
+  std::vector<Minimizer> memory_minis=get_kmer_minimizers(memory_sequence,k,w);
+  //build the tree in an arena of its own, so that its statistics cover exactly this tree (nodes and satellites), and
+  //discard it with the arena in O(chunks)
+  uint64_t plain_before=dyn::slab_allocator<md::b_tree_tag>::stats().allocations;
+  dyn::slab_arena memoryArena;
+  {
+    dyn::slab_arena_scope memoryScope(&memoryArena);
+    B_tree<int,std::string,7,3>* memoryTree=dyn::slab_allocator<md::b_tree_tag>::create<B_tree<int,std::string,7,3>>();
+    fill_minimizer_tree(memoryTree,memory_minis);
+  }
+  uint64_t plain_bytes=memoryArena.stats().live_bytes;
+  bool rightArena=plain_bytes>0 && dyn::slab_allocator<md::b_tree_tag>::stats().allocations==plain_before;
+  memoryArena.release();
+  rightArena=rightArena && memoryArena.stats().chunks==0 && memoryArena.stats().live_bytes==0;
+  if(rightArena){
+    cout<<"The slab arena held the whole tree and released it!\n";
+  }
+  CompressedMinimizerTree<int> memoryCompressed(memory_minis,k);
+  cout<<"Bytes per minimizer: B-tree "<<(double)plain_bytes/memory_minis.size()<<", compressed tree "<<(double)memoryCompressed.getBytes()/memory_minis.size()<<" ("<<memoryCompressed.getNumberOfLeaves()<<" leaves)\n";
+  //stream the minimizers of reads sampled from the sequence and compare them with the packed minimizers of every read
+  std::vector<std::string> stream_reads;
+  std::ostringstream stream_fastq;
+  for(int i=0;i<20000;i++){
+    stream_reads.push_back(memory_sequence.substr(rand()%(memory_sequence.size()-150),50+rand()%100));
+    stream_fastq<<"@read"<<i<<"\n"<<stream_reads.back()<<"\n+\n"<<std::string(stream_reads.back().size(),'I')<<"\n";
+  }
+  std::istringstream stream_input(stream_fastq.str());
+  std::vector<std::vector<std::pair<uint64_t,uint64_t>>> streamed(stream_reads.size());
+  auto stream_consumer=[&](int,uint64_t read,const StreamedMinimizer& minimizer){
+    streamed[read].push_back(std::make_pair(minimizer.pos,minimizer.kmer));
+  };
+  StreamStatistics stream_statistics=stream_fastq_minimizers(stream_input,k,w,4,stream_consumer,256);
+  bool rightStream=stream_statistics.reads==stream_reads.size();
+  for(int i=0;rightStream && i<(int)stream_reads.size();i++){
+    std::vector<uint8_t> read_codes=pack_sequence(stream_reads[i]);
+    std::vector<Minimizer> read_minis=get_packed_kmer_minimizers(read_codes,k,w,LEXICOGRAPHIC,0);
+    rightStream=read_minis.size()==streamed[i].size();
+    for(int j=0;rightStream && j<(int)read_minis.size();j++){
+      rightStream=(uint64_t)read_minis[j].getPosition()==streamed[i][j].first && read_minis[j].getSequence()==unpack_kmer(streamed[i][j].second,k);
+    }
+  }
+  //the generator over a range of the dynamic sequence delivers the minimizers of the substring
+  MinimizerGenerator<DynamicSequenceSource> dynamic_generator(k,w);
+  std::string compressed_string=dynseq_tostring(compressed_dynseq);
+  uint64_t stream_left=compressed_string.size()/4;
+  uint64_t stream_right=compressed_string.size()/2;
+  dynamic_generator.reset(DynamicSequenceSource(compressed_dynseq,stream_left,stream_right),stream_left);
+  std::vector<uint8_t> range_codes=pack_sequence(compressed_string);
+  range_codes=std::vector<uint8_t>(range_codes.begin()+stream_left,range_codes.begin()+stream_right+1);
+  std::vector<Minimizer> range_minis=get_packed_kmer_minimizers(range_codes,k,w,LEXICOGRAPHIC,stream_left);
+  int range_index=0;
+  for(StreamedMinimizer minimizer: dynamic_generator){
+    if(range_index>=(int)range_minis.size() || (uint64_t)range_minis[range_index].getPosition()!=minimizer.pos || range_minis[range_index].getSequence()!=unpack_kmer(minimizer.kmer,k)){
+      rightStream=false;
+    }
+    range_index++;
+  }
+  if(rightStream && range_index==(int)range_minis.size()){
+    cout<<"The minimizer stream delivered the right minimizers! ("<<stream_statistics.reads/stream_statistics.seconds<<" reads per second)\n";
+  }
+  //compare the fixed kernels of the production configurations with the generic packed kernel
+  std::vector<uint8_t> kernel_codes=pack_sequence(memory_sequence);
+  bool rightKernels=true;
+  PerfCounterGroup kernel_counters;
+  if(!kernel_counters.isAvailable()){
+    cout<<"Hardware counters unavailable ("<<kernel_counters.getError()<<"), timing the kernels only\n";
+  }
+  for(int c=0;c<(int)(sizeof(FIXED_KMER_CONFIGURATIONS)/sizeof(FIXED_KMER_CONFIGURATIONS[0]));c++){
+    int kernel_k=FIXED_KMER_CONFIGURATIONS[c][0];
+    int kernel_w=FIXED_KMER_CONFIGURATIONS[c][1];
+    PerfMeasurement generic_counters;
+    PerfMeasurement fixed_counters;
+    for(int round=0;round<10;round++){
+      kernel_counters.start();
+      std::vector<Minimizer> generic_minis=get_generic_packed_kmer_minimizers(kernel_codes,kernel_k,kernel_w,HASHED,0);
+      generic_counters+=kernel_counters.stop();
+      kernel_counters.start();
+      std::vector<Minimizer> fixed_minis=get_packed_kmer_minimizers(kernel_codes,kernel_k,kernel_w,HASHED,0);
+      fixed_counters+=kernel_counters.stop();
+      rightKernels=rightKernels && generic_minis.size()==fixed_minis.size();
+      for(int i=0;rightKernels && i<(int)generic_minis.size();i++){
+        rightKernels=generic_minis[i].getPosition()==fixed_minis[i].getPosition() && generic_minis[i].getSequence()==fixed_minis[i].getSequence();
+      }
+    }
+    double generic_seconds=generic_counters.seconds;
+    double fixed_seconds=fixed_counters.seconds;
+    cout<<"Kernel k="<<kernel_k<<" w="<<kernel_w<<": generic "<<generic_seconds*100<<" ms, fixed "<<fixed_seconds*100<<" ms per 100k bases (speedup "<<generic_seconds/fixed_seconds<<")\n";
+    generic_counters.printPerOperation("  generic",10*kernel_codes.size(),"base");
+    fixed_counters.printPerOperation("  fixed",10*kernel_codes.size(),"base");
+  }
+  //windows of a power of two k-mers fill the ring buffer of a fixed kernel completely
+  std::mt19937 window_generator(w);
+  for(int round=0;rightKernels && round<200;round++){
+    std::string window_sequence;
+    for(int i=10+window_generator()%300;i>0;i--){
+      window_sequence+="ACGT"[window_generator()%4];
+    }
+    std::vector<uint8_t> window_codes=pack_sequence(window_sequence);
+    int window_k=4;
+    int window_w=7;
+    std::vector<Minimizer> generic_minis=get_generic_packed_kmer_minimizers(window_codes,window_k,window_w,HASHED,0);
+    std::vector<Minimizer> fixed_minis=get_fixed_kmer_minimizers<4,7,HASHED,int>(window_codes.data(),window_codes.size(),0);
+    rightKernels=generic_minis.size()==fixed_minis.size();
+    for(int i=0;rightKernels && i<(int)generic_minis.size();i++){
+      rightKernels=generic_minis[i].getPosition()==fixed_minis[i].getPosition() && generic_minis[i].getSequence()==fixed_minis[i].getSequence();
+    }
+  }
+  if(rightKernels){
+    cout<<"The fixed kernels delivered the right minimizers!\n";
+  }
+  //compare the density and the update time of the seeding schemes on the same variants
+  int seed_variant_count=200;
+  vector<Variant> seed_variants=generate_random_variations(memory_sequence,seed_variant_count);
+  std::vector<SeedScheme> seed_schemes;
+  seed_schemes.push_back(SeedScheme::minimizer(15,24));
+  seed_schemes.push_back(SeedScheme::openSyncmer(15,11,2));
+  seed_schemes.push_back(SeedScheme::closedSyncmer(15,11));
+  seed_schemes.push_back(SeedScheme::randstrobe(15,16,40));
+  bool rightSchemes=true;
+  std::vector<std::string> seed_reports;
+  for(int i=0;i<(int)seed_schemes.size();i++){
+    std::vector<Minimizer> seeds=get_seeds(memory_sequence,seed_schemes[i]);
+    B_tree<int,std::string,7,3>* seedTree=new B_tree<int,std::string,7,3>();
+    fill_minimizer_tree(seedTree,seeds);
+    wt_str seed_dynseq(sigma);
+    dynseq_push_many(seed_dynseq,memory_sequence);
+    vector<Variant> scheme_variants=seed_variants;
+    //time the update and not the debug output: the tree is not dumped after every variation-impact-range and the
+    //remaining debug messages are dropped by the failed stream
+    print_updated_minimizer_trees()=false;
+    cout.setstate(std::ios::failbit);
+    auto seed_start=std::chrono::high_resolution_clock::now();
+    compute_dynamic_seeds(seedTree,seed_dynseq,scheme_variants,seed_schemes[i]);
+    double seed_seconds=std::chrono::duration<double>(std::chrono::high_resolution_clock::now()-seed_start).count();
+    cout.clear();
+    print_updated_minimizer_trees()=true;
+    //every scheme, the window minimizers included, is checked against a recomputation on the altered sequence
+    std::string seed_string=dynseq_tostring(seed_dynseq);
+    std::vector<Minimizer> seed_minis=get_seeds(seed_string,seed_schemes[i]);
+    std::vector<Minimizer> seed_algominis=minimizer_to_vector(seedTree);
+    rightSchemes=rightSchemes && seed_minis.size()==seed_algominis.size();
+    for(int j=0;rightSchemes && j<(int)seed_minis.size();j++){
+      rightSchemes=seed_minis[j].getPosition()==seed_algominis[j].getPosition() && seed_minis[j].getSequence()==seed_algominis[j].getSequence();
+    }
+    std::ostringstream report;
+    report<<"density "<<(double)seeds.size()/memory_sequence.size()<<", impact range +-"<<seed_schemes[i].getImpactW()+seed_schemes[i].getK()-1<<" bases, "<<seed_seconds*1000000/seed_variant_count<<" microseconds per variant";
+    seed_reports.push_back(report.str());
+    delete seedTree;
+  }
+  for(int i=0;i<(int)seed_schemes.size();i++){
+    seed_schemes[i].printScheme();
+    cout<<"  "<<seed_reports[i]<<"\n";
+  }
+  if(rightSchemes){
+    cout<<"The seeding schemes delivered the right seeds!\n";
+  }
+  //apply the variants of a cohort to the same reference, every sample carries each variant with probability 1/2
+  std::string cohort_sequence=memory_sequence.substr(0,1000);
+  int cohort_variant_count=20;
+  vector<Variant> cohort_pool=generate_random_variations(cohort_sequence,cohort_variant_count);
+  std::vector<Minimizer> cohort_minis=get_kmer_minimizers(cohort_sequence,k,w);
+  B_tree<int,std::string,7,3>* cohortTree=new B_tree<int,std::string,7,3>();
+  fill_minimizer_tree(cohortTree,cohort_minis);
+  wt_str cohort_dynseq(sigma);
+  dynseq_push_many(cohort_dynseq,cohort_sequence);
+  MinimizerWindowCache windowCache(1<<20);
+  std::vector<std::string> cohort_windows;
+  bool rightCache=true;
+  for(int sample=0;sample<10;sample++){
+    vector<Variant> sample_variants;
+    for(int i=0;i<(int)cohort_pool.size();i++){
+      if(rand()%2){
+        sample_variants.push_back(cohort_pool[i]);
+      }
+    }
+    vector<Variant> cached_variants=sample_variants;
+    vector<Variant> window_variants=sample_variants;
+    UndoJournal window_journal;
+    apply_variants_to_dynamic_sequence(cohort_dynseq,window_variants,k,w,[&](std::string& fullsubseq,int&,int&){
+      cohort_windows.push_back(fullsubseq);
+    },(Liftover*)nullptr,&window_journal);
+    window_journal.revert(cohort_dynseq,&window_variants);
+    UndoJournal uncached_journal;
+    compute_dynamic_minimizers(cohortTree,cohort_dynseq,sample_variants,k,w,UpdateObservers().withJournal(&uncached_journal));
+    std::vector<Minimizer> uncached_minis=minimizer_to_vector(cohortTree);
+    uncached_journal.revert(cohort_dynseq,&sample_variants);
+    UndoJournal cached_journal;
+    compute_dynamic_minimizers_cached(cohortTree,cohort_dynseq,cached_variants,k,w,windowCache,UpdateObservers().withJournal(&cached_journal));
+    std::vector<Minimizer> cached_minis=minimizer_to_vector(cohortTree);
+    cached_journal.revert(cohort_dynseq,&cached_variants);
+    rightCache=rightCache && cached_minis.size()==uncached_minis.size();
+    for(int j=0;rightCache && j<(int)cached_minis.size();j++){
+      rightCache=cached_minis[j].getPosition()==uncached_minis[j].getPosition() && cached_minis[j].getSequence()==uncached_minis[j].getSequence();
+    }
+  }
+  delete cohortTree;
+  windowCache.printStatistics();
+  //the update extracts every window anyway, the cache only replaces the minimizer computation of a window by hashing
+  //and comparing it, so both are timed on the windows of the samples (a fresh cache per round, misses included)
+  double uncached_seconds=0;
+  double cached_seconds=0;
+  int zero_shift=0;
+  for(int round=0;rightCache && round<20;round++){
+    auto begin=std::chrono::high_resolution_clock::now();
+    std::vector<std::vector<Minimizer>> computed(cohort_windows.size());
+    for(int i=0;i<(int)cohort_windows.size();i++){
+      computed[i]=get_kmer_minimizers_algo(cohort_windows[i],k,w,zero_shift);
+    }
+    auto middle=std::chrono::high_resolution_clock::now();
+    MinimizerWindowCache timedCache(1<<20);
+    std::vector<std::vector<Minimizer>> cached(cohort_windows.size());
+    for(int i=0;i<(int)cohort_windows.size();i++){
+      cached[i]=timedCache.getMinimizers(cohort_windows[i],k,w,zero_shift);
+    }
+    auto end=std::chrono::high_resolution_clock::now();
+    uncached_seconds+=std::chrono::duration<double>(middle-begin).count();
+    cached_seconds+=std::chrono::duration<double>(end-middle).count();
+    for(int i=0;rightCache && i<(int)cohort_windows.size();i++){
+      rightCache=computed[i].size()==cached[i].size();
+      for(int j=0;rightCache && j<(int)computed[i].size();j++){
+        rightCache=computed[i][j].getPosition()==cached[i][j].getPosition() && computed[i][j].getSequence()==cached[i][j].getSequence();
+      }
+    }
+  }
+  cout<<cohort_windows.size()<<" windows: "<<uncached_seconds<<" s computed, "<<cached_seconds<<" s through the cache ("<<uncached_seconds/cached_seconds<<"x)\n";
+  rightCache=rightCache && cached_seconds<uncached_seconds;
+  if(rightCache){
+    cout<<"The window cache delivered the right minimizers!\n";
+  }
+  //samples descending from three founders, each differing from its founder in two variants of the pool
+  std::vector<std::vector<bool>> founders(3,std::vector<bool>(cohort_pool.size()));
+  for(int f=0;f<(int)founders.size();f++){
+    for(int i=0;i<(int)cohort_pool.size();i++){
+      founders[f][i]=rand()%2;
+    }
+  }
+  std::vector<std::vector<Variant>> cohort_samples;
+  uint64_t reset_variants=0;
+  for(int sample=0;sample<12;sample++){
+    std::vector<bool> carried=founders[sample%founders.size()];
+    carried[rand()%carried.size()].flip();
+    carried[rand()%carried.size()].flip();
+    cohort_samples.push_back(std::vector<Variant>());
+    for(int i=0;i<(int)cohort_pool.size();i++){
+      if(carried[i]){
+        cohort_samples.back().push_back(cohort_pool[i]);
+      }
+    }
+    //applying and reverting the sample starting from the reference
+    reset_variants+=2*cohort_samples.back().size();
+  }
+  Cohort cohort(cohort_sequence,cohort_samples);
+  B_tree<int,std::string,7,3>* transitionTree=new B_tree<int,std::string,7,3>();
+  fill_minimizer_tree(transitionTree,cohort_minis);
+  wt_str transition_dynseq(sigma);
+  dynseq_push_many(transition_dynseq,cohort_sequence);
+  bool rightTransitions=true;
+  uint64_t transition_variants=cohort.computeDynamicMinimizers(transitionTree,transition_dynseq,k,w,[&](int sample){
+    B_tree<int,std::string,7,3>* sampleTree=new B_tree<int,std::string,7,3>();
+    fill_minimizer_tree(sampleTree,cohort_minis);
+    wt_str sample_dynseq(sigma);
+    dynseq_push_many(sample_dynseq,cohort_sequence);
+    std::vector<Variant> sample_variants=cohort_samples[sample];
+    if(!sample_variants.empty()){
+      compute_dynamic_minimizers(sampleTree,sample_dynseq,sample_variants,k,w);
+    }
+    std::vector<Minimizer> sample_minis=minimizer_to_vector(sampleTree);
+    std::vector<Minimizer> transition_minis=minimizer_to_vector(transitionTree);
+    rightTransitions=rightTransitions && dynseq_tostring(sample_dynseq)==dynseq_tostring(transition_dynseq) && sample_minis.size()==transition_minis.size();
+    for(int j=0;rightTransitions && j<(int)sample_minis.size();j++){
+      rightTransitions=sample_minis[j].getPosition()==transition_minis[j].getPosition() && sample_minis[j].getSequence()==transition_minis[j].getSequence();
+    }
+    delete sampleTree;
+  },&windowCache);
+  rightTransitions=rightTransitions && dynseq_tostring(transition_dynseq)==cohort_sequence;
+  delete transitionTree;
+  cout<<"Cohort of "<<cohort.getNumberOfSamples()<<" samples: "<<transition_variants<<" variants applied along the schedule, "<<reset_variants<<" when starting every sample from the reference\n";
+  if(rightTransitions){
+    cout<<"The sample transitions delivered the right minimizers!\n";
+  }
+  //follow a minimizer tree through the changes of the feed only
+  B_tree<int,std::string,7,3>* feedTree=new B_tree<int,std::string,7,3>();
+  fill_minimizer_tree(feedTree,cohort_minis);
+  std::map<int,std::vector<std::string>> feed_mirror;
+  for(int i=0;i<(int)cohort_minis.size();i++){
+    feed_mirror[cohort_minis[i].getPosition()].push_back(cohort_minis[i].getSequence());
+  }
+  MinimizerFilter feed_filter(k,cohort_minis.size());
+  feed_filter.addTree(feedTree);
+  SeedIndex feed_seeds(feedTree,k);
+  bool followed_filter=true;
+  bool followed_seeds=true;
+  ChangeFeed feed([&](const MinimizerChange& change){
+    followed_filter=feed_filter.follow(change) && followed_filter;
+    followed_seeds=feed_seeds.follow(change) && followed_seeds;
+    if(change.type==MINIMIZER_INSERTED){
+      feed_mirror[change.position].push_back(change.kmer);
+    }
+    else if(change.type==MINIMIZER_DELETED){
+      std::vector<std::string>& kmers=feed_mirror[change.position];
+      kmers.erase(std::find(kmers.begin(),kmers.end(),change.kmer));
+      if(kmers.empty()){
+        feed_mirror.erase(change.position);
+      }
+    }
+    else{
+      std::map<int,std::vector<std::string>> shifted;
+      for(auto it=feed_mirror.begin();it!=feed_mirror.end();++it){
+        shifted[it->first>=change.position ? it->first+change.delta : it->first]=it->second;
+      }
+      feed_mirror.swap(shifted);
+    }
+  });
+  wt_str feed_dynseq(sigma);
+  dynseq_push_many(feed_dynseq,cohort_sequence);
+  UndoJournal feed_journal;
+  vector<Variant> feed_variants=cohort_pool;
+  compute_dynamic_minimizers(feedTree,feed_dynseq,feed_variants,k,w,UpdateObservers().withJournal(&feed_journal).withFeed(&feed));
+  auto feed_matches=[&](){
+    std::vector<Minimizer> tree_minis=minimizer_to_vector(feedTree);
+    bool match=tree_minis.size()==feed_mirror.size();
+    auto it=feed_mirror.begin();
+    for(int i=0;match && i<(int)tree_minis.size();i++,++it){
+      match=tree_minis[i].getPosition()==it->first && it->second.size()==1 && tree_minis[i].getSequence()==it->second[0];
+    }
+    return match;
+  };
+  //the filter contains every minimizer of the tree and nothing that was deleted for good
+  auto filter_matches=[&](){
+    std::vector<Minimizer> tree_minis=minimizer_to_vector(feedTree);
+    bool match=feed_filter.getNumberOfOccurrences()==tree_minis.size();
+    for(int i=0;match && i<(int)tree_minis.size();i++){
+      std::string kmer=tree_minis[i].getSequence();
+      match=feed_filter.contains(kmer);
+    }
+    return match;
+  };
+  //the seed index answers every k-mer of the tree like a seed index rebuilt from it
+  auto seeds_match=[&](){
+    feed_seeds.flush();
+    std::vector<Minimizer> tree_minis=minimizer_to_vector(feedTree);
+    SeedIndex rebuilt_seeds(feedTree,k);
+    SeedQueryResult followed_result;
+    SeedQueryResult rebuilt_result;
+    feed_seeds.query_batch(tree_minis,followed_result);
+    rebuilt_seeds.query_batch(tree_minis,rebuilt_result);
+    return feed_seeds.size()==rebuilt_seeds.size() && followed_result.offsets==rebuilt_result.offsets && followed_result.positions==rebuilt_result.positions;
+  };
+  bool rightFeed=feed_matches();
+  //the same variants through a ring buffer of 4 changes drained by a consumer thread with poll(). The consumer only
+  //starts once the ring is full, so the updating thread has to wait for it
+  B_tree<int,std::string,7,3>* ringTree=new B_tree<int,std::string,7,3>();
+  fill_minimizer_tree(ringTree,cohort_minis);
+  std::map<int,std::vector<std::string>> ring_mirror;
+  for(int i=0;i<(int)cohort_minis.size();i++){
+    ring_mirror[cohort_minis[i].getPosition()].push_back(cohort_minis[i].getSequence());
+  }
+  ChangeFeed ring_feed((uint64_t)4);
+  std::atomic<bool> ring_done(false);
+  uint64_t ring_polled=0;
+  bool ring_ordered=true;
+  std::thread ring_consumer([&](){
+    while(ring_feed.getNumberOfBufferedChanges()<4 && !ring_done.load(std::memory_order_acquire)){
+      std::this_thread::yield();
+    }
+    MinimizerChange change;
+    while(true){
+      bool done=ring_done.load(std::memory_order_acquire);
+      if(!ring_feed.poll(change)){
+        if(done){
+          break;
+        }
+        std::this_thread::yield();
+        continue;
+      }
+      ring_ordered=ring_ordered && change.number==ring_polled;
+      ring_polled++;
+      if(change.type==MINIMIZER_INSERTED){
+        ring_mirror[change.position].push_back(change.kmer);
+      }
+      else if(change.type==MINIMIZER_DELETED){
+        std::vector<std::string>& kmers=ring_mirror[change.position];
+        kmers.erase(std::find(kmers.begin(),kmers.end(),change.kmer));
+        if(kmers.empty()){
+          ring_mirror.erase(change.position);
+        }
+      }
+      else{
+        std::map<int,std::vector<std::string>> shifted;
+        for(auto it=ring_mirror.begin();it!=ring_mirror.end();++it){
+          shifted[it->first>=change.position ? it->first+change.delta : it->first]=it->second;
+        }
+        ring_mirror.swap(shifted);
+      }
+    }
+  });
+  wt_str ring_dynseq(sigma);
+  dynseq_push_many(ring_dynseq,cohort_sequence);
+  vector<Variant> ring_variants=cohort_pool;
+  compute_dynamic_minimizers(ringTree,ring_dynseq,ring_variants,k,w,UpdateObservers().withFeed(&ring_feed));
+  ring_done.store(true,std::memory_order_release);
+  ring_consumer.join();
+  std::vector<Minimizer> ring_minis=minimizer_to_vector(ringTree);
+  bool rightRing=ring_ordered && ring_polled==ring_feed.getNumberOfChanges() && ring_feed.getNumberOfChanges()>4 && ring_feed.getNumberOfStalls()>0
+    && ring_minis.size()==ring_mirror.size();
+  auto ring_it=ring_mirror.begin();
+  for(int i=0;rightRing && i<(int)ring_minis.size();i++,++ring_it){
+    rightRing=ring_minis[i].getPosition()==ring_it->first && ring_it->second.size()==1 && ring_minis[i].getSequence()==ring_it->second[0];
+  }
+  delete ringTree;
+  cout<<ring_feed.getNumberOfChanges()<<" changes polled from the ring buffer, "<<ring_feed.getNumberOfStalls()<<" found it full\n";
+  if(rightRing){
+    cout<<"The ring buffer delivered the changes to the polling thread!\n";
+  }
+  rightFilter=rightFilter && filter_matches();
+  bool rightFollowedSeeds=seeds_match();
+  feed_journal.revert(feed_dynseq,&feed_variants,(KmerFrequencyTable*)nullptr,&feed);
+  rightFeed=rightFeed && feed_matches();
+  rightFilter=rightFilter && filter_matches();
+  rightFollowedSeeds=rightFollowedSeeds && seeds_match() && followed_seeds && feed_seeds.getNumberOfMissingDeletes()==0;
+  //deleting a minimizer the snapshot does not hold is detected and leaves the snapshot unchanged
+  MinimizerChange missing_change;
+  missing_change.number=0;
+  missing_change.type=MINIMIZER_DELETED;
+  missing_change.position=cohort_sequence.size();
+  missing_change.delta=0;
+  missing_change.kmer=cohort_minis[0].getSequence();
+  rightFollowedSeeds=rightFollowedSeeds && !feed_seeds.follow(missing_change) && feed_seeds.getNumberOfMissingDeletes()==1 && !feed_seeds.hasPendingChanges();
+  if(rightFollowedSeeds){
+    cout<<"The seed index followed the minimizer updates!\n";
+  }
+  rightFilter=rightFilter && followed_filter;
+  feed_filter.printStatistics();
+  if(rightFilter){
+    cout<<"The minimizer filter followed the minimizer updates!\n";
+  }
+  //the subtree counts have followed the deletions, shifts and insertions as well
+  std::vector<Minimizer> counted_minis=minimizer_to_vector(feedTree);
+  bool rightCounts=feedTree->size()==counted_minis.size();
+  for(int i=0;rightCounts && i<(int)counted_minis.size();i++){
+    auto elem=feedTree->select(i);
+    rightCounts=elem.key!=nullptr && elem.key->value+elem.shift==counted_minis[i].getPosition() && (int)feedTree->rank(counted_minis[i].getPosition())==i;
+  }
+  for(int left=0;rightCounts && left<(int)cohort_sequence.size();left+=97){
+    int right=left+150;
+    int inside=0;
+    for(int i=0;i<(int)counted_minis.size();i++){
+      if(counted_minis[i].getPosition()>=left && counted_minis[i].getPosition()<=right){
+        inside++;
+      }
+    }
+    rightCounts=(int)feedTree->count_range(left,right)==inside;
+  }
+  std::vector<int> boundaries=partition_minimizers(feedTree,4);
+  for(int i=0;rightCounts && i<(int)boundaries.size();i++){
+    int end=i+1<(int)boundaries.size() ? boundaries[i+1]-1 : cohort_sequence.size();
+    int part=feedTree->count_range(boundaries[i],end);
+    rightCounts=part==(int)counted_minis.size()/4 || part==(int)counted_minis.size()/4+1;
+  }
+  delete feedTree;
+  if(rightCounts){
+    cout<<"The order statistics delivered the right minimizers!\n";
+  }
+  //run the variants of the cohort pool through the pipeline as a VCF, the overlapping second record is skipped
+  //and the record in the middle of the pool whose last REF base is wrong is skipped as a REF mismatch
+  std::stringstream pipeline_vcf;
+  pipeline_vcf<<"##fileformat=VCFv4.2\n#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\n";
+  int mismatch_index=-1;
+  for(int i=cohort_pool.size()/2;i<(int)cohort_pool.size() && mismatch_index<0;i++){
+    if(cohort_pool[i].getVariantOriginalSeqLen()>0){
+      mismatch_index=i;
+    }
+  }
+  for(int i=0;i<(int)cohort_pool.size();i++){
+    int pos=cohort_pool[i].getVariantPosition();
+    std::string ref=cohort_sequence.substr(pos-1,cohort_pool[i].getVariantOriginalSeqLen()+1);
+    std::string alt=cohort_sequence[pos-1]+cohort_pool[i].getVariantSequence();
+    if(i==mismatch_index){
+      for(char base:std::string("ACGT")){
+        if(base!=ref.back() && (alt.size()<ref.size() || base!=alt[ref.size()-1])){
+          ref.back()=base;
+          break;
+        }
+      }
+    }
+    pipeline_vcf<<"chr1\t"<<pos<<"\t.\t"<<ref<<"\t"<<alt<<"\t.\tPASS\t.\n";
+    if(i==0){
+      pipeline_vcf<<"chr1\t"<<pos<<"\t.\t"<<cohort_sequence.substr(pos-1,2)<<"\t"<<cohort_sequence[pos-1]<<"\t.\tPASS\t.\n";
+    }
+  }
+  B_tree<int,std::string,7,3>* pipelineTree=new B_tree<int,std::string,7,3>();
+  fill_minimizer_tree(pipelineTree,cohort_minis);
+  wt_str pipeline_dynseq(sigma);
+  dynseq_push_many(pipeline_dynseq,cohort_sequence);
+  std::ostringstream pipeline_changelog;
+  std::string pipeline_index_path="pipeline.snapshot";
+  PipelineStatistics pipeline_statistics=run_minimizer_pipeline(pipeline_vcf,pipelineTree,pipeline_dynseq,k,w,pipeline_changelog,pipeline_index_path,4,2);
+  pipeline_statistics.printStatistics();
+  B_tree<int,std::string,7,3>* pipelineReference=new B_tree<int,std::string,7,3>();
+  fill_minimizer_tree(pipelineReference,cohort_minis);
+  wt_str pipeline_refseq(sigma);
+  dynseq_push_many(pipeline_refseq,cohort_sequence);
+  vector<Variant> pipeline_variants=cohort_pool;
+  pipeline_variants.erase(pipeline_variants.begin()+mismatch_index);
+  compute_dynamic_minimizers(pipelineReference,pipeline_refseq,pipeline_variants,k,w);
+  std::vector<Minimizer> pipeline_minis=minimizer_to_vector(pipelineReference);
+  MinimizerSnapshot pipeline_snapshot;
+  bool rightPipeline=mismatch_index>=0 && pipeline_statistics.skipped==1 && pipeline_statistics.reference_mismatch==1 && dynseq_tostring(pipeline_dynseq)==dynseq_tostring(pipeline_refseq) && pipeline_snapshot.open(pipeline_index_path);
+  if(rightPipeline){
+    std::vector<Minimizer> pipeline_algominis=minimizer_to_vector(pipelineTree);
+    LazyMinimizerTree pipeline_lazyTree(&pipeline_snapshot);
+    std::vector<Minimizer> pipeline_snapshotminis=minimizer_to_vector(pipeline_lazyTree.thaw_all());
+    rightPipeline=pipeline_minis.size()==pipeline_algominis.size() && pipeline_minis.size()==pipeline_snapshotminis.size();
+    for(int i=0;rightPipeline && i<(int)pipeline_minis.size();i++){
+      rightPipeline=pipeline_minis[i].getPosition()==pipeline_algominis[i].getPosition() && pipeline_minis[i].getSequence()==pipeline_algominis[i].getSequence() && pipeline_minis[i].getPosition()==pipeline_snapshotminis[i].getPosition() && pipeline_minis[i].getSequence()==pipeline_snapshotminis[i].getSequence();
+    }
+  }
+  std::remove(pipeline_index_path.c_str());
+  delete pipelineTree;
+  delete pipelineReference;
+  if(rightPipeline){
+    cout<<"The pipeline delivered the right minimizers!\n";
+  }
+  //plan the shuffled records of the pipeline VCF in runs of 4 records, a duplicate, the overlapping record and the record with the wrong REF are dropped
+  std::vector<std::string> plan_lines;
+  std::string plan_line;
+  pipeline_vcf.clear();
+  pipeline_vcf.seekg(0);
+  while(std::getline(pipeline_vcf,plan_line)){
+    if(!plan_line.empty() && plan_line[0]!='#'){
+      plan_lines.push_back(plan_line);
+    }
+  }
+  for(int i=plan_lines.size()-1;i>0;i--){
+    std::string fields=plan_lines[i].substr(plan_lines[i].find("\t.\t")+3);
+    if(fields.substr(0,fields.find('\t'))!=fields.substr(fields.find('\t')+1,fields.find("\t.\tPASS")-fields.find('\t')-1)){
+      plan_lines.push_back(plan_lines[i]);
+      break;
+    }
+  }
+  //the overlapping record has to follow the record it overlaps, the first record at a position is kept
+  std::string overlapping_line=plan_lines[1];
+  plan_lines.erase(plan_lines.begin()+1);
+  std::shuffle(plan_lines.begin(),plan_lines.end(),std::mt19937(plan_lines.size()));
+  plan_lines.push_back(overlapping_line);
+  std::stringstream plan_vcf;
+  for(int i=0;i<(int)plan_lines.size();i++){
+    plan_vcf<<plan_lines[i]<<"\n";
+  }
+  std::vector<std::string> plan_names={"chr1"};
+  std::vector<std::string> plan_references={cohort_sequence};
+  std::string plan_path="variants.plan";
+  VariantPlanStatistics plan_statistics;
+  bool rightPlan=build_variant_plan(plan_vcf,plan_names,plan_references,k,w,plan_path,&plan_statistics,4);
+  plan_statistics.printStatistics();
+  VariantPlan plan;
+  ContigMinimizerIndex<int> planIndex(k,w);
+  planIndex.addContig("chr1",cohort_sequence);
+  rightPlan=rightPlan && plan_statistics.duplicates==1 && plan_statistics.conflicts==1 && plan_statistics.reference_mismatch==1 && plan.open(plan_path);
+  //the planned variation-impact-ranges are the ranges the algorithm computes when it applies the variants
+  if(rightPlan){
+    std::vector<std::tuple<int,std::string,int>> computed_ranges;
+    std::vector<std::tuple<int,std::string,int>> planned_ranges;
+    std::vector<Variant> computed_variants=plan.getVariants<int>(0);
+    std::vector<Variant> planned_variants=computed_variants;
+    std::vector<ImpactRange> plan_ranges=plan.getImpactRanges<int>(0);
+    wt_str computed_sequence(sigma);
+    wt_str planned_sequence(sigma);
+    dynseq_push_many(computed_sequence,cohort_sequence);
+    dynseq_push_many(planned_sequence,cohort_sequence);
+    apply_variants_to_dynamic_sequence(computed_sequence,computed_variants,k,w,[&](std::string& fullsubseq,int& thisstartpos,int& var_impact_shift){
+      computed_ranges.push_back(std::make_tuple(thisstartpos,fullsubseq,var_impact_shift));
+    });
+    apply_variants_to_dynamic_sequence(planned_sequence,planned_variants,k,w,[&](std::string& fullsubseq,int& thisstartpos,int& var_impact_shift){
+      planned_ranges.push_back(std::make_tuple(thisstartpos,fullsubseq,var_impact_shift));
+    },(Liftover*)nullptr,(UndoJournal*)nullptr,&plan_ranges);
+    cout<<plan.getNumberOfClusters(0)<<" planned variation-impact-ranges for "<<plan.getNumberOfVariants(0)<<" variants\n";
+    rightPlan=plan_statistics.clusters<=plan_statistics.variants && plan.getNumberOfClusters(0)==computed_ranges.size() && computed_ranges==planned_ranges
+      && dynseq_tostring(planned_sequence)==dynseq_tostring(computed_sequence);
+  }
+  rightPlan=rightPlan && apply_variant_plan(plan,planIndex);
+  if(rightPlan){
+    std::vector<Minimizer> plan_minis=minimizer_to_vector(planIndex.getTree(0));
+    rightPlan=dynseq_tostring(planIndex.getSequence(0))==dynseq_tostring(pipeline_refseq) && plan_minis.size()==pipeline_minis.size();
+    for(int i=0;rightPlan && i<(int)plan_minis.size();i++){
+      rightPlan=plan_minis[i].getPosition()==pipeline_minis[i].getPosition() && plan_minis[i].getSequence()==pipeline_minis[i].getSequence();
+    }
+  }
+  plan.close();
+  if(rightPlan){
+    cout<<"The variant plan delivered the right minimizers!\n";
+  }
+  //damaged plans are rejected instead of being read outside the mapping
+  std::ifstream plan_file(plan_path,std::ios::binary);
+  std::string plan_bytes((std::istreambuf_iterator<char>(plan_file)),std::istreambuf_iterator<char>());
+  plan_file.close();
+  std::remove(plan_path.c_str());
+  std::string damaged_plan_path="damaged.plan";
+  auto opens_damaged_plan=[&](std::string bytes,bool verify){
+    std::ofstream damaged_file(damaged_plan_path,std::ios::binary|std::ios::trunc);
+    damaged_file.write(bytes.data(),bytes.size());
+    damaged_file.close();
+    VariantPlan damaged;
+    return damaged.open(damaged_plan_path,verify);
+  };
+  plan_header_t plan_header;
+  memcpy(&plan_header,plan_bytes.data(),sizeof(plan_header));
+  //a header only file with a section far behind its end
+  plan_header_t far_plan_header=plan_header;
+  far_plan_header.variants_offset=(uint64_t)1<<40;
+  far_plan_header.file_size=sizeof(far_plan_header);
+  bool rightPlanDamage=plan_header.n_variants>0 && opens_damaged_plan(plan_bytes,true) && !opens_damaged_plan(std::string((const char*)&far_plan_header,sizeof(far_plan_header)),false);
+  //a variant whose allele lies behind the allele section
+  std::string far_allele_bytes=plan_bytes;
+  plan_variant_t far_variant;
+  memcpy(&far_variant,far_allele_bytes.data()+plan_header.variants_offset,sizeof(far_variant));
+  far_variant.allele_offset=plan_header.n_allele_bytes;
+  far_variant.length=1;
+  memcpy(&far_allele_bytes[plan_header.variants_offset],&far_variant,sizeof(far_variant));
+  rightPlanDamage=rightPlanDamage && !opens_damaged_plan(far_allele_bytes,false);
+  //a cluster reaching behind the end of its contig
+  std::string far_cluster_bytes=plan_bytes;
+  plan_cluster_t far_cluster;
+  memcpy(&far_cluster,far_cluster_bytes.data()+plan_header.clusters_offset,sizeof(far_cluster));
+  far_cluster.right=cohort_sequence.size();
+  memcpy(&far_cluster_bytes[plan_header.clusters_offset],&far_cluster,sizeof(far_cluster));
+  rightPlanDamage=rightPlanDamage && plan_header.n_clusters>0 && !opens_damaged_plan(far_cluster_bytes,false);
+  //a changed header field is caught by the checksum
+  plan_header_t changed_plan_header=plan_header;
+  changed_plan_header.w_size++;
+  std::string changed_plan_bytes=plan_bytes;
+  memcpy(&changed_plan_bytes[0],&changed_plan_header,sizeof(changed_plan_header));
+  rightPlanDamage=rightPlanDamage && opens_damaged_plan(changed_plan_bytes,false) && !opens_damaged_plan(changed_plan_bytes,true);
+  std::remove(damaged_plan_path.c_str());
+  if(rightPlanDamage){
+    cout<<"The variant plan rejected the damaged files!\n";
+  }
+  //export the altered haplotype in chunks and compare it with the bases read one by one
+  dyn::wt_str& haplotype=planIndex.getSequence(0);
+  std::string haplotype_name="chr1";
+  std::string haplotype_path="haplotype.fa";
+  std::string expected_fasta=">"+haplotype_name+"\n";
+  for(uint64_t i=0;i<haplotype.size();i++){
+    expected_fasta+=haplotype.at(i);
+    if(i%60==59 || i+1==haplotype.size()){
+      expected_fasta+="\n";
+    }
+  }
+  HaplotypeExportStatistics export_statistics;
+  bool rightExport=export_haplotype_file(haplotype,haplotype_path,haplotype_name,HAPLOTYPE_FASTA,2,240,60,&export_statistics);
+  export_statistics.printStatistics();
+  std::ifstream exported_fasta(haplotype_path);
+  std::stringstream exported;
+  exported<<exported_fasta.rdbuf();
+  rightExport=rightExport && exported.str()==expected_fasta;
+  int haplotype_fd=open(haplotype_path.c_str(),O_WRONLY|O_TRUNC);
+  rightExport=rightExport && export_haplotype(haplotype,haplotype_fd,haplotype_name,HAPLOTYPE_TWO_BIT,2,64);
+  close(haplotype_fd);
+  std::ifstream exported_bits(haplotype_path,std::ios::binary);
+  std::vector<uint64_t> words((haplotype.size()+31)/32,0);
+  exported_bits.read((char*)words.data(),words.size()*sizeof(uint64_t));
+  rightExport=rightExport && exported_bits.gcount()==(std::streamsize)(words.size()*sizeof(uint64_t)) && exported_bits.peek()==EOF;
+  for(uint64_t i=0;rightExport && i<haplotype.size();i++){
+    rightExport=decode_base(words[i/32]>>(2*(i%32)))==(char)haplotype.at(i);
+  }
+  std::remove(haplotype_path.c_str());
+  if(rightExport){
+    cout<<"The haplotype export delivered the right sequence!\n";
+  }
+  feed.printStatistics();
+  if(rightFeed){
+    cout<<"The change feed followed the minimizer updates!\n";
+  }
   brute_force_minimizer_computation_normal_string(minimizerTreeBF,sequence2,variants3,k,w);
+  dyn::slab_allocator<md::b_tree_tag>::print_stats(cout,"B-tree nodes");
+  dyn::slab_allocator<dyn::spsi_tag>::print_stats(cout,"Dynamic string nodes");
 
   //std::vector<Minimizer> newminimethod=minimizer_to_vector(minimizerTree);
   /*int pos=3;
@@ -14,18 +14,25 @@
 
 #include <fstream>
 #include <forward_list>
+#include <functional>
 
 #include<iostream>
 
 #include <limits>
 
+#include <map>
+
 #include <memory>
 #include <mutex>
 
 #include <random>
 
+#include <sstream>
+
 #include <string>
 
+#include <thread>
+
 #include <time.h>
 #include <tuple>
 
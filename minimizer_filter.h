@@ -0,0 +1,410 @@
+////////////////////////////////////////////////////////////////////////////////
+// minimizer_filter.h
+//   minimizer filter header file.
+//
+//  approximate membership filter over the packed k-mers of the minimizers.
+//  Lookups ask the filter first, so query k-mers missing from the index are
+//  rejected without probing it. The filter supports deletions and follows the
+//  minimizer tree through the changes of a change feed.
+//
+////////////////////////////////////////////////////////////////////////////////
+//  author: Alexander Petri
+
+#ifndef MINIMIZER_FILTER_H
+#define MINIMIZER_FILTER_H
+
+#include "main.h"
+#include "packed_kmers.h"
+#include "change_feed.h"
+#include "B-tree.hh"
+#include "B_tree_node.hh"
+
+using namespace md;
+
+//the number of queries whose buckets are prefetched before they are probed
+#define FILTER_BATCH 16
+//the number of relocations before an entry is put into the stash
+#define FILTER_MAX_KICKS 500
+//counts reaching this value are never decremented again
+#define FILTER_SATURATED 0xFFFF
+
+/*
+* An entry that found no place in the table
+*
+* @param bucket        the smaller of its two buckets
+* @param fingerprint   its fingerprint
+* @param count         the number of occurrences
+*/
+struct filter_stash_t{
+  uint64_t bucket;
+  uint16_t fingerprint;
+  uint16_t count;
+};
+
+/*
+* Counting cuckoo filter over packed k-mers. Every k-mer is hashed to a 16 bit fingerprint and two buckets of four
+* slots; the second bucket is derived from the first and the fingerprint, so entries can be relocated without knowing
+* their k-mer. The four fingerprints of a bucket share one 64 bit word and are compared in one step with SWAR
+* arithmetic, a lookup reads at most two words. Every slot counts the occurrences of its k-mer, so a k-mer stays in
+* the filter until its last minimizer is deleted. Entries that cannot be placed go into a small stash, inserts
+* therefore never fail. The filter has no false negatives, the false positive rate is about 8*load/2^16.
+*
+* @param fingerprints   one word per bucket holding four 16 bit fingerprints, 0 marks an empty slot
+* @param counts         the counts of the slots, four per bucket
+* @param stash          the entries that found no place in the table
+* @param mask           the number of buckets - 1
+* @param entries        the number of distinct entries (k-mers up to fingerprint collisions)
+* @param occurrences    the number of counted occurrences
+* @param random         state of the generator choosing the relocated entries
+*/
+class MinimizerFilter{
+private:
+  std::vector<uint64_t> fingerprints;
+  std::vector<uint16_t> counts;
+  std::vector<filter_stash_t> stash;
+  uint64_t mask;
+  uint64_t entries=0;
+  uint64_t occurrences=0;
+  uint64_t random=0x2545F4914F6CDD1DULL;
+  int k_size;
+
+  static uint64_t mix(uint64_t x){
+    x+=0x9E3779B97F4A7C15ULL;
+    x=(x^(x>>30))*0xBF58476D1CE4E5B9ULL;
+    x=(x^(x>>27))*0x94D049BB133111EBULL;
+    return x^(x>>31);
+  }
+  /*
+  * returns a nonzero bit in the lane of every slot of word equal to fingerprint (exact for the lowest such lane)
+  */
+  static uint64_t matches(uint64_t word,uint16_t fingerprint){
+    uint64_t x=word^(fingerprint*0x0001000100010001ULL);
+    return (x-0x0001000100010001ULL)&~x&0x8000800080008000ULL;
+  }
+  void locate(uint64_t kmer,uint64_t& bucket,uint16_t& fingerprint) const{
+    uint64_t hash=mix(kmer);
+    bucket=hash&mask;
+    fingerprint=hash>>48;
+    if(fingerprint==0){
+      fingerprint=1;
+    }
+  }
+  uint64_t alternate(uint64_t bucket,uint16_t fingerprint) const{
+    return (bucket^mix(fingerprint))&mask;
+  }
+  uint16_t getFingerprint(uint64_t bucket,int slot) const{
+    return fingerprints[bucket]>>(16*slot);
+  }
+  void setSlot(uint64_t bucket,int slot,uint16_t fingerprint,uint16_t count){
+    fingerprints[bucket]=(fingerprints[bucket]&~(uint64_t(0xFFFF)<<(16*slot)))|(uint64_t(fingerprint)<<(16*slot));
+    counts[4*bucket+slot]=count;
+  }
+  /*
+  * returns the slot of fingerprint in bucket or -1
+  */
+  int findSlot(uint64_t bucket,uint16_t fingerprint) const{
+    if(!matches(fingerprints[bucket],fingerprint)){
+      return -1;
+    }
+    for(int slot=0;slot<4;slot++){
+      if(getFingerprint(bucket,slot)==fingerprint){
+        return slot;
+      }
+    }
+    return -1;
+  }
+  /*
+  * returns the index of the stash entry of fingerprint in the buckets b1 and b2 or -1
+  */
+  int findStash(uint64_t b1,uint64_t b2,uint16_t fingerprint) const{
+    uint64_t bucket=std::min(b1,b2);
+    for(int i=0;i<(int)stash.size();i++){
+      if(stash[i].bucket==bucket && stash[i].fingerprint==fingerprint){
+        return i;
+      }
+    }
+    return -1;
+  }
+  /*
+  * puts an entry into an empty slot of bucket, returns false if the bucket is full
+  */
+  bool place(uint64_t bucket,uint16_t fingerprint,uint16_t count){
+    int slot=findSlot(bucket,0);
+    if(slot<0){
+      return false;
+    }
+    setSlot(bucket,slot,fingerprint,count);
+    return true;
+  }
+  int nextSlot(){
+    random^=random<<13;
+    random^=random>>7;
+    random^=random<<17;
+    return random&3;
+  }
+  /*
+  * moves stash entries of bucket into its slots freed by a deletion
+  */
+  void drainStash(uint64_t bucket){
+    for(int i=0;i<(int)stash.size();i++){
+      filter_stash_t entry=stash[i];
+      if((entry.bucket==bucket || alternate(entry.bucket,entry.fingerprint)==bucket) && place(bucket,entry.fingerprint,entry.count)){
+        stash[i]=stash.back();
+        stash.pop_back();
+        return;
+      }
+    }
+  }
+
+public:
+  /*!
+   * @param k:                length of the k-mers
+   * @param expected_kmers:   the number of distinct k-mers the table is sized for (at a load of 90%)
+   */
+  MinimizerFilter(int k,uint64_t expected_kmers=(uint64_t)1<<20){
+    assert(k>0 && k<=32);
+    k_size=k;
+    reset(expected_kmers);
+  }
+
+  /*
+  * empties the filter and sizes it for expected_kmers distinct k-mers
+  */
+  void reset(uint64_t expected_kmers){
+    uint64_t buckets=1;
+    while(buckets*4*9<expected_kmers*10){
+      buckets*=2;
+    }
+    fingerprints.assign(buckets,0);
+    counts.assign(4*buckets,0);
+    stash.clear();
+    mask=buckets-1;
+    entries=0;
+    occurrences=0;
+  }
+
+  /*
+  * counts one more occurrence of kmer
+  */
+  void add(uint64_t kmer){
+    uint64_t b1;
+    uint16_t fingerprint;
+    locate(kmer,b1,fingerprint);
+    uint64_t b2=alternate(b1,fingerprint);
+    occurrences++;
+    uint64_t buckets[2]={b1,b2};
+    for(int b=0;b<2;b++){
+      int slot=findSlot(buckets[b],fingerprint);
+      if(slot>=0){
+        uint16_t& count=counts[4*buckets[b]+slot];
+        count+=count<FILTER_SATURATED;
+        return;
+      }
+    }
+    int in_stash=stash.empty() ? -1 : findStash(b1,b2,fingerprint);
+    if(in_stash>=0){
+      stash[in_stash].count+=stash[in_stash].count<FILTER_SATURATED;
+      return;
+    }
+    entries++;
+    if(place(b1,fingerprint,1) || place(b2,fingerprint,1)){
+      return;
+    }
+    //relocate random entries until one finds an empty slot in its other bucket
+    uint64_t bucket=(random&1) ? b1 : b2;
+    uint16_t count=1;
+    for(int kick=0;kick<FILTER_MAX_KICKS;kick++){
+      int slot=nextSlot();
+      uint16_t victim=getFingerprint(bucket,slot);
+      uint16_t victim_count=counts[4*bucket+slot];
+      setSlot(bucket,slot,fingerprint,count);
+      fingerprint=victim;
+      count=victim_count;
+      bucket=alternate(bucket,fingerprint);
+      if(place(bucket,fingerprint,count)){
+        return;
+      }
+    }
+    filter_stash_t entry;
+    entry.bucket=std::min(bucket,alternate(bucket,fingerprint));
+    entry.fingerprint=fingerprint;
+    entry.count=count;
+    stash.push_back(entry);
+  }
+  /*
+  * removes one occurrence of kmer, returns false if the filter holds no k-mer with its fingerprint
+  */
+  bool remove(uint64_t kmer){
+    uint64_t b1;
+    uint16_t fingerprint;
+    locate(kmer,b1,fingerprint);
+    uint64_t b2=alternate(b1,fingerprint);
+    uint64_t buckets[2]={b1,b2};
+    for(int b=0;b<2;b++){
+      int slot=findSlot(buckets[b],fingerprint);
+      if(slot>=0){
+        occurrences--;
+        uint16_t& count=counts[4*buckets[b]+slot];
+        if(count==FILTER_SATURATED){
+          return true;
+        }
+        if(--count==0){
+          setSlot(buckets[b],slot,0,0);
+          entries--;
+          if(!stash.empty()){
+            drainStash(buckets[b]);
+          }
+        }
+        return true;
+      }
+    }
+    int in_stash=stash.empty() ? -1 : findStash(b1,b2,fingerprint);
+    if(in_stash<0){
+      return false;
+    }
+    occurrences--;
+    if(stash[in_stash].count!=FILTER_SATURATED && --stash[in_stash].count==0){
+      stash[in_stash]=stash.back();
+      stash.pop_back();
+      entries--;
+    }
+    return true;
+  }
+  void add(std::string& sequence){
+    add(pack_kmer(sequence,0,k_size));
+  }
+  bool remove(std::string& sequence){
+    return remove(pack_kmer(sequence,0,k_size));
+  }
+
+  /*
+  * returns false if kmer is certainly not in the filter
+  */
+  bool contains(uint64_t kmer) const{
+    uint64_t b1;
+    uint16_t fingerprint;
+    locate(kmer,b1,fingerprint);
+    uint64_t b2=alternate(b1,fingerprint);
+    if(matches(fingerprints[b1],fingerprint) || matches(fingerprints[b2],fingerprint)){
+      return true;
+    }
+    return !stash.empty() && findStash(b1,b2,fingerprint)>=0;
+  }
+  bool contains(std::string& sequence) const{
+    return contains(pack_kmer(sequence,0,k_size));
+  }
+  /*!
+   * Answers contains for n k-mers. The buckets of a group of FILTER_BATCH queries are prefetched before the group is
+   * probed, so the cache misses of the group overlap instead of being paid one after the other.
+   * @param kmers:      the packed k-mers
+   * @param n:          the number of k-mers
+   * @param present:    receives 1 for every k-mer that may be in the filter, 0 otherwise
+   */
+  void containsBatch(const uint64_t* kmers,uint64_t n,uint8_t* present) const{
+    uint64_t b1[FILTER_BATCH];
+    uint64_t b2[FILTER_BATCH];
+    uint16_t fingerprint[FILTER_BATCH];
+    for(uint64_t start=0;start<n;start+=FILTER_BATCH){
+      int group=std::min<uint64_t>(FILTER_BATCH,n-start);
+      for(int i=0;i<group;i++){
+        locate(kmers[start+i],b1[i],fingerprint[i]);
+        b2[i]=alternate(b1[i],fingerprint[i]);
+#if defined(__GNUC__)
+        __builtin_prefetch(&fingerprints[b1[i]]);
+        __builtin_prefetch(&fingerprints[b2[i]]);
+#endif
+      }
+      for(int i=0;i<group;i++){
+        present[start+i]=(matches(fingerprints[b1[i]],fingerprint[i])|matches(fingerprints[b2[i]],fingerprint[i]))!=0;
+      }
+      if(!stash.empty()){
+        for(int i=0;i<group;i++){
+          present[start+i]|=findStash(b1[i],b2[i],fingerprint[i])>=0;
+        }
+      }
+    }
+  }
+
+  /*!
+   * Adds the minimizers stored in a B-tree, e.g. the minimizers of the reference before any variant is applied
+   * @param minimizerTree:    the B-tree holding the minimizers
+   */
+  template<class Pos>
+  void addTree(B_tree<Pos,std::string,7,3>* minimizerTree){
+    if(minimizerTree->is_empty()){
+      return;
+    }
+    for(auto elem: *minimizerTree){
+      for(int i=0;i<(int)elem.second.size();i++){
+        add(elem.second[i]);
+      }
+    }
+  }
+  /*!
+   * Empties the filter, sizes it for the minimizers of a B-tree and adds them, e.g. once needsRebuild reports an
+   * overfull table
+   * @param minimizerTree:    the B-tree holding the minimizers
+   */
+  template<class Pos>
+  void rebuild(B_tree<Pos,std::string,7,3>* minimizerTree){
+    reset(std::max<uint64_t>(2*entries,minimizerTree->size()));
+    addTree(minimizerTree);
+  }
+  /*!
+   * Applies one change of a change feed, so the filter follows the minimizer tree the feed belongs to:
+   * ChangeFeed feed([&](const MinimizerChange& change){ filter.follow(change); });
+   * @param change:   the change, shifts do not concern the filter
+   *
+   * @return false if a deleted k-mer was not in the filter, i.e. the filter does not hold the minimizers of the tree
+   */
+  template<class Pos>
+  bool follow(const BasicMinimizerChange<Pos>& change){
+    std::string kmer=change.kmer;
+    if(change.type==MINIMIZER_INSERTED){
+      add(kmer);
+    }
+    else if(change.type==MINIMIZER_DELETED){
+      return remove(kmer);
+    }
+    return true;
+  }
+
+  /*
+  * returns the fraction of occupied slots
+  */
+  double getLoadFactor() const{
+    return (double)(entries-stash.size())/(4*fingerprints.size());
+  }
+  /*
+  * returns the expected fraction of k-mers not in the filter that are reported as present
+  */
+  double getFalsePositiveRate() const{
+    return 8*getLoadFactor()/65535.0;
+  }
+  /*
+  * returns true if the table is nearly full and lookups start paying for the stash
+  */
+  bool needsRebuild() const{
+    return stash.size()>64 || getLoadFactor()>0.95;
+  }
+  uint64_t getNumberOfEntries() const{
+    return entries;
+  }
+  uint64_t getNumberOfOccurrences() const{
+    return occurrences;
+  }
+  uint64_t getStashSize() const{
+    return stash.size();
+  }
+  uint64_t getBytes() const{
+    return fingerprints.size()*sizeof(uint64_t)+counts.size()*sizeof(uint16_t)+stash.size()*sizeof(filter_stash_t);
+  }
+  /*
+  * prints the size and the load of the filter to the console
+  */
+  void printStatistics() const{
+    cout<<entries<<" k-mers ("<<occurrences<<" occurrences) in "<<fingerprints.size()<<" buckets, load "<<getLoadFactor()<<", "<<stash.size()<<" stashed, "<<getBytes()<<" bytes, false positive rate "<<getFalsePositiveRate()<<"\n";
+  }
+};
+
+#endif
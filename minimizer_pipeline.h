@@ -0,0 +1,390 @@
+////////////////////////////////////////////////////////////////////////////////
+// minimizer_pipeline.h
+//   minimizer pipeline header file.
+//
+//  staged driver applying the variants of a VCF stream to a sequence and its
+//  minimizer tree. A parser thread turns VCF records into batches of variants,
+//  the calling thread applies them to the sequence and the tree, and a writer
+//  thread writes the change log of every batch and the final index, so parsing
+//  and writing overlap with the updates. The stages are connected by bounded
+//  lock-free queues, a full queue stalls the stage in front of it.
+//
+////////////////////////////////////////////////////////////////////////////////
+//  author: Alexander Petri
+
+#ifndef MINIMIZER_PIPELINE_H
+#define MINIMIZER_PIPELINE_H
+
+#include "main.h"
+#include "Variant.h"
+#include "B-tree.hh"
+#include "B_tree_node.hh"
+#include "B_tree_operations.h"
+#include "dynamic_minimizer.h"
+#include "change_feed.h"
+#include "snapshot.h"
+#include "include/dynamic.hpp"
+
+#include <atomic>
+#include <cassert>
+
+typedef std::chrono::high_resolution_clock::time_point pipeline_time_t;
+
+/*
+* Bounded lock-free queue between two pipeline stages (one producer and one consumer thread). push waits while the
+* queue is full and pop waits while it is empty, the time spent waiting is added to the waited counter of the caller.
+*
+* @param slots      the items, the capacity is a power of two
+* @param head       the number of items popped so far (written by the consumer)
+* @param tail       the number of items pushed so far (written by the producer)
+* @param closed     set by the producer after its last item
+*/
+template<class T>
+class PipelineQueue{
+private:
+  std::vector<T> slots;
+  uint64_t mask;
+  std::atomic<uint64_t> head;
+  std::atomic<uint64_t> tail;
+  std::atomic<bool> closed;
+
+public:
+  PipelineQueue(uint64_t capacity){
+    assert(capacity>0 && (capacity&(capacity-1))==0);
+    slots.resize(capacity);
+    mask=capacity-1;
+    head.store(0);
+    tail.store(0);
+    closed.store(false);
+  }
+  void push(T& item,double& waited){
+    uint64_t t=tail.load(std::memory_order_relaxed);
+    if(t-head.load(std::memory_order_acquire)>mask){
+      pipeline_time_t start=std::chrono::high_resolution_clock::now();
+      while(t-head.load(std::memory_order_acquire)>mask){
+        std::this_thread::yield();
+      }
+      waited+=std::chrono::duration<double>(std::chrono::high_resolution_clock::now()-start).count();
+    }
+    slots[t&mask]=std::move(item);
+    tail.store(t+1,std::memory_order_release);
+  }
+  /*
+  * returns false once the queue is closed and empty
+  */
+  bool pop(T& item,double& waited){
+    uint64_t h=head.load(std::memory_order_relaxed);
+    if(h==tail.load(std::memory_order_acquire)){
+      pipeline_time_t start=std::chrono::high_resolution_clock::now();
+      while(h==tail.load(std::memory_order_acquire)){
+        if(closed.load(std::memory_order_acquire) && h==tail.load(std::memory_order_acquire)){
+          waited+=std::chrono::duration<double>(std::chrono::high_resolution_clock::now()-start).count();
+          return false;
+        }
+        std::this_thread::yield();
+      }
+      waited+=std::chrono::duration<double>(std::chrono::high_resolution_clock::now()-start).count();
+    }
+    item=std::move(slots[h&mask]);
+    head.store(h+1,std::memory_order_release);
+    return true;
+  }
+  void close(){
+    closed.store(true,std::memory_order_release);
+  }
+};
+
+/*
+* A batch of variants handed from the parser to the update stage
+*
+* @param number               the number of the batch, starting at 0
+* @param variants             the variants in reference coordinates
+* @param reference_alleles    REF of every variant as it is given in the record
+* @param parsed               the time the batch was complete
+*/
+struct VariantBatch{
+  uint64_t number=0;
+  std::vector<Variant> variants;
+  std::vector<std::string> reference_alleles;
+  pipeline_time_t parsed;
+};
+
+/*
+* The changes of the minimizer tree caused by one batch, handed from the update stage to the writer
+*
+* @param number     the number of the batch
+* @param changes    the changes in the order they were applied
+* @param parsed     the time the variant batch was complete
+*/
+struct ChangeBatch{
+  uint64_t number=0;
+  std::vector<MinimizerChange> changes;
+  pipeline_time_t parsed;
+};
+
+/*
+* Counters of one stage: the items it produced, the time it worked and the time it waited for the neighbouring
+* queues (on an empty input queue or, as backpressure, on a full output queue)
+*/
+struct PipelineStageStatistics{
+  uint64_t items=0;
+  double busy_seconds=0;
+  double wait_seconds=0;
+
+  double getThroughput() const{
+    return busy_seconds+wait_seconds==0 ? 0.0 : items/(busy_seconds+wait_seconds);
+  }
+};
+
+/*
+* Statistics of a run_minimizer_pipeline run. The latency of a batch is the time from the end of its parsing to the
+* end of writing its changes.
+*/
+struct PipelineStatistics{
+  PipelineStageStatistics parser;
+  PipelineStageStatistics updater;
+  PipelineStageStatistics writer;
+  uint64_t records=0;
+  uint64_t variants=0;
+  uint64_t skipped=0;
+  uint64_t reference_mismatch=0;
+  uint64_t changes=0;
+  double mean_latency=0;
+  double max_latency=0;
+  double seconds=0;
+
+  /*
+  * prints the statistics to the console
+  */
+  void printStatistics() const{
+    cout<<records<<" VCF records, "<<variants<<" variants applied, "<<skipped<<" skipped, "<<reference_mismatch<<" REF mismatch, "<<changes<<" changes in "<<seconds<<" s\n";
+    cout<<"parser:  "<<parser.items<<" batches, "<<parser.busy_seconds<<" s busy, "<<parser.wait_seconds<<" s stalled, "<<parser.getThroughput()<<" batches/s\n";
+    cout<<"updater: "<<updater.items<<" batches, "<<updater.busy_seconds<<" s busy, "<<updater.wait_seconds<<" s waiting, "<<updater.getThroughput()<<" batches/s\n";
+    cout<<"writer:  "<<writer.items<<" batches, "<<writer.busy_seconds<<" s busy, "<<writer.wait_seconds<<" s waiting, "<<writer.getThroughput()<<" batches/s\n";
+    cout<<"batch latency: mean "<<mean_latency<<" s, max "<<max_latency<<" s\n";
+  }
+};
+
+/*
+* Turns a VCF data line into a variant. Only the first ALT allele is used, the bases REF and ALT share at their start
+* are removed, so the variant replaces the differing bases only. Returns false for header lines, other chromosomes
+* (unless chromosome is empty), symbolic or missing alleles and records leaving REF unchanged.
+*
+* @param line         the VCF line (CHROM POS ID REF ALT ...), POS is 1-based
+* @param chromosome   the chromosome of the sequence, empty to accept every record
+* @param variant      receives the variant in 0-based coordinates
+* @param contig       (optional) receives the CHROM field of the record
+* @param alleles      (optional) receives REF and the first ALT allele as they are given in the record
+*/
+bool parse_vcf_variant(std::string& line,std::string& chromosome,Variant& variant,std::string* contig=nullptr,std::pair<std::string,std::string>* alleles=nullptr){
+  if(line.empty() || line[0]=='#'){
+    return false;
+  }
+  std::string fields[5];
+  uint64_t start=0;
+  for(int i=0;i<5;i++){
+    uint64_t end=line.find('\t',start);
+    if(end==std::string::npos){
+      if(i<4){
+        return false;
+      }
+      end=line.size();
+    }
+    fields[i]=line.substr(start,end-start);
+    start=end+1;
+  }
+  if(!chromosome.empty() && fields[0]!=chromosome){
+    return false;
+  }
+  std::string reference=fields[3];
+  std::string alternative=fields[4].substr(0,fields[4].find(','));
+  if(alternative.empty() || alternative[0]=='<' || alternative=="*" || alternative=="." || alternative.find('[')!=std::string::npos || alternative.find(']')!=std::string::npos){
+    return false;
+  }
+  int pos=atoi(fields[1].c_str())-1;
+  int common=0;
+  while(common<(int)reference.size() && common<(int)alternative.size() && reference[common]==alternative[common]){
+    common++;
+  }
+  pos+=common;
+  int originalseqlen=reference.size()-common;
+  std::string sequence=alternative.substr(common);
+  int length=sequence.size();
+  if(originalseqlen==0 && length==0){
+    return false;
+  }
+  variant=Variant(pos,originalseqlen,length,sequence);
+  if(contig!=nullptr){
+    *contig=fields[0];
+  }
+  if(alleles!=nullptr){
+    *alleles=std::make_pair(reference,alternative);
+  }
+  return true;
+}
+
+/*!
+ * Checks REF of a VCF record against the sequence the variant is applied to.
+ * @param dynamic_sequence: the sequence
+ * @param variant:          the variant of the record, its position moved into the coordinates of the sequence
+ * @param reference_allele: REF as it is given in the record, it ends with the last base the variant replaces
+ *
+ * @return true if the sequence holds REF at the position of the record
+ */
+bool reference_allele_matches(dyn::wt_str& dynamic_sequence,Variant& variant,std::string& reference_allele){
+  int64_t start=(int64_t)variant.getVariantPosition()+variant.getVariantOriginalSeqLen()-(int64_t)reference_allele.size();
+  if(start<0 || start+(int64_t)reference_allele.size()>(int64_t)dynamic_sequence.size()){
+    return false;
+  }
+  for(uint64_t i=0;i<reference_allele.size();i++){
+    if((char)dynamic_sequence.at(start+i)!=reference_allele[i]){
+      return false;
+    }
+  }
+  return true;
+}
+
+/*!
+ * Applies the variants of a VCF stream to the sequence and its minimizer tree in three stages: a parser thread
+ * reading the stream into batches of batch_size variants, the update stage on the calling thread applying every
+ * batch with compute_dynamic_minimizers, and a writer thread writing the changes of every batch to the change log
+ * (one line per change: D position kmer, I position kmer or S position delta, positions as in the ChangeFeed) and
+ * finally the index of the altered sequence as a snapshot. The VCF has to be sorted by position; records
+ * overlapping or touching the previous one, starting at position 0 or reaching beyond the sequence are skipped.
+ * The update stage checks REF of every record against the sequence before it applies the batch (the parser must not
+ * read the sequence while it is updated) and skips records whose REF does not match, as build_variant_plan does.
+ * Compressed VCFs have to be decompressed in front of the stream (e.g. by reading from zcat).
+ * @param vcf:              the VCF stream
+ * @param minimizerTree:    B-tree holding the minimizers of the reference
+ * @param dynamic_sequence: the reference sequence
+ * @param k_size:           length of the k-mers
+ * @param w_size:           window size for the minimizer generations
+ * @param changelog:        stream receiving the changes
+ * @param index_path:       (optional) path of the snapshot written after the last batch
+ * @param batch_size:       the number of variants per batch
+ * @param queue_capacity:   the number of batches each queue can hold (a power of two)
+ * @param chromosome:       (optional) the chromosome of the sequence, records of other chromosomes are ignored
+ */
+PipelineStatistics run_minimizer_pipeline(std::istream& vcf,B_tree<int,std::string,7,3>* minimizerTree,dyn::wt_str& dynamic_sequence,int& k_size,int& w_size,std::ostream& changelog,std::string index_path="",int batch_size=256,uint64_t queue_capacity=16,std::string chromosome=""){
+  PipelineStatistics statistics;
+  PipelineQueue<VariantBatch> parsed(queue_capacity);
+  PipelineQueue<ChangeBatch> updated(queue_capacity);
+  uint64_t reference_length=dynamic_sequence.size();
+  pipeline_time_t start=std::chrono::high_resolution_clock::now();
+
+  std::thread parser([&](){
+    PipelineStageStatistics& stage=statistics.parser;
+    pipeline_time_t busy_start=std::chrono::high_resolution_clock::now();
+    std::string line;
+    int zero=0;
+    Variant variant(zero,zero,zero,line);
+    std::pair<std::string,std::string> alleles;
+    VariantBatch batch;
+    int previous_end=0;
+    auto flush=[&](){
+      batch.number=stage.items++;
+      batch.parsed=std::chrono::high_resolution_clock::now();
+      stage.busy_seconds+=std::chrono::duration<double>(batch.parsed-busy_start).count();
+      parsed.push(batch,stage.wait_seconds);
+      batch=VariantBatch();
+      busy_start=std::chrono::high_resolution_clock::now();
+    };
+    while(std::getline(vcf,line)){
+      if(!parse_vcf_variant(line,chromosome,variant,nullptr,&alleles)){
+        continue;
+      }
+      statistics.records++;
+      int end=variant.getVariantPosition()+variant.getVariantOriginalSeqLen();
+      if(variant.getVariantPosition()<=previous_end || end>(int64_t)reference_length){
+        statistics.skipped++;
+        continue;
+      }
+      previous_end=end;
+      batch.variants.push_back(variant);
+      batch.reference_alleles.push_back(alleles.first);
+      if((int)batch.variants.size()==batch_size){
+        flush();
+      }
+    }
+    if(!batch.variants.empty()){
+      flush();
+    }
+    stage.busy_seconds+=std::chrono::duration<double>(std::chrono::high_resolution_clock::now()-busy_start).count();
+    parsed.close();
+  });
+
+  std::thread writer([&](){
+    PipelineStageStatistics& stage=statistics.writer;
+    ChangeBatch batch;
+    double latency=0;
+    while(updated.pop(batch,stage.wait_seconds)){
+      pipeline_time_t busy_start=std::chrono::high_resolution_clock::now();
+      for(int i=0;i<(int)batch.changes.size();i++){
+        MinimizerChange& change=batch.changes[i];
+        if(change.type==MINIMIZERS_SHIFTED){
+          changelog<<"S\t"<<change.position<<"\t"<<change.delta<<"\n";
+        }
+        else{
+          changelog<<(change.type==MINIMIZER_DELETED ? "D\t" : "I\t")<<change.position<<"\t"<<change.kmer<<"\n";
+        }
+      }
+      statistics.changes+=batch.changes.size();
+      stage.items++;
+      pipeline_time_t written=std::chrono::high_resolution_clock::now();
+      double batch_latency=std::chrono::duration<double>(written-batch.parsed).count();
+      latency+=batch_latency;
+      statistics.max_latency=std::max(statistics.max_latency,batch_latency);
+      stage.busy_seconds+=std::chrono::duration<double>(written-busy_start).count();
+    }
+    changelog.flush();
+    //the update stage has finished, the tree and the sequence are not altered any more
+    if(!index_path.empty()){
+      pipeline_time_t busy_start=std::chrono::high_resolution_clock::now();
+      write_minimizer_snapshot(index_path,minimizerTree,dynamic_sequence,k_size,w_size);
+      stage.busy_seconds+=std::chrono::duration<double>(std::chrono::high_resolution_clock::now()-busy_start).count();
+    }
+    statistics.mean_latency=stage.items==0 ? 0.0 : latency/stage.items;
+  });
+
+  //the update stage: the positions of a batch are moved by the length changes of the previous batches
+  PipelineStageStatistics& stage=statistics.updater;
+  VariantBatch batch;
+  ChangeBatch changes;
+  ChangeFeed feed([&](const MinimizerChange& change){
+    changes.changes.push_back(change);
+  });
+  Variant::delta_t shift=0;
+  while(parsed.pop(batch,stage.wait_seconds)){
+    pipeline_time_t busy_start=std::chrono::high_resolution_clock::now();
+    Variant::delta_t batch_shift=0;
+    std::vector<Variant> matching;
+    for(int i=0;i<(int)batch.variants.size();i++){
+      batch.variants[i].updateVariantPosition(shift);
+      //the variants of the batch are not applied yet, so REF is compared with the bases of the previous batches
+      if(!reference_allele_matches(dynamic_sequence,batch.variants[i],batch.reference_alleles[i])){
+        statistics.reference_mismatch++;
+        continue;
+      }
+      batch_shift+=batch.variants[i].getVariantLength()-batch.variants[i].getVariantOriginalSeqLen();
+      matching.push_back(batch.variants[i]);
+    }
+    batch.variants.swap(matching);
+    compute_dynamic_minimizers(minimizerTree,dynamic_sequence,batch.variants,k_size,w_size,UpdateObservers().withFeed(&feed));
+    shift+=batch_shift;
+    statistics.variants+=batch.variants.size();
+    changes.number=batch.number;
+    changes.parsed=batch.parsed;
+    stage.items++;
+    stage.busy_seconds+=std::chrono::duration<double>(std::chrono::high_resolution_clock::now()-busy_start).count();
+    updated.push(changes,stage.wait_seconds);
+    changes=ChangeBatch();
+  }
+  updated.close();
+
+  parser.join();
+  writer.join();
+  statistics.seconds=std::chrono::duration<double>(std::chrono::high_resolution_clock::now()-start).count();
+  return statistics;
+}
+
+#endif
@@ -0,0 +1,444 @@
+////////////////////////////////////////////////////////////////////////////////
+// minimizer_stream.h
+//   minimizer stream header file.
+//
+// Pull-based minimizer generation. A MinimizerGenerator yields the minimizers
+// of a character buffer, a memory-mapped file or a range of a dynamic sequence
+// one at a time as (position, packed k-mer, hash) without allocating, and can be
+// reset to the next read. stream_fastq_minimizers drives one generator per
+// thread over the reads of a FASTQ file.
+//
+////////////////////////////////////////////////////////////////////////////////
+//  author: Alexander Petri
+
+#ifndef MINIMIZER_STREAM_H
+#define MINIMIZER_STREAM_H
+
+#include "main.h"
+#include "packed_kmers.h"
+#include "include/dynamic.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+* A minimizer produced by a MinimizerGenerator
+*
+* @param pos    the position of the k-mer (including the position shift of the source)
+* @param kmer   the 2-bit packed k-mer
+* @param hash   hash_kmer of the packed k-mer, independent of the ordering used to choose the minimizer
+*/
+struct StreamedMinimizer{
+  uint64_t pos;
+  uint64_t kmer;
+  uint64_t hash;
+};
+
+/*
+* Source of the bases of a character buffer (a std::string, a read of a batch or a memory-mapped file).
+* The buffer is not copied and has to outlive the source.
+*/
+class BufferSource{
+private:
+  const char* data;
+  uint64_t length;
+
+public:
+  BufferSource() : data(nullptr),length(0){}
+  BufferSource(const char* data,uint64_t length) : data(data),length(length){}
+  BufferSource(const std::string& sequence) : data(sequence.data()),length(sequence.size()){}
+
+  uint64_t size() const{
+    return length;
+  }
+  char at(uint64_t i) const{
+    return data[i];
+  }
+};
+
+/*
+* Source of the bases left ... right (inclusive) of a dynamic sequence
+*/
+class DynamicSequenceSource{
+private:
+  dyn::wt_str* sequence;
+  uint64_t left;
+  uint64_t length;
+
+public:
+  DynamicSequenceSource() : sequence(nullptr),left(0),length(0){}
+  DynamicSequenceSource(dyn::wt_str& sequence,uint64_t left,uint64_t right) : sequence(&sequence),left(left),length(right+1-left){
+    assert(right<sequence.size());
+  }
+
+  uint64_t size() const{
+    return length;
+  }
+  char at(uint64_t i) const{
+    return sequence->at(left+i);
+  }
+};
+
+/*
+* Read-only memory mapping of a whole file, the mapping is released by the destructor
+*/
+class MappedFile{
+private:
+  char* mapped=nullptr;
+  uint64_t length=0;
+
+public:
+  MappedFile(){}
+  ~MappedFile(){
+    close();
+  }
+  MappedFile(const MappedFile&)=delete;
+  MappedFile& operator=(const MappedFile&)=delete;
+
+  /*
+  * maps the file at path, returns false if it cannot be opened
+  */
+  bool open(std::string& path){
+    close();
+    int fd=::open(path.c_str(),O_RDONLY);
+    if(fd<0){
+      cout<<"Cannot open "<<path<<"\n";
+      return false;
+    }
+    struct stat st;
+    if(fstat(fd,&st)!=0){
+      ::close(fd);
+      return false;
+    }
+    length=st.st_size;
+    if(length>0){
+      void* m=mmap(nullptr,length,PROT_READ,MAP_PRIVATE,fd,0);
+      if(m==MAP_FAILED){
+        ::close(fd);
+        length=0;
+        return false;
+      }
+      mapped=static_cast<char*>(m);
+    }
+    ::close(fd);
+    return true;
+  }
+  void close(){
+    if(mapped!=nullptr){
+      munmap(mapped,length);
+    }
+    mapped=nullptr;
+    length=0;
+  }
+  /*
+  * returns a source over the bytes [offset, offset+count) of the file
+  */
+  BufferSource getSource(uint64_t offset,uint64_t count){
+    assert(offset+count<=length);
+    return BufferSource(mapped+offset,count);
+  }
+  const char* data(){
+    return mapped;
+  }
+  uint64_t size(){
+    return length;
+  }
+};
+
+/*
+* Pull-based generator of the minimizers of a source. It reports the same minimizers as get_packed_kmer_minimizers
+* (and therefore as get_kmer_minimizers for LEXICOGRAPHIC ordering): the leftmost smallest k-mer of every window,
+* consecutive windows sharing a minimizer report it once, and a source shorter than a window reports the smallest
+* of its k-mers. Characters other than ACGT are treated as A, like encode_base does.
+*
+* The monotone queue of the window is a ring buffer of w_size-k_size+2 entries allocated by the constructor, so
+* next() and reset() never allocate and one generator can be reused for all reads of a thread.
+*
+* @param source     the bases the minimizers are generated from
+* @param posshift   the position of the first base of the source
+* @param cursor     the index of the next base to be read from the source
+* @param kmer       the packed k-mer ending at the last read base
+* @param queue_*    ring buffer of (rank, k-mer index, packed k-mer) with increasing ranks
+* @param last_pos   the k-mer index of the last reported minimizer, -1 if none was reported yet
+*/
+template<class Source>
+class MinimizerGenerator{
+private:
+  int k_size;
+  int w_size;
+  int w;
+  KmerOrdering ordering;
+  uint64_t mask;
+
+  Source source;
+  uint64_t posshift=0;
+  uint64_t cursor=0;
+  uint64_t kmer=0;
+  int64_t n_kmers=0;
+  int64_t last_pos=-1;
+  bool finished=false;
+
+  std::vector<uint64_t> queue_rank;
+  std::vector<int64_t> queue_pos;
+  std::vector<uint64_t> queue_kmer;
+  int capacity;
+  int queue_head=0;
+  int queue_size=0;
+
+  int slot(int i){
+    int s=queue_head+i;
+    return s>=capacity ? s-capacity : s;
+  }
+  void report(StreamedMinimizer& result){
+    int front=queue_head;
+    last_pos=queue_pos[front];
+    result.pos=posshift+last_pos;
+    result.kmer=queue_kmer[front];
+    result.hash=(ordering==HASHED) ? queue_rank[front] : hash_kmer(result.kmer,mask);
+  }
+
+public:
+  /*!
+   * @param k:          length of the k-mers
+   * @param window:     window size (length of the subsequence in which window-k+1 k-mers are present)
+   * @param order:      the order in which the k-mers are compared
+   */
+  MinimizerGenerator(int k,int window,KmerOrdering order=LEXICOGRAPHIC){
+    assert(k>0 && k<=32 && window>=k);
+    k_size=k;
+    w_size=window;
+    w=w_size-k_size+1;
+    ordering=order;
+    mask=kmer_mask(k_size);
+    //k-mers of equal rank stay in the queue, so it holds up to w k-mers of the window and the new one
+    capacity=w+1;
+    queue_rank.resize(capacity);
+    queue_pos.resize(capacity);
+    queue_kmer.resize(capacity);
+  }
+
+  /*!
+   * Starts generating the minimizers of a new source
+   * @param src:        the source
+   * @param shift:      the position of the first base of the source
+   */
+  void reset(const Source& src,uint64_t shift=0){
+    source=src;
+    posshift=shift;
+    cursor=0;
+    kmer=0;
+    n_kmers=0;
+    last_pos=-1;
+    finished=false;
+    queue_head=0;
+    queue_size=0;
+  }
+
+  /*!
+   * Generates the next minimizer, returns false if all minimizers of the source were reported
+   * @param result:     the next minimizer
+   */
+  bool next(StreamedMinimizer& result){
+    while(cursor<source.size()){
+      kmer=((kmer<<2)|encode_base(source.at(cursor)))&mask;
+      cursor++;
+      if(cursor<(uint64_t)k_size){
+        continue;
+      }
+      int64_t i=n_kmers++;
+      uint64_t rank=kmer_rank(kmer,mask,ordering);
+      //only strictly greater k-mers are dropped, so that the leftmost minimum stays at the front
+      while(queue_size>0 && queue_rank[slot(queue_size-1)]>rank){
+        queue_size--;
+      }
+      int back=slot(queue_size);
+      queue_rank[back]=rank;
+      queue_pos[back]=i;
+      queue_kmer[back]=kmer;
+      queue_size++;
+      if(queue_pos[queue_head]<=i-w){
+        queue_head=slot(1);
+        queue_size--;
+      }
+      if(i>=w-1 && queue_pos[queue_head]!=last_pos){
+        report(result);
+        return true;
+      }
+    }
+    //the source is shorter than a window: report the minimum of all k-mers
+    if(!finished && last_pos<0 && queue_size>0){
+      finished=true;
+      report(result);
+      return true;
+    }
+    finished=true;
+    return false;
+  }
+
+  /*
+  * input iterator over the remaining minimizers of the source, so a generator can be used in a range-based for loop
+  */
+  class iterator{
+  private:
+    MinimizerGenerator* generator;
+    StreamedMinimizer current;
+
+  public:
+    iterator(MinimizerGenerator* g) : generator(g){
+      if(generator!=nullptr && !generator->next(current)){
+        generator=nullptr;
+      }
+    }
+    const StreamedMinimizer& operator*() const{
+      return current;
+    }
+    iterator& operator++(){
+      if(!generator->next(current)){
+        generator=nullptr;
+      }
+      return *this;
+    }
+    bool operator!=(const iterator& rhs) const{
+      return generator!=rhs.generator;
+    }
+  };
+  iterator begin(){
+    return iterator(this);
+  }
+  iterator end(){
+    return iterator(nullptr);
+  }
+};
+
+/*
+* Batch of reads stored back to back in one buffer, read i occupies bases[offsets[i]] ... bases[offsets[i+1]-1].
+* The buffers keep their capacity, so a batch reused by one thread stops allocating once it has grown.
+*
+* @param bases          the sequences of all reads of the batch
+* @param offsets        the start of every read in bases
+* @param first_read     the index of the first read of the batch in the file
+*/
+struct ReadBatch{
+  std::string bases;
+  std::vector<uint64_t> offsets;
+  uint64_t first_read=0;
+
+  void clear(){
+    bases.clear();
+    offsets.clear();
+    offsets.push_back(0);
+  }
+  int size() const{
+    return offsets.empty() ? 0 : offsets.size()-1;
+  }
+  BufferSource getRead(int i) const{
+    return BufferSource(bases.data()+offsets[i],offsets[i+1]-offsets[i]);
+  }
+};
+
+/*
+* reads up to max_reads FASTQ records into batch, returns the number of reads. line is a reusable buffer.
+*/
+int read_fastq_batch(std::istream& in,ReadBatch& batch,int max_reads,std::string& line){
+  batch.clear();
+  while(batch.size()<max_reads && std::getline(in,line)){
+    if(line.empty() || line[0]!='@'){
+      continue;
+    }
+    if(!std::getline(in,line)){
+      break;
+    }
+    batch.bases.append(line);
+    batch.offsets.push_back(batch.bases.size());
+    //skip the separator and the quality line
+    if(!std::getline(in,line) || !std::getline(in,line)){
+      break;
+    }
+  }
+  return batch.size();
+}
+
+/*
+* Statistics of a stream_fastq_minimizers run
+*/
+struct StreamStatistics{
+  uint64_t reads=0;
+  uint64_t bases=0;
+  uint64_t minimizers=0;
+  double seconds=0;
+};
+
+/*!
+ * Generates the minimizers of all reads of a FASTQ stream with several threads. Every thread owns a read batch,
+ * a line buffer and a generator, takes the next batch of reads from the stream under a lock and reports the
+ * minimizers of its reads to consumer(thread, read_index, minimizer). Positions are relative to the read.
+ * The consumer is called concurrently by different threads, but never concurrently with the same thread index.
+ * @param in:           the FASTQ stream
+ * @param k_size:       length of the k-mers
+ * @param w_size:       window size
+ * @param threads:      the number of threads
+ * @param consumer:     callable receiving the minimizers
+ * @param batch_size:   the number of reads a thread takes from the stream at once
+ * @param ordering:     the order in which the k-mers are compared
+ */
+template<class Consumer>
+StreamStatistics stream_fastq_minimizers(std::istream& in,int k_size,int w_size,int threads,Consumer& consumer,int batch_size=4096,KmerOrdering ordering=LEXICOGRAPHIC){
+  StreamStatistics statistics;
+  std::mutex input_lock;
+  std::atomic<uint64_t> reads(0);
+  std::atomic<uint64_t> bases(0);
+  std::atomic<uint64_t> minimizers(0);
+  uint64_t next_read=0;
+  auto start=std::chrono::high_resolution_clock::now();
+  auto worker=[&](int thread){
+    ReadBatch batch;
+    std::string line;
+    MinimizerGenerator<BufferSource> generator(k_size,w_size,ordering);
+    StreamedMinimizer minimizer;
+    uint64_t thread_reads=0;
+    uint64_t thread_bases=0;
+    uint64_t thread_minimizers=0;
+    while(true){
+      {
+        std::lock_guard<std::mutex> guard(input_lock);
+        if(read_fastq_batch(in,batch,batch_size,line)==0){
+          break;
+        }
+        batch.first_read=next_read;
+        next_read+=batch.size();
+      }
+      for(int i=0;i<batch.size();i++){
+        generator.reset(batch.getRead(i));
+        while(generator.next(minimizer)){
+          consumer(thread,batch.first_read+i,minimizer);
+          thread_minimizers++;
+        }
+      }
+      thread_reads+=batch.size();
+      thread_bases+=batch.bases.size();
+    }
+    reads+=thread_reads;
+    bases+=thread_bases;
+    minimizers+=thread_minimizers;
+  };
+  threads=std::max(1,threads);
+  std::vector<std::thread> workers;
+  for(int t=1;t<threads;t++){
+    workers.push_back(std::thread(worker,t));
+  }
+  worker(0);
+  for(int t=0;t<(int)workers.size();t++){
+    workers[t].join();
+  }
+  statistics.reads=reads;
+  statistics.bases=bases;
+  statistics.minimizers=minimizers;
+  statistics.seconds=std::chrono::duration<double>(std::chrono::high_resolution_clock::now()-start).count();
+  return statistics;
+}
+
+#endif
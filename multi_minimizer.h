@@ -0,0 +1,139 @@
+////////////////////////////////////////////////////////////////////////////////
+// multi_minimizer.h
+//   Algorithm header file.
+//
+// Maintains the minimizers of several (k,w,ordering) schemes at once. The sequence is only updated
+// once per variant and every variation-impact-range is only extracted and packed once.
+//
+////////////////////////////////////////////////////////////////////////////////
+// author: Alexander Petri
+
+#ifndef MULTI_MINIMIZER_H
+#define MULTI_MINIMIZER_H
+
+#include "main.h"
+#include "Variant.h"
+#include "packed_kmers.h"
+#include "B-tree.hh"
+#include "B_tree_node.hh"
+#include "B_tree_operations.h"
+#include "dynamic_minimizer.h"
+#include "include/dynamic.hpp"
+
+/*
+* Class to define a minimizer scheme
+*
+* @param k_size      the length of the k-mers
+* @param w_size      the window size (length of the subsequence in which w kmers are present)
+* @param ordering    the order in which the k-mers are compared
+*
+*/
+class MinimizerScheme{
+private:
+  int k_size;
+  int w_size;
+  KmerOrdering ordering;
+public:
+  // Constructor
+  MinimizerScheme(int k, int w, KmerOrdering order=LEXICOGRAPHIC){
+    assert(k>0 && k<=32 && w>k);
+    k_size=k;
+    w_size=w;
+    ordering=order;
+  }
+  /*
+  *returns the length of the k-mers
+  */
+  int getK(){
+    return k_size;
+  }
+  /*
+  *returns the window size
+  */
+  int getW(){
+    return w_size;
+  }
+  /*
+  *returns the ordering of the k-mers
+  */
+  KmerOrdering getOrdering(){
+    return ordering;
+  }
+  /*
+  * prints the scheme to the console
+  *
+  *Output: Scheme k: k_size, w: w_size, ordering
+  */
+  void printScheme(){
+    cout<<"Scheme k: "<<k_size<<", w: "<<w_size<<", "<<(ordering==HASHED ? "hashed" : "lexicographic")<<"\n";
+  }
+};
+
+/*!
+ * Returns the index of the scheme having the widest variation-impact-range. The bounds computed by
+ * compute_left_bound and compute_right_bound only depend on w_size+k_size.
+ * @param schemes:    the minimizer schemes
+ */
+int widest_minimizer_scheme(std::vector<MinimizerScheme>& schemes){
+  int widest=0;
+  for(int i=1;i<(int)schemes.size();i++){
+    if(schemes[i].getK()+schemes[i].getW()>schemes[widest].getK()+schemes[widest].getW()){
+      widest=i;
+    }
+  }
+  return widest;
+}
+
+/*!
+ * Fill one B-tree per scheme with the minimizers of the sequence. The sequence is packed once and every
+ * scheme generates its minimizers from the same packed stream.
+ * @param minimizerTrees:   the B-trees to be filled, one per scheme
+ * @param schemes:          the minimizer schemes
+ * @param sequence:         the sequence for which the minimizers are generated
+ */
+void fill_multi_minimizer_trees(std::vector<B_tree<int,std::string,7,3>*>& minimizerTrees,std::vector<MinimizerScheme>& schemes,std::string& sequence){
+  assert(minimizerTrees.size()==schemes.size());
+  std::vector<uint8_t> codes=pack_sequence(sequence);
+  for(int i=0;i<(int)schemes.size();i++){
+    int k_size=schemes[i].getK();
+    int w_size=schemes[i].getW();
+    std::vector<Minimizer> minimizers=get_packed_kmer_minimizers(codes,k_size,w_size,schemes[i].getOrdering(),0);
+    fill_minimizer_tree(minimizerTrees[i],minimizers);
+  }
+}
+
+/*!
+ * Implementation of the dynamic minimizer algorithm for several minimizer schemes at once. The variants are
+ * applied to the sequence a single time, using the variation-impact-ranges of the widest scheme, which contain
+ * the ranges of all other schemes. Each range is packed once and then updates the B-trees of all schemes.
+ * @param minimizerTrees:    B-trees holding the final minimizers, one per scheme
+ * @param schemes:           the minimizer schemes
+ * @param dynamic_sequence:  the sequence to be altered
+ * @param variants:          Vector of variants which are applied to the sequence
+ * @param observers:         (optional) liftover recording every applied variant and undo journal recording the
+ *                           changes of the sequence and of all trees. K-mer counts and change feeds describe a
+ *                           single tree, they are passed per scheme in scheme_observers.
+ * @param scheme_observers:  (optional) the k-mer counts and the change feed following the tree of every scheme,
+ *                           empty or one entry per scheme
+ */
+void compute_dynamic_minimizers_multi(std::vector<B_tree<int,std::string,7,3>*>& minimizerTrees,std::vector<MinimizerScheme>& schemes,dyn::wt_str& dynamic_sequence,std::vector<Variant>& variants,UpdateObservers observers=UpdateObservers(),std::vector<UpdateObservers> scheme_observers=std::vector<UpdateObservers>()){
+  assert(minimizerTrees.size()==schemes.size());
+  assert(observers.frequencies==nullptr && observers.feed==nullptr);
+  assert(scheme_observers.empty() || scheme_observers.size()==schemes.size());
+  scheme_observers.resize(schemes.size());
+  int widest=widest_minimizer_scheme(schemes);
+  int k_size=schemes[widest].getK();
+  int w_size=schemes[widest].getW();
+  apply_variants_to_dynamic_sequence(dynamic_sequence,variants,k_size,w_size,
+    [&](std::string& fullsubseq,int& thisstartpos,int& var_impact_shift){
+      std::vector<uint8_t> codes=pack_sequence(fullsubseq);
+      for(int i=0;i<(int)schemes.size();i++){
+        int scheme_k=schemes[i].getK();
+        int scheme_w=schemes[i].getW();
+        std::vector<Minimizer> newminis=get_packed_kmer_minimizers(codes,scheme_k,scheme_w,schemes[i].getOrdering(),thisstartpos);
+        update_minimizerTree_with_minimizers(minimizerTrees[i],newminis,thisstartpos,var_impact_shift,observers.journal,scheme_observers[i].frequencies,scheme_observers[i].feed);
+      }
+    },observers.liftover,observers.journal);
+}
+
+#endif
@@ -0,0 +1,322 @@
+////////////////////////////////////////////////////////////////////////////////
+// packed_kmers.h
+//   packed k-mer header file.
+//
+//  2-bit encoding of nucleotides and k-mers together with a minimizer generation working
+//  on the packed k-mer stream
+//
+////////////////////////////////////////////////////////////////////////////////
+//  author: Alexander Petri
+
+#ifndef PACKED_KMERS_H
+#define PACKED_KMERS_H
+
+#include "main.h"
+#include "Minimizer.h"
+
+#include <cassert>
+#include <deque>
+
+/*
+* The order in which k-mers are compared when choosing the minimizer of a window.
+* LEXICOGRAPHIC is the order used by get_kmer_minimizers, HASHED compares an invertible hash of the packed k-mer.
+*/
+enum KmerOrdering{
+  LEXICOGRAPHIC,
+  HASHED
+};
+
+/*
+* encodes a nucleotide into 2 bits (A=0,C=1,G=2,T=3), so that the order of the codes is the lexicographic order
+* @param base   the nucleotide
+*
+* @return code  the 2 bit code of the nucleotide (any other character is treated as A)
+*/
+inline uint8_t encode_base(char base){
+  switch(base){
+    case 'C': case 'c':
+      return 1;
+    case 'G': case 'g':
+      return 2;
+    case 'T': case 't':
+      return 3;
+    default:
+      return 0;
+  }
+}
+
+/*
+* decodes a 2 bit code into a nucleotide
+*/
+inline char decode_base(uint8_t code){
+  static const char bases[4]={'A','C','G','T'};
+  return bases[code&3];
+}
+
+/*
+* returns the mask covering the 2*k_size bits of a packed k-mer
+*/
+inline uint64_t kmer_mask(int k_size){
+  assert(k_size>0 && k_size<=32);
+  return k_size==32 ? std::numeric_limits<uint64_t>::max() : (uint64_t(1)<<(2*k_size))-1;
+}
+
+/*
+* encodes a sequence into its 2 bit codes
+* @param sequence   the sequence to be encoded
+*
+* @return codes     one code per nucleotide
+*/
+std::vector<uint8_t> pack_sequence(std::string& sequence){
+  std::vector<uint8_t> codes(sequence.size());
+  for(int i=0;i<(int)sequence.size();i++){
+    codes[i]=encode_base(sequence[i]);
+  }
+  return codes;
+}
+
+/*
+* decodes a packed k-mer into its sequence
+* @param kmer     the packed k-mer
+* @param k_size   the length of the k-mer
+*/
+std::string unpack_kmer(uint64_t kmer,int k_size){
+  std::string sequence(k_size,'A');
+  for(int i=k_size-1;i>=0;i--){
+    sequence[i]=decode_base(kmer&3);
+    kmer>>=2;
+  }
+  return sequence;
+}
+
+/*
+* encodes the k-mer of length k_size starting at position pos of sequence
+*/
+uint64_t pack_kmer(std::string& sequence,int pos,int k_size){
+  uint64_t kmer=0;
+  for(int i=0;i<k_size;i++){
+    kmer=(kmer<<2)|encode_base(sequence[pos+i]);
+  }
+  return kmer;
+}
+
+/*
+* invertible integer hash of a packed k-mer (Thomas Wang's 64 bit mix restricted to mask)
+*/
+inline uint64_t hash_kmer(uint64_t kmer,uint64_t mask){
+  kmer=(~kmer+(kmer<<21))&mask;
+  kmer=kmer^(kmer>>24);
+  kmer=((kmer+(kmer<<3))+(kmer<<8))&mask;
+  kmer=kmer^(kmer>>14);
+  kmer=((kmer+(kmer<<2))+(kmer<<4))&mask;
+  kmer=kmer^(kmer>>28);
+  kmer=(kmer+(kmer<<31))&mask;
+  return kmer;
+}
+
+/*
+* returns the value by which a packed k-mer is ranked under the given ordering
+*/
+inline uint64_t kmer_rank(uint64_t kmer,uint64_t mask,KmerOrdering ordering){
+  return ordering==HASHED ? hash_kmer(kmer,mask) : kmer;
+}
+
+/*!
+ * Generate the kmer minimizers of a packed sequence. Every window of w consecutive k-mers reports its leftmost
+ * smallest k-mer, consecutive windows sharing the same minimizer report it once. For LEXICOGRAPHIC ordering this
+ * delivers the same minimizers as get_kmer_minimizers. The window is maintained in a monotone queue, so every
+ * k-mer is handled in amortized O(1). Does not generate end minimizers!!!
+ *
+ * @param codes       the 2 bit codes of the sequence for which minimizers are to be generated
+ * @param k_size      the length of the window_kmers
+ * @param w_size      the window size (length of the subsequence in which w kmers are present)
+ * @param ordering    the order in which the k-mers are compared
+ * @param posshift    the position of the first code in the whole sequence
+ *
+ * @return minimizers  the minimizers for the sequence stored in a vector
+ */
+std::vector<Minimizer> get_generic_packed_kmer_minimizers(std::vector<uint8_t>& codes,int& k_size,int& w_size,KmerOrdering ordering,int posshift){
+  std::vector<Minimizer> minimizers;
+  int w=w_size-k_size+1;
+  int n_kmers=(int)codes.size()-k_size+1;
+  if(n_kmers<=0){
+    return minimizers;
+  }
+  uint64_t mask=kmer_mask(k_size);
+  //queue of (rank, position, packed k-mer) with increasing ranks
+  std::deque<std::tuple<uint64_t,int,uint64_t>> window;
+  uint64_t kmer=0;
+  int last_pos=-1;
+  for(int i=0;i<k_size-1;i++){
+    kmer=(kmer<<2)|codes[i];
+  }
+  for(int i=0;i<n_kmers;i++){
+    kmer=((kmer<<2)|codes[i+k_size-1])&mask;
+    uint64_t rank=kmer_rank(kmer,mask,ordering);
+    //only strictly greater k-mers are dropped, so that the leftmost minimum stays at the front
+    while(!window.empty() && std::get<0>(window.back())>rank){
+      window.pop_back();
+    }
+    window.push_back(std::make_tuple(rank,i,kmer));
+    if(std::get<1>(window.front())<=i-w){
+      window.pop_front();
+    }
+    if(i>=w-1 && std::get<1>(window.front())!=last_pos){
+      last_pos=std::get<1>(window.front());
+      int realpos=last_pos+posshift;
+      std::string sequence=unpack_kmer(std::get<2>(window.front()),k_size);
+      minimizers.push_back(Minimizer(realpos,sequence));
+    }
+  }
+  //the sequence is shorter than a window: report the minimum of all k-mers
+  if(minimizers.empty()){
+    int realpos=std::get<1>(window.front())+posshift;
+    std::string sequence=unpack_kmer(std::get<2>(window.front()),k_size);
+    minimizers.push_back(Minimizer(realpos,sequence));
+  }
+  return minimizers;
+}
+
+/*
+* mask of a packed k-mer of length K, usable as a compile-time constant
+*/
+constexpr uint64_t fixed_kmer_mask(int K){
+  return K==32 ? ~uint64_t(0) : (uint64_t(1)<<(2*K))-1;
+}
+
+/*
+* the smallest power of two >= n, the capacity of the window ring buffer of a fixed kernel
+*/
+constexpr int fixed_window_capacity(int n,int capacity=1){
+  return capacity>=n ? capacity : fixed_window_capacity(n,2*capacity);
+}
+
+/*!
+ * Kernel of get_packed_kmer_minimizers for a fixed k-mer length K, window size W and ordering. The monotone queue of
+ * the window lives in a ring buffer on the stack sized at compile time, the k-mer mask is a constant and the loops
+ * over the bases of a k-mer have constant trip counts, so the compiler can unroll them. Delivers the same minimizers
+ * as get_generic_packed_kmer_minimizers.
+ *
+ * @param codes       the 2 bit codes of the sequence
+ * @param length      the number of codes
+ * @param posshift    the position of the first code in the whole sequence
+ *
+ * @return minimizers  the minimizers for the sequence stored in a vector
+ */
+template<int K,int W,KmerOrdering ORDERING,class Pos>
+std::vector<BasicMinimizer<Pos>> get_fixed_kmer_minimizers(const uint8_t* codes,int64_t length,Pos posshift){
+  static_assert(K>0 && K<=32 && W>=K,"a fixed kernel needs 0 < K <= 32 and W >= K");
+  constexpr int WINDOW=W-K+1;
+  //entry i is pushed before entry i-WINDOW leaves the front, so the queue briefly holds WINDOW+1 entries
+  constexpr int CAPACITY=fixed_window_capacity(WINDOW+1);
+  constexpr uint64_t MASK=fixed_kmer_mask(K);
+  std::vector<BasicMinimizer<Pos>> minimizers;
+  int64_t n_kmers=length-K+1;
+  if(n_kmers<=0){
+    return minimizers;
+  }
+  //monotone queue of the window with increasing ranks, entries [front,back) modulo CAPACITY
+  uint64_t ranks[CAPACITY];
+  int64_t positions[CAPACITY];
+  uint64_t kmers[CAPACITY];
+  int64_t front=0;
+  int64_t back=0;
+  uint64_t kmer=0;
+  int64_t last_pos=-1;
+  std::string sequence(K,'A');
+  for(int i=0;i<K-1;i++){
+    kmer=(kmer<<2)|codes[i];
+  }
+  for(int64_t i=0;i<n_kmers;i++){
+    kmer=((kmer<<2)|codes[i+K-1])&MASK;
+    uint64_t rank=ORDERING==HASHED ? hash_kmer(kmer,MASK) : kmer;
+    //only strictly greater k-mers are dropped, so that the leftmost minimum stays at the front
+    while(back>front && ranks[(back-1)&(CAPACITY-1)]>rank){
+      back--;
+    }
+    ranks[back&(CAPACITY-1)]=rank;
+    positions[back&(CAPACITY-1)]=i;
+    kmers[back&(CAPACITY-1)]=kmer;
+    back++;
+    if(positions[front&(CAPACITY-1)]<=i-WINDOW){
+      front++;
+    }
+    if(i>=WINDOW-1 && positions[front&(CAPACITY-1)]!=last_pos){
+      last_pos=positions[front&(CAPACITY-1)];
+      uint64_t minimum=kmers[front&(CAPACITY-1)];
+      for(int j=K-1;j>=0;j--){
+        sequence[j]=decode_base(minimum&3);
+        minimum>>=2;
+      }
+      Pos realpos=last_pos+posshift;
+      minimizers.push_back(BasicMinimizer<Pos>(realpos,sequence));
+    }
+  }
+  //the sequence is shorter than a window: report the minimum of all k-mers
+  if(minimizers.empty()){
+    Pos realpos=positions[front&(CAPACITY-1)]+posshift;
+    sequence=unpack_kmer(kmers[front&(CAPACITY-1)],K);
+    minimizers.push_back(BasicMinimizer<Pos>(realpos,sequence));
+  }
+  return minimizers;
+}
+
+template<int K,int W,class Pos>
+std::vector<BasicMinimizer<Pos>> get_fixed_kmer_minimizers(const uint8_t* codes,int64_t length,KmerOrdering ordering,Pos posshift){
+  if(ordering==HASHED){
+    return get_fixed_kmer_minimizers<K,W,HASHED,Pos>(codes,length,posshift);
+  }
+  return get_fixed_kmer_minimizers<K,W,LEXICOGRAPHIC,Pos>(codes,length,posshift);
+}
+
+/*
+* The (k, w_size) configurations with a fixed kernel: the minimap2 presets for Nanopore reads (map-ont, 15, 24),
+* PacBio CLR reads (map-pb, 19, 28), short reads (sr, 21, 31) and HiFi reads (map-hifi, 19, 37). w_size spans the w k-mers of a window, so w_size=k+w-1.
+*/
+static const int FIXED_KMER_CONFIGURATIONS[][2]={{15,24},{19,28},{21,31},{19,37}};
+
+/*!
+ * Runtime dispatch to the fixed kernel of (k_size, w_size).
+ * @param codes       the 2 bit codes of the sequence
+ * @param length      the number of codes
+ * @param k_size      the length of the k-mers
+ * @param w_size      the window size
+ * @param ordering    the order in which the k-mers are compared
+ * @param posshift    the position of the first code in the whole sequence
+ * @param minimizers  receives the minimizers
+ *
+ * @return false if there is no fixed kernel for (k_size, w_size), minimizers is left untouched then
+ */
+template<class Pos>
+bool get_fixed_kmer_minimizers_dispatch(const uint8_t* codes,int64_t length,int k_size,int w_size,KmerOrdering ordering,Pos posshift,std::vector<BasicMinimizer<Pos>>& minimizers){
+  if(k_size==15 && w_size==24){
+    minimizers=get_fixed_kmer_minimizers<15,24,Pos>(codes,length,ordering,posshift);
+  }
+  else if(k_size==19 && w_size==37){
+    minimizers=get_fixed_kmer_minimizers<19,37,Pos>(codes,length,ordering,posshift);
+  }
+  else if(k_size==21 && w_size==31){
+    minimizers=get_fixed_kmer_minimizers<21,31,Pos>(codes,length,ordering,posshift);
+  }
+  else if(k_size==19 && w_size==28){
+    minimizers=get_fixed_kmer_minimizers<19,28,Pos>(codes,length,ordering,posshift);
+  }
+  else{
+    return false;
+  }
+  return true;
+}
+
+/*!
+ * Generate the kmer minimizers of a packed sequence (see get_generic_packed_kmer_minimizers). The configurations in
+ * FIXED_KMER_CONFIGURATIONS are computed by their fixed kernel, all others by the generic kernel.
+ */
+std::vector<Minimizer> get_packed_kmer_minimizers(std::vector<uint8_t>& codes,int& k_size,int& w_size,KmerOrdering ordering,int posshift){
+  std::vector<Minimizer> minimizers;
+  if(get_fixed_kmer_minimizers_dispatch(codes.data(),codes.size(),k_size,w_size,ordering,posshift,minimizers)){
+    return minimizers;
+  }
+  return get_generic_packed_kmer_minimizers(codes,k_size,w_size,ordering,posshift);
+}
+
+#endif
@@ -0,0 +1,249 @@
+////////////////////////////////////////////////////////////////////////////////
+// perf_counters.h
+//   performance counter header file.
+//
+//  hardware performance counters (cycles, instructions, L1 and last level cache
+//  misses, branch misses) read as one perf_event_open group around the phases
+//  of a benchmark. Where the counters cannot be opened (other systems, missing
+//  permissions, virtual machines without a PMU) only the time is measured.
+//
+////////////////////////////////////////////////////////////////////////////////
+//  author: Alexander Petri
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#ifdef __linux__
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+enum PerfEvent{
+  PERF_CYCLES,
+  PERF_INSTRUCTIONS,
+  PERF_L1D_MISSES,
+  PERF_LLC_MISSES,
+  PERF_BRANCH_MISSES,
+  PERF_EVENT_COUNT
+};
+
+static const char* PERF_EVENT_NAMES[PERF_EVENT_COUNT]={"cycles","instructions","L1d misses","LLC misses","branch misses"};
+
+/*
+* The counters and the time of one measured phase. Counters which could not be opened or were never scheduled are
+* not available. If the group shared the PMU with other events, the counts are extrapolated to the whole phase and
+* scaled is set.
+*/
+struct PerfMeasurement{
+  double seconds=0;
+  uint64_t values[PERF_EVENT_COUNT]={0,0,0,0,0};
+  bool available[PERF_EVENT_COUNT]={false,false,false,false,false};
+  bool scaled=false;
+
+  /*
+  * adds the time and the counters of another measurement of the same group, e.g. of the next round of a phase
+  */
+  PerfMeasurement& operator+=(const PerfMeasurement& other){
+    seconds+=other.seconds;
+    for(int e=0;e<PERF_EVENT_COUNT;e++){
+      values[e]+=other.values[e];
+      available[e]=available[e] || other.available[e];
+    }
+    scaled=scaled || other.scaled;
+    return *this;
+  }
+
+  /*!
+   * prints the throughput and the time and counters per operation, n/a for unavailable counters
+   * @param name:         the name of the phase
+   * @param operations:   the number of operations of the phase
+   * @param unit:         the name of an operation
+   */
+  void printPerOperation(std::string name,uint64_t operations,std::string unit="op",std::ostream& out=std::cout) const{
+    double ops=operations==0 ? 1.0 : (double)operations;
+    out<<name<<": "<<operations<<" "<<unit<<"s, "<<(seconds>0 ? operations/seconds : 0.0)<<" "<<unit<<"s/s, "<<seconds*1e9/ops<<" ns/"<<unit;
+    for(int e=0;e<PERF_EVENT_COUNT;e++){
+      out<<", "<<PERF_EVENT_NAMES[e]<<"/"<<unit<<" ";
+      if(available[e]){
+        out<<values[e]/ops;
+      }
+      else{
+        out<<"n/a";
+      }
+    }
+    if(available[PERF_CYCLES] && available[PERF_INSTRUCTIONS] && values[PERF_CYCLES]>0){
+      out<<", IPC "<<(double)values[PERF_INSTRUCTIONS]/values[PERF_CYCLES];
+    }
+    if(scaled){
+      out<<" (multiplexed)";
+    }
+    out<<"\n";
+  }
+};
+
+/*
+* A group of hardware counters of the calling thread, read together so that the counters of a phase cover the same
+* instructions. The counters exclude the kernel, so they can be opened with perf_event_paranoid up to 2. Counters the
+* system does not offer are left out, without any counter start and stop only measure the time.
+*
+* @param fds        the file descriptor of every event, -1 if it is not available
+* @param leader     the file descriptor of the group leader, -1 if no counter is available
+* @param error      why the first unavailable counter could not be opened
+*/
+class PerfCounterGroup{
+private:
+  int fds[PERF_EVENT_COUNT];
+  int leader;
+  std::string error;
+  std::chrono::high_resolution_clock::time_point started;
+
+#ifdef __linux__
+  static int open_event(uint32_t type,uint64_t config,int group){
+    struct perf_event_attr attr;
+    memset(&attr,0,sizeof(attr));
+    attr.size=sizeof(attr);
+    attr.type=type;
+    attr.config=config;
+    attr.disabled=group==-1;
+    attr.exclude_kernel=1;
+    attr.exclude_hv=1;
+    attr.read_format=PERF_FORMAT_GROUP|PERF_FORMAT_TOTAL_TIME_ENABLED|PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return syscall(__NR_perf_event_open,&attr,0,-1,group,0);
+  }
+#endif
+
+public:
+  // Constructor
+  PerfCounterGroup(){
+    leader=-1;
+    for(int e=0;e<PERF_EVENT_COUNT;e++){
+      fds[e]=-1;
+    }
+#ifdef __linux__
+    const uint32_t types[PERF_EVENT_COUNT]={PERF_TYPE_HARDWARE,PERF_TYPE_HARDWARE,PERF_TYPE_HW_CACHE,PERF_TYPE_HARDWARE,PERF_TYPE_HARDWARE};
+    const uint64_t configs[PERF_EVENT_COUNT]={PERF_COUNT_HW_CPU_CYCLES,PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_CACHE_L1D|(PERF_COUNT_HW_CACHE_OP_READ<<8)|(PERF_COUNT_HW_CACHE_RESULT_MISS<<16),
+      PERF_COUNT_HW_CACHE_MISSES,PERF_COUNT_HW_BRANCH_MISSES};
+    for(int e=0;e<PERF_EVENT_COUNT;e++){
+      fds[e]=open_event(types[e],configs[e],leader);
+      if(fds[e]<0 && error.empty()){
+        error=std::string(PERF_EVENT_NAMES[e])+": "+strerror(errno);
+      }
+      if(fds[e]>=0 && leader==-1){
+        leader=fds[e];
+      }
+    }
+#else
+    error="perf_event_open is only available on Linux";
+#endif
+  }
+  // Destructor
+  ~PerfCounterGroup(){
+#ifdef __linux__
+    for(int e=0;e<PERF_EVENT_COUNT;e++){
+      if(fds[e]>=0){
+        close(fds[e]);
+      }
+    }
+#endif
+  }
+  PerfCounterGroup(const PerfCounterGroup&) = delete;
+  PerfCounterGroup& operator=(const PerfCounterGroup&) = delete;
+
+  /*
+  * returns true if at least one counter is available
+  */
+  bool isAvailable() const{
+    return leader>=0;
+  }
+  bool isAvailable(PerfEvent event) const{
+    return fds[event]>=0;
+  }
+  /*
+  * returns why the first unavailable counter could not be opened, empty if all counters are available
+  */
+  std::string getError() const{
+    return error;
+  }
+
+  /*
+  * resets the counters and starts the measurement
+  */
+  void start(){
+#ifdef __linux__
+    if(leader>=0){
+      ioctl(leader,PERF_EVENT_IOC_RESET,PERF_IOC_FLAG_GROUP);
+      ioctl(leader,PERF_EVENT_IOC_ENABLE,PERF_IOC_FLAG_GROUP);
+    }
+#endif
+    started=std::chrono::high_resolution_clock::now();
+  }
+
+  /*
+  * stops the measurement and returns the time and the counters since start
+  */
+  PerfMeasurement stop(){
+    PerfMeasurement result;
+    result.seconds=std::chrono::duration<double>(std::chrono::high_resolution_clock::now()-started).count();
+#ifdef __linux__
+    if(leader>=0){
+      ioctl(leader,PERF_EVENT_IOC_DISABLE,PERF_IOC_FLAG_GROUP);
+      //nr, time enabled, time running and the values in the order the events were opened
+      uint64_t buffer[3+PERF_EVENT_COUNT];
+      if(read(leader,buffer,sizeof(buffer))>=(ssize_t)(3*sizeof(uint64_t)) && buffer[2]>0){
+        double scale=(double)buffer[1]/buffer[2];
+        result.scaled=buffer[1]!=buffer[2];
+        uint64_t value=3;
+        for(int e=0;e<PERF_EVENT_COUNT;e++){
+          if(fds[e]>=0 && value<3+buffer[0]){
+            result.values[e]=buffer[value++]*scale;
+            result.available[e]=true;
+          }
+        }
+      }
+    }
+#endif
+    return result;
+  }
+};
+
+/*
+* Measures the scope it lives in with a counter group and prints the result per operation when the scope is left
+*
+* @param result     (optional) receives the measurement
+*/
+class PerfPhase{
+private:
+  PerfCounterGroup& group;
+  std::string name;
+  uint64_t operations;
+  PerfMeasurement* result;
+
+public:
+  PerfPhase(PerfCounterGroup& counters,std::string phase,uint64_t ops,PerfMeasurement* measurement=nullptr):group(counters){
+    name=phase;
+    operations=ops;
+    result=measurement;
+    group.start();
+  }
+  ~PerfPhase(){
+    PerfMeasurement measurement=group.stop();
+    measurement.printPerOperation(name,operations);
+    if(result!=nullptr){
+      *result=measurement;
+    }
+  }
+  PerfPhase(const PerfPhase&) = delete;
+  PerfPhase& operator=(const PerfPhase&) = delete;
+};
+
+#endif
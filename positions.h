@@ -0,0 +1,124 @@
+////////////////////////////////////////////////////////////////////////////////
+// positions.h
+//   positions header file.
+//
+//  position types of the minimizer pipeline and the contig table mapping
+//  (contig, offset) pairs to 64-bit keys
+//
+////////////////////////////////////////////////////////////////////////////////
+//  author: Alexander Petri
+
+#ifndef POSITIONS_H
+#define POSITIONS_H
+
+#include "main.h"
+
+#include <cassert>
+#include <cstdint>
+#include <type_traits>
+
+/*
+* Properties of the integer type Pos used for the positions of minimizers and variants.
+* int is the type used by default, int64_t allows sequences longer than 2^31 bases and uint32_t halves the
+* memory of the keys compared to int64_t for contigs shorter than 2^31 bases.
+*
+* @param delta_type   signed type of the shifts between positions (the length differences of variants)
+*/
+template<class Pos>
+struct position_traits{
+  static_assert(std::is_integral<Pos>::value,"positions have to be integers");
+  typedef typename std::make_signed<Pos>::type delta_type;
+
+  /*
+  * returns true if a sequence of the given length can be addressed with Pos. The B-tree compares unsigned keys by
+  * their signed difference (lazy shifts may wrap them around), so unsigned positions are limited to the range of
+  * the signed type as well.
+  */
+  static bool fits(uint64_t length){
+    return length<=(uint64_t)std::numeric_limits<delta_type>::max();
+  }
+};
+
+/*
+* Packed 64-bit key of a position on a contig: the contig id is stored in the upper contig_bits bits and the
+* offset on the contig in the lower offset_bits bits, so sorting the keys sorts by contig first and by offset second.
+*/
+typedef uint64_t contig_key_t;
+const int offset_bits=40;
+const int contig_bits=64-offset_bits;
+
+inline contig_key_t make_contig_key(uint64_t contig,uint64_t offset){
+  assert(contig<(1ULL<<contig_bits) && offset<(1ULL<<offset_bits));
+  return (contig<<offset_bits)|offset;
+}
+inline uint64_t key_contig(contig_key_t key){
+  return key>>offset_bits;
+}
+inline uint64_t key_offset(contig_key_t key){
+  return key&((1ULL<<offset_bits)-1);
+}
+
+/*
+* Table of the contigs of a genome (chromosomes, scaffolds or the sequences of a whole-genome concatenation).
+*
+* @param names      the names of the contigs
+* @param lengths    the lengths of the contigs
+*/
+class ContigTable{
+private:
+  std::vector<std::string> names;
+  std::vector<uint64_t> lengths;
+
+public:
+  /*
+  * adds a contig and returns its id
+  */
+  int addContig(std::string name,uint64_t length){
+    assert(names.size()<(1ULL<<contig_bits) && length<=(1ULL<<offset_bits));
+    names.push_back(name);
+    lengths.push_back(length);
+    return names.size()-1;
+  }
+  /*
+  * returns the id of the contig called name or -1 if there is no such contig
+  */
+  int findContig(std::string& name){
+    for(int i=0;i<(int)names.size();i++){
+      if(names[i]==name){
+        return i;
+      }
+    }
+    return -1;
+  }
+  int getNumberOfContigs(){
+    return names.size();
+  }
+  std::string getName(int contig){
+    return names[contig];
+  }
+  uint64_t getLength(int contig){
+    return lengths[contig];
+  }
+  void setLength(int contig,uint64_t length){
+    assert(length<=(1ULL<<offset_bits));
+    lengths[contig]=length;
+  }
+  /*
+  * returns the total length of all contigs
+  */
+  uint64_t getTotalLength(){
+    uint64_t total=0;
+    for(int i=0;i<(int)lengths.size();i++){
+      total+=lengths[i];
+    }
+    return total;
+  }
+  /*
+  * returns true if the positions of the contig can be stored as 32-bit unsigned integers
+  */
+  bool fitsUint32(int contig){
+    return position_traits<uint32_t>::fits(lengths[contig]);
+  }
+};
+
+#endif
@@ -0,0 +1,263 @@
+////////////////////////////////////////////////////////////////////////////////
+// sample_transitions.h
+//   Sample transitions header file.
+//
+//  indexes the haplotypes of many samples one after the other without going
+//  back to the reference in between. The sequence and the minimizers are moved
+//  from one sample to the next by reverting the variants only the first sample
+//  carries and applying the variants only the next sample carries, and the
+//  samples are ordered such that consecutive samples share most of their variants.
+//
+////////////////////////////////////////////////////////////////////////////////
+//  author: Alexander Petri
+
+#ifndef SAMPLE_TRANSITIONS_H
+#define SAMPLE_TRANSITIONS_H
+
+#include "main.h"
+#include "Variant.h"
+#include "positions.h"
+#include "B-tree.hh"
+#include "B_tree_node.hh"
+#include "B_tree_operations.h"
+#include "dynamic_minimizer.h"
+#include "window_cache.h"
+#include "include/dynamic.hpp"
+
+#include <cassert>
+#include <iterator>
+
+/*
+* The variants of a cohort of samples on the same reference. Every distinct variant is stored once and numbered in
+* the order of its position, a sample is the sorted list of the numbers of its variants. The variants of a sample
+* are given in reference coordinates, sorted by position and separated by at least one base, like the variants
+* handed to compute_dynamic_minimizers.
+*
+* @param reference   the reference sequence
+* @param variants    the distinct variants of all samples, sorted by (position, original length, sequence)
+* @param samples     samples[i] holds the numbers of the variants of sample i in ascending order
+*/
+template<class Pos>
+class BasicCohort{
+private:
+  std::string reference;
+  std::vector<BasicVariant<Pos>> variants;
+  std::vector<std::vector<int>> samples;
+
+  Pos variantEnd(BasicVariant<Pos>& variant){
+    return variant.getVariantPosition()+variant.getVariantOriginalSeqLen();
+  }
+  Pos variantEnd(int id){
+    return variantEnd(variants[id]);
+  }
+  /*
+  * returns the bases of reference[left,right) after applying the variants of members
+  */
+  std::string applyToInterval(Pos left,Pos right,std::vector<int>& members){
+    std::string bases="";
+    Pos cursor=left;
+    for(int i=0;i<(int)members.size();i++){
+      Pos pos=variants[members[i]].getVariantPosition();
+      bases+=reference.substr(cursor,pos-cursor)+variants[members[i]].getVariantSequence();
+      cursor=variantEnd(members[i]);
+    }
+    return bases+reference.substr(cursor,right-cursor);
+  }
+
+public:
+  /*!
+   * @param reference_sequence:   the reference sequence
+   * @param sample_variants:      the variants of every sample in reference coordinates
+   */
+  BasicCohort(std::string& reference_sequence,std::vector<std::vector<BasicVariant<Pos>>>& sample_variants){
+    reference=reference_sequence;
+    typedef std::tuple<Pos,int,std::string> variant_key;
+    std::map<variant_key,int> ids;
+    for(int s=0;s<(int)sample_variants.size();s++){
+      for(int i=0;i<(int)sample_variants[s].size();i++){
+        BasicVariant<Pos>& variant=sample_variants[s][i];
+        assert(variant.getVariantPosition()>0 && variantEnd(variant)<=(int)reference.size());
+        if(i>0){
+          assert(variant.getVariantPosition()>variantEnd(sample_variants[s][i-1]));
+        }
+        ids[std::make_tuple(variant.getVariantPosition(),variant.getVariantOriginalSeqLen(),variant.getVariantSequence())]=0;
+      }
+    }
+    //number the distinct variants in the order of the keys, so that the numbers follow the positions
+    for(auto it=ids.begin();it!=ids.end();++it){
+      it->second=variants.size();
+      Pos pos=std::get<0>(it->first);
+      int originalseqlen=std::get<1>(it->first);
+      std::string sequence=std::get<2>(it->first);
+      int length=sequence.size();
+      variants.push_back(BasicVariant<Pos>(pos,originalseqlen,length,sequence));
+    }
+    samples.resize(sample_variants.size());
+    for(int s=0;s<(int)sample_variants.size();s++){
+      for(int i=0;i<(int)sample_variants[s].size();i++){
+        BasicVariant<Pos>& variant=sample_variants[s][i];
+        samples[s].push_back(ids[std::make_tuple(variant.getVariantPosition(),variant.getVariantOriginalSeqLen(),variant.getVariantSequence())]);
+      }
+    }
+  }
+
+  int getNumberOfSamples(){
+    return samples.size();
+  }
+  int getNumberOfDistinctVariants(){
+    return variants.size();
+  }
+  std::vector<int>& getSample(int sample){
+    return samples[sample];
+  }
+
+  /*
+  * returns the size of the symmetric difference of two sorted variant sets
+  */
+  static uint64_t distance(std::vector<int>& from,std::vector<int>& to){
+    uint64_t common=0;
+    int i=0;
+    int j=0;
+    while(i<(int)from.size() && j<(int)to.size()){
+      if(from[i]==to[j]){
+        common++;
+        i++;
+        j++;
+      }
+      else if(from[i]<to[j]){
+        i++;
+      }
+      else{
+        j++;
+      }
+    }
+    return from.size()+to.size()-2*common;
+  }
+
+  /*!
+   * Orders the samples greedily: starting from the reference, the next sample is always the unvisited sample
+   * with the fewest variants not shared with the current one. O(n^2) distance computations for n samples.
+   */
+  std::vector<int> schedule(){
+    std::vector<int> order;
+    std::vector<bool> visited(samples.size(),false);
+    std::vector<int> none;
+    std::vector<int>* current=&none;
+    for(int step=0;step<(int)samples.size();step++){
+      int best=-1;
+      uint64_t best_distance=std::numeric_limits<uint64_t>::max();
+      for(int s=0;s<(int)samples.size();s++){
+        if(!visited[s]){
+          uint64_t d=distance(*current,samples[s]);
+          if(d<best_distance){
+            best=s;
+            best_distance=d;
+          }
+        }
+      }
+      visited[best]=true;
+      order.push_back(best);
+      current=&samples[best];
+    }
+    return order;
+  }
+
+  /*!
+   * Computes the variants turning the haplotype of from into the haplotype of to. The variants are given in the
+   * coordinates of the from haplotype, so they can be handed to compute_dynamic_minimizers on a sequence holding
+   * it. Variants of both sets whose reference intervals overlap or touch are merged into one variant.
+   * @param from:     sorted variant numbers of the current haplotype (empty for the reference)
+   * @param to:       sorted variant numbers of the next haplotype
+   */
+  std::vector<BasicVariant<Pos>> transition(std::vector<int>& from,std::vector<int>& to){
+    std::vector<int> removed;
+    std::vector<int> added;
+    std::set_difference(from.begin(),from.end(),to.begin(),to.end(),std::back_inserter(removed));
+    std::set_difference(to.begin(),to.end(),from.begin(),from.end(),std::back_inserter(added));
+    std::vector<BasicVariant<Pos>> edits;
+    //shift of the from haplotype against the reference left of the current cluster
+    typename position_traits<Pos>::delta_type shift=0;
+    int next_from=0;
+    int r=0;
+    int a=0;
+    while(r<(int)removed.size() || a<(int)added.size()){
+      //collect a cluster of removed and added variants with overlapping or touching reference intervals
+      std::vector<int> cluster_removed;
+      std::vector<int> cluster_added;
+      bool take_removed=a==(int)added.size() || (r<(int)removed.size() && removed[r]<added[a]);
+      int first=take_removed ? removed[r] : added[a];
+      Pos left=variants[first].getVariantPosition();
+      Pos right=left;
+      while(true){
+        if(r<(int)removed.size() && variants[removed[r]].getVariantPosition()<=right && (a==(int)added.size() || removed[r]<added[a])){
+          cluster_removed.push_back(removed[r]);
+          right=std::max(right,variantEnd(removed[r]));
+          r++;
+        }
+        else if(a<(int)added.size() && variants[added[a]].getVariantPosition()<=right){
+          cluster_added.push_back(added[a]);
+          right=std::max(right,variantEnd(added[a]));
+          a++;
+        }
+        else{
+          break;
+        }
+      }
+      while(next_from<(int)from.size() && variants[from[next_from]].getVariantPosition()<left){
+        shift+=variants[from[next_from]].getVariantLength()-variants[from[next_from]].getVariantOriginalSeqLen();
+        next_from++;
+      }
+      std::string current=applyToInterval(left,right,cluster_removed);
+      std::string target=applyToInterval(left,right,cluster_added);
+      if(current!=target){
+        Pos pos=left+shift;
+        int originalseqlen=current.size();
+        int length=target.size();
+        edits.push_back(BasicVariant<Pos>(pos,originalseqlen,length,target));
+      }
+    }
+    return edits;
+  }
+
+  /*!
+   * Runs through the haplotypes of all samples in the order of schedule(). Before the first sample the tree and
+   * the sequence hold the reference, between two samples only the variants not shared by both are reverted or
+   * applied. After the last sample the tree and the sequence are moved back to the reference.
+   * @param minimizerTree:     B-tree holding the minimizers of the reference
+   * @param dynamic_sequence:  the reference sequence
+   * @param k_size:            length of the k-mers
+   * @param w_size:            window size for the minimizer generations
+   * @param visit:             called with the number of the sample while the tree and the sequence hold its haplotype
+   * @param cache:             (optional) cache of the window minimizers shared by all samples
+   * @param observers:         (optional) observers following the updates of all transitions
+   * @return the number of variants applied in total, including the merged variants moving back to the reference
+   */
+  uint64_t computeDynamicMinimizers(B_tree<Pos,std::string,7,3>* minimizerTree,dyn::wt_str& dynamic_sequence,int& k_size,int& w_size,std::function<void(int)> visit,MinimizerWindowCache* cache=nullptr,BasicUpdateObservers<Pos> observers=BasicUpdateObservers<Pos>()){
+    uint64_t applied=0;
+    std::vector<int> none;
+    std::vector<int>* current=&none;
+    std::vector<int> order=schedule();
+    for(int step=0;step<=(int)order.size();step++){
+      std::vector<int>* next=step<(int)order.size() ? &samples[order[step]] : &none;
+      std::vector<BasicVariant<Pos>> edits=transition(*current,*next);
+      if(!edits.empty()){
+        if(cache!=nullptr){
+          compute_dynamic_minimizers_cached(minimizerTree,dynamic_sequence,edits,k_size,w_size,*cache,observers);
+        }
+        else{
+          compute_dynamic_minimizers(minimizerTree,dynamic_sequence,edits,k_size,w_size,observers);
+        }
+      }
+      applied+=edits.size();
+      if(step<(int)order.size()){
+        visit(order[step]);
+      }
+      current=next;
+    }
+    return applied;
+  }
+};
+
+typedef BasicCohort<int> Cohort;
+
+#endif
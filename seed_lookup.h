@@ -0,0 +1,423 @@
+////////////////////////////////////////////////////////////////////////////////
+// seed_lookup.h
+//   seed lookup header file.
+//
+//  batched lookup of query minimizers against the minimizers stored in the B-tree
+//
+////////////////////////////////////////////////////////////////////////////////
+//  author: Alexander Petri
+
+#ifndef SEED_LOOKUP_H
+#define SEED_LOOKUP_H
+
+#include "main.h"
+#include "packed_kmers.h"
+#include "kmer_frequency.h"
+#include "minimizer_filter.h"
+#include "change_feed.h"
+#include "B-tree.hh"
+#include "B_tree_node.hh"
+
+#include <cassert>
+
+using namespace md;
+
+/*
+* Result of a batched seed lookup. All positions are stored in one flat arena, the positions of query i
+* are positions[offsets[i]] ... positions[offsets[i+1]-1]. The buffers keep their capacity between batches,
+* so reusing one result object per thread avoids any allocation once it has grown to the batch size.
+*
+* @param positions     the flat arena holding the positions of all queries
+* @param offsets       the start of the positions of every query in the arena
+* @param order         scratch buffer holding the query indices sorted by k-mer
+* @param ranges        scratch buffer holding the index range of every distinct query k-mer
+* @param present       scratch buffer holding the answers of the filter
+* @param lookups       the number of queries of the last batch
+* @param filtered      the number of queries of the last batch rejected by the filter
+* @param seconds       the time needed to answer the last batch
+*/
+class SeedQueryResult{
+public:
+  std::vector<int> positions;
+  std::vector<int> offsets;
+  std::vector<int> order;
+  std::vector<std::pair<int,int>> ranges;
+  std::vector<uint8_t> present;
+  int lookups=0;
+  int filtered=0;
+  double seconds=0;
+
+  /*
+  * reserves the arena for a batch of number_of_queries queries with expected_hits positions in total
+  */
+  void reserve(int number_of_queries,int expected_hits){
+    offsets.reserve(number_of_queries+1);
+    order.reserve(number_of_queries);
+    ranges.reserve(number_of_queries);
+    present.reserve(number_of_queries);
+    positions.reserve(expected_hits);
+  }
+  /*
+  * returns the number of positions found for query i
+  */
+  int getNumberOfHits(int i){
+    return offsets[i+1]-offsets[i];
+  }
+  /*
+  * returns a pointer to the first position found for query i
+  */
+  int* getHits(int i){
+    return positions.data()+offsets[i];
+  }
+  /*
+  * returns the throughput of the last batch
+  */
+  double getLookupsPerSecond(){
+    return seconds>0 ? lookups/seconds : 0;
+  }
+  /*
+  * prints the throughput of the last batch to the console
+  *
+  * Output: lookups lookups in seconds seconds (lookups per second lookups/s), hits hits, filtered filtered
+  */
+  void printStatistics(){
+    cout<<lookups<<" lookups in "<<seconds<<" seconds ("<<getLookupsPerSecond()<<" lookups/s), "<<positions.size()<<" hits, "<<filtered<<" filtered\n";
+  }
+};
+
+/*
+* Read-only snapshot of a minimizer B-tree ordered by (packed k-mer, position). Lookups are answered by
+* sorting and deduplicating the queries and merging them with the snapshot, so the snapshot is scanned from
+* left to right once per batch instead of descending a tree once per query.
+* query_batch does not modify the snapshot, so any number of threads may query it concurrently as long as every
+* thread uses its own SeedQueryResult.
+* The snapshot does not see later updates of the B-tree on its own: it either follows them through the change feed of
+* the updates (follow, then flush once per update), or it has to be rebuilt afterwards. Until then lookups return the
+* minimizers and positions of the B-tree at the time of the last rebuild or flush.
+*
+* @param kmers            the packed k-mers of all minimizers, sorted
+* @param positions        the positions of the minimizers, in the order of kmers
+* @param k_size           the length of the k-mers
+* @param shift_from       start of every shift segment in the positions of the snapshot, sorted (changes not flushed)
+* @param shift_offset     the shift of the positions in every segment
+* @param inserted         the (packed k-mer, position) of the minimizers inserted since the last flush
+* @param removed          marks the entries of the snapshot deleted since the last flush
+* @param n_removed        the number of marked entries
+* @param missing_deletes  the number of deleted minimizers that were not in the snapshot
+*/
+class SeedIndex{
+private:
+  std::vector<uint64_t> kmers;
+  std::vector<int> positions;
+  int k_size;
+  std::vector<int64_t> shift_from;
+  std::vector<int64_t> shift_offset;
+  std::vector<std::pair<uint64_t,int>> inserted;
+  std::vector<uint8_t> removed;
+  int n_removed=0;
+  uint64_t missing_deletes=0;
+
+  void clear_pending(){
+    shift_from.assign(1,std::numeric_limits<int64_t>::min());
+    shift_offset.assign(1,0);
+    inserted.clear();
+    removed.assign(kmers.size(),0);
+    n_removed=0;
+  }
+
+  /*
+  * returns the first index in [from,kmers.size()) holding a k-mer >= kmer. The search gallops from from,
+  * so that close successive queries only touch neighbouring parts of the snapshot.
+  */
+  int lower_bound_from(int from,uint64_t kmer) const{
+    int n=(int)kmers.size();
+    int step=1;
+    int lo=from;
+    int hi=from;
+    while(hi<n && kmers[hi]<kmer){
+      lo=hi+1;
+      hi+=step;
+      step*=2;
+    }
+    if(hi>n){
+      hi=n;
+    }
+    return (int)(std::lower_bound(kmers.begin()+lo,kmers.begin()+hi,kmer)-kmers.begin());
+  }
+
+public:
+  // Constructor
+  SeedIndex(B_tree<int,std::string,7,3>* minimizerTree,int k){
+    k_size=k;
+    rebuild(minimizerTree);
+  }
+
+  /*!
+   * Rebuild the snapshot from the minimizers stored in the B-tree
+   * @param minimizerTree:    the B-tree holding the minimizers
+   */
+  void rebuild(B_tree<int,std::string,7,3>* minimizerTree){
+    std::vector<std::pair<uint64_t,int>> entries;
+    if(!minimizerTree->is_empty()){
+      for(auto elem: *minimizerTree){
+        for(int i=0;i<(int)elem.second.size();i++){
+          entries.push_back(std::make_pair(pack_kmer(elem.second[i],0,k_size),elem.first));
+        }
+      }
+    }
+    std::sort(entries.begin(),entries.end());
+    kmers.resize(entries.size());
+    positions.resize(entries.size());
+    for(int i=0;i<(int)entries.size();i++){
+      kmers[i]=entries[i].first;
+      positions[i]=entries[i].second;
+    }
+    clear_pending();
+  }
+
+  /*!
+   * Applies one change of a change feed, so the snapshot follows the minimizer tree the feed belongs to:
+   * ChangeFeed feed([&](const MinimizerChange& change){ seedIndex.follow(change); });
+   * The changes are collected and merged into the snapshot by flush, so follow does not touch the snapshot arrays:
+   * a shift is folded into the offsets of the shift segments (O(segments + inserted minimizers of the batch)), an
+   * insertion is appended to the inserted minimizers and a deletion is resolved to the entry it removes right away.
+   * follow must not run concurrently with query_batch.
+   * @param change:   the change
+   *
+   * @return false if a deleted minimizer is not in the snapshot, i.e. the snapshot does not hold the minimizers of
+   *         the tree (the deletions are counted, see getNumberOfMissingDeletes)
+   */
+  bool follow(const MinimizerChange& change){
+    if(change.type==MINIMIZERS_SHIFTED){
+      //every segment of original positions whose shifted positions reach change.position is (partly) shifted
+      std::vector<int64_t> from;
+      std::vector<int64_t> offset;
+      for(int i=0;i<(int)shift_from.size();i++){
+        int64_t end=i+1<(int)shift_from.size() ? shift_from[i+1] : std::numeric_limits<int64_t>::max();
+        int64_t split=(int64_t)change.position-shift_offset[i];
+        if(split<=shift_from[i]){
+          from.push_back(shift_from[i]);
+          offset.push_back(shift_offset[i]+change.delta);
+        }
+        else{
+          from.push_back(shift_from[i]);
+          offset.push_back(shift_offset[i]);
+          if(split<end){
+            from.push_back(split);
+            offset.push_back(shift_offset[i]+change.delta);
+          }
+        }
+      }
+      shift_from.swap(from);
+      shift_offset.swap(offset);
+      for(int i=0;i<(int)inserted.size();i++){
+        if(inserted[i].second>=change.position){
+          inserted[i].second+=change.delta;
+        }
+      }
+      return true;
+    }
+    std::string sequence=change.kmer;
+    uint64_t kmer=pack_kmer(sequence,0,k_size);
+    if(change.type==MINIMIZER_INSERTED){
+      inserted.push_back(std::make_pair(kmer,(int)change.position));
+      return true;
+    }
+    //the minimizer was inserted by the same batch
+    for(int i=(int)inserted.size()-1;i>=0;i--){
+      if(inserted[i].first==kmer && inserted[i].second==change.position){
+        inserted.erase(inserted.begin()+i);
+        return true;
+      }
+    }
+    //otherwise it is an entry of the snapshot, its original position lies in one of the shift segments
+    int lo=(int)(std::lower_bound(kmers.begin(),kmers.end(),kmer)-kmers.begin());
+    int hi=(int)(std::upper_bound(kmers.begin()+lo,kmers.end(),kmer)-kmers.begin());
+    for(int i=0;i<(int)shift_from.size();i++){
+      int64_t end=i+1<(int)shift_from.size() ? shift_from[i+1] : std::numeric_limits<int64_t>::max();
+      int64_t original=(int64_t)change.position-shift_offset[i];
+      if(original<shift_from[i] || original>=end){
+        continue;
+      }
+      int index=(int)(std::lower_bound(positions.begin()+lo,positions.begin()+hi,original)-positions.begin());
+      while(index<hi && positions[index]==original){
+        if(!removed[index]){
+          removed[index]=1;
+          n_removed++;
+          return true;
+        }
+        index++;
+      }
+    }
+    missing_deletes++;
+    return false;
+  }
+
+  /*!
+   * Merges the changes collected by follow into the snapshot in one pass over it: every remaining entry is moved by
+   * the offset of its shift segment and the inserted minimizers are merged in. Has to be called after an update and
+   * before the next query_batch.
+   */
+  void flush(){
+    if(!hasPendingChanges()){
+      return;
+    }
+    std::vector<uint64_t> moved_kmers;
+    std::vector<int> moved_positions;
+    moved_kmers.reserve(kmers.size()-n_removed);
+    moved_positions.reserve(kmers.size()-n_removed);
+    int segment=0;
+    int start=0;
+    bool unsorted=false;
+    for(int i=0;i<(int)kmers.size();i++){
+      if(i>0 && kmers[i]!=kmers[i-1]){
+        segment=0;
+      }
+      while(segment+1<(int)shift_from.size() && shift_from[segment+1]<=positions[i]){
+        segment++;
+      }
+      if(removed[i]){
+        continue;
+      }
+      if(moved_kmers.empty() || moved_kmers.back()!=kmers[i]){
+        if(unsorted){
+          std::sort(moved_positions.begin()+start,moved_positions.end());
+        }
+        start=(int)moved_kmers.size();
+        unsorted=false;
+      }
+      int position=(int)(positions[i]+shift_offset[segment]);
+      //a negative shift may move a position of the k-mer past the previous one
+      unsorted=unsorted || ((int)moved_kmers.size()>start && position<moved_positions.back());
+      moved_kmers.push_back(kmers[i]);
+      moved_positions.push_back(position);
+    }
+    if(unsorted){
+      std::sort(moved_positions.begin()+start,moved_positions.end());
+    }
+    std::sort(inserted.begin(),inserted.end());
+    kmers.clear();
+    positions.clear();
+    int j=0;
+    for(int i=0;i<(int)moved_kmers.size() || j<(int)inserted.size();){
+      if(j==(int)inserted.size() || (i<(int)moved_kmers.size() && std::make_pair(moved_kmers[i],moved_positions[i])<inserted[j])){
+        kmers.push_back(moved_kmers[i]);
+        positions.push_back(moved_positions[i]);
+        i++;
+      }
+      else{
+        kmers.push_back(inserted[j].first);
+        positions.push_back(inserted[j].second);
+        j++;
+      }
+    }
+    clear_pending();
+  }
+
+  /*
+  * returns true if follow collected changes that flush has not merged into the snapshot yet
+  */
+  bool hasPendingChanges() const{
+    return !inserted.empty() || n_removed>0 || shift_from.size()>1 || shift_offset[0]!=0;
+  }
+  /*
+  * returns the number of deleted minimizers follow did not find in the snapshot
+  */
+  uint64_t getNumberOfMissingDeletes() const{
+    return missing_deletes;
+  }
+
+  /*!
+   * Look up a batch of packed query k-mers. The queries are sorted and deduplicated, every distinct k-mer is
+   * located by one left-to-right merge with the snapshot and the positions are written into the arena of result
+   * in the order of the queries.
+   * @param queries:    the packed k-mers to be looked up
+   * @param result:     the result holding the positions of every query
+   * @param mask:       (optional) k-mer counts, queries of masked (highly frequent) k-mers get no hits
+   * @param filter:     (optional) filter over the k-mers of the minimizers, queries it rejects get no hits without
+   *                    being sorted or merged with the snapshot
+   */
+  void query_batch(const std::vector<uint64_t>& queries,SeedQueryResult& result,const KmerFrequencyTable* mask=nullptr,const MinimizerFilter* filter=nullptr) const{
+    assert(!hasPendingChanges());
+    auto begin=std::chrono::high_resolution_clock::now();
+    int n_queries=(int)queries.size();
+    //sort the indices of the queries the filter does not rule out by k-mer
+    result.order.clear();
+    if(filter!=nullptr){
+      result.present.resize(n_queries);
+      filter->containsBatch(queries.data(),n_queries,result.present.data());
+      for(int i=0;i<n_queries;i++){
+        if(result.present[i]){
+          result.order.push_back(i);
+        }
+      }
+    }
+    else{
+      for(int i=0;i<n_queries;i++){
+        result.order.push_back(i);
+      }
+    }
+    int n_candidates=(int)result.order.size();
+    std::sort(result.order.begin(),result.order.end(),[&queries](int a,int b){return queries[a]<queries[b];});
+    //merge the distinct query k-mers with the snapshot and count the hits of every query
+    result.ranges.assign(n_queries,std::make_pair(0,0));
+    result.offsets.assign(n_queries+1,0);
+    int index=0;
+    int i=0;
+    while(i<n_candidates){
+      uint64_t kmer=queries[result.order[i]];
+      int lo=lower_bound_from(index,kmer);
+      int hi=lo;
+      while(hi<(int)kmers.size() && kmers[hi]==kmer){
+        hi++;
+      }
+      index=hi;
+      if(mask!=nullptr && mask->isMasked(kmer)){
+        hi=lo;
+      }
+      //all duplicates of the k-mer share the same range
+      while(i<n_candidates && queries[result.order[i]]==kmer){
+        result.ranges[result.order[i]]=std::make_pair(lo,hi);
+        result.offsets[result.order[i]+1]=hi-lo;
+        i++;
+      }
+    }
+    for(int q=0;q<n_queries;q++){
+      result.offsets[q+1]+=result.offsets[q];
+    }
+    //copy the positions into the arena
+    result.positions.resize(result.offsets[n_queries]);
+    for(int q=0;q<n_queries;q++){
+      std::copy(positions.begin()+result.ranges[q].first,positions.begin()+result.ranges[q].second,result.positions.begin()+result.offsets[q]);
+    }
+    auto end=std::chrono::high_resolution_clock::now();
+    result.lookups=n_queries;
+    result.filtered=n_queries-n_candidates;
+    result.seconds=std::chrono::duration<double>(end-begin).count();
+  }
+
+  /*!
+   * Look up a batch of query minimizers given by their sequences
+   * @param queries:    the minimizers to be looked up
+   * @param result:     the result holding the positions of every query
+   * @param mask:       (optional) k-mer counts, queries of masked (highly frequent) k-mers get no hits
+   * @param filter:     (optional) filter over the k-mers of the minimizers, queries it rejects get no hits
+   */
+  void query_batch(std::vector<Minimizer>& queries,SeedQueryResult& result,const KmerFrequencyTable* mask=nullptr,const MinimizerFilter* filter=nullptr) const{
+    std::vector<uint64_t> packed(queries.size());
+    for(int i=0;i<(int)queries.size();i++){
+      std::string sequence=queries[i].getSequence();
+      packed[i]=pack_kmer(sequence,0,k_size);
+    }
+    query_batch(packed,result,mask,filter);
+  }
+
+  /*
+  * returns the number of minimizers in the snapshot
+  */
+  int size() const{
+    return (int)kmers.size();
+  }
+};
+
+#endif
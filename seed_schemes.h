@@ -0,0 +1,390 @@
+////////////////////////////////////////////////////////////////////////////////
+// seed_schemes.h
+//   Algorithm header file.
+//
+// Seeding schemes besides (w,k) window minimizers: open and closed syncmers and
+// order-2 randstrobes. A syncmer only depends on the bases of its own k-mer, so a
+// variant only changes the seeds of the k-1 surrounding positions and its
+// variation-impact-range is much smaller than the one of a window minimizer.
+//
+////////////////////////////////////////////////////////////////////////////////
+// author: Alexander Petri
+
+#ifndef SEED_SCHEMES_H
+#define SEED_SCHEMES_H
+
+#include "main.h"
+#include "Variant.h"
+#include "Minimizer.h"
+#include "positions.h"
+#include "packed_kmers.h"
+#include "get_kmer_minimizers.h"
+#include "B-tree.hh"
+#include "B_tree_node.hh"
+#include "B_tree_operations.h"
+#include "dynamic_minimizer.h"
+#include "undo_journal.h"
+#include "include/dynamic.hpp"
+
+#include <deque>
+
+/*
+* The seeds a SeedScheme selects:
+* WINDOW_MINIMIZER   the leftmost smallest k-mer of every window of w_size bases (get_kmer_minimizers)
+* OPEN_SYNCMER       the k-mers whose smallest s-mer starts at offset t
+* CLOSED_SYNCMER     the k-mers whose smallest s-mer is their first or their last s-mer
+* RANDSTROBE         every k-mer, linked with the k-mer starting between w_min and w_max bases after it that
+*                    minimizes the xor of both hashes (Sahlin's randstrobes of order 2)
+*/
+enum SeedType{WINDOW_MINIMIZER,OPEN_SYNCMER,CLOSED_SYNCMER,RANDSTROBE};
+
+/*
+* Class to define a seeding scheme
+*
+* @param type        the kind of the selected seeds
+* @param k_size      the length of the k-mers
+* @param w_size      the window size of WINDOW_MINIMIZER
+* @param s_size      the length of the s-mers of OPEN_SYNCMER and CLOSED_SYNCMER
+* @param t_offset    the offset of the smallest s-mer of OPEN_SYNCMER
+* @param w_min       the smallest distance between the two strobes of RANDSTROBE
+* @param w_max       the largest distance between the two strobes of RANDSTROBE
+* @param ordering    the order in which the k-mers (WINDOW_MINIMIZER) or s-mers (syncmers) are compared
+*/
+class SeedScheme{
+private:
+  SeedType type;
+  int k_size;
+  int w_size=0;
+  int s_size=0;
+  int t_offset=0;
+  int w_min=0;
+  int w_max=0;
+  KmerOrdering ordering;
+
+  SeedScheme(SeedType t,int k,KmerOrdering order){
+    assert(k>0 && k<=32);
+    type=t;
+    k_size=k;
+    ordering=order;
+  }
+
+public:
+  /*
+  * (w,k) window minimizers, maintained by compute_dynamic_minimizers
+  */
+  static SeedScheme minimizer(int k,int w){
+    assert(w>=k);
+    SeedScheme scheme(WINDOW_MINIMIZER,k,LEXICOGRAPHIC);
+    scheme.w_size=w;
+    return scheme;
+  }
+  /*
+  * open syncmers of k-mers whose smallest s-mer starts at offset t
+  */
+  static SeedScheme openSyncmer(int k,int s,int t=0,KmerOrdering order=HASHED){
+    assert(s>0 && s<k && t>=0 && t<=k-s);
+    SeedScheme scheme(OPEN_SYNCMER,k,order);
+    scheme.s_size=s;
+    scheme.t_offset=t;
+    return scheme;
+  }
+  /*
+  * closed syncmers of k-mers whose smallest s-mer is their first or last s-mer
+  */
+  static SeedScheme closedSyncmer(int k,int s,KmerOrdering order=HASHED){
+    assert(s>0 && s<k);
+    SeedScheme scheme(CLOSED_SYNCMER,k,order);
+    scheme.s_size=s;
+    return scheme;
+  }
+  /*
+  * randstrobes of order 2, the second strobe starts w_min ... w_max bases after the first
+  */
+  static SeedScheme randstrobe(int k,int wmin,int wmax){
+    assert(wmin>0 && wmin<=wmax);
+    SeedScheme scheme(RANDSTROBE,k,HASHED);
+    scheme.w_min=wmin;
+    scheme.w_max=wmax;
+    return scheme;
+  }
+
+  SeedType getType(){
+    return type;
+  }
+  int getK(){
+    return k_size;
+  }
+  int getW(){
+    return w_size;
+  }
+  int getS(){
+    return s_size;
+  }
+  int getT(){
+    return t_offset;
+  }
+  int getWMin(){
+    return w_min;
+  }
+  int getWMax(){
+    return w_max;
+  }
+  KmerOrdering getOrdering(){
+    return ordering;
+  }
+  /*
+  * returns the number of bases p ... p+span-1 the seed at position p depends on. Window minimizers also
+  * depend on the bases in front of them, their range is covered by getImpactW.
+  */
+  int getSpan(){
+    switch(type){
+      case RANDSTROBE:
+        return w_max+k_size;
+      case WINDOW_MINIMIZER:
+        return w_size;
+      default:
+        return k_size;
+    }
+  }
+  /*
+  * returns the window size handed to compute_left_bound and compute_right_bound together with k_size.
+  * The bounds extend w_size+k_size-1 bases in front of and w_size+k_size-2 bases behind the variant, so a
+  * syncmer needs no window at all and a randstrobe needs the distance to its farthest second strobe.
+  */
+  int getImpactW(){
+    switch(type){
+      case RANDSTROBE:
+        return w_max;
+      case WINDOW_MINIMIZER:
+        return w_size;
+      default:
+        return 0;
+    }
+  }
+  /*
+  * prints the scheme to the console
+  */
+  void printScheme(){
+    switch(type){
+      case WINDOW_MINIMIZER:
+        cout<<"Scheme minimizer k: "<<k_size<<", w: "<<w_size<<"\n";
+        break;
+      case OPEN_SYNCMER:
+        cout<<"Scheme open syncmer k: "<<k_size<<", s: "<<s_size<<", t: "<<t_offset<<"\n";
+        break;
+      case CLOSED_SYNCMER:
+        cout<<"Scheme closed syncmer k: "<<k_size<<", s: "<<s_size<<"\n";
+        break;
+      case RANDSTROBE:
+        cout<<"Scheme randstrobe k: "<<k_size<<", w_min: "<<w_min<<", w_max: "<<w_max<<"\n";
+        break;
+    }
+  }
+};
+
+/*!
+ * Generate the open or closed syncmers of a sequence. The s-mers of every k-mer are kept in a monotone queue,
+ * so every k-mer is handled in amortized O(1). Ties between s-mers are broken by the leftmost s-mer.
+ * @param sequence:    the sequence for which syncmers are to be generated
+ * @param scheme:      an OPEN_SYNCMER or CLOSED_SYNCMER scheme
+ * @param posshift:    the position of the first base of sequence in the whole sequence
+ *
+ * @return the syncmers (position and k-mer) sorted by position
+ */
+template<class Pos>
+std::vector<BasicMinimizer<Pos>> get_syncmers(std::string& sequence,SeedScheme& scheme,Pos posshift){
+  std::vector<BasicMinimizer<Pos>> syncmers;
+  int k_size=scheme.getK();
+  int s_size=scheme.getS();
+  int n_smers_per_kmer=k_size-s_size+1;
+  int64_t n_kmers=(int64_t)sequence.size()-k_size+1;
+  if(n_kmers<=0){
+    return syncmers;
+  }
+  uint64_t mask=kmer_mask(s_size);
+  KmerOrdering ordering=scheme.getOrdering();
+  //queue of (rank, position) of the s-mers with increasing ranks
+  std::deque<std::pair<uint64_t,int64_t>> smers;
+  uint64_t smer=0;
+  for(int64_t i=0;i<(int64_t)sequence.size();i++){
+    smer=((smer<<2)|encode_base(sequence[i]))&mask;
+    int64_t smer_pos=i-s_size+1;
+    if(smer_pos<0){
+      continue;
+    }
+    uint64_t rank=kmer_rank(smer,mask,ordering);
+    while(!smers.empty() && smers.back().first>rank){
+      smers.pop_back();
+    }
+    smers.push_back(std::make_pair(rank,smer_pos));
+    int64_t kmer_pos=smer_pos-n_smers_per_kmer+1;
+    if(kmer_pos<0){
+      continue;
+    }
+    if(smers.front().second<kmer_pos){
+      smers.pop_front();
+    }
+    int offset=smers.front().second-kmer_pos;
+    bool selected=(scheme.getType()==OPEN_SYNCMER) ? offset==scheme.getT() : (offset==0 || offset==k_size-s_size);
+    if(selected){
+      Pos position=posshift+kmer_pos;
+      std::string kmer=sequence.substr(kmer_pos,k_size);
+      syncmers.push_back(BasicMinimizer<Pos>(position,kmer));
+    }
+  }
+  return syncmers;
+}
+
+/*!
+ * Generate the randstrobes of order 2 of a sequence. A randstrobe is only generated for the positions whose
+ * whole window of second strobes lies in the sequence, so the seed at p only depends on the bases p ... p+w_max+k-1.
+ * Costs O(n*(w_max-w_min+1)).
+ * @param sequence:    the sequence for which randstrobes are to be generated
+ * @param scheme:      a RANDSTROBE scheme
+ * @param posshift:    the position of the first base of sequence in the whole sequence
+ *
+ * @return the randstrobes (position of the first strobe and the concatenation of both strobes) sorted by position
+ */
+template<class Pos>
+std::vector<BasicMinimizer<Pos>> get_randstrobes(std::string& sequence,SeedScheme& scheme,Pos posshift){
+  std::vector<BasicMinimizer<Pos>> strobes;
+  int k_size=scheme.getK();
+  int64_t n_strobes=(int64_t)sequence.size()-scheme.getSpan()+1;
+  if(n_strobes<=0){
+    return strobes;
+  }
+  uint64_t mask=kmer_mask(k_size);
+  int64_t n_kmers=(int64_t)sequence.size()-k_size+1;
+  std::vector<uint64_t> hashes(n_kmers);
+  uint64_t kmer=0;
+  for(int64_t i=0;i<(int64_t)sequence.size();i++){
+    kmer=((kmer<<2)|encode_base(sequence[i]))&mask;
+    if(i>=k_size-1){
+      hashes[i-k_size+1]=hash_kmer(kmer,mask);
+    }
+  }
+  for(int64_t p=0;p<n_strobes;p++){
+    int64_t second=p+scheme.getWMin();
+    uint64_t best=hashes[p]^hashes[second];
+    for(int64_t q=second+1;q<=p+scheme.getWMax();q++){
+      if((hashes[p]^hashes[q])<best){
+        best=hashes[p]^hashes[q];
+        second=q;
+      }
+    }
+    Pos position=posshift+p;
+    std::string strobe=sequence.substr(p,k_size)+sequence.substr(second,k_size);
+    strobes.push_back(BasicMinimizer<Pos>(position,strobe));
+  }
+  return strobes;
+}
+
+/*!
+ * Generate the seeds of a sequence for any scheme
+ * @param sequence:    the sequence for which seeds are to be generated
+ * @param scheme:      the seeding scheme
+ * @param posshift:    the position of the first base of sequence in the whole sequence
+ */
+template<class Pos=int>
+std::vector<BasicMinimizer<Pos>> get_seeds(std::string& sequence,SeedScheme& scheme,Pos posshift=0){
+  switch(scheme.getType()){
+    case WINDOW_MINIMIZER:{
+      int k_size=scheme.getK();
+      int w_size=scheme.getW();
+      return get_kmer_minimizers_algo(sequence,k_size,w_size,posshift);
+    }
+    case RANDSTROBE:
+      return get_randstrobes(sequence,scheme,posshift);
+    default:
+      return get_syncmers(sequence,scheme,posshift);
+  }
+}
+
+/*!
+ * Updating the B-tree after the sequence of a variation-impact-range was altered. Unlike window minimizers, the
+ * seeds of a syncmer or randstrobe scheme do not have to reach the border of the range, so the replaced seeds are
+ * given by the positions that are completely determined by fullsubseq instead of the first and last new seed.
+ * @param seedTree:          the B-tree to be updated
+ * @param fullsubseq:        the updated substring covering the variation-impact-range
+ * @param thisstartpos:      the index of the substrings starting position in the whole DNA sequence
+ * @param scheme:            an OPEN_SYNCMER, CLOSED_SYNCMER or RANDSTROBE scheme
+ * @param var_impact_shift:  the length by which subsequent seed keys have to be shifted
+ * @param journal:           (optional) undo journal recording the deleted, shifted and inserted seeds
+ * @param feed:              (optional) change feed receiving the deleted, shifted and inserted seeds
+ */
+template<class Pos>
+void update_seed_tree(B_tree<Pos,std::string,7,3>* seedTree,std::string& fullsubseq,Pos& thisstartpos,SeedScheme& scheme,typename position_traits<Pos>::delta_type& var_impact_shift,BasicUndoJournal<Pos>* journal=nullptr,BasicChangeFeed<Pos>* feed=nullptr){
+  typedef typename position_traits<Pos>::delta_type delta_t;
+  if(journal!=nullptr){
+    journal->beginTreeEdit(seedTree);
+  }
+  std::vector<BasicMinimizer<Pos>> newseeds=get_seeds(fullsubseq,scheme,thisstartpos);
+  //the last position whose seed is determined by the bases of the range before the update
+  delta_t last=(delta_t)thisstartpos+(delta_t)fullsubseq.size()-scheme.getSpan()-var_impact_shift;
+  if(!seedTree->is_empty() && last>=(delta_t)thisstartpos){
+    Pos right=(Pos)last;
+    B_tree<Pos,std::string,7,3>* removed=extract_minimizers(seedTree,thisstartpos,right);
+    if(journal!=nullptr || feed!=nullptr){
+      for(auto elem: *removed){
+        if(journal!=nullptr){
+          journal->recordRemovedMinimizer(elem.first,elem.second);
+        }
+        if(feed!=nullptr){
+          for(int s=0;s<(int)elem.second.size();s++){
+            feed->recordDeleted(elem.first,elem.second[s]);
+          }
+        }
+      }
+    }
+    delete removed;
+    auto suc=seedTree->successor(right);
+    if(suc.key!=nullptr && var_impact_shift!=0){
+      Pos suc_key=suc.shift_key().value;
+      Pos shift=var_impact_shift;
+      seedTree->shift_greater(suc_key,shift);
+      if(journal!=nullptr){
+        journal->recordShift(suc_key,var_impact_shift);
+      }
+      if(feed!=nullptr){
+        feed->recordShift(suc_key,var_impact_shift);
+      }
+    }
+  }
+  fill_minimizer_tree(seedTree,newseeds);
+  if(journal!=nullptr){
+    for(int i=0;i<(int)newseeds.size();i++){
+      journal->recordInsertedMinimizer(newseeds[i].getPosition());
+    }
+  }
+  if(feed!=nullptr){
+    for(int i=0;i<(int)newseeds.size();i++){
+      feed->recordInserted(newseeds[i].getPosition(),newseeds[i].getSequence());
+    }
+  }
+}
+
+/*!
+ * Dynamic seed algorithm for every scheme: window minimizers are handed to compute_dynamic_minimizers, syncmers and
+ * randstrobes use the variation-impact-ranges of getImpactW and update_seed_tree.
+ * @param seedTree:          B-tree holding the seeds
+ * @param dynamic_sequence:  the sequence to be altered
+ * @param variants:          Vector of variants which are applied to the sequence
+ * @param scheme:            the seeding scheme
+ * @param observers:         (optional) liftover, undo journal and change feed following the update, the k-mer counts
+ *                           are only followed for window minimizers
+ */
+template<class Pos>
+void compute_dynamic_seeds(B_tree<Pos,std::string,7,3>* seedTree,dyn::wt_str& dynamic_sequence,std::vector<BasicVariant<Pos>>& variants,SeedScheme& scheme,BasicUpdateObservers<Pos> observers=BasicUpdateObservers<Pos>()){
+  int k_size=scheme.getK();
+  int w_size=scheme.getImpactW();
+  if(scheme.getType()==WINDOW_MINIMIZER){
+    compute_dynamic_minimizers(seedTree,dynamic_sequence,variants,k_size,w_size,observers);
+    return;
+  }
+  apply_variants_to_dynamic_sequence(dynamic_sequence,variants,k_size,w_size,
+    [&](std::string& fullsubseq,Pos& thisstartpos,typename position_traits<Pos>::delta_type& var_impact_shift){
+      update_seed_tree(seedTree,fullsubseq,thisstartpos,scheme,var_impact_shift,observers.journal,observers.feed);
+    },observers.liftover,observers.journal);
+}
+
+#endif
@@ -0,0 +1,596 @@
+////////////////////////////////////////////////////////////////////////////////
+// snapshot.h
+//   snapshot header file.
+//
+//  memory-mappable snapshot of a minimizer B-tree and its sequence, which is thawed
+//  lazily into a mutable B-tree
+//
+////////////////////////////////////////////////////////////////////////////////
+//  author: Alexander Petri
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "main.h"
+#include "Variant.h"
+#include "Minimizer.h"
+#include "packed_kmers.h"
+#include "B-tree.hh"
+#include "B_tree_node.hh"
+#include "B_tree_operations.h"
+#include "dynamic_minimizer.h"
+#include "haplotype_export.h"
+#include "include/dynamic.hpp"
+
+#include <cstring>
+#include <limits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace md;
+
+/*
+* Layout of a snapshot file. All sections are 8 byte aligned and pointer-free:
+*
+*   header
+*   keys               int32_t[n_keys]              minimizer positions, relative to the shift of their block
+*   satellite_offsets  uint32_t[n_keys+1]           the satellites of key i are satellites[offsets[i]] ... [offsets[i+1]-1]
+*   satellites         uint64_t[n_satellites]       2 bit packed k-mers
+*   blocks             snapshot_block_t[n_blocks]   every block_size consecutive keys share one shift
+*   sequence           uint64_t[(length+31)/32]     2 bit packed bases
+*
+* The checksum is the 64 bit FNV-1a hash of the header (with the checksum field set to 0) and all bytes behind it.
+*/
+#define SNAPSHOT_MAGIC "MINISNAP"
+#define SNAPSHOT_VERSION 2
+#define SNAPSHOT_BLOCK_SIZE 256
+
+typedef struct t_snapshot_header{
+  char magic[8];
+  uint32_t version;
+  uint32_t k_size;
+  uint32_t w_size;
+  uint32_t block_size;
+  uint64_t n_keys;
+  uint64_t n_satellites;
+  uint64_t n_blocks;
+  uint64_t sequence_length;
+  uint64_t keys_offset;
+  uint64_t satellite_offsets_offset;
+  uint64_t satellites_offset;
+  uint64_t blocks_offset;
+  uint64_t sequence_offset;
+  uint64_t file_size;
+  uint64_t checksum;
+} snapshot_header_t;
+
+typedef struct t_snapshot_block{
+  uint32_t first_key;
+  int32_t shift;
+} snapshot_block_t;
+
+/*
+* returns the 64 bit FNV-1a hash of length bytes, continuing from hash
+*/
+uint64_t snapshot_checksum(const char* data,uint64_t length,uint64_t hash=14695981039346656037ULL){
+  for(uint64_t i=0;i<length;i++){
+    hash^=(uint8_t)data[i];
+    hash*=1099511628211ULL;
+  }
+  return hash;
+}
+
+/*
+* returns offset rounded up to a multiple of 8
+*/
+inline uint64_t snapshot_align(uint64_t offset){
+  return (offset+7)&~uint64_t(7);
+}
+
+/*
+* returns the checksum of a file with a header holding a checksum field: the header with the checksum set to 0,
+* followed by the length bytes behind the header
+*/
+template<class Header>
+uint64_t snapshot_file_checksum(const Header& header,const char* behind,uint64_t length){
+  Header copy=header;
+  copy.checksum=0;
+  return snapshot_checksum(behind,length,snapshot_checksum((const char*)&copy,sizeof(copy)));
+}
+
+/*
+* checks that a section of count elements of size bytes starting at offset is 8 byte aligned, starts behind the
+* previous section ending at end and ends inside a file of file_size bytes, without overflowing for any header
+* values. On success end is moved behind the section.
+*/
+inline bool snapshot_section_fits(uint64_t offset,uint64_t count,uint64_t size,uint64_t file_size,uint64_t& end){
+  if(offset<end || offset>file_size || (offset&7)!=0 || count>(file_size-offset)/size){
+    return false;
+  }
+  end=offset+count*size;
+  return true;
+}
+
+/*!
+ * Write the minimizers of a B-tree and the sequence into a snapshot file. The shifts of the B-tree are resolved,
+ * so the blocks of the written snapshot all have shift 0. Bases other than A, C, G and T are stored as A.
+ * @param path:               the path of the snapshot file
+ * @param minimizerTree:      the B-tree holding the minimizers
+ * @param dynamic_sequence:   the sequence
+ * @param k_size:             k-mer length (at most 32)
+ * @param w_size:             window size
+ *
+ * @return true if the snapshot was written
+ */
+bool write_minimizer_snapshot(std::string& path,B_tree<int,std::string,7,3>* minimizerTree,dyn::wt_str& dynamic_sequence,int& k_size,int& w_size){
+  assert(k_size>0 && k_size<=32);
+  std::vector<int32_t> keys;
+  std::vector<uint32_t> satellite_offsets(1,0);
+  std::vector<uint64_t> satellites;
+  if(!minimizerTree->is_empty()){
+    for(auto elem: *minimizerTree){
+      keys.push_back(elem.first);
+      for(int i=0;i<(int)elem.second.size();i++){
+        satellites.push_back(pack_kmer(elem.second[i],0,k_size));
+      }
+      satellite_offsets.push_back(satellites.size());
+    }
+  }
+  std::vector<snapshot_block_t> blocks;
+  for(uint64_t i=0;i<keys.size();i+=SNAPSHOT_BLOCK_SIZE){
+    snapshot_block_t block;
+    block.first_key=i;
+    block.shift=0;
+    blocks.push_back(block);
+  }
+  uint64_t length=dynamic_sequence.size();
+  std::vector<uint64_t> sequence((length+31)/32,0);
+  std::string sequence_name="";
+  export_haplotype(dynamic_sequence,(char*)sequence.data(),sequence_name,HAPLOTYPE_TWO_BIT);
+  //compute the layout
+  snapshot_header_t header;
+  memset(&header,0,sizeof(header));
+  memcpy(header.magic,SNAPSHOT_MAGIC,8);
+  header.version=SNAPSHOT_VERSION;
+  header.k_size=k_size;
+  header.w_size=w_size;
+  header.block_size=SNAPSHOT_BLOCK_SIZE;
+  header.n_keys=keys.size();
+  header.n_satellites=satellites.size();
+  header.n_blocks=blocks.size();
+  header.sequence_length=length;
+  header.keys_offset=snapshot_align(sizeof(header));
+  header.satellite_offsets_offset=snapshot_align(header.keys_offset+keys.size()*sizeof(int32_t));
+  header.satellites_offset=snapshot_align(header.satellite_offsets_offset+satellite_offsets.size()*sizeof(uint32_t));
+  header.blocks_offset=snapshot_align(header.satellites_offset+satellites.size()*sizeof(uint64_t));
+  header.sequence_offset=snapshot_align(header.blocks_offset+blocks.size()*sizeof(snapshot_block_t));
+  header.file_size=header.sequence_offset+sequence.size()*sizeof(uint64_t);
+  //assemble the padding and the payload behind the header
+  std::vector<char> payload(header.file_size-sizeof(header),0);
+  char* base=payload.data()-sizeof(header);
+  memcpy(base+header.keys_offset,keys.data(),keys.size()*sizeof(int32_t));
+  memcpy(base+header.satellite_offsets_offset,satellite_offsets.data(),satellite_offsets.size()*sizeof(uint32_t));
+  memcpy(base+header.satellites_offset,satellites.data(),satellites.size()*sizeof(uint64_t));
+  memcpy(base+header.blocks_offset,blocks.data(),blocks.size()*sizeof(snapshot_block_t));
+  memcpy(base+header.sequence_offset,sequence.data(),sequence.size()*sizeof(uint64_t));
+  header.checksum=snapshot_file_checksum(header,payload.data(),payload.size());
+  std::ofstream out(path,std::ios::binary|std::ios::trunc);
+  if(!out){
+    cout<<"Could not write snapshot "<<path<<"\n";
+    return false;
+  }
+  out.write((const char*)&header,sizeof(header));
+  out.write(payload.data(),payload.size());
+  return out.good();
+}
+
+/*
+* Read-only view of a snapshot file mapped into memory. Opening maps the file and checks the header, the layout of
+* the sections (and the checksum if requested), nothing is copied or rebuilt.
+*
+* @param data       the mapped file
+* @param header     the header of the file
+*/
+class MinimizerSnapshot{
+private:
+  char* data;
+  uint64_t mapped_size;
+  snapshot_header_t* header;
+
+  const int32_t* keys() const{
+    return (const int32_t*)(data+header->keys_offset);
+  }
+  const uint32_t* satellite_offsets() const{
+    return (const uint32_t*)(data+header->satellite_offsets_offset);
+  }
+  const uint64_t* satellites() const{
+    return (const uint64_t*)(data+header->satellites_offset);
+  }
+  const snapshot_block_t* blocks() const{
+    return (const snapshot_block_t*)(data+header->blocks_offset);
+  }
+  const uint64_t* sequence() const{
+    return (const uint64_t*)(data+header->sequence_offset);
+  }
+
+public:
+  // Constructor
+  MinimizerSnapshot(){
+    data=nullptr;
+    mapped_size=0;
+    header=nullptr;
+  }
+  // Destructor
+  ~MinimizerSnapshot(){
+    close();
+  }
+  MinimizerSnapshot(const MinimizerSnapshot&) = delete;
+  MinimizerSnapshot& operator=(const MinimizerSnapshot&) = delete;
+
+  /*!
+   * Map a snapshot file read-only into memory
+   * @param path:     the path of the snapshot file
+   * @param verify:   if true the checksum of the whole file is verified. The layout (the sections lie inside the
+   *                  file and match the counts of the header) is checked either way, so the accessors never read
+   *                  outside the mapping.
+   *
+   * @return true if the snapshot was opened
+   */
+  bool open(std::string& path,bool verify=true){
+    close();
+    int fd=::open(path.c_str(),O_RDONLY);
+    if(fd<0){
+      cout<<"Could not open snapshot "<<path<<"\n";
+      return false;
+    }
+    struct stat st;
+    if(fstat(fd,&st)!=0 || (uint64_t)st.st_size<sizeof(snapshot_header_t)){
+      cout<<"Snapshot "<<path<<" is too small\n";
+      ::close(fd);
+      return false;
+    }
+    void* mapped=mmap(nullptr,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+    ::close(fd);
+    if(mapped==MAP_FAILED){
+      cout<<"Could not map snapshot "<<path<<"\n";
+      return false;
+    }
+    data=(char*)mapped;
+    mapped_size=st.st_size;
+    header=(snapshot_header_t*)data;
+    if(memcmp(header->magic,SNAPSHOT_MAGIC,8)!=0 || header->version!=SNAPSHOT_VERSION || header->file_size!=mapped_size){
+      cout<<"Snapshot "<<path<<" has an unknown format\n";
+      close();
+      return false;
+    }
+    //every section has to lie inside the file behind the previous one and match the counts of the header
+    uint64_t end=sizeof(snapshot_header_t);
+    uint64_t words=header->sequence_length/32+(header->sequence_length%32!=0);
+    bool fits=header->k_size>0 && header->k_size<=32 && header->block_size>0 && header->n_keys<(uint64_t)std::numeric_limits<int>::max()
+      && header->n_satellites<=std::numeric_limits<uint32_t>::max() && header->sequence_length<=(uint64_t)std::numeric_limits<int>::max()
+      && header->n_blocks==header->n_keys/header->block_size+(header->n_keys%header->block_size!=0)
+      && snapshot_section_fits(header->keys_offset,header->n_keys,sizeof(int32_t),mapped_size,end)
+      && snapshot_section_fits(header->satellite_offsets_offset,header->n_keys+1,sizeof(uint32_t),mapped_size,end)
+      && snapshot_section_fits(header->satellites_offset,header->n_satellites,sizeof(uint64_t),mapped_size,end)
+      && snapshot_section_fits(header->blocks_offset,header->n_blocks,sizeof(snapshot_block_t),mapped_size,end)
+      && snapshot_section_fits(header->sequence_offset,words,sizeof(uint64_t),mapped_size,end);
+    //the satellites of every key have to lie inside the satellite section
+    for(uint64_t i=0;fits && i<header->n_keys;i++){
+      fits=satellite_offsets()[i]<=satellite_offsets()[i+1];
+    }
+    for(uint64_t b=0;fits && b<header->n_blocks;b++){
+      fits=blocks()[b].first_key==b*header->block_size;
+    }
+    if(!fits || satellite_offsets()[0]!=0 || satellite_offsets()[header->n_keys]!=header->n_satellites){
+      cout<<"Snapshot "<<path<<" has an invalid layout\n";
+      close();
+      return false;
+    }
+    if(verify && snapshot_file_checksum(*header,data+sizeof(snapshot_header_t),header->file_size-sizeof(snapshot_header_t))!=header->checksum){
+      cout<<"Snapshot "<<path<<" is corrupted\n";
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  /*
+  * unmaps the snapshot
+  */
+  void close(){
+    if(data!=nullptr){
+      munmap(data,mapped_size);
+    }
+    data=nullptr;
+    mapped_size=0;
+    header=nullptr;
+  }
+
+  /*
+  * returns true if a snapshot is mapped
+  */
+  bool is_open() const{
+    return data!=nullptr;
+  }
+
+  int getK() const{
+    return header->k_size;
+  }
+  int getW() const{
+    return header->w_size;
+  }
+  /*
+  * returns the number of minimizer positions
+  */
+  int getNumberOfKeys() const{
+    return header->n_keys;
+  }
+  /*
+  * returns the number of blocks sharing a shift
+  */
+  int getNumberOfBlocks() const{
+    return header->n_blocks;
+  }
+  int getBlockSize() const{
+    return header->block_size;
+  }
+  /*
+  * returns the index of the first key of block b
+  */
+  int getBlockStart(int b) const{
+    return blocks()[b].first_key;
+  }
+  /*
+  * returns the index behind the last key of block b
+  */
+  int getBlockEnd(int b) const{
+    return b+1<(int)header->n_blocks ? blocks()[b+1].first_key : header->n_keys;
+  }
+  /*
+  * returns the shift stored for block b
+  */
+  int getBlockShift(int b) const{
+    return blocks()[b].shift;
+  }
+  /*
+  * returns the position of minimizer i
+  */
+  int getKey(int i) const{
+    return keys()[i]+blocks()[i/header->block_size].shift;
+  }
+  /*
+  * returns the satellites (k-mers) of minimizer i
+  */
+  std::vector<std::string> getSatellites(int i) const{
+    std::vector<std::string> result;
+    for(uint32_t j=satellite_offsets()[i];j<satellite_offsets()[i+1];j++){
+      result.push_back(unpack_kmer(satellites()[j],header->k_size));
+    }
+    return result;
+  }
+  /*
+  * returns the index of the first minimizer with a position >= pos
+  */
+  int lower_bound(int pos) const{
+    int lo=0;
+    int hi=header->n_keys;
+    while(lo<hi){
+      int mid=(lo+hi)/2;
+      if(getKey(mid)<pos){
+        lo=mid+1;
+      }
+      else{
+        hi=mid;
+      }
+    }
+    return lo;
+  }
+  /*
+  * returns the length of the sequence
+  */
+  int getSequenceLength() const{
+    return header->sequence_length;
+  }
+  /*
+  * returns the base at position i of the sequence
+  */
+  char getBase(int i) const{
+    return decode_base(sequence()[i/32]>>(2*(i%32)));
+  }
+  /*
+  * returns the bases left ... right of the sequence
+  */
+  std::string getSequence(int left,int right) const{
+    std::string result;
+    result.reserve(right-left+1);
+    for(int i=left;i<=right;i++){
+      result+=getBase(i);
+    }
+    return result;
+  }
+
+  /*!
+   * Append the sequence of the snapshot to an (empty) dynamic sequence
+   * @param dynamic_sequence:   the dynamic sequence
+   */
+  void thaw_sequence(dyn::wt_str& dynamic_sequence) const{
+    for(int i=0;i<(int)header->sequence_length;i++){
+      dynamic_sequence.push_back(getBase(i));
+    }
+  }
+};
+
+/*
+* Minimizer B-tree, which is thawed lazily from a snapshot. The B-tree only holds the minimizers of the blocks
+* which have been touched by an update, all other blocks stay in the mapped file. Shifts of frozen blocks are kept in
+* a Fenwick tree (one suffix update per shift), so shifting never thaws a block.
+*
+* @param snapshot       the mapped snapshot
+* @param minimizerTree  the B-tree holding the thawed minimizers
+* @param frozen         the indices of the blocks which are not thawed yet, in increasing order
+* @param pending_shift  Fenwick tree holding the shifts applied to the frozen blocks since the snapshot was opened
+*/
+class LazyMinimizerTree{
+private:
+  const MinimizerSnapshot* snapshot;
+  B_tree<int,std::string,7,3>* minimizerTree;
+  std::vector<int> frozen;
+  std::vector<int> pending_shift;
+
+  /*
+  * returns the shift applied to block b since the snapshot was opened
+  */
+  int getPendingShift(int b){
+    int shift=0;
+    for(int i=b+1;i>0;i-=i&(-i)){
+      shift+=pending_shift[i];
+    }
+    return shift;
+  }
+
+  /*
+  * adds shift to the blocks b ... n_blocks-1
+  */
+  void addPendingShift(int b,int shift){
+    for(int i=b+1;i<(int)pending_shift.size();i+=i&(-i)){
+      pending_shift[i]+=shift;
+    }
+  }
+
+  /*
+  * returns the current position of minimizer i of the frozen block b
+  */
+  int getKey(int b,int i){
+    return snapshot->getKey(i)+getPendingShift(b);
+  }
+
+  /*
+  * inserts the minimizers of the frozen block frozen[f] into the B-tree
+  */
+  void thaw_block(int f){
+    int b=frozen[f];
+    for(int i=snapshot->getBlockStart(b);i<snapshot->getBlockEnd(b);i++){
+      int position=getKey(b,i);
+      std::vector<std::string> satellites=snapshot->getSatellites(i);
+      for(int j=0;j<(int)satellites.size();j++){
+        minimizerTree->insert(position,satellites[j]);
+      }
+    }
+    frozen.erase(frozen.begin()+f);
+  }
+
+public:
+  // Constructor
+  LazyMinimizerTree(const MinimizerSnapshot* snap){
+    snapshot=snap;
+    minimizerTree=new B_tree<int,std::string,7,3>();
+    for(int b=0;b<snapshot->getNumberOfBlocks();b++){
+      frozen.push_back(b);
+    }
+    pending_shift.assign(snapshot->getNumberOfBlocks()+1,0);
+  }
+  // Destructor
+  ~LazyMinimizerTree(){
+    delete minimizerTree;
+  }
+  LazyMinimizerTree(const LazyMinimizerTree&) = delete;
+  LazyMinimizerTree& operator=(const LazyMinimizerTree&) = delete;
+
+  /*!
+   * Thaw all blocks holding minimizers with left<=position<=right and the block holding the successor of right,
+   * so that every minimizer an update of this range deletes or looks up is in the B-tree. Only the frozen blocks are
+   * searched, their positions are exact and increasing, as updates only shift the blocks behind the updated range.
+   * @param left:    the lower bound of the range
+   * @param right:   the upper bound of the range
+   *
+   * @return the first block behind the thawed range, all frozen blocks from there on lie behind right
+   */
+  int thaw_range(int left,int right){
+    //find the first frozen block whose last minimizer is >= left
+    int lo=0;
+    int hi=frozen.size();
+    while(lo<hi){
+      int mid=(lo+hi)/2;
+      if(getKey(frozen[mid],snapshot->getBlockEnd(frozen[mid])-1)<left){
+        lo=mid+1;
+      }
+      else{
+        hi=mid;
+      }
+    }
+    while(lo<(int)frozen.size() && getKey(frozen[lo],snapshot->getBlockStart(frozen[lo]))<=right){
+      thaw_block(lo);
+    }
+    if(lo<(int)frozen.size()){
+      int next_block=frozen[lo]+1;
+      thaw_block(lo);
+      return next_block;
+    }
+    if(!frozen.empty()){
+      //the range lies behind all frozen minimizers, the last one is needed as the maximum of the B-tree
+      thaw_block(frozen.size()-1);
+    }
+    return snapshot->getNumberOfBlocks();
+  }
+
+  /*!
+   * Shift all frozen blocks from block b on
+   * @param b:       the first block to be shifted
+   * @param shift:   the shift
+   */
+  void shift_frozen(int b,int shift){
+    if(b<snapshot->getNumberOfBlocks()){
+      addPendingShift(b,shift);
+    }
+  }
+
+  /*!
+   * Thaw all blocks, afterwards the B-tree holds all minimizers
+   */
+  B_tree<int,std::string,7,3>* thaw_all(){
+    while(!frozen.empty()){
+      thaw_block(frozen.size()-1);
+    }
+    return minimizerTree;
+  }
+
+  /*
+  * returns the B-tree holding the thawed minimizers
+  */
+  B_tree<int,std::string,7,3>* getTree(){
+    return minimizerTree;
+  }
+
+  /*
+  * returns the number of thawed blocks
+  */
+  int getNumberOfThawedBlocks(){
+    return snapshot->getNumberOfBlocks()-frozen.size();
+  }
+};
+
+/*!
+ * Implementation of the dynamic minimizer algorithm on a lazily thawed snapshot. Every variation-impact-range only
+ * thaws the blocks holding the minimizers it replaces, the minimizers behind it are shifted inside the B-tree and as
+ * pending shift of the frozen blocks.
+ * @param lazyTree:          the lazily thawed minimizer tree
+ * @param dynamic_sequence:  the (thawed) sequence to be altered
+ * @param variants:          Vector of variants which are applied to the sequence
+ * @param k_size:            k-mer length
+ * @param w_size:            window size
+ */
+void compute_dynamic_minimizers_lazy(LazyMinimizerTree& lazyTree,dyn::wt_str& dynamic_sequence,std::vector<Variant>& variants,int& k_size,int& w_size){
+  apply_variants_to_dynamic_sequence(dynamic_sequence,variants,k_size,w_size,
+    [&](std::string& fullsubseq,int& thisstartpos,int& var_impact_shift){
+      std::vector<Minimizer> newminis=get_kmer_minimizers_algo(fullsubseq,k_size,w_size,thisstartpos);
+      int left=(thisstartpos==0) ? std::numeric_limits<int>::min() : newminis.front().getPosition();
+      int right=newminis.back().getPosition()-var_impact_shift;
+      int next_block=lazyTree.thaw_range(left,right);
+      update_minimizerTree_with_minimizers(lazyTree.getTree(),newminis,thisstartpos,var_impact_shift);
+      lazyTree.shift_frozen(next_block,var_impact_shift);
+    });
+}
+
+#endif
@@ -0,0 +1,143 @@
+////////////////////////////////////////////////////////////////////////////////
+// streaming_minimizer.h
+//   Algorithm header file.
+//
+// Append-only fast path for growing sequences. The sliding window of the last k-mers
+// stays resident, so appended bases produce their minimizers in amortized O(1) and
+// the new minimizers are attached to the right edge of the B-tree in one join.
+//
+////////////////////////////////////////////////////////////////////////////////
+// author: Alexander Petri
+
+#ifndef STREAMING_MINIMIZER_H
+#define STREAMING_MINIMIZER_H
+
+#include "main.h"
+#include "Minimizer.h"
+#include "packed_kmers.h"
+#include "B-tree.hh"
+#include "B_tree_node.hh"
+#include "B_tree_operations.h"
+#include "dynseq_functions.h"
+#include "include/dynamic.hpp"
+
+#include <deque>
+
+using namespace md;
+
+/*
+* Class appending bases to a sequence and its minimizer B-tree. The sliding window state (the last k-1 bases as packed
+* k-mer and a monotone queue of the candidate k-mers of the current window) is kept between calls, so appending does
+* neither use the variation-impact-range of compute_dynamic_minimizers nor regenerate any existing minimizer.
+* All minimizers of one call are collected in a B-tree of their own, which is joined to the right edge of the
+* minimizer tree, instead of descending from the root once per minimizer.
+* The B-tree and the sequence must not be altered by other functions while the appender is in use, and the sequence
+* has to be empty or at least w_size bases long when the appender is created.
+*
+* @param minimizerTree      the B-tree holding the minimizers
+* @param dynamic_sequence   the sequence to be extended
+* @param k_size             k-mer length
+* @param w_size             window size
+* @param ordering           the order in which the k-mers are compared
+* @param window             queue of (rank, position, packed k-mer) with increasing ranks
+* @param kmer               the packed k-mer ending at the last base
+* @param loaded             the number of bases in kmer (at most k_size)
+* @param length             the length of the sequence
+* @param last_pos           the position of the last minimizer
+*/
+class MinimizerAppender{
+private:
+  B_tree<int,std::string,7,3>* minimizerTree;
+  dyn::wt_str* dynamic_sequence;
+  int k_size;
+  int w_size;
+  KmerOrdering ordering;
+  uint64_t mask;
+  std::deque<std::tuple<uint64_t,int,uint64_t>> window;
+  uint64_t kmer;
+  int loaded;
+  int length;
+  int last_pos;
+
+  /*
+  * moves the window by one base and appends the minimizer of the new window to minimizers if it is a new one
+  * (minimizers is nullptr while the state is restored)
+  */
+  void push_base(uint8_t code,std::vector<Minimizer>* minimizers){
+    int w=w_size-k_size+1;
+    kmer=((kmer<<2)|code)&mask;
+    length++;
+    if(loaded<k_size){
+      loaded++;
+    }
+    if(loaded<k_size){
+      return;
+    }
+    int i=length-k_size;
+    uint64_t rank=kmer_rank(kmer,mask,ordering);
+    while(!window.empty() && std::get<0>(window.back())>rank){
+      window.pop_back();
+    }
+    window.push_back(std::make_tuple(rank,i,kmer));
+    if(std::get<1>(window.front())<=i-w){
+      window.pop_front();
+    }
+    //while the state is restored the windows are incomplete and their minimizers are already in the tree
+    if(minimizers!=nullptr && i>=w-1 && std::get<1>(window.front())!=last_pos){
+      last_pos=std::get<1>(window.front());
+      std::string sequence=unpack_kmer(std::get<2>(window.front()),k_size);
+      minimizers->push_back(Minimizer(last_pos,sequence));
+    }
+  }
+
+public:
+  // Constructor, restores the window state from the last w_size-1 bases of the sequence
+  MinimizerAppender(B_tree<int,std::string,7,3>* tree,dyn::wt_str* sequence,int k,int w,KmerOrdering order=LEXICOGRAPHIC){
+    assert(k>0 && k<=32 && w>k);
+    minimizerTree=tree;
+    dynamic_sequence=sequence;
+    k_size=k;
+    w_size=w;
+    ordering=order;
+    mask=kmer_mask(k_size);
+    kmer=0;
+    loaded=0;
+    int n=dynamic_sequence->size();
+    int start=std::max(0,n-(w_size-1));
+    length=start;
+    last_pos=minimizerTree->is_empty() ? -1 : minimizerTree->get_max();
+    for(int i=start;i<n;i++){
+      push_base(encode_base(dynamic_sequence->at(i)),nullptr);
+    }
+  }
+
+  /*!
+   * Append bases to the sequence and add the minimizers of all new windows to the B-tree
+   * @param bases:    the bases to be appended
+   *
+   * @return the number of new minimizers
+   */
+  int append(std::string& bases){
+    std::vector<Minimizer> minimizers;
+    for(int i=0;i<(int)bases.size();i++){
+      push_base(encode_base(bases[i]),&minimizers);
+    }
+    dynseq_push_many(*dynamic_sequence,bases);
+    if(!minimizers.empty()){
+      //all new minimizers lie behind the last minimizer of the tree
+      B_tree<int,std::string,7,3>* rhs=new B_tree<int,std::string,7,3>();
+      fill_minimizer_tree(rhs,minimizers);
+      minimizerTree->join(rhs);
+    }
+    return minimizers.size();
+  }
+
+  /*
+  * returns the length of the sequence
+  */
+  int getLength(){
+    return length;
+  }
+};
+
+#endif
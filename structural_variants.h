@@ -0,0 +1,276 @@
+////////////////////////////////////////////////////////////////////////////////
+// structural_variants.h
+//   Algorithm header file.
+//
+// Structural variants (large deletions, translocations and inversions) applied to the
+// sequence and the minimizer B-tree. Whole blocks of minimizers are moved by splitting,
+// shifting and joining the B-tree, only the windows around the breakpoints are recomputed.
+//
+////////////////////////////////////////////////////////////////////////////////
+// author: Alexander Petri
+
+#ifndef STRUCTURAL_VARIANTS_H
+#define STRUCTURAL_VARIANTS_H
+
+#include "main.h"
+#include "Minimizer.h"
+#include "get_kmer_minimizers.h"
+#include "B-tree.hh"
+#include "B_tree_node.hh"
+#include "B_tree_operations.h"
+#include "dynseq_functions.h"
+#include "include/dynamic.hpp"
+
+using namespace md;
+
+/*
+* The kinds of structural variants
+*/
+enum StructuralVariantType{
+  DELETION,
+  TRANSLOCATION,
+  INVERSION
+};
+
+/*
+* Class to define a structural variant. Positions are 0-based positions in the sequence the variant is applied to.
+*
+* @param type          the kind of the structural variant
+* @param position      the position of the first base of the affected block
+* @param length        the length of the affected block
+* @param destination   (translocations only) the position in front of which the block is moved,
+*                      must not lie inside the block
+*
+*/
+class StructuralVariant{
+private:
+  StructuralVariantType type;
+  int position;
+  int length;
+  int destination;
+public:
+  // Constructor
+  StructuralVariant(StructuralVariantType t, int pos, int len, int dest=0){
+    assert(pos>=0 && len>0);
+    assert(t!=TRANSLOCATION || dest<=pos || dest>=pos+len);
+    type=t;
+    position=pos;
+    length=len;
+    destination=dest;
+  }
+  /*
+  *returns the kind of the structural variant
+  */
+  StructuralVariantType getType(){
+    return type;
+  }
+  /*
+  *returns the position of the first base of the block
+  */
+  int getPosition(){
+    return position;
+  }
+  /*
+  *returns the length of the block
+  */
+  int getLength(){
+    return length;
+  }
+  /*
+  *returns the position in front of which a translocated block is moved
+  */
+  int getDestination(){
+    return destination;
+  }
+  /*
+  * prints the structural variant to the console
+  *
+  *Output: Structural variant type at position, length: length(, destination: destination)
+  */
+  void printStructuralVariant(){
+    const char* names[3]={"deletion","translocation","inversion"};
+    cout<<"Structural variant "<<names[type]<<" at "<<position<<", length: "<<length;
+    if(type==TRANSLOCATION){
+      cout<<", destination: "<<destination;
+    }
+    cout<<"\n";
+  }
+};
+
+/*
+* returns the reverse complement of a sequence
+*/
+std::string reverse_complement(std::string& sequence){
+  std::string rc(sequence.size(),'N');
+  for(int i=0;i<(int)sequence.size();i++){
+    char base=sequence[sequence.size()-1-i];
+    switch(base){
+      case 'A': rc[i]='T'; break;
+      case 'C': rc[i]='G'; break;
+      case 'G': rc[i]='C'; break;
+      case 'T': rc[i]='A'; break;
+      default: rc[i]=base;
+    }
+  }
+  return rc;
+}
+
+/*!
+ * Recompute the minimizers of all windows overlapping the bases left-1 ... right of the (already altered) sequence.
+ * A junction between two blocks at position J is repaired with left=right=J. The minimizers in a margin of two window
+ * sizes around the range are detached from the B-tree and replaced by the minimizers of the corresponding substring,
+ * every minimizer outside of the margin is reported by a window which did not change.
+ * @param minimizerTree:     the B-tree holding the minimizers
+ * @param dynamic_sequence:  the altered sequence
+ * @param left:              the first altered position
+ * @param right:             the position behind the last altered position
+ * @param k_size:            k-mer length
+ * @param w_size:            window size
+ */
+void recompute_breakpoint_minimizers(B_tree<int,std::string,7,3>* minimizerTree,dyn::wt_str& dynamic_sequence,int left,int right,int& k_size,int& w_size){
+  int n=dynamic_sequence.size();
+  int w=w_size-k_size+1;
+  //the substring the minimizers are generated from
+  int a=std::max(0,left-2*w_size);
+  int b=std::min(n-1,right+2*w_size);
+  if(n<w_size){
+    a=0;
+    b=n-1;
+  }
+  //the keys which are only reported by windows inside the substring (all keys lie in 0 ... n-k_size)
+  int first_key=(a==0) ? 0 : a+w-1;
+  int last_key=(b==n-1) ? n : b-w_size+1;
+  delete extract_minimizers(minimizerTree,first_key,last_key);
+  if(n<k_size){
+    return;
+  }
+  std::string subsequence=dynseq_get_substr(dynamic_sequence,a,b);
+  std::vector<Minimizer> minimizers=get_kmer_minimizers_algo(subsequence,k_size,w_size,a);
+  for(int i=0;i<(int)minimizers.size();i++){
+    int position=minimizers[i].getPosition();
+    if(position>=first_key && position<=last_key){
+      std::string sequence=minimizers[i].getSequence();
+      minimizerTree->insert(position,sequence);
+    }
+  }
+}
+
+/*!
+ * Apply a large deletion. The minimizers inside the deleted block are detached from the B-tree with two splits,
+ * the minimizers behind the block are shifted as one subtree and both parts are joined again, so the B-tree is updated
+ * in O(log n + w) independent of the length of the deletion.
+ * @param minimizerTree:     the B-tree holding the minimizers
+ * @param dynamic_sequence:  the sequence to be altered
+ * @param position:          the position of the first deleted base
+ * @param length:            the number of deleted bases
+ * @param k_size:            k-mer length
+ * @param w_size:            window size
+ *
+ * @return the B-tree holding the minimizers of the deleted block at their old positions (owned by the caller)
+ */
+B_tree<int,std::string,7,3>* apply_large_deletion(B_tree<int,std::string,7,3>* minimizerTree,dyn::wt_str& dynamic_sequence,int position,int length,int& k_size,int& w_size){
+  assert(position>=0 && position+length<=(int)dynamic_sequence.size());
+  B_tree<int,std::string,7,3>* deleted=minimizerTree->split(position-1);
+  B_tree<int,std::string,7,3>* rhs=deleted->split(position+length-1);
+  int shift=-length;
+  rhs->shift(shift);
+  minimizerTree->join(rhs);
+  dynseq_update_substr(dynamic_sequence,position,position+length,"");
+  recompute_breakpoint_minimizers(minimizerTree,dynamic_sequence,position,position,k_size,w_size);
+  return deleted;
+}
+
+/*!
+ * Apply a translocation, which moves the block position ... position+length-1 in front of destination. The B-tree is
+ * split into the block, the part between block and destination and the two outer parts. The block and the part in
+ * between are shifted as whole subtrees and joined in their new order, then the three new junctions are recomputed.
+ * @param minimizerTree:     the B-tree holding the minimizers
+ * @param dynamic_sequence:  the sequence to be altered
+ * @param position:          the position of the first base of the block
+ * @param length:            the length of the block
+ * @param destination:       the position (before the move) in front of which the block is inserted
+ * @param k_size:            k-mer length
+ * @param w_size:            window size
+ */
+void apply_translocation(B_tree<int,std::string,7,3>* minimizerTree,dyn::wt_str& dynamic_sequence,int position,int length,int destination,int& k_size,int& w_size){
+  assert(position>=0 && position+length<=(int)dynamic_sequence.size());
+  assert(destination<=position || destination>=position+length);
+  assert(destination>=0 && destination<=(int)dynamic_sequence.size());
+  if(destination==position || destination==position+length){
+    return;
+  }
+  //the outer part in front of the moved region, the first and the second moved part and the outer part behind
+  int first=std::min(position,destination);
+  int middle=(destination<position) ? position : position+length;
+  int last=(destination<position) ? position+length : destination;
+  B_tree<int,std::string,7,3>* first_part=minimizerTree->split(first-1);
+  B_tree<int,std::string,7,3>* second_part=first_part->split(middle-1);
+  B_tree<int,std::string,7,3>* outer_part=second_part->split(last-1);
+  //swap the two inner parts
+  int first_shift=last-middle;
+  int second_shift=first-middle;
+  first_part->shift(first_shift);
+  second_part->shift(second_shift);
+  minimizerTree->join(second_part);
+  minimizerTree->join(first_part);
+  minimizerTree->join(outer_part);
+  //move the bases
+  std::string block=dynseq_get_substr(dynamic_sequence,first,middle-1);
+  dynseq_update_substr(dynamic_sequence,first,middle,"");
+  int insert_position=first+(last-middle);
+  dynseq_update_substr(dynamic_sequence,insert_position,insert_position,block);
+  //recompute the windows around the new junctions
+  int junction=first+(last-middle);
+  recompute_breakpoint_minimizers(minimizerTree,dynamic_sequence,first,first,k_size,w_size);
+  recompute_breakpoint_minimizers(minimizerTree,dynamic_sequence,junction,junction,k_size,w_size);
+  recompute_breakpoint_minimizers(minimizerTree,dynamic_sequence,last,last,k_size,w_size);
+}
+
+/*!
+ * Apply an inversion, which replaces the block position ... position+length-1 by its reverse complement. The old
+ * minimizers of the block are detached with two splits and replaced by the recomputed minimizers of the inverted block
+ * and its breakpoints.
+ * @param minimizerTree:     the B-tree holding the minimizers
+ * @param dynamic_sequence:  the sequence to be altered
+ * @param position:          the position of the first base of the block
+ * @param length:            the length of the block
+ * @param k_size:            k-mer length
+ * @param w_size:            window size
+ */
+void apply_inversion(B_tree<int,std::string,7,3>* minimizerTree,dyn::wt_str& dynamic_sequence,int position,int length,int& k_size,int& w_size){
+  assert(position>=0 && position+length<=(int)dynamic_sequence.size());
+  std::string block=dynseq_get_substr(dynamic_sequence,position,position+length-1);
+  std::string inverted=reverse_complement(block);
+  //the wavelet tree string does not support set, so only the changed bases are removed and reinserted
+  for(int i=0;i<length;i++){
+    if(inverted[i]!=block[i]){
+      dynamic_sequence.remove(position+i);
+      dynamic_sequence.insert(position+i,inverted[i]);
+    }
+  }
+  recompute_breakpoint_minimizers(minimizerTree,dynamic_sequence,position,position+length,k_size,w_size);
+}
+
+/*!
+ * Apply a structural variant to the sequence and the minimizer B-tree
+ * @param minimizerTree:     the B-tree holding the minimizers
+ * @param dynamic_sequence:  the sequence to be altered
+ * @param variant:           the structural variant
+ * @param k_size:            k-mer length
+ * @param w_size:            window size
+ */
+void apply_structural_variant(B_tree<int,std::string,7,3>* minimizerTree,dyn::wt_str& dynamic_sequence,StructuralVariant& variant,int& k_size,int& w_size){
+  switch(variant.getType()){
+    case DELETION:
+      delete apply_large_deletion(minimizerTree,dynamic_sequence,variant.getPosition(),variant.getLength(),k_size,w_size);
+      break;
+    case TRANSLOCATION:
+      apply_translocation(minimizerTree,dynamic_sequence,variant.getPosition(),variant.getLength(),variant.getDestination(),k_size,w_size);
+      break;
+    case INVERSION:
+      apply_inversion(minimizerTree,dynamic_sequence,variant.getPosition(),variant.getLength(),k_size,w_size);
+      break;
+  }
+}
+
+#endif
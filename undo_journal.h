@@ -0,0 +1,205 @@
+////////////////////////////////////////////////////////////////////////////////
+// undo_journal.h
+//   undo journal header file.
+//
+//  records the changes applied by the dynamic minimizer algorithm, so that they can be reverted
+//
+////////////////////////////////////////////////////////////////////////////////
+//  author: Alexander Petri
+
+#ifndef UNDO_JOURNAL_H
+#define UNDO_JOURNAL_H
+
+#include "main.h"
+#include "Variant.h"
+#include "B-tree.hh"
+#include "B_tree_node.hh"
+#include "dynseq_functions.h"
+#include "kmer_frequency.h"
+#include "change_feed.h"
+#include "include/dynamic.hpp"
+
+using namespace md;
+
+/*
+* Class recording every change the dynamic minimizer algorithm applies to the sequence, the minimizer trees
+* and the variants. revert() undoes all recorded changes in reverse order, which restores the reference in
+* time proportional to the size of the edits instead of rebuilding the sequence and the trees.
+*
+* @param sequence_edits   the replaced substrings of the sequence (position, removed bases, inserted length)
+* @param tree_edits       the changes of the minimizer trees, one entry per variation-impact-range and tree
+* @param variant_shifts   the shifts added to the variant positions (variant index, shift)
+*/
+template<class Pos>
+class BasicUndoJournal{
+private:
+  typedef B_tree<Pos,std::string,7,3> minimizer_tree_t;
+  typedef typename position_traits<Pos>::delta_type delta_t;
+
+  typedef struct t_sequence_edit{
+    Pos left;
+    std::string removed;
+    int inserted_length;
+  } sequence_edit_t;
+
+  typedef struct t_tree_edit{
+    minimizer_tree_t* tree;
+    std::vector<std::pair<Pos,std::vector<std::string>>> removed;
+    bool shifted;
+    Pos shift_key;
+    delta_t shift;
+    std::vector<Pos> inserted;
+  } tree_edit_t;
+
+  std::vector<sequence_edit_t> sequence_edits;
+  std::vector<tree_edit_t> tree_edits;
+  std::vector<std::pair<int,delta_t>> variant_shifts;
+
+public:
+  /*
+  * records that the inserted_length bases at left replaced the bases removed
+  */
+  void recordSequenceEdit(Pos left, std::string& removed, int inserted_length){
+    sequence_edit_t edit;
+    edit.left=left;
+    edit.removed=removed;
+    edit.inserted_length=inserted_length;
+    sequence_edits.push_back(edit);
+  }
+
+  /*
+  * records that shift was added to the position of the variant at index variant_index
+  */
+  void recordVariantShift(int variant_index, delta_t shift){
+    variant_shifts.push_back(std::make_pair(variant_index,shift));
+  }
+
+  /*
+  * starts recording the update of one variation-impact-range in minimizerTree
+  */
+  void beginTreeEdit(minimizer_tree_t* minimizerTree){
+    tree_edit_t edit;
+    edit.tree=minimizerTree;
+    edit.shifted=false;
+    edit.shift_key=0;
+    edit.shift=0;
+    tree_edits.push_back(edit);
+  }
+
+  /*
+  * records a minimizer removed from the tree of the current tree edit
+  */
+  void recordRemovedMinimizer(Pos position, std::vector<std::string>& satellites){
+    assert(!tree_edits.empty());
+    tree_edits.back().removed.push_back(std::make_pair(position,satellites));
+  }
+
+  /*
+  * records that all minimizers >= key were shifted by shift in the tree of the current tree edit
+  */
+  void recordShift(Pos key, delta_t shift){
+    assert(!tree_edits.empty());
+    tree_edits.back().shifted=true;
+    tree_edits.back().shift_key=key;
+    tree_edits.back().shift=shift;
+  }
+
+  /*
+  * records a minimizer inserted into the tree of the current tree edit
+  */
+  void recordInsertedMinimizer(Pos position){
+    assert(!tree_edits.empty());
+    tree_edits.back().inserted.push_back(position);
+  }
+
+  /*!
+   * Reverts all recorded changes in reverse order and clears the journal afterwards.
+   * @param dynamic_sequence:   the sequence the changes were applied to
+   * @param variants:           (optional) the variants whose positions were shifted
+   * @param frequencies:        (optional) k-mer counts that followed the recorded changes of the trees
+   * @param feed:               (optional) change feed receiving the reverting changes of the trees
+   */
+  void revert(dyn::wt_str& dynamic_sequence, std::vector<BasicVariant<Pos>>* variants=nullptr, KmerFrequencyTable* frequencies=nullptr, BasicChangeFeed<Pos>* feed=nullptr){
+    //restore the minimizer trees
+    for(int i=(int)tree_edits.size()-1;i>=0;i--){
+      tree_edit_t& edit=tree_edits[i];
+      for(int j=(int)edit.inserted.size()-1;j>=0;j--){
+        if(!edit.tree->is_empty()){
+          //an inserted minimizer may have been appended to a key that already existed, keep the older satellites
+          auto removed=edit.tree->remove(edit.inserted[j]);
+          for(int s=0;s+1<(int)removed.satellites.size();s++){
+            edit.tree->insert(edit.inserted[j],removed.satellites[s]);
+          }
+          if(frequencies!=nullptr && !removed.satellites.empty()){
+            frequencies->remove(removed.satellites.back());
+          }
+          if(feed!=nullptr && !removed.satellites.empty()){
+            feed->recordDeleted(edit.inserted[j],removed.satellites.back());
+          }
+        }
+      }
+      if(edit.shifted && !edit.tree->is_empty()){
+        Pos key=edit.shift_key+edit.shift;
+        Pos unshift=-edit.shift;
+        edit.tree->shift_greater(key,unshift);
+        if(feed!=nullptr){
+          feed->recordShift(key,-edit.shift);
+        }
+      }
+      for(int j=(int)edit.removed.size()-1;j>=0;j--){
+        Pos position=edit.removed[j].first;
+        for(int s=0;s<(int)edit.removed[j].second.size();s++){
+          edit.tree->insert(position,edit.removed[j].second[s]);
+          if(frequencies!=nullptr){
+            frequencies->add(edit.removed[j].second[s]);
+          }
+          if(feed!=nullptr){
+            feed->recordInserted(position,edit.removed[j].second[s]);
+          }
+        }
+      }
+    }
+    //restore the sequence
+    for(int i=(int)sequence_edits.size()-1;i>=0;i--){
+      sequence_edit_t& edit=sequence_edits[i];
+      dynseq_update_substr(dynamic_sequence,edit.left,edit.left+edit.inserted_length,edit.removed);
+    }
+    //restore the variant positions
+    if(variants!=nullptr){
+      for(int i=(int)variant_shifts.size()-1;i>=0;i--){
+        delta_t unshift=-variant_shifts[i].second;
+        variants->at(variant_shifts[i].first).updateVariantPosition(unshift);
+      }
+    }
+    clear();
+  }
+
+  /*
+  * discards all recorded changes
+  */
+  void clear(){
+    sequence_edits.clear();
+    tree_edits.clear();
+    variant_shifts.clear();
+  }
+
+  /*
+  * returns true if no change has been recorded
+  */
+  bool is_empty(){
+    return sequence_edits.empty() && tree_edits.empty() && variant_shifts.empty();
+  }
+
+  /*
+  * prints the size of the journal to the console
+  *
+  * Output: Journal: sequence edits, tree edits, variant shifts
+  */
+  void printJournal(){
+    cout<<"Journal: "<<sequence_edits.size()<<" sequence edits, "<<tree_edits.size()<<" tree edits, "<<variant_shifts.size()<<" variant shifts\n";
+  }
+};
+
+typedef BasicUndoJournal<int> UndoJournal;
+
+#endif
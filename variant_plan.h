@@ -0,0 +1,817 @@
+////////////////////////////////////////////////////////////////////////////////
+// variant_plan.h
+//   variant plan header file.
+//
+//  preprocessing of unsorted call sets for the dynamic minimizer algorithm. The
+//  records of a VCF are sorted by (contig, position) in external memory, and in
+//  one streaming pass overlapping records are merged or rejected, indels are
+//  left-normalized against the reference and the variation-impact-ranges are
+//  computed.
+//  The result is written as a memory-mappable plan, from which the variants of a
+//  contig and their variation-impact-ranges are read in the order
+//  compute_dynamic_minimizers expects them.
+//
+////////////////////////////////////////////////////////////////////////////////
+//  author: Alexander Petri
+
+#ifndef VARIANT_PLAN_H
+#define VARIANT_PLAN_H
+
+#include "main.h"
+#include "Variant.h"
+#include "contig_index.h"
+#include "minimizer_pipeline.h"
+#include "snapshot.h"
+
+#include <cassert>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+* Layout of a plan file. All sections are 8 byte aligned and pointer-free:
+*
+*   header
+*   variants   plan_variant_t[n_variants]   sorted by contig and position, non-overlapping and non-touching
+*   clusters   plan_cluster_t[n_clusters]   the variation-impact-ranges, sorted like the variants
+*   alleles    char[n_allele_bytes]         the new sequences of the variants
+*   contigs    plan_contig_t[n_contigs]     in the order of the reference contigs
+*   names      char[n_name_bytes]           the names of the contigs
+*
+* The checksum is the 64 bit FNV-1a hash of all bytes behind the header followed by the header with the checksum set
+* to 0 (plan_checksum), so the writer can hash the sections while it streams them.
+*/
+#define VARIANT_PLAN_MAGIC "VARIPLAN"
+#define VARIANT_PLAN_VERSION 3
+
+typedef struct t_plan_header{
+  char magic[8];
+  uint32_t version;
+  uint32_t k_size;
+  uint32_t w_size;
+  uint32_t padding;
+  uint64_t n_variants;
+  uint64_t n_clusters;
+  uint64_t n_allele_bytes;
+  uint64_t n_contigs;
+  uint64_t n_name_bytes;
+  uint64_t variants_offset;
+  uint64_t clusters_offset;
+  uint64_t alleles_offset;
+  uint64_t contigs_offset;
+  uint64_t names_offset;
+  uint64_t file_size;
+  uint64_t checksum;
+} plan_header_t;
+
+typedef struct t_plan_variant{
+  int64_t position;
+  uint64_t allele_offset;
+  uint32_t originalseqlen;
+  uint32_t length;
+} plan_variant_t;
+
+/*
+* A variation-impact-range as apply_variants_to_dynamic_sequence computes it when all variants of the contig are
+* applied in one call. left and right are reference positions (BasicImpactRange), the range covers the altered sequence
+* from left+shift to right+shift+delta.
+*/
+typedef struct t_plan_cluster{
+  uint64_t first_variant;
+  int64_t left;
+  int64_t right;
+  int64_t shift;
+  uint32_t n_variants;
+  int32_t delta;
+} plan_cluster_t;
+
+typedef struct t_plan_contig{
+  uint64_t first_variant;
+  uint64_t n_variants;
+  uint64_t first_cluster;
+  uint64_t n_clusters;
+  uint64_t length;
+  uint64_t name_offset;
+  uint64_t name_length;
+} plan_contig_t;
+
+/*!
+ * Completes the checksum of a plan file.
+ * @param header:     the header of the file, its checksum field is ignored
+ * @param sections:   the FNV-1a hash of all bytes behind the header
+ *
+ * @return the checksum stored in the header
+ */
+uint64_t plan_checksum(const plan_header_t& header,uint64_t sections){
+  plan_header_t copy=header;
+  copy.checksum=0;
+  return snapshot_checksum((const char*)&copy,sizeof(copy),sections);
+}
+
+/*
+* A record while the plan is built: the variant of one VCF record in reference coordinates. The records are sorted by
+* the position of REF in the VCF, records at the same position are alternative alleles.
+*
+* @param order        the number of the record in the VCF, so that records at the same position keep their order
+* @param anchor       the position of REF
+* @param position     the position of the trimmed variant
+*/
+struct PlanRecord{
+  uint64_t order=0;
+  int64_t anchor=0;
+  int64_t position=0;
+  uint32_t contig=0;
+  uint32_t originalseqlen=0;
+  std::string sequence;
+
+  int64_t getEnd() const{
+    return position+originalseqlen;
+  }
+  bool operator<(const PlanRecord& other) const{
+    return std::tie(contig,anchor,order)<std::tie(other.contig,other.anchor,other.order);
+  }
+};
+
+/*
+* Counters of a build_variant_plan run. Every record is either written as a variant, merged into one or rejected.
+*/
+struct VariantPlanStatistics{
+  uint64_t records=0;
+  uint64_t variants=0;
+  uint64_t clusters=0;
+  uint64_t runs=0;
+  uint64_t shifted=0;
+  uint64_t duplicates=0;
+  uint64_t merged=0;
+  uint64_t conflicts=0;
+  uint64_t unknown_contig=0;
+  uint64_t reference_mismatch=0;
+  uint64_t out_of_range=0;
+  double seconds=0;
+
+  /*
+  * prints the statistics to the console
+  */
+  void printStatistics() const{
+    cout<<records<<" VCF records, "<<variants<<" variants in "<<clusters<<" variation-impact-ranges, sorted in "<<runs<<" runs in "<<seconds<<" s\n";
+    cout<<shifted<<" indels moved left, "<<duplicates<<" duplicates and "<<merged<<" touching records merged\n";
+    cout<<"rejected: "<<conflicts<<" overlapping, "<<unknown_contig<<" unknown contig, "<<reference_mismatch<<" REF mismatch, "<<out_of_range<<" out of range\n";
+  }
+};
+
+/*!
+ * Removes the bases both alleles of a variant share at their start and then the bases they share at their end. The
+ * variant is never moved to the left of REF, this is left to shift_variant_left, which knows the previous variant.
+ * @param position:           the position of the variant, updated
+ * @param reference_allele:   the replaced reference bases, updated
+ * @param alternative:        the new bases, updated
+ */
+void trim_variant(int64_t& position,std::string& reference_allele,std::string& alternative){
+  uint64_t common=0;
+  while(common<reference_allele.size() && common<alternative.size() && reference_allele[common]==alternative[common]){
+    common++;
+  }
+  reference_allele.erase(0,common);
+  alternative.erase(0,common);
+  position+=common;
+  while(!reference_allele.empty() && !alternative.empty() && reference_allele.back()==alternative.back()){
+    reference_allele.pop_back();
+    alternative.pop_back();
+  }
+}
+
+/*!
+ * Moves an insertion or deletion to the leftmost position, not before bound, at which it yields the same sequence.
+ * Other variants are not moved.
+ * @param reference:          the reference sequence
+ * @param position:           the position of the variant, updated
+ * @param originalseqlen:     the number of deleted bases
+ * @param sequence:           the inserted bases, updated
+ * @param bound:              the first position the variant may start at
+ *
+ * @return true if the variant was moved
+ */
+bool shift_variant_left(std::string& reference,int64_t& position,uint32_t originalseqlen,std::string& sequence,int64_t bound){
+  int64_t original_position=position;
+  if(originalseqlen==0 && !sequence.empty()){
+    while(position>bound && reference[position-1]==sequence.back()){
+      sequence.pop_back();
+      sequence.insert(sequence.begin(),reference[position-1]);
+      position--;
+    }
+  }
+  else if(originalseqlen>0 && sequence.empty()){
+    while(position>bound && reference[position-1]==reference[position+originalseqlen-1]){
+      position--;
+    }
+  }
+  return position!=original_position;
+}
+
+/*
+* writes a record to a run file
+*/
+void write_plan_record(std::ofstream& out,PlanRecord& record){
+  uint32_t length=record.sequence.size();
+  out.write((const char*)&record.order,sizeof(record.order));
+  out.write((const char*)&record.anchor,sizeof(record.anchor));
+  out.write((const char*)&record.position,sizeof(record.position));
+  out.write((const char*)&record.contig,sizeof(record.contig));
+  out.write((const char*)&record.originalseqlen,sizeof(record.originalseqlen));
+  out.write((const char*)&length,sizeof(length));
+  out.write(record.sequence.data(),length);
+}
+
+/*
+* reads the next record of a run file, returns false at its end
+*/
+bool read_plan_record(std::ifstream& in,PlanRecord& record){
+  uint32_t length=0;
+  in.read((char*)&record.order,sizeof(record.order));
+  in.read((char*)&record.anchor,sizeof(record.anchor));
+  in.read((char*)&record.position,sizeof(record.position));
+  in.read((char*)&record.contig,sizeof(record.contig));
+  in.read((char*)&record.originalseqlen,sizeof(record.originalseqlen));
+  in.read((char*)&length,sizeof(length));
+  if(!in){
+    return false;
+  }
+  record.sequence.resize(length);
+  in.read(&record.sequence[0],length);
+  return (bool)in;
+}
+
+/*!
+ * Builds a plan from an unsorted VCF stream in external memory. The records are read in runs of run_size records,
+ * every record is checked against the reference and trimmed, every run is sorted by contig and position and written
+ * to a temporary file next to the plan. The runs are merged in one pass which drops duplicates, moves indels left
+ * up to the end of the previous variant, merges records touching the previous variant into it (the algorithm cannot
+ * apply them separately), rejects records overlapping it or sharing its position (alternative alleles) and computes
+ * the variation-impact-ranges, so only run_size records are held in memory. Indels are moved after sorting, so that
+ * an indel is never moved across another variant.
+ * @param vcf:          the VCF stream, in any order
+ * @param names:        the names of the reference contigs
+ * @param references:   the sequences of the reference contigs
+ * @param k_size:       length of the k-mers
+ * @param w_size:       window size for the minimizer generations
+ * @param path:         the path of the plan file
+ * @param statistics:   (optional) receives the counters of the run
+ * @param run_size:     the number of records sorted in memory
+ *
+ * @return true if the plan was written
+ */
+bool build_variant_plan(std::istream& vcf,std::vector<std::string>& names,std::vector<std::string>& references,int& k_size,int& w_size,std::string& path,VariantPlanStatistics* statistics=nullptr,uint64_t run_size=1<<20){
+  assert(names.size()==references.size() && run_size>0);
+  VariantPlanStatistics counters;
+  pipeline_time_t start=std::chrono::high_resolution_clock::now();
+  std::unordered_map<std::string,uint32_t> contig_ids;
+  for(uint32_t c=0;c<names.size();c++){
+    contig_ids[names[c]]=c;
+  }
+  //read, check and normalize the records and write the sorted runs
+  std::vector<std::string> run_paths;
+  std::vector<PlanRecord> run;
+  auto flush=[&](){
+    std::sort(run.begin(),run.end());
+    run_paths.push_back(path+".run"+std::to_string(run_paths.size()));
+    std::ofstream out(run_paths.back(),std::ios::binary|std::ios::trunc);
+    for(uint64_t i=0;i<run.size();i++){
+      write_plan_record(out,run[i]);
+    }
+    run.clear();
+    return out.good();
+  };
+  std::string line;
+  std::string any_chromosome="";
+  std::string contig;
+  std::pair<std::string,std::string> alleles;
+  int zero=0;
+  Variant variant(zero,zero,zero,line);
+  bool written=true;
+  while(written && std::getline(vcf,line)){
+    if(!parse_vcf_variant(line,any_chromosome,variant,&contig,&alleles)){
+      continue;
+    }
+    counters.records++;
+    auto id=contig_ids.find(contig);
+    if(id==contig_ids.end()){
+      counters.unknown_contig++;
+      continue;
+    }
+    std::string& reference=references[id->second];
+    PlanRecord record;
+    record.order=counters.records;
+    record.contig=id->second;
+    std::string& reference_allele=alleles.first;
+    record.sequence=alleles.second;
+    record.anchor=variant.getVariantPosition()-((int64_t)reference_allele.size()-variant.getVariantOriginalSeqLen());
+    record.position=record.anchor;
+    if(record.position<0 || record.position+(int64_t)reference_allele.size()>(int64_t)reference.size()){
+      counters.out_of_range++;
+      continue;
+    }
+    if(reference.compare(record.position,reference_allele.size(),reference_allele)!=0){
+      counters.reference_mismatch++;
+      continue;
+    }
+    trim_variant(record.position,reference_allele,record.sequence);
+    if(record.position==0){
+      counters.out_of_range++;
+      continue;
+    }
+    record.originalseqlen=reference_allele.size();
+    run.push_back(record);
+    if(run.size()==run_size){
+      written=flush();
+    }
+  }
+  if(written && !run.empty()){
+    written=flush();
+  }
+  counters.runs=run_paths.size();
+
+  std::ofstream out(path,std::ios::binary|std::ios::trunc);
+  std::string clusters_path=path+".clusters";
+  std::string alleles_path=path+".alleles";
+  std::ofstream clusters_out(clusters_path,std::ios::binary|std::ios::trunc);
+  std::ofstream alleles_out(alleles_path,std::ios::binary|std::ios::trunc);
+  if(!written || !out || !clusters_out || !alleles_out){
+    cout<<"Could not write variant plan "<<path<<"\n";
+    for(uint64_t i=0;i<run_paths.size();i++){
+      std::remove(run_paths[i].c_str());
+    }
+    std::remove(clusters_path.c_str());
+    std::remove(alleles_path.c_str());
+    return false;
+  }
+  plan_header_t header;
+  memset(&header,0,sizeof(header));
+  memcpy(header.magic,VARIANT_PLAN_MAGIC,8);
+  header.version=VARIANT_PLAN_VERSION;
+  header.k_size=k_size;
+  header.w_size=w_size;
+  header.n_contigs=names.size();
+  header.variants_offset=snapshot_align(sizeof(header));
+  out.write((const char*)&header,sizeof(header));
+  uint64_t offset=sizeof(header);
+  uint64_t checksum=14695981039346656037ULL;
+  auto write=[&](const char* data,uint64_t length){
+    out.write(data,length);
+    checksum=snapshot_checksum(data,length,checksum);
+    offset+=length;
+  };
+  auto align=[&](){
+    char zeros[8]={0};
+    write(zeros,snapshot_align(offset)-offset);
+  };
+  align();
+
+  //merge the runs
+  std::vector<std::ifstream> runs(run_paths.size());
+  std::priority_queue<std::pair<PlanRecord,uint64_t>,std::vector<std::pair<PlanRecord,uint64_t>>,std::greater<std::pair<PlanRecord,uint64_t>>> heads;
+  for(uint64_t i=0;i<run_paths.size();i++){
+    runs[i].open(run_paths[i],std::ios::binary);
+    PlanRecord record;
+    if(read_plan_record(runs[i],record)){
+      heads.push(std::make_pair(record,i));
+    }
+  }
+  std::vector<plan_contig_t> contigs(names.size());
+  for(uint64_t c=0;c<names.size();c++){
+    memset(&contigs[c],0,sizeof(plan_contig_t));
+    contigs[c].length=references[c].size();
+    contigs[c].name_offset=header.n_name_bytes;
+    contigs[c].name_length=names[c].size();
+    header.n_name_bytes+=names[c].size();
+  }
+  //the variant waiting for the records touching it and the last record merged into it, before it was moved
+  PlanRecord pending;
+  PlanRecord accepted;
+  bool has_pending=false;
+  //the variant waiting for its cluster to be determined
+  PlanRecord last;
+  bool has_last=false;
+  int64_t shift=0;
+  plan_cluster_t cluster;
+  bool cluster_open=false;
+  //write last and close its variation-impact-range if next does not lie within it, as compute_left_bound and
+  //compute_right_bound do (the position of the next variant is compared before it is shifted)
+  auto place=[&](PlanRecord* next){
+    int64_t position=last.position+shift;
+    int64_t delta=(int64_t)last.sequence.size()-(int64_t)last.originalseqlen;
+    if(!cluster_open){
+      memset(&cluster,0,sizeof(cluster));
+      cluster.first_variant=header.n_variants;
+      cluster.shift=shift;
+      cluster.left=position<=w_size+(k_size-1) ? -shift : position-w_size-(k_size-1)-shift;
+      cluster_open=true;
+    }
+    plan_variant_t entry;
+    entry.position=last.position;
+    entry.allele_offset=header.n_allele_bytes;
+    entry.originalseqlen=last.originalseqlen;
+    entry.length=last.sequence.size();
+    write((const char*)&entry,sizeof(entry));
+    alleles_out.write(last.sequence.data(),last.sequence.size());
+    header.n_allele_bytes+=last.sequence.size();
+    header.n_variants++;
+    contigs[last.contig].n_variants++;
+    cluster.n_variants++;
+    cluster.delta+=delta;
+    bool closed=true;
+    int64_t right=0;
+    if(next!=nullptr){
+      if(position+last.originalseqlen+2*w_size+2*(k_size-1)>=next->position){
+        closed=false;
+      }
+      else{
+        right=position+w_size+last.originalseqlen+(k_size-2);
+      }
+    }
+    else{
+      int64_t sequence_size=contigs[last.contig].length+shift;
+      if(position+w_size+last.originalseqlen+k_size+1>=sequence_size-1){
+        right=sequence_size-1;
+      }
+      else{
+        right=position+w_size+last.originalseqlen+k_size+1;
+      }
+    }
+    if(closed){
+      cluster.right=right-shift;
+      clusters_out.write((const char*)&cluster,sizeof(cluster));
+      contigs[last.contig].n_clusters++;
+      header.n_clusters++;
+      cluster_open=false;
+    }
+    shift+=delta;
+  };
+  //hand a variant to the cluster computation, the variants of a contig are consecutive
+  auto emit=[&](PlanRecord* record){
+    if(has_last){
+      bool same_contig=record!=nullptr && record->contig==last.contig;
+      place(same_contig ? record : nullptr);
+      if(!same_contig){
+        shift=0;
+      }
+    }
+    if(record!=nullptr){
+      if(!has_last || record->contig!=last.contig){
+        contigs[record->contig].first_variant=header.n_variants;
+        contigs[record->contig].first_cluster=header.n_clusters;
+      }
+      last=*record;
+    }
+    has_last=record!=nullptr;
+  };
+  while(!heads.empty()){
+    PlanRecord record=heads.top().first;
+    uint64_t r=heads.top().second;
+    heads.pop();
+    PlanRecord following;
+    if(read_plan_record(runs[r],following)){
+      heads.push(std::make_pair(following,r));
+    }
+    bool same_contig=has_pending && record.contig==pending.contig;
+    if(same_contig && record.anchor==accepted.anchor && record.position==accepted.position && record.originalseqlen==accepted.originalseqlen && record.sequence==accepted.sequence){
+      counters.duplicates++;
+      continue;
+    }
+    //the bases in front of the record up to the end of the previous variant are unchanged, indels may move there
+    PlanRecord moved=record;
+    if(shift_variant_left(references[moved.contig],moved.position,moved.originalseqlen,moved.sequence,same_contig ? pending.getEnd() : 1)){
+      counters.shifted++;
+    }
+    if(same_contig){
+      if(moved.position<pending.getEnd() || record.anchor==accepted.anchor){
+        counters.conflicts++;
+        continue;
+      }
+      if(moved.position==pending.getEnd()){
+        pending.originalseqlen+=moved.originalseqlen;
+        pending.sequence+=moved.sequence;
+        accepted=record;
+        counters.merged++;
+        continue;
+      }
+    }
+    if(has_pending){
+      emit(&pending);
+    }
+    pending=moved;
+    accepted=record;
+    has_pending=true;
+  }
+  if(has_pending){
+    emit(&pending);
+  }
+  emit(nullptr);
+  for(uint64_t i=0;i<run_paths.size();i++){
+    runs[i].close();
+    std::remove(run_paths[i].c_str());
+  }
+  clusters_out.close();
+  alleles_out.close();
+
+  //append the clusters and alleles behind the variants, followed by the contigs
+  auto append=[&](std::string& section_path){
+    std::ifstream in(section_path,std::ios::binary);
+    std::vector<char> buffer(1<<16);
+    while(in){
+      in.read(buffer.data(),buffer.size());
+      write(buffer.data(),in.gcount());
+    }
+    in.close();
+    std::remove(section_path.c_str());
+  };
+  header.clusters_offset=offset;
+  append(clusters_path);
+  align();
+  header.alleles_offset=offset;
+  append(alleles_path);
+  align();
+  header.contigs_offset=offset;
+  write((const char*)contigs.data(),contigs.size()*sizeof(plan_contig_t));
+  header.names_offset=offset;
+  for(uint64_t c=0;c<names.size();c++){
+    write(names[c].data(),names[c].size());
+  }
+  align();
+  header.file_size=offset;
+  header.checksum=plan_checksum(header,checksum);
+  out.seekp(0);
+  out.write((const char*)&header,sizeof(header));
+  out.close();
+
+  counters.variants=header.n_variants;
+  counters.clusters=header.n_clusters;
+  counters.seconds=std::chrono::duration<double>(std::chrono::high_resolution_clock::now()-start).count();
+  if(statistics!=nullptr){
+    *statistics=counters;
+  }
+  return out.good();
+}
+
+/*
+* Read-only view of a plan file mapped into memory. The variants of a contig are stored consecutively in the order
+* they are applied, reading them is a sequential scan of the mapped file.
+*
+* @param data       the mapped file
+* @param header     the header of the file
+*/
+class VariantPlan{
+private:
+  char* data;
+  uint64_t mapped_size;
+  plan_header_t* header;
+
+  const plan_variant_t* variants() const{
+    return (const plan_variant_t*)(data+header->variants_offset);
+  }
+  const plan_cluster_t* clusters() const{
+    return (const plan_cluster_t*)(data+header->clusters_offset);
+  }
+  const char* alleles() const{
+    return data+header->alleles_offset;
+  }
+  const plan_contig_t* contigs() const{
+    return (const plan_contig_t*)(data+header->contigs_offset);
+  }
+
+public:
+  // Constructor
+  VariantPlan(){
+    data=nullptr;
+    mapped_size=0;
+    header=nullptr;
+  }
+  // Destructor
+  ~VariantPlan(){
+    close();
+  }
+  VariantPlan(const VariantPlan&) = delete;
+  VariantPlan& operator=(const VariantPlan&) = delete;
+
+  /*!
+   * Map a plan file read-only into memory
+   * @param path:     the path of the plan file
+   * @param verify:   if true the checksum of the whole file is verified. The layout (the sections lie inside the
+   *                  file, the variants and names of every contig inside their sections) is always checked.
+   *
+   * @return true if the plan was opened
+   */
+  bool open(std::string& path,bool verify=true){
+    close();
+    int fd=::open(path.c_str(),O_RDONLY);
+    if(fd<0){
+      cout<<"Could not open variant plan "<<path<<"\n";
+      return false;
+    }
+    struct stat st;
+    if(fstat(fd,&st)!=0 || (uint64_t)st.st_size<sizeof(plan_header_t)){
+      cout<<"Variant plan "<<path<<" is too small\n";
+      ::close(fd);
+      return false;
+    }
+    void* mapped=mmap(nullptr,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+    ::close(fd);
+    if(mapped==MAP_FAILED){
+      cout<<"Could not map variant plan "<<path<<"\n";
+      return false;
+    }
+    data=(char*)mapped;
+    mapped_size=st.st_size;
+    header=(plan_header_t*)data;
+    if(memcmp(header->magic,VARIANT_PLAN_MAGIC,8)!=0 || header->version!=VARIANT_PLAN_VERSION || header->file_size!=mapped_size){
+      cout<<"Variant plan "<<path<<" has an unknown format\n";
+      close();
+      return false;
+    }
+    //every section has to lie inside the file behind the previous one and match the counts of the header
+    uint64_t end=sizeof(plan_header_t);
+    bool fits=header->k_size>0 && header->w_size>0 && header->n_contigs<=(uint64_t)std::numeric_limits<int>::max()
+      && snapshot_section_fits(header->variants_offset,header->n_variants,sizeof(plan_variant_t),mapped_size,end)
+      && snapshot_section_fits(header->clusters_offset,header->n_clusters,sizeof(plan_cluster_t),mapped_size,end)
+      && snapshot_section_fits(header->alleles_offset,header->n_allele_bytes,1,mapped_size,end)
+      && snapshot_section_fits(header->contigs_offset,header->n_contigs,sizeof(plan_contig_t),mapped_size,end)
+      && snapshot_section_fits(header->names_offset,header->n_name_bytes,1,mapped_size,end);
+    //the variants and the name of every contig have to lie inside their sections, the variants of a contig have to
+    //be sorted, non-overlapping and inside the contig
+    for(uint64_t c=0;fits && c<header->n_contigs;c++){
+      const plan_contig_t& contig=contigs()[c];
+      fits=contig.n_variants<=header->n_variants && contig.first_variant<=header->n_variants-contig.n_variants
+        && contig.name_length<=header->n_name_bytes && contig.name_offset<=header->n_name_bytes-contig.name_length;
+      uint64_t previous_end=1;
+      for(uint64_t i=contig.first_variant;fits && i<contig.first_variant+contig.n_variants;i++){
+        const plan_variant_t& variant=variants()[i];
+        fits=variant.position>=(int64_t)previous_end && (uint64_t)variant.position<=contig.length && variant.originalseqlen<=contig.length-variant.position
+          && variant.originalseqlen<=(uint32_t)std::numeric_limits<int>::max() && variant.length<=(uint32_t)std::numeric_limits<int>::max()
+          && variant.length<=header->n_allele_bytes && variant.allele_offset<=header->n_allele_bytes-variant.length;
+        previous_end=variant.position+variant.originalseqlen;
+      }
+      //the clusters of a contig cover its variants in order, and their bounds lie inside the sequence the variants
+      //are applied to
+      fits=fits && contig.n_clusters<=header->n_clusters && contig.first_cluster<=header->n_clusters-contig.n_clusters;
+      uint64_t next_variant=contig.first_variant;
+      int64_t shift=0;
+      for(uint64_t j=contig.first_cluster;fits && j<contig.first_cluster+contig.n_clusters;j++){
+        const plan_cluster_t& cluster=clusters()[j];
+        fits=cluster.first_variant==next_variant && cluster.n_variants>0 && cluster.n_variants<=contig.first_variant+contig.n_variants-next_variant
+          && cluster.shift==shift && cluster.left+shift>=0 && cluster.left<=variants()[next_variant].position;
+        int64_t delta=0;
+        for(uint64_t i=next_variant;fits && i<next_variant+cluster.n_variants;i++){
+          const plan_variant_t& variant=variants()[i];
+          if(i+1==next_variant+cluster.n_variants){
+            fits=cluster.right+1>=variant.position+(int64_t)variant.originalseqlen && cluster.right<(int64_t)contig.length;
+          }
+          delta+=(int64_t)variant.length-(int64_t)variant.originalseqlen;
+        }
+        fits=fits && cluster.delta==delta;
+        next_variant+=cluster.n_variants;
+        shift+=delta;
+      }
+      fits=fits && next_variant==contig.first_variant+contig.n_variants;
+    }
+    if(!fits){
+      cout<<"Variant plan "<<path<<" has an invalid layout\n";
+      close();
+      return false;
+    }
+    if(verify && plan_checksum(*header,snapshot_checksum(data+sizeof(plan_header_t),mapped_size-sizeof(plan_header_t)))!=header->checksum){
+      cout<<"Variant plan "<<path<<" is corrupted\n";
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  /*
+  * unmaps the plan
+  */
+  void close(){
+    if(data!=nullptr){
+      munmap(data,mapped_size);
+    }
+    data=nullptr;
+    mapped_size=0;
+    header=nullptr;
+  }
+
+  /*
+  * returns true if a plan is mapped
+  */
+  bool is_open() const{
+    return data!=nullptr;
+  }
+
+  int getK() const{
+    return header->k_size;
+  }
+  int getW() const{
+    return header->w_size;
+  }
+  int getNumberOfContigs() const{
+    return header->n_contigs;
+  }
+  std::string getContigName(int contig) const{
+    return std::string(data+header->names_offset+contigs()[contig].name_offset,contigs()[contig].name_length);
+  }
+  /*
+  * returns the length of the reference sequence of contig
+  */
+  uint64_t getContigLength(int contig) const{
+    return contigs()[contig].length;
+  }
+  uint64_t getNumberOfVariants(int contig) const{
+    return contigs()[contig].n_variants;
+  }
+  uint64_t getNumberOfClusters(int contig) const{
+    return contigs()[contig].n_clusters;
+  }
+  /*
+  * returns the i-th variation-impact-range of contig
+  */
+  const plan_cluster_t& getCluster(int contig,uint64_t i) const{
+    return clusters()[contigs()[contig].first_cluster+i];
+  }
+  /*
+  * returns the variation-impact-ranges of contig, ready for compute_dynamic_minimizers. The first variant of a range
+  * is counted from the first variant of the contig.
+  */
+  template<class Pos>
+  std::vector<BasicImpactRange<Pos>> getImpactRanges(int contig) const{
+    std::vector<BasicImpactRange<Pos>> result;
+    const plan_contig_t& entry=contigs()[contig];
+    result.reserve(entry.n_clusters);
+    for(uint64_t j=entry.first_cluster;j<entry.first_cluster+entry.n_clusters;j++){
+      const plan_cluster_t& cluster=clusters()[j];
+      BasicImpactRange<Pos> range;
+      range.first_variant=cluster.first_variant-entry.first_variant;
+      range.left=cluster.left;
+      range.right=cluster.right;
+      range.n_variants=cluster.n_variants;
+      result.push_back(range);
+    }
+    return result;
+  }
+
+  /*
+  * returns the variants of contig in reference coordinates, ready for compute_dynamic_minimizers
+  */
+  template<class Pos>
+  std::vector<BasicVariant<Pos>> getVariants(int contig) const{
+    std::vector<BasicVariant<Pos>> result;
+    const plan_contig_t& entry=contigs()[contig];
+    result.reserve(entry.n_variants);
+    for(uint64_t i=entry.first_variant;i<entry.first_variant+entry.n_variants;i++){
+      const plan_variant_t& variant=variants()[i];
+      Pos position=variant.position;
+      int originalseqlen=variant.originalseqlen;
+      int length=variant.length;
+      std::string sequence(alleles()+variant.allele_offset,variant.length);
+      result.push_back(BasicVariant<Pos>(position,originalseqlen,length,sequence));
+    }
+    return result;
+  }
+};
+
+/*!
+ * Applies the variants of a plan to the contigs of an index with the same names. The variation-impact-ranges are read
+ * from the plan instead of being computed again. Contigs without variants in the plan stay unchanged.
+ * @param plan:       the variant plan, built for the k-mer length and window size of the index
+ * @param index:      the contig index
+ * @param threads:    the number of worker threads
+ *
+ * @return false if the plan was built for another k-mer length or window size or for other contig lengths
+ */
+template<class Pos>
+bool apply_variant_plan(VariantPlan& plan,ContigMinimizerIndex<Pos>& index,int threads=1){
+  if(plan.getK()!=index.getK() || plan.getW()!=index.getW()){
+    cout<<"The variant plan was built for k="<<plan.getK()<<", w="<<plan.getW()<<"\n";
+    return false;
+  }
+  ContigTable& table=index.getContigTable();
+  std::vector<std::vector<BasicVariant<Pos>>> variants(table.getNumberOfContigs());
+  std::vector<std::vector<BasicImpactRange<Pos>>> ranges(table.getNumberOfContigs());
+  for(int c=0;c<plan.getNumberOfContigs();c++){
+    std::string name=plan.getContigName(c);
+    int contig=table.findContig(name);
+    if(contig<0 || plan.getNumberOfVariants(c)==0){
+      continue;
+    }
+    if(table.getLength(contig)!=plan.getContigLength(c)){
+      cout<<"Contig "<<name<<" does not have the length of the variant plan\n";
+      return false;
+    }
+    variants[contig]=plan.getVariants<Pos>(c);
+    ranges[contig]=plan.getImpactRanges<Pos>(c);
+  }
+  index.applyVariants(variants,threads,&ranges);
+  return true;
+}
+
+#endif
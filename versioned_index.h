@@ -0,0 +1,520 @@
+////////////////////////////////////////////////////////////////////////////////
+// versioned_index.h
+//   versioned minimizer index header file.
+//
+// Single-writer/multi-reader minimizer index. The writer publishes a new version
+// after every variant cluster by path copying, readers pin an epoch and query a
+// consistent version without taking any lock. Replaced nodes are freed by
+// epoch-based reclamation once no reader can reach them any more.
+//
+////////////////////////////////////////////////////////////////////////////////
+// author: Alexander Petri
+
+#ifndef VERSIONED_INDEX_H
+#define VERSIONED_INDEX_H
+
+#include "main.h"
+#include "Variant.h"
+#include "Minimizer.h"
+#include "get_kmer_minimizers.h"
+#include "dynamic_minimizer.h"
+#include "include/internal/slab_allocator.hpp"
+#include "include/dynamic.hpp"
+
+#include <atomic>
+#include <cassert>
+
+struct versioned_index_tag{};
+
+/*
+* Node of the persistent minimizer tree, a treap ordered by position. A node which belongs to a published version
+* is never changed again, the writer copies it first (path copying).
+*
+* @param pos        position of the minimizer, the shifts of the node and of its ancestors have to be added
+* @param shift      lazy shift of the whole subtree including the node itself
+* @param priority   heap priority of the treap
+* @param size       number of minimizers in the subtree
+* @param version    the version which created the node, nodes of the unpublished version may be changed in place
+* @param kmer       the k-mer of the minimizer
+*/
+struct VersionedNode{
+  int pos;
+  int shift;
+  uint32_t priority;
+  int size;
+  uint64_t version;
+  VersionedNode* left;
+  VersionedNode* right;
+  std::string kmer;
+};
+
+/*
+* Epochs of the readers. Every reader owns a slot on a cache line of its own, which holds the global epoch seen when
+* the reader pinned its version or idle when the reader is not reading. Memory retired in epoch e may be freed as
+* soon as every pinned slot holds an epoch greater than e.
+*
+* @param global_epoch   the current epoch, increased with every published version
+* @param slots          the epochs of the readers
+*/
+class EpochManager{
+public:
+  static const int max_readers=64;
+  static const uint64_t idle=std::numeric_limits<uint64_t>::max();
+
+  EpochManager(){
+    global_epoch.store(1);
+    for(int i=0;i<max_readers;i++){
+      slots[i].epoch.store(idle);
+      slots[i].used.store(false);
+    }
+  }
+  /*
+  * reserves a slot for a new reader and returns its index
+  */
+  int registerReader(){
+    for(int i=0;i<max_readers;i++){
+      bool expected=false;
+      if(slots[i].used.compare_exchange_strong(expected,true)){
+        return i;
+      }
+    }
+    assert(false && "too many readers");
+    return -1;
+  }
+  /*
+  * releases the slot of a reader
+  */
+  void unregisterReader(int slot){
+    slots[slot].epoch.store(idle);
+    slots[slot].used.store(false);
+  }
+  /*
+  * announces that the reader in slot starts reading. Everything the reader loads afterwards is protected until unpin
+  */
+  void pin(int slot){
+    slots[slot].epoch.store(global_epoch.load());
+  }
+  void unpin(int slot){
+    slots[slot].epoch.store(idle,std::memory_order_release);
+  }
+  /*
+  * ends the current epoch and returns it
+  */
+  uint64_t advance(){
+    return global_epoch.fetch_add(1);
+  }
+  /*
+  * returns the smallest epoch pinned by a reader or idle if no reader is pinned
+  */
+  uint64_t minPinnedEpoch(){
+    uint64_t min_epoch=idle;
+    for(int i=0;i<max_readers;i++){
+      min_epoch=std::min(min_epoch,slots[i].epoch.load());
+    }
+    return min_epoch;
+  }
+
+private:
+  struct alignas(64) slot_t{
+    std::atomic<uint64_t> epoch;
+    std::atomic<bool> used;
+  };
+  std::atomic<uint64_t> global_epoch;
+  slot_t slots[max_readers];
+};
+
+/*
+* Minimizer index supporting one writer and any number of concurrent readers (at most EpochManager::max_readers).
+*
+* The minimizers are kept in a treap ordered by position whose nodes carry lazy shifts, so shifting all minimizers
+* behind a variant costs O(1) at the root of the split off part. The writer never changes a node of a published
+* version: split and merge copy the nodes on their path (path copying), all other subtrees are shared with the
+* previous version. publish makes the new root visible to the readers with one atomic store and retires the
+* replaced nodes, which are freed as soon as no reader pinned an epoch in which they were reachable.
+* Nodes created since the last publish are private to the writer and are changed or freed directly.
+*
+* Only the index is versioned: the dynamic sequence is still updated in place and must not be read while
+* the writer runs.
+*
+* @param root       the root of the latest published version
+* @param work       the root of the version being built by the writer
+* @param version    the number of the version being built by the writer
+* @param epochs     the epochs of the readers
+* @param retired    the replaced nodes together with the epoch they were retired in
+* @param rng        random generator for the treap priorities
+*/
+class VersionedMinimizerIndex{
+public:
+  typedef dyn::slab_allocator<versioned_index_tag> alloc;
+
+  VersionedMinimizerIndex(){
+    root.store(nullptr);
+  }
+  /*
+  * builds the first version from minimizers sorted by position and publishes it
+  */
+  VersionedMinimizerIndex(std::vector<Minimizer>& minimizers) : VersionedMinimizerIndex(){
+    for(int i=0;i<(int)minimizers.size();i++){
+      work=merge(work,createNode(minimizers[i]));
+    }
+    publish();
+  }
+  /*
+  * frees all nodes, no reader may be registered any more
+  */
+  ~VersionedMinimizerIndex(){
+    freeTree(work);
+    for(int i=0;i<(int)retired.size();i++){
+      alloc::destroy(retired[i].second);
+    }
+  }
+
+  VersionedMinimizerIndex(const VersionedMinimizerIndex&)=delete;
+  VersionedMinimizerIndex& operator=(const VersionedMinimizerIndex&)=delete;
+
+  /*
+  * replaces the minimizers in [left, right] by newminis and shifts the minimizers behind right by shift.
+  * The positions of newminis are already shifted and have to lie between the remaining minimizers.
+  * The change becomes visible to the readers with the next publish.
+  */
+  void replaceRange(int left,int right,std::vector<Minimizer>& newminis,int shift){
+    VersionedNode* lower;
+    VersionedNode* rest;
+    VersionedNode* middle;
+    VersionedNode* upper;
+    split(work,left,lower,rest);
+    if(right==std::numeric_limits<int>::max()){
+      middle=rest;
+      upper=nullptr;
+    }
+    else{
+      split(rest,right+1,middle,upper);
+    }
+    dropTree(middle);
+    if(upper!=nullptr && shift!=0){
+      upper=own(upper);
+      upper->shift+=shift;
+    }
+    VersionedNode* inserted=nullptr;
+    for(int i=0;i<(int)newminis.size();i++){
+      inserted=merge(inserted,createNode(newminis[i]));
+    }
+    work=merge(merge(lower,inserted),upper);
+  }
+  /*
+  * makes the version built by the writer visible to the readers and frees the retired nodes no reader can reach
+  */
+  void publish(){
+    root.store(work);
+    uint64_t epoch=epochs.advance();
+    for(int i=pending;i<(int)retired.size();i++){
+      retired[i].first=epoch;
+    }
+    pending=retired.size();
+    version++;
+    reclaim();
+  }
+  /*
+  * returns the number of the latest published version
+  */
+  uint64_t getVersion(){
+    return version-1;
+  }
+  /*
+  * returns the number of replaced nodes waiting for the readers
+  */
+  int getNumberOfRetiredNodes(){
+    return retired.size();
+  }
+  /*
+  * returns the number of minimizers of the version being built by the writer
+  */
+  int size(){
+    return nodeSize(work);
+  }
+
+private:
+  friend class MinimizerIndexReader;
+
+  std::atomic<VersionedNode*> root;
+  VersionedNode* work=nullptr;
+  uint64_t version=1;
+  EpochManager epochs;
+  std::vector<std::pair<uint64_t,VersionedNode*>> retired;
+  int pending=0;
+  std::mt19937 rng{42};
+
+  static int nodeSize(VersionedNode* node){
+    return node==nullptr ? 0 : node->size;
+  }
+
+  VersionedNode* createNode(Minimizer& minimizer){
+    VersionedNode* node=alloc::create<VersionedNode>();
+    node->pos=minimizer.getPosition();
+    node->shift=0;
+    node->priority=rng();
+    node->size=1;
+    node->version=version;
+    node->left=nullptr;
+    node->right=nullptr;
+    node->kmer=minimizer.getSequence();
+    return node;
+  }
+  /*
+  * returns a node of the version being built which may be changed in place. Published nodes are copied and
+  * retired, as their parent is copied as well no node of the new version points to them any more.
+  */
+  VersionedNode* own(VersionedNode* node){
+    if(node==nullptr || node->version==version){
+      return node;
+    }
+    VersionedNode* copy=alloc::create<VersionedNode>(*node);
+    copy->version=version;
+    retired.push_back(std::make_pair(0,node));
+    return copy;
+  }
+  /*
+  * applies the lazy shift of a private node to its own position and hands it down to its children
+  */
+  void push(VersionedNode* node){
+    if(node->shift==0){
+      return;
+    }
+    if(node->left!=nullptr){
+      node->left=own(node->left);
+      node->left->shift+=node->shift;
+    }
+    if(node->right!=nullptr){
+      node->right=own(node->right);
+      node->right->shift+=node->shift;
+    }
+    node->pos+=node->shift;
+    node->shift=0;
+  }
+  void update(VersionedNode* node){
+    node->size=1+nodeSize(node->left)+nodeSize(node->right);
+  }
+  /*
+  * splits tree into the minimizers located before pos and the ones located at or behind pos
+  */
+  void split(VersionedNode* tree,int pos,VersionedNode*& lower,VersionedNode*& upper){
+    if(tree==nullptr){
+      lower=nullptr;
+      upper=nullptr;
+      return;
+    }
+    tree=own(tree);
+    push(tree);
+    if(tree->pos<pos){
+      split(tree->right,pos,tree->right,upper);
+      lower=tree;
+    }
+    else{
+      split(tree->left,pos,lower,tree->left);
+      upper=tree;
+    }
+    update(tree);
+  }
+  /*
+  * concatenates two trees, all minimizers of lower are located before the ones of upper
+  */
+  VersionedNode* merge(VersionedNode* lower,VersionedNode* upper){
+    if(lower==nullptr){
+      return upper;
+    }
+    if(upper==nullptr){
+      return lower;
+    }
+    if(lower->priority>upper->priority){
+      lower=own(lower);
+      push(lower);
+      lower->right=merge(lower->right,upper);
+      update(lower);
+      return lower;
+    }
+    upper=own(upper);
+    push(upper);
+    upper->left=merge(lower,upper->left);
+    update(upper);
+    return upper;
+  }
+  /*
+  * removes a subtree which has been split off: private nodes are freed directly, published ones are retired
+  */
+  void dropTree(VersionedNode* tree){
+    if(tree==nullptr){
+      return;
+    }
+    dropTree(tree->left);
+    dropTree(tree->right);
+    if(tree->version==version){
+      alloc::destroy(tree);
+    }
+    else{
+      retired.push_back(std::make_pair(0,tree));
+    }
+  }
+  void freeTree(VersionedNode* tree){
+    if(tree==nullptr){
+      return;
+    }
+    freeTree(tree->left);
+    freeTree(tree->right);
+    alloc::destroy(tree);
+  }
+  /*
+  * frees the retired nodes of all epochs older than the oldest epoch pinned by a reader
+  */
+  void reclaim(){
+    uint64_t min_epoch=epochs.minPinnedEpoch();
+    int freed=0;
+    while(freed<pending && retired[freed].first<min_epoch){
+      alloc::destroy(retired[freed].second);
+      freed++;
+    }
+    retired.erase(retired.begin(),retired.begin()+freed);
+    pending-=freed;
+  }
+};
+
+/*
+* Reader of a VersionedMinimizerIndex. Between pin and unpin all queries are answered on the version which was
+* the latest one when pin was called, no matter how many versions the writer publishes in the meantime.
+* The read path neither locks nor writes to shared memory except for the own epoch slot.
+* Every thread has to use a reader of its own.
+*
+* @param index     the index to be read
+* @param slot      the epoch slot of the reader
+* @param pinned    the root of the pinned version
+*/
+class MinimizerIndexReader{
+public:
+  MinimizerIndexReader(VersionedMinimizerIndex& index) : index(index){
+    slot=index.epochs.registerReader();
+  }
+  ~MinimizerIndexReader(){
+    index.epochs.unregisterReader(slot);
+  }
+
+  MinimizerIndexReader(const MinimizerIndexReader&)=delete;
+  MinimizerIndexReader& operator=(const MinimizerIndexReader&)=delete;
+
+  /*
+  * pins the latest published version
+  */
+  void pin(){
+    index.epochs.pin(slot);
+    pinned=index.root.load();
+  }
+  /*
+  * releases the pinned version, its nodes must not be used afterwards
+  */
+  void unpin(){
+    pinned=nullptr;
+    index.epochs.unpin(slot);
+  }
+  /*
+  * returns the number of minimizers of the pinned version
+  */
+  int size(){
+    return VersionedMinimizerIndex::nodeSize(pinned);
+  }
+  /*
+  * looks up the minimizer located at pos and stores its k-mer in kmer
+  *
+  * Output: true if there is a minimizer at pos
+  */
+  bool find(int pos,std::string& kmer){
+    int offset=0;
+    VersionedNode* node=pinned;
+    while(node!=nullptr){
+      offset+=node->shift;
+      int key=node->pos+offset;
+      if(key==pos){
+        kmer=node->kmer;
+        return true;
+      }
+      node= pos<key ? node->left : node->right;
+    }
+    return false;
+  }
+  /*
+  * finds the first minimizer located behind pos
+  *
+  * Output: true if there is such a minimizer
+  */
+  bool successor(int pos,Minimizer& result){
+    int offset=0;
+    VersionedNode* node=pinned;
+    VersionedNode* best=nullptr;
+    int best_key=0;
+    while(node!=nullptr){
+      offset+=node->shift;
+      int key=node->pos+offset;
+      if(key>pos){
+        best=node;
+        best_key=key;
+        node=node->left;
+      }
+      else{
+        node=node->right;
+      }
+    }
+    if(best==nullptr){
+      return false;
+    }
+    result.updateMinimizer(best_key,best->kmer);
+    return true;
+  }
+  /*
+  * appends all minimizers located in [left, right] to result in the order of their positions
+  */
+  void collect(int left,int right,std::vector<Minimizer>& result){
+    collect(pinned,0,left,right,result);
+  }
+
+private:
+  VersionedMinimizerIndex& index;
+  int slot;
+  VersionedNode* pinned=nullptr;
+
+  void collect(VersionedNode* node,int offset,int left,int right,std::vector<Minimizer>& result){
+    if(node==nullptr){
+      return;
+    }
+    offset+=node->shift;
+    int key=node->pos+offset;
+    if(key>left){
+      collect(node->left,offset,left,right,result);
+    }
+    if(key>=left && key<=right){
+      result.push_back(Minimizer(key,node->kmer));
+    }
+    if(key<right){
+      collect(node->right,offset,left,right,result);
+    }
+  }
+};
+
+/*!
+ * Applies the variants to the sequence and updates the versioned index, a new version is published after every
+ * variant cluster (variation-impact-range), so concurrent readers see the minimizers after each cluster.
+ * Only the minimizers are versioned, readers must not access dynamic_sequence until the function returns.
+ * @param index:    the versioned minimizer index
+ * @param dynamic_sequence:  the sequence to be altered
+ * @param variants: the variants to be applied
+ * @param k_size:   k-mer length
+ * @param w_size:   window size
+ */
+void compute_dynamic_minimizers_versioned(VersionedMinimizerIndex& index,dyn::wt_str& dynamic_sequence,std::vector<Variant>& variants,int& k_size,int& w_size){
+  apply_variants_to_dynamic_sequence(dynamic_sequence,variants,k_size,w_size,
+    [&](std::string& fullsubseq,int& thisstartpos,int& var_impact_shift){
+      std::vector<Minimizer> newminis=get_kmer_minimizers_algo(fullsubseq,k_size,w_size,thisstartpos);
+      int left=(thisstartpos==0) ? std::numeric_limits<int>::min() : newminis.front().getPosition();
+      int right=newminis.back().getPosition()-var_impact_shift;
+      index.replaceRange(left,right,newminis,var_impact_shift);
+      index.publish();
+    });
+}
+
+#endif
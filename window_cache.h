@@ -0,0 +1,240 @@
+////////////////////////////////////////////////////////////////////////////////
+// window_cache.h
+//   Window cache header file.
+//
+//  memoizes the minimizers of the updated variation-impact-ranges. When many
+//  samples share the same alleles, the same windows (left context, allele,
+//  right context) are recomputed over and over, so their minimizers are cached
+//  relative to the window start in a bounded LRU cache.
+//
+////////////////////////////////////////////////////////////////////////////////
+//  author: Alexander Petri
+
+#ifndef WINDOW_CACHE_H
+#define WINDOW_CACHE_H
+
+#include "main.h"
+#include "Variant.h"
+#include "positions.h"
+#include "packed_kmers.h"
+#include "get_kmer_minimizers.h"
+#include "B-tree.hh"
+#include "B_tree_node.hh"
+#include "B_tree_operations.h"
+#include "dynamic_minimizer.h"
+#include "include/dynamic.hpp"
+
+#include <list>
+#include <unordered_map>
+
+/*
+* Bounded LRU cache mapping the bases of an updated window together with (k, w, ordering) to the minimizers of
+* the window, stored relative to the window start. The bases of the window are the left context, the allele and
+* the right context, so two samples carrying the same allele in the same context share one entry, wherever the
+* window lies in their sequences. Entries are looked up by a hash of the key and the bases are compared on every
+* hit, so a hash collision only costs a recomputation. The window is the substring the update extracts from the
+* sequence anyway to apply the variants, so keying on it adds one hash and one comparison of the window per lookup
+* and no extraction; a key without the bases (e.g. reference position and allele) would not see earlier variants in
+* the context of the window. The least recently used entries are evicted as soon as the
+* estimated memory of the cache exceeds max_bytes. The cache is not thread-safe.
+*
+* @param entries      the cached windows, the most recently used first
+* @param index        hash of the key -> entry
+* @param max_bytes    the memory cap of the cache
+* @param bytes        the estimated memory of the cached entries
+* @param hits         the number of lookups answered from the cache
+* @param misses       the number of lookups which computed the minimizers
+* @param evictions    the number of entries evicted because of the memory cap
+*/
+class MinimizerWindowCache{
+private:
+  struct Entry{
+    uint64_t hash;
+    std::string window;
+    int k_size;
+    int w_size;
+    KmerOrdering ordering;
+    std::vector<std::pair<int,std::string>> minimizers;
+    uint64_t bytes;
+  };
+  std::list<Entry> entries;
+  std::unordered_map<uint64_t,std::list<Entry>::iterator> index;
+  uint64_t max_bytes;
+  uint64_t bytes=0;
+  uint64_t hits=0;
+  uint64_t misses=0;
+  uint64_t evictions=0;
+
+  static uint64_t hashKey(std::string& window,int k_size,int w_size,KmerOrdering ordering){
+    uint64_t h=std::hash<std::string>()(window);
+    h^=((uint64_t)k_size<<40)^((uint64_t)w_size<<16)^(uint64_t)ordering;
+    return h*0x9E3779B97F4A7C15ULL;
+  }
+  /*
+  * estimated memory of an entry: the bases, the minimizers and the list and map nodes
+  */
+  static uint64_t entryBytes(Entry& entry){
+    uint64_t size=sizeof(Entry)+entry.window.capacity()+4*sizeof(void*)+sizeof(std::pair<uint64_t,void*>);
+    for(int i=0;i<(int)entry.minimizers.size();i++){
+      size+=sizeof(std::pair<int,std::string>)+entry.minimizers[i].second.capacity();
+    }
+    return size;
+  }
+  void erase(std::list<Entry>::iterator it){
+    bytes-=it->bytes;
+    index.erase(it->hash);
+    entries.erase(it);
+  }
+  /*
+  * evicts the least recently used entries until the cache fits into max_bytes
+  */
+  void shrink(){
+    while(bytes>max_bytes && !entries.empty()){
+      erase(std::prev(entries.end()));
+      evictions++;
+    }
+  }
+  /*
+  * computes the minimizers of the window relative to its start
+  */
+  static std::vector<std::pair<int,std::string>> computeMinimizers(std::string& window,int& k_size,int& w_size,KmerOrdering ordering){
+    std::vector<std::pair<int,std::string>> relative;
+    if(ordering==LEXICOGRAPHIC){
+      int zero=0;
+      std::vector<BasicMinimizer<int>> minimizers=get_kmer_minimizers_algo(window,k_size,w_size,zero);
+      relative.reserve(minimizers.size());
+      for(int i=0;i<(int)minimizers.size();i++){
+        relative.push_back(std::make_pair(minimizers[i].getPosition(),minimizers[i].getSequence()));
+      }
+    }
+    else{
+      std::vector<uint8_t> codes=pack_sequence(window);
+      std::vector<Minimizer> minimizers=get_packed_kmer_minimizers(codes,k_size,w_size,ordering,0);
+      relative.reserve(minimizers.size());
+      for(int i=0;i<(int)minimizers.size();i++){
+        relative.push_back(std::make_pair(minimizers[i].getPosition(),minimizers[i].getSequence()));
+      }
+    }
+    return relative;
+  }
+
+public:
+  /*!
+   * @param max_memory:    the memory cap of the cache in bytes
+   */
+  MinimizerWindowCache(uint64_t max_memory=(uint64_t)64<<20){
+    max_bytes=max_memory;
+  }
+
+  /*!
+   * Returns the minimizers of the window, shifted to the position of the window in the sequence. On a hit the
+   * minimizers are taken from the cache, on a miss they are computed and cached.
+   * @param window:     the bases of the updated variation-impact-range
+   * @param k_size:     length of the k-mers
+   * @param w_size:     window size for the minimizer generations
+   * @param posshift:   the position of the window in the sequence
+   * @param ordering:   the order in which the k-mers are compared (LEXICOGRAPHIC as in get_kmer_minimizers_algo)
+   */
+  template<class Pos>
+  std::vector<BasicMinimizer<Pos>> getMinimizers(std::string& window,int& k_size,int& w_size,Pos& posshift,KmerOrdering ordering=LEXICOGRAPHIC){
+    uint64_t hash=hashKey(window,k_size,w_size,ordering);
+    auto found=index.find(hash);
+    std::list<Entry>::iterator it;
+    if(found!=index.end() && found->second->window==window && found->second->k_size==k_size && found->second->w_size==w_size && found->second->ordering==ordering){
+      it=found->second;
+      entries.splice(entries.begin(),entries,it);
+      hits++;
+    }
+    else{
+      if(found!=index.end()){
+        //hash collision, the newer window replaces the cached one
+        erase(found->second);
+      }
+      misses++;
+      Entry entry;
+      entry.hash=hash;
+      entry.window=window;
+      entry.k_size=k_size;
+      entry.w_size=w_size;
+      entry.ordering=ordering;
+      entry.minimizers=computeMinimizers(window,k_size,w_size,ordering);
+      entry.bytes=entryBytes(entry);
+      entries.push_front(std::move(entry));
+      it=entries.begin();
+      index[hash]=it;
+      bytes+=it->bytes;
+    }
+    std::vector<BasicMinimizer<Pos>> minimizers;
+    minimizers.reserve(it->minimizers.size());
+    for(int i=0;i<(int)it->minimizers.size();i++){
+      Pos position=posshift+it->minimizers[i].first;
+      minimizers.push_back(BasicMinimizer<Pos>(position,it->minimizers[i].second));
+    }
+    //evict only after copying, an entry larger than the whole cache is still returned once
+    shrink();
+    return minimizers;
+  }
+
+  /*
+  * removes all entries, the counters are kept
+  */
+  void clear(){
+    entries.clear();
+    index.clear();
+    bytes=0;
+  }
+  void setMaxBytes(uint64_t max_memory){
+    max_bytes=max_memory;
+    shrink();
+  }
+  uint64_t getMaxBytes() const{
+    return max_bytes;
+  }
+  uint64_t getBytes() const{
+    return bytes;
+  }
+  uint64_t getNumberOfEntries() const{
+    return entries.size();
+  }
+  uint64_t getHits() const{
+    return hits;
+  }
+  uint64_t getMisses() const{
+    return misses;
+  }
+  uint64_t getEvictions() const{
+    return evictions;
+  }
+  double getHitRate() const{
+    return hits+misses==0 ? 0.0 : (double)hits/(hits+misses);
+  }
+  /*
+  * prints the counters and the size of the cache to the console
+  */
+  void printStatistics() const{
+    cout<<hits<<" hits, "<<misses<<" misses (hit rate "<<getHitRate()<<"), "<<evictions<<" evictions, "<<entries.size()<<" entries using "<<bytes<<" of "<<max_bytes<<" bytes\n";
+  }
+};
+
+/*!
+ * Implementation of the dynamic minimizer algorithm taking the minimizers of the updated variation-impact-ranges
+ * from a window cache. Meant for applying the variants of many samples to the same reference: the windows of
+ * alleles shared by several samples are only computed once.
+ * @param minimizerTree:     B-tree holding the final minimizers
+ * @param dynamic_sequence:  the sequence to be altered
+ * @param variants:          Vector of variants which are applied to the sequence
+ * @param k_size:            length of the k-mers
+ * @param w_size:            window size for the minimizer generations
+ * @param cache:             the cache of the window minimizers, shared by all samples
+ * @param observers:         (optional) liftover, undo journal, k-mer counts and change feed following the update
+ */
+template<class Pos>
+void compute_dynamic_minimizers_cached(B_tree<Pos,std::string,7,3>* minimizerTree,dyn::wt_str& dynamic_sequence,std::vector<BasicVariant<Pos>>& variants,int& k_size,int& w_size,MinimizerWindowCache& cache,BasicUpdateObservers<Pos> observers=BasicUpdateObservers<Pos>()){
+  apply_variants_to_dynamic_sequence(dynamic_sequence,variants,k_size,w_size,
+    [&](std::string& fullsubseq,Pos& thisstartpos,typename position_traits<Pos>::delta_type& var_impact_shift){
+      std::vector<BasicMinimizer<Pos>> newminis=cache.getMinimizers(fullsubseq,k_size,w_size,thisstartpos);
+      update_minimizerTree_with_minimizers(minimizerTree,newminis,thisstartpos,var_impact_shift,observers.journal,observers.frequencies,observers.feed);
+    },observers.liftover,observers.journal);
+}
+
+#endif